@@ -0,0 +1,104 @@
+#include "CRC32C.h"
+#include "CpuFeatures.h"
+#include <cstring>
+
+#if MFPIPE_X86_DISPATCH
+#include <nmmintrin.h>
+#endif
+
+namespace comm {
+namespace utils {
+
+	namespace {
+		/// slicing-by-8 tables for reflected polynomial 0x82F63B78
+		struct Tables {
+			uint32_t t[ 8 ][ 256 ];
+
+			Tables() {
+				for( uint32_t i = 0; i < 256; i++ ) {
+					uint32_t crc = i;
+					for( int k = 0; k < 8; k++ ) {
+						crc = ( crc >> 1 ) ^ ( ( crc & 1 ) ? 0x82F63B78u : 0 );
+					}
+					t[ 0 ][ i ] = crc;
+				}
+				for( uint32_t i = 0; i < 256; i++ ) {
+					for( int k = 1; k < 8; k++ ) {
+						t[ k ][ i ] = ( t[ k - 1 ][ i ] >> 8 ) ^ t[ 0 ][ t[ k - 1 ][ i ] & 0xFF ];
+					}
+				}
+			}
+		};
+
+		const Tables& GetTables() {
+			static const Tables tables;
+			return tables;
+		}
+
+#if MFPIPE_X86_DISPATCH
+		MFPIPE_TARGET( "sse4.2" )
+		uint32_t Crc32cSSE42( uint32_t crc, const byte* data, size_t len ) {
+			crc = ~crc;
+#if defined( __x86_64__ ) || defined( _M_X64 )
+			uint64_t crc64 = crc;
+			for( ; len >= sizeof( uint64_t ); len -= sizeof( uint64_t ), data += sizeof( uint64_t ) ) {
+				uint64_t v;
+				std::memcpy( &v, data, sizeof( v ) );
+				crc64 = _mm_crc32_u64( crc64, v );
+			}
+			crc = static_cast<uint32_t>( crc64 );
+#endif
+			for( ; len >= sizeof( uint32_t ); len -= sizeof( uint32_t ), data += sizeof( uint32_t ) ) {
+				uint32_t v;
+				std::memcpy( &v, data, sizeof( v ) );
+				crc = _mm_crc32_u32( crc, v );
+			}
+			for( ; len > 0; len--, data++ ) {
+				crc = _mm_crc32_u8( crc, *data );
+			}
+			return ~crc;
+		}
+#endif
+
+		using Crc32cFunc = uint32_t ( * )( uint32_t, const byte*, size_t );
+
+		Crc32cFunc SelectCrc32c() {
+#if MFPIPE_X86_DISPATCH
+			if( cpu::HasSSE42() ) {
+				return Crc32cSSE42;
+			}
+#endif
+			return Crc32cTable;
+		}
+	}  // namespace
+
+	uint32_t Crc32c( uint32_t crc, const byte* data, size_t len ) {
+		static const Crc32cFunc impl = SelectCrc32c();
+		return impl( crc, data, len );
+	}
+
+	uint32_t Crc32cTable( uint32_t crc, const byte* data, size_t len ) {
+		crc = ~crc;
+
+		const Tables& tables = GetTables();
+		const auto& t = tables.t;
+		for( ; len >= 8; len -= 8, data += 8 ) {
+			// little-endian
+			uint32_t lo;
+			uint32_t hi;
+			std::memcpy( &lo, data, sizeof( lo ) );
+			std::memcpy( &hi, data + 4, sizeof( hi ) );
+			lo ^= crc;
+			crc = t[ 7 ][ lo & 0xFF ] ^ t[ 6 ][ ( lo >> 8 ) & 0xFF ] ^ t[ 5 ][ ( lo >> 16 ) & 0xFF ] ^
+				  t[ 4 ][ lo >> 24 ] ^ t[ 3 ][ hi & 0xFF ] ^ t[ 2 ][ ( hi >> 8 ) & 0xFF ] ^
+				  t[ 1 ][ ( hi >> 16 ) & 0xFF ] ^ t[ 0 ][ hi >> 24 ];
+		}
+		for( ; len > 0; len--, data++ ) {
+			crc = ( crc >> 8 ) ^ t[ 0 ][ ( crc ^ *data ) & 0xFF ];
+		}
+
+		return ~crc;
+	}
+
+}  // namespace utils
+}  // namespace comm
@@ -0,0 +1,20 @@
+/**
+*	CRC32C (Castagnoli) checksum, uses SSE4.2 crc32 instruction when CPU supports it (checked once at runtime)
+*/
+#pragma once
+
+#include "MFTypes.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace comm {
+namespace utils {
+
+	/// continue checksum of data, start with crc = 0
+	uint32_t Crc32c( uint32_t crc, const byte* data, size_t len );
+
+	/// slicing-by-8 table implementation, the fallback of Crc32c() on CPUs without SSE4.2
+	uint32_t Crc32cTable( uint32_t crc, const byte* data, size_t len );
+
+}  // namespace utils
+}  // namespace comm
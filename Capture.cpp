@@ -0,0 +1,383 @@
+#include "Capture.h"
+#include "MappedFile.h"
+#include "ChunkReaderWriter.h"
+#include "Trace.h"
+#include "Log.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace comm {
+namespace utils {
+	namespace capture {
+
+		static_assert( sizeof( FileHeader ) == 64, "FileHeader is a part of file format" );
+		static_assert( sizeof( EntryHeader ) == 32, "EntryHeader is a part of file format" );
+		static_assert( sizeof( IndexEntry ) == 16, "IndexEntry is a part of file format" );
+
+		namespace {
+			size_t AlignUp( size_t size, size_t align ) {
+				return ( size + align - 1 ) / align * align;
+			}
+		}  // namespace
+
+		/***************************************************************************
+		*	                         Writer
+		***************************************************************************/
+
+		Writer::Writer( std::unique_ptr<MappedFile> file, size_t segment_size )
+			: m_File( std::move( file ) )
+			, m_SegmentSize( segment_size ) {
+			std::memset( &m_Header, 0, sizeof( m_Header ) );
+			std::memcpy( m_Header.magic, FileMagic, sizeof( FileMagic ) );
+			m_Header.version = FileVersion;
+			m_Header.header_size = sizeof( FileHeader );
+			m_Header.segment_size = segment_size;
+			m_Header.started = trace::Now();
+		}
+
+		Writer::~Writer() {
+			Close();
+		}
+
+		Writer::Ptr Writer::Create( const std::string& path, size_t segment_size ) {
+			auto file = MappedFile::Open( path, true );
+			if( file == nullptr ) {
+				return nullptr;
+			}
+			Ptr writer( new Writer( std::move( file ), AlignUp( std::max<size_t>( segment_size, 1 ), SegmentAlign ) ) );
+			if( !writer->MapSegment( sizeof( FileHeader ) ) ) {
+				return nullptr;
+			}
+			std::memcpy( writer->m_Segment.data, &writer->m_Header, sizeof( FileHeader ) );
+			writer->m_SegmentUsed = sizeof( FileHeader );
+			return writer;
+		}
+
+		bool Writer::AppendObject( Direction direction, const std::string& channel, const MF_BASE_TYPE& object,
+								   int64_t time ) {
+			return Append( direction, Kind::Object, object.GetObjectType(), channel, object.EncodedSize( EEncoding::Fixed ),
+						   time, [&]( ChunkWriter& writer ) { return object.Write( writer ); } );
+		}
+
+		bool Writer::AppendMessage( Direction direction, const std::string& channel, const std::string& name,
+									const std::string& param, int64_t time ) {
+			size_t size = EncodedSize( EEncoding::Fixed, name ) + EncodedSize( EEncoding::Fixed, param );
+			return Append( direction, Kind::Message, ObjectType::Base, channel, size, time, [&]( ChunkWriter& writer ) {
+				bool res = writer.Write( name );
+				res &= writer.Write( param );
+				return res;
+			} );
+		}
+
+		size_t Writer::GetCount() {
+			std::unique_lock lock( m_Lock );
+			return m_Index.size();
+		}
+
+		bool Writer::Close() {
+			std::unique_lock lock( m_Lock );
+			if( m_Closed ) {
+				return true;
+			}
+			m_Closed = true;
+
+			uint64_t end = m_SegmentOffset + m_SegmentUsed;
+			m_File->UnmapAll();
+			m_Segment = Segment{ nullptr, 0 };
+
+			m_Header.index_offset = end;
+			m_Header.index_count = m_Index.size();
+			bool res = m_File->Resize( end );
+			res = res && m_File->WriteAt( end, m_Index.data(), m_Index.size() * sizeof( IndexEntry ) );
+			// header refers to the index when it is written
+			res = res && m_File->WriteAt( 0, &m_Header, sizeof( m_Header ) );
+			if( !res ) {
+				MFPIPE_LOG( Warning, "capture index is not written", { "entries", m_Index.size() } );
+			}
+			m_Index.clear();
+			m_Index.shrink_to_fit();
+			return res;
+		}
+
+		bool Writer::Append( Direction direction, Kind kind, ObjectType object_type, const std::string& channel,
+							 size_t payload_size, int64_t time, const std::function<bool( ChunkWriter& )>& write ) {
+			if( channel.size() > UINT16_MAX ) {
+				return false;
+			}
+			size_t size = AlignUp( sizeof( EntryHeader ) + channel.size() + payload_size, 8 );
+			if( size > MaxEntrySize ) {
+				return false;
+			}
+
+			std::unique_lock lock( m_Lock );
+			if( m_Closed ) {
+				return false;
+			}
+			byte* data = Reserve( size );
+			if( data == nullptr ) {
+				return false;
+			}
+			uint64_t offset = m_SegmentOffset + ( data - m_Segment.data );
+
+			EntryHeader* header = reinterpret_cast<EntryHeader*>( data );
+			header->size = static_cast<uint32_t>( size );
+			header->direction = direction;
+			header->kind = kind;
+			header->channel_size = static_cast<uint16_t>( channel.size() );
+			header->object_type = static_cast<uint32_t>( object_type );
+			header->time = time;
+			header->payload_size = payload_size;
+			std::memcpy( header + 1, channel.data(), channel.size() );
+
+			// chunks are written directly to the mapped file
+			byte* payload = data + sizeof( EntryHeader ) + channel.size();
+			SinkChunkWriter<BufferSink> writer( BufferSink( payload, payload_size ), EEncoding::Fixed );
+			bool res = write( writer );
+			writer.Flush();
+			if( !res || writer.GetSink().GetSize() != payload_size ) {
+				header->magic = PaddingMagic;
+				return false;
+			}
+
+			header->magic = EntryMagic;
+			m_Index.push_back( IndexEntry{ offset, time } );
+			return true;
+		}
+
+		bool Writer::MapSegment( size_t size ) {
+			uint64_t offset = m_SegmentOffset + m_Segment.size;
+			size_t segment_size = std::max( m_SegmentSize, AlignUp( size, SegmentAlign ) );
+			if( !m_File->Resize( offset + segment_size ) ) {
+				return false;
+			}
+			byte* data = m_File->Map( offset, segment_size );
+			if( data == nullptr ) {
+				MFPIPE_LOG( Warning, "capture segment is not mapped", { "offset", offset }, { "size", segment_size } );
+				return false;
+			}
+			m_Segment = Segment{ data, segment_size };
+			m_SegmentOffset = offset;
+			m_SegmentUsed = 0;
+			return true;
+		}
+
+		byte* Writer::Reserve( size_t size ) {
+			size_t rest = m_Segment.size - m_SegmentUsed;
+			if( rest < size ) {
+				if( rest != 0 ) {
+					// the rest of segment is skipped by readers
+					uint32_t padding[ 2 ] = { PaddingMagic, static_cast<uint32_t>( rest ) };
+					std::memcpy( m_Segment.data + m_SegmentUsed, padding, sizeof( padding ) );
+					m_SegmentUsed = m_Segment.size;
+				}
+				if( !MapSegment( size ) ) {
+					return nullptr;
+				}
+			}
+			byte* data = m_Segment.data + m_SegmentUsed;
+			m_SegmentUsed += size;
+			return data;
+		}
+
+		/***************************************************************************
+		*	                         Reader
+		***************************************************************************/
+
+		Reader::Reader( std::unique_ptr<MappedFile> file )
+			: m_File( std::move( file ) ) {}
+
+		Reader::~Reader() = default;
+
+		Reader::Ptr Reader::Open( const std::string& path ) {
+			auto file = MappedFile::Open( path, false );
+			if( file == nullptr ) {
+				return nullptr;
+			}
+			Ptr reader( new Reader( std::move( file ) ) );
+			if( !reader->Load() ) {
+				return nullptr;
+			}
+			return reader;
+		}
+
+		int64_t Reader::GetStarted() const {
+			return reinterpret_cast<const FileHeader*>( m_Data )->started;
+		}
+
+		bool Reader::Get( size_t index, Entry& entry ) const {
+			if( index >= m_Offsets.size() ) {
+				return false;
+			}
+			const byte* data = m_Data + m_Offsets[ index ];
+			const EntryHeader* header = reinterpret_cast<const EntryHeader*>( data );
+			if( sizeof( EntryHeader ) + header->channel_size + header->payload_size > header->size ) {
+				return false;
+			}
+			entry.direction = header->direction;
+			entry.kind = header->kind;
+			entry.object_type = static_cast<ObjectType>( header->object_type );
+			entry.time = header->time;
+			entry.channel.assign( reinterpret_cast<const char*>( header + 1 ), header->channel_size );
+			entry.data = data + sizeof( EntryHeader ) + header->channel_size;
+			entry.size = static_cast<size_t>( header->payload_size );
+			return true;
+		}
+
+		MF_BASE_TYPE::Ptr Reader::LoadObject( const Entry& entry ) {
+			if( entry.kind != Kind::Object ) {
+				return nullptr;
+			}
+			auto object = MF_BASE_TYPE::CreateByObjectType( entry.object_type );
+			if( object == nullptr ) {
+				return nullptr;
+			}
+			ChunkReader reader( entry.data, entry.size, EEncoding::Fixed );
+			return object->Load( reader ) ? object : nullptr;
+		}
+
+		bool Reader::LoadMessage( const Entry& entry, std::string& name, std::string& param ) {
+			if( entry.kind != Kind::Message ) {
+				return false;
+			}
+			ChunkReader reader( entry.data, entry.size, EEncoding::Fixed );
+			bool res = reader.Read( name );
+			res &= reader.Read( param );
+			return res;
+		}
+
+		bool Reader::Load() {
+			uint64_t size = m_File->GetSize();
+			if( size < sizeof( FileHeader ) || size > SIZE_MAX ) {
+				return false;
+			}
+			m_Size = static_cast<size_t>( size );
+			m_Data = m_File->Map( 0, m_Size );
+			if( m_Data == nullptr ) {
+				return false;
+			}
+			const FileHeader* header = reinterpret_cast<const FileHeader*>( m_Data );
+			if( std::memcmp( header->magic, FileMagic, sizeof( FileMagic ) ) != 0 || header->version != FileVersion ||
+				header->header_size < sizeof( FileHeader ) || header->header_size > m_Size ) {
+				return false;
+			}
+
+			// index of closed capture
+			uint64_t index_end = header->index_offset + header->index_count * sizeof( IndexEntry );
+			if( header->index_offset >= header->header_size && index_end == m_Size ) {
+				const byte* index = m_Data + header->index_offset;
+				m_Offsets.reserve( static_cast<size_t>( header->index_count ) );
+				for( uint64_t i = 0; i < header->index_count; i++ ) {
+					IndexEntry el;
+					std::memcpy( &el, index + i * sizeof( IndexEntry ), sizeof( el ) );
+					const EntryHeader* entry = reinterpret_cast<const EntryHeader*>( m_Data + el.offset );
+					if( el.offset % 8 != 0 || el.offset + sizeof( EntryHeader ) > header->index_offset ||
+						entry->magic != EntryMagic || el.offset + entry->size > header->index_offset ) {
+						m_Offsets.clear();
+						break;
+					}
+					m_Offsets.push_back( el.offset );
+				}
+				m_Indexed = m_Offsets.size() == header->index_count;
+			}
+			if( !m_Indexed ) {
+				Scan();
+			}
+			return true;
+		}
+
+		void Reader::Scan() {
+			const FileHeader* header = reinterpret_cast<const FileHeader*>( m_Data );
+			size_t pos = AlignUp( header->header_size, 8 );
+			while( pos + 2 * sizeof( uint32_t ) <= m_Size ) {
+				uint32_t magic_size[ 2 ];
+				std::memcpy( magic_size, m_Data + pos, sizeof( magic_size ) );
+				uint32_t size = magic_size[ 1 ];
+				if( size < sizeof( magic_size ) || size % 8 != 0 || size > m_Size - pos ) {
+					break;
+				}
+				if( magic_size[ 0 ] == EntryMagic && size >= sizeof( EntryHeader ) ) {
+					m_Offsets.push_back( pos );
+				} else if( magic_size[ 0 ] != PaddingMagic ) {
+					// not written tail of the last segment
+					break;
+				}
+				pos += size;
+			}
+		}
+
+		/***************************************************************************
+		*	                         Replay
+		***************************************************************************/
+
+		Error Replay( MFPipe& pipe, const Reader& reader, const ReplaySettings& settings, ReplayStats* stats ) {
+			using Clock = std::chrono::steady_clock;
+
+			ReplayStats result_stats;
+			Error result = Error::Ok;
+			bool paced = settings.paced && settings.speed > 0;
+			auto started = Clock::now();
+			int64_t first = 0;
+			bool has_first = false;
+
+			Entry entry;
+			for( size_t i = 0; i < reader.GetCount(); i++ ) {
+				if( !reader.Get( i, entry ) ) {
+					result_stats.failed++;
+					result = Error::Fatal;
+					continue;
+				}
+				if( !( entry.direction == Direction::Sent ? settings.sent : settings.received ) ||
+					( !settings.channel.empty() && entry.channel != settings.channel ) ) {
+					continue;
+				}
+
+				if( paced ) {
+					if( !has_first ) {
+						first = entry.time;
+						has_first = true;
+					}
+					auto due = started + std::chrono::nanoseconds(
+											 static_cast<int64_t>( std::max<int64_t>( 0, entry.time - first ) / settings.speed ) );
+					auto now = Clock::now();
+					if( now < due ) {
+						std::this_thread::sleep_until( due );
+					} else {
+						result_stats.max_lag =
+							std::max<int64_t>( result_stats.max_lag,
+											   std::chrono::duration_cast<std::chrono::nanoseconds>( now - due ).count() );
+					}
+				}
+
+				Error err = Error::Fatal;
+				if( entry.kind == Kind::Object ) {
+					auto object = Reader::LoadObject( entry );
+					if( object != nullptr ) {
+						err = pipe.PipePut( entry.channel, object, settings.max_wait_ms, std::string() );
+					}
+					result_stats.objects += err == Error::Ok ? 1 : 0;
+				} else {
+					std::string name;
+					std::string param;
+					if( Reader::LoadMessage( entry, name, param ) ) {
+						err = pipe.PipeMessagePut( entry.channel, name, param, settings.max_wait_ms );
+					}
+					result_stats.messages += err == Error::Ok ? 1 : 0;
+				}
+				if( err != Error::Ok ) {
+					result_stats.failed++;
+					result = err;
+				}
+			}
+
+			result_stats.seconds = std::chrono::duration<double>( Clock::now() - started ).count();
+			if( stats != nullptr ) {
+				*stats = result_stats;
+			}
+			return result;
+		}
+
+	}  // namespace capture
+}  // namespace utils
+}  // namespace comm
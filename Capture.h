@@ -0,0 +1,233 @@
+/**
+*	Capture of pipe traffic for repeatable load tests ("capture=path" hint of PipeCreate/PipeOpen):
+*	- every object/message put by the pipe and every object/message taken by PipeGet/PipeMessageGet is appended
+*	  to capture file as entry: direction, channel, object type, wall clock ns and serialized chunks of the object
+*	  (fixed encoding, uncompressed, frames of delta channels are captured as full frames)
+*	- the file is append-only sequence of memory-mapped segments ("capture_segment=MB", 64 by default), entry is
+*	  written directly to the mapped segment; entry which does not fit the rest of segment starts the next one
+*	- Close() truncates the file to written entries and appends index (offset and time of every entry); capture
+*	  without index (e.g. the process crashed) is read by scan of entries
+*	- Replay() puts captured objects/messages to a pipe at original pacing (optionally scaled) or as fast as
+*	  possible, see mfpipe_replay tool
+*
+*	File layout: FileHeader | entries (EntryHeader | channel | chunks | padding to 8 bytes) ... | IndexEntry[]
+*/
+#pragma once
+
+#include "MFTypes.h"
+#include "MFObjects.h"
+#include "MFPipe.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace comm {
+namespace utils {
+	class MappedFile;
+
+	namespace capture {
+
+		enum class Direction : byte {
+			/// put by the capturing pipe
+			Sent = 0,
+			/// taken by PipeGet/PipeMessageGet of the capturing pipe
+			Received = 1,
+		};
+
+		enum class Kind : byte {
+			Object = 0,
+			Message = 1,
+		};
+
+		constexpr char FileMagic[ 8 ] = { 'M', 'F', 'P', 'C', 'A', 'P', 'T', 'R' };
+		constexpr uint32_t FileVersion = 1;
+		constexpr uint32_t EntryMagic = 0x52544E45;  // "ENTR"
+		/// skipped space: the rest of segment or failed entry, only magic and size are written
+		constexpr uint32_t PaddingMagic = 0x44444150;  // "PADD"
+		constexpr size_t DefaultSegmentSize = 64 * 1024 * 1024;
+		/// segments are multiple of mapping granularity (64 KB on Windows)
+		constexpr size_t SegmentAlign = 64 * 1024;
+
+		struct FileHeader {
+			char magic[ 8 ];
+			uint32_t version;
+			uint32_t header_size;
+			uint64_t segment_size;
+			/// offset of index, 0 - the capture is not closed
+			uint64_t index_offset;
+			uint64_t index_count;
+			/// wall clock ns of capture start
+			int64_t started;
+			uint64_t reserved[ 2 ];
+		};
+
+		struct EntryHeader {
+			/// EntryMagic, written last: entry with other value is not complete
+			uint32_t magic;
+			/// size of entry with header and padding
+			uint32_t size;
+			Direction direction;
+			Kind kind;
+			uint16_t channel_size;
+			/// ObjectType of object
+			uint32_t object_type;
+			/// wall clock ns: put start for sent entries, arrival for received ones
+			int64_t time;
+			uint64_t payload_size;
+		};
+
+		struct IndexEntry {
+			uint64_t offset;
+			int64_t time;
+		};
+
+		/// max size of one entry (EntryHeader::size)
+		constexpr size_t MaxEntrySize = UINT32_MAX & ~size_t( 7 );
+
+		struct Entry {
+			Direction direction{ Direction::Sent };
+			Kind kind{ Kind::Object };
+			ObjectType object_type{ ObjectType::Base };
+			int64_t time{ 0 };
+			std::string channel;
+			/// serialized chunks (fixed encoding), they point to mapped file
+			const byte* data{ nullptr };
+			size_t size{ 0 };
+		};
+
+		/**
+		*	Appends entries to capture file, Append*() may be called by several threads
+		*/
+		class Writer {
+		public:
+			using Ptr = std::unique_ptr<Writer>;
+
+		protected:
+			struct Segment {
+				byte* data;
+				size_t size;
+			};
+
+			std::unique_ptr<MappedFile> m_File;
+			size_t m_SegmentSize;
+			FileHeader m_Header;
+			/// lock of entries appending
+			std::mutex m_Lock;
+			/// the current mapped segment, segments stay mapped till Close()
+			Segment m_Segment{ nullptr, 0 };
+			/// file offset of the current segment
+			uint64_t m_SegmentOffset{ 0 };
+			/// used bytes of the current segment
+			size_t m_SegmentUsed{ 0 };
+			std::vector<IndexEntry> m_Index;
+			bool m_Closed{ false };
+
+		public:
+			~Writer();
+
+			/// create (truncate) capture file
+			/// @return nullptr - the file can not be created or mapped
+			static Ptr Create( const std::string& path, size_t segment_size = DefaultSegmentSize );
+
+			bool AppendObject( Direction direction, const std::string& channel, const MF_BASE_TYPE& object, int64_t time );
+			bool AppendMessage( Direction direction, const std::string& channel, const std::string& name,
+								const std::string& param, int64_t time );
+
+			/// number of appended entries
+			size_t GetCount();
+
+			/// write index and truncate the file, next Append*() fail
+			bool Close();
+
+		protected:
+			Writer( std::unique_ptr<MappedFile> file, size_t segment_size );
+
+			/// write entry with payload of the size written by the callback
+			bool Append( Direction direction, Kind kind, ObjectType object_type, const std::string& channel,
+						 size_t payload_size, int64_t time, const std::function<bool( ChunkWriter& )>& write );
+			/// map the next segment of at least size bytes
+			bool MapSegment( size_t size );
+			/// space for entry of the size (multiple of 8) in mapped segment, m_Lock is held
+			/// @return nullptr - the segment can not be mapped
+			byte* Reserve( size_t size );
+		};
+
+		/**
+		*	Reads capture file, it is mapped for reading as a whole
+		*/
+		class Reader {
+		public:
+			using Ptr = std::unique_ptr<Reader>;
+
+		protected:
+			std::unique_ptr<MappedFile> m_File;
+			const byte* m_Data{ nullptr };
+			size_t m_Size{ 0 };
+			std::vector<uint64_t> m_Offsets;
+			bool m_Indexed{ false };
+
+		public:
+			~Reader();
+
+			/// @return nullptr - the file can not be read or it is not a capture
+			static Ptr Open( const std::string& path );
+
+			size_t GetCount() const {
+				return m_Offsets.size();
+			}
+
+			/// index is present, otherwise complete entries are found by scan
+			bool IsIndexed() const {
+				return m_Indexed;
+			}
+
+			/// wall clock ns of capture start
+			int64_t GetStarted() const;
+
+			bool Get( size_t index, Entry& entry ) const;
+
+			/// @return nullptr - the entry is not an object or it is damaged
+			static MF_BASE_TYPE::Ptr LoadObject( const Entry& entry );
+			static bool LoadMessage( const Entry& entry, std::string& name, std::string& param );
+
+		protected:
+			explicit Reader( std::unique_ptr<MappedFile> file );
+
+			bool Load();
+			/// offsets of complete entries following the header
+			void Scan();
+		};
+
+		struct ReplaySettings {
+			/// keep intervals between entries, otherwise put them as fast as possible
+			bool paced{ true };
+			/// pacing speed factor, 2 - twice faster than captured
+			double speed{ 1.0 };
+			bool sent{ true };
+			bool received{ true };
+			/// replay only the channel, empty - all channels
+			std::string channel;
+			/// _nMaxWaitMs of PipePut/PipeMessagePut
+			int max_wait_ms{ 1000 };
+		};
+
+		struct ReplayStats {
+			size_t objects{ 0 };
+			size_t messages{ 0 };
+			/// failed puts and damaged entries
+			size_t failed{ 0 };
+			/// the longest delay behind captured pacing in ns
+			int64_t max_lag{ 0 };
+			double seconds{ 0 };
+		};
+
+		/// put captured objects/messages to the opened pipe, entries are replayed in order of the capture
+		/// @return Error::Ok - all selected entries were put
+		Error Replay( MFPipe& pipe, const Reader& reader, const ReplaySettings& settings, ReplayStats* stats = nullptr );
+
+	}  // namespace capture
+}  // namespace utils
+}  // namespace comm
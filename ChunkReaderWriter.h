@@ -4,12 +4,58 @@
 #pragma once
 
 #include "Transport.h"
+#include "CRC32C.h"
+#include "Compression.h"
 #include <functional>
+#include <cstring>
 #include <cassert>
 #include <algorithm>
+#include <type_traits>
+#include <tuple>
+#include <utility>
+#include <deque>
+#include <memory>
 
 namespace comm {
 namespace utils {
+	/**
+	*	Wire encoding of chunks
+	*	- Fixed: [uint32 size (prefix included)][byte type][data]
+	*	- Compact: [byte type << 5 | size][data] for size < 31, [byte type << 5 | 31][LEB128 size][data] otherwise,
+	*	  uint32 values are stored as LEB128 too
+	*/
+	enum class EEncoding : byte {
+		Fixed = 0,
+		Compact = 1,
+	};
+
+	namespace compact {
+		constexpr byte TypeShift = 5;
+		/// size value in tag meaning that LEB128 size follows
+		constexpr byte LongSize = 0x1f;
+		constexpr size_t MaxVarintSize = 5;
+		constexpr size_t MaxPrefixSize = 1 + MaxVarintSize;
+
+		inline size_t PutVarint( uint32_t val, byte* out ) {
+			size_t size = 0;
+			while( val >= 0x80 ) {
+				out[ size++ ] = static_cast<byte>( val | 0x80 );
+				val >>= 7;
+			}
+			out[ size++ ] = static_cast<byte>( val );
+			return size;
+		}
+
+		inline size_t PutPrefix( byte type, size_t len, byte* out ) {
+			if( len < LongSize ) {
+				out[ 0 ] = static_cast<byte>( ( type << TypeShift ) | len );
+				return 1;
+			}
+			out[ 0 ] = static_cast<byte>( ( type << TypeShift ) | LongSize );
+			return 1 + PutVarint( static_cast<uint32_t>( len ), out + 1 );
+		}
+	}  // namespace compact
+
 	namespace traits {
 		enum class ETypes : byte {
 			UInt32 = 1,
@@ -17,6 +63,8 @@ namespace utils {
 			Char = 3,
 			String = 4,
 			BytesArray = 5,
+			Block = 6,     // POD structure with fixed layout
+			Checksum = 7,  // CRC32C of stream before the chunk
 		};
 
 		template<typename TYPE>
@@ -36,8 +84,176 @@ namespace utils {
 		template<typename TYPE>
 		Output GetValueBuffer( TYPE& val, uint32_t size );
 
+		/// size of chunk prefix: uint32 size (prefix included) + type
+		constexpr size_t ChunkPrefixSize = sizeof( uint32_t ) + sizeof( byte );
+
+		/// compile-time type code and value size (0 - variable size) of chunk
+		template<typename TYPE>
+		struct TypeInfo;
+
+		template<>
+		struct TypeInfo<uint32_t> {
+			static constexpr ETypes type = ETypes::UInt32;
+			static constexpr size_t fixed_size = sizeof( uint32_t );
+		};
+
+		template<>
+		struct TypeInfo<byte> {
+			static constexpr ETypes type = ETypes::Byte;
+			static constexpr size_t fixed_size = sizeof( byte );
+		};
+
+		template<>
+		struct TypeInfo<char> {
+			static constexpr ETypes type = ETypes::Char;
+			static constexpr size_t fixed_size = sizeof( char );
+		};
+
+		template<>
+		struct TypeInfo<std::string> {
+			static constexpr ETypes type = ETypes::String;
+			static constexpr size_t fixed_size = 0;
+		};
+
+		template<>
+		struct TypeInfo<std::vector<byte>> {
+			static constexpr ETypes type = ETypes::BytesArray;
+			static constexpr size_t fixed_size = 0;
+		};
+
 	}  // namespace traits
 
+	/**
+	*	Compile-time schema of serialized object, fields are declared once by the object:
+	*		static constexpr auto Schema() {
+	*			return schema::Fields( schema::Field( &OBJ::name ), schema::FieldAs<uint32_t>( &OBJ::flags ) );
+	*		}
+	*	ChunkWriter::WriteSchema/ChunkReader::ReadSchema produce/consume the same stream as per-field Write/Read
+	*/
+	namespace schema {
+		template<typename OBJ, typename MEMBER, typename WIRE>
+		struct FieldDesc {
+			using Member = MEMBER;
+			using Wire = WIRE;
+			static constexpr byte type = static_cast<byte>( traits::TypeInfo<WIRE>::type );
+			static constexpr size_t fixed_size = traits::TypeInfo<WIRE>::fixed_size;
+			static constexpr bool is_fixed = fixed_size != 0;
+
+			MEMBER OBJ::*member;
+		};
+
+		/// field stored as its own type
+		template<typename OBJ, typename MEMBER>
+		constexpr FieldDesc<OBJ, MEMBER, MEMBER> Field( MEMBER OBJ::*member ) {
+			return { member };
+		}
+
+		/// field stored as WIRE type (e.g. enum as uint32_t)
+		template<typename WIRE, typename OBJ, typename MEMBER>
+		constexpr FieldDesc<OBJ, MEMBER, WIRE> FieldAs( MEMBER OBJ::*member ) {
+			return { member };
+		}
+
+		template<typename... FIELDS>
+		constexpr std::tuple<FIELDS...> Fields( FIELDS... fields ) {
+			return std::tuple<FIELDS...>( fields... );
+		}
+
+		/// size of all prefixes and fixed size values of schema
+		template<typename FIELDS>
+		struct FixedPart;
+
+		template<typename... FIELDS>
+		struct FixedPart<std::tuple<FIELDS...>> {
+			static constexpr size_t size = ( ( traits::ChunkPrefixSize + FIELDS::fixed_size ) + ... + 0 );
+		};
+
+		/// size of run of adjacent fixed size fields starting from field I
+		template<size_t I, typename FIELDS>
+		constexpr size_t RunSize() {
+			if constexpr( I >= std::tuple_size<FIELDS>::value ) {
+				return 0;
+			} else {
+				using FIELD = std::tuple_element_t<I, FIELDS>;
+				if constexpr( !FIELD::is_fixed ) {
+					return 0;
+				} else {
+					return traits::ChunkPrefixSize + FIELD::fixed_size + RunSize<I + 1, FIELDS>();
+				}
+			}
+		}
+
+		/// field I is the first one in run of fixed size fields
+		template<size_t I, typename FIELDS>
+		constexpr bool IsRunStart() {
+			if constexpr( I == 0 ) {
+				return true;
+			} else {
+				return !std::tuple_element_t<I - 1, FIELDS>::is_fixed;
+			}
+		}
+
+		/// value of field as it is stored in stream (reference if types are the same)
+		template<typename OBJ, typename FIELD>
+		decltype( auto ) WireValue( const OBJ& obj, const FIELD& field ) {
+			if constexpr( std::is_same<typename FIELD::Wire, typename FIELD::Member>::value ) {
+				return ( obj.*field.member );
+			} else {
+				return static_cast<typename FIELD::Wire>( obj.*field.member );
+			}
+		}
+
+		inline byte* PutPrefix( byte* out, byte type, size_t len ) {
+			uint32_t size32 = static_cast<uint32_t>( len + traits::ChunkPrefixSize );
+			std::memcpy( out, &size32, sizeof( size32 ) );
+			out[ sizeof( size32 ) ] = type;
+			return out + traits::ChunkPrefixSize;
+		}
+	}  // namespace schema
+
+	/// size of chunk with len bytes of data
+	inline size_t EncodedChunkSize( EEncoding encoding, size_t len ) {
+		if( encoding == EEncoding::Fixed ) {
+			return traits::ChunkPrefixSize + len;
+		}
+		byte prefix[ compact::MaxPrefixSize ];
+		return compact::PutPrefix( 0, len, prefix ) + len;
+	}
+
+	/// size of value written by ChunkWriter::Write()
+	template<typename TYPE>
+	size_t EncodedSize( EEncoding encoding, const TYPE& val ) {
+		if constexpr( std::is_same<TYPE, uint32_t>::value ) {
+			if( encoding == EEncoding::Compact ) {
+				byte varint[ compact::MaxVarintSize ];
+				return EncodedChunkSize( encoding, compact::PutVarint( val, varint ) );
+			}
+		}
+		return EncodedChunkSize( encoding, traits::ValueToSize( val ) );
+	}
+
+	/// size of block written by ChunkWriter::WriteBlock()
+	template<typename TYPE>
+	size_t EncodedBlockSize( EEncoding encoding ) {
+		return EncodedChunkSize( encoding, sizeof( TYPE ) );
+	}
+
+	/// size of fields written by ChunkWriter::WriteSchema()
+	template<typename OBJ>
+	size_t EncodedSchemaSize( EEncoding encoding, const OBJ& obj ) {
+		size_t size = 0;
+		auto add = [&]( const auto& field ) { size += EncodedSize( encoding, schema::WireValue( obj, field ) ); };
+		std::apply( [&]( const auto&... field ) { ( add( field ), ... ); }, OBJ::Schema() );
+		return size;
+	}
+
+	/**
+	*	Write data to chunked stream
+	*	Buffers are taken from the sink: std::function allocator/writer pair for this class, SinkChunkWriter<SINK>
+	*	for sink policies. Sink is called once per buffer, encoding and copying are not virtual.
+	*	Bytes arrays are compressed when compression is enabled: compression::Header block followed by chunk per
+	*	compressed block.
+	*/
 	class ChunkWriter {
 	public:
 		using Allocator = std::function<NetBufferRef*( size_t )>;
@@ -46,24 +262,77 @@ namespace utils {
 	protected:
 		Allocator m_Allocator;
 		Writer m_Writer;
+		EEncoding m_Encoding;
 		NetBufferSeq m_Buffers;
 		size_t m_Buffer{ 0 };
 		size_t m_PosInBuffer{ 0 };
+		/// checksum is computed while data is copied
+		bool m_Checksum{ false };
+		uint32_t m_Crc{ 0 };
+		/// compressor of bytes arrays, nullptr - compression is disabled
+		std::unique_ptr<Compressor> m_Compressor;
 
 	public:
-		ChunkWriter( Allocator allocator, Writer writer )
+		ChunkWriter( Allocator allocator, Writer writer, EEncoding encoding = EEncoding::Fixed )
 			: m_Allocator( allocator )
-			, m_Writer( writer ) {}
+			, m_Writer( writer )
+			, m_Encoding( encoding ) {}
+
+		virtual ~ChunkWriter() {}
+
+		/// size of value in stream of this writer
+		template<typename TYPE>
+		size_t EncodedSize( const TYPE& val ) const {
+			return utils::EncodedSize( m_Encoding, val );
+		}
+
+		EEncoding GetEncoding() const {
+			return m_Encoding;
+		}
+
+		/// start computing checksum of written data
+		void EnableChecksum() {
+			m_Checksum = true;
+			m_Crc = 0;
+		}
+
+		/// write checksum of data written after EnableChecksum(), it should be the last chunk of stream
+		bool WriteChecksum() {
+			uint32_t crc = m_Crc;
+			m_Checksum = false;
+			return CheckAndWrite( static_cast<byte>( traits::ETypes::Checksum ), reinterpret_cast<const byte*>( &crc ),
+								  sizeof( crc ) );
+		}
+
+		/// compress bytes arrays of compression::MinSize bytes or more (ECodec::None disables compression)
+		/// @param level - codec specific level, 0 - default
+		void EnableCompression( ECodec codec, int level = 0 ) {
+			if( codec == ECodec::None ) {
+				m_Compressor.reset();
+			} else if( m_Compressor == nullptr || m_Compressor->GetCodec() != codec ) {
+				m_Compressor.reset( new Compressor( codec, level ) );
+			}
+		}
+
+		/// take buffers for size bytes from the sink in one step
+		bool Reserve( size_t size ) {
+			return CheckAndAlloc( size );
+		}
 
 		bool CheckAndWrite( byte type, const byte* data, size_t len ) {
-			size_t size = len + sizeof( type ) + sizeof( uint32_t );
-			if( !CheckAndAlloc( size ) ) {
+			byte prefix[ compact::MaxPrefixSize ];
+			size_t prefix_size;
+			if( m_Encoding == EEncoding::Compact ) {
+				prefix_size = compact::PutPrefix( type, len, prefix );
+			} else {
+				prefix_size = schema::PutPrefix( prefix, type, len ) - prefix;
+			}
+
+			if( !CheckAndAlloc( prefix_size + len ) ) {
 				return false;
 			}
 
-			uint32_t size32 = static_cast<uint32_t>( size );
-			WriteSafe( reinterpret_cast<const byte*>( &size32 ), sizeof( size32 ) );
-			WriteSafe( reinterpret_cast<const byte*>( &type ), sizeof( byte ) );
+			WriteSafe( prefix, prefix_size );
 			WriteSafe( data, len );
 
 			return true;
@@ -71,20 +340,206 @@ namespace utils {
 
 		template<typename TYPE>
 		bool Write( const TYPE& val ) {
+			if constexpr( std::is_same<TYPE, std::vector<byte>>::value ) {
+				if( m_Compressor != nullptr && val.size() >= compression::MinSize ) {
+					return WriteBytes( val.size(), [&]( auto put ) { put( val.data(), val.size() ); } );
+				}
+			}
+			if constexpr( std::is_same<TYPE, uint32_t>::value ) {
+				if( m_Encoding == EEncoding::Compact ) {
+					byte varint[ compact::MaxVarintSize ];
+					size_t size = compact::PutVarint( val, varint );
+					return CheckAndWrite( traits::TypeToByte<TYPE>(), varint, size );
+				}
+			}
 			return CheckAndWrite( traits::TypeToByte<TYPE>(), traits::ValueToData( val ), traits::ValueToSize( val ) );
 		}
 
+		/**
+		*	Write bytes array gathered from pieces (e.g. image rows without stride padding), it is read back as
+		*	std::vector<byte> or by ChunkReader::ReadBytes()
+		*	@param len - size of array
+		*	@param fill - fill( put ) calls put( const byte* data, size_t size ) for pieces of len bytes in total
+		*/
+		template<typename FILL>
+		bool WriteBytes( size_t len, FILL fill ) {
+			constexpr byte type = static_cast<byte>( traits::ETypes::BytesArray );
+			if( m_Compressor != nullptr && len >= compression::MinSize ) {
+				return WriteCompressed( len, fill );
+			}
+
+			byte prefix[ compact::MaxPrefixSize ];
+			size_t prefix_size;
+			if( m_Encoding == EEncoding::Compact ) {
+				prefix_size = compact::PutPrefix( type, len, prefix );
+			} else {
+				prefix_size = schema::PutPrefix( prefix, type, len ) - prefix;
+			}
+			if( !CheckAndAlloc( prefix_size + len ) ) {
+				return false;
+			}
+
+			WriteSafe( prefix, prefix_size );
+			size_t written = 0;
+			fill( [&]( const byte* data, size_t size ) {
+				size = std::min( size, len - written );
+				WriteSafe( data, size );
+				written += size;
+			} );
+			return written == len;
+		}
+
+		/// write POD structure as one block, it is read back by single copy
+		template<typename TYPE>
+		bool WriteBlock( const TYPE& val ) {
+			static_assert( std::is_trivially_copyable<TYPE>::value, "block should be trivially copyable" );
+			return CheckAndWrite( static_cast<byte>( traits::ETypes::Block ), reinterpret_cast<const byte*>( &val ),
+								  sizeof( val ) );
+		}
+
+		/**
+		*	Write fields declared by OBJ::Schema(): space is checked once, prefixes and adjacent fixed size values
+		*	are staged and copied to stream by one write per variable size field
+		*/
+		template<typename OBJ>
+		bool WriteSchema( const OBJ& obj ) {
+			constexpr auto fields = OBJ::Schema();
+			using Fields = std::remove_const_t<decltype( fields )>;
+
+			if( m_Encoding != EEncoding::Fixed || m_Compressor != nullptr ) {
+				// compact prefixes and compressed sizes depend on values, write field by field
+				bool res = true;
+				std::apply( [&]( const auto&... field ) { ( ( res = res && WriteFieldValue( obj, field ) ), ... ); },
+							fields );
+				return res;
+			}
+
+			size_t size = schema::FixedPart<Fields>::size;
+			std::apply( [&]( const auto&... field ) { ( ( size += VariableSize( obj, field ) ), ... ); }, fields );
+			if( !CheckAndAlloc( size ) ) {
+				return false;
+			}
+
+			byte stage[ schema::FixedPart<Fields>::size ];
+			byte* pos = stage;
+			std::apply( [&]( const auto&... field ) { ( WriteField( obj, field, stage, pos ), ... ); }, fields );
+			WriteSafe( stage, pos - stage );
+
+			return true;
+		}
+
 		void Flush() {
-			NetBufferRef* buffer = m_Buffers[ m_Buffer ];
-			m_Writer( buffer, m_PosInBuffer );
+			if( !m_Buffers.empty() ) {
+				SinkWrite( m_Buffers[ m_Buffer ], m_PosInBuffer );
+			}
 		}
 
 	protected:
+		explicit ChunkWriter( EEncoding encoding )
+			: m_Encoding( encoding ) {}
+
+		/// get next buffer from the sink, size is a hint (amount of data to be written)
+		virtual NetBufferRef* SinkAlloc( size_t size ) {
+			return m_Allocator( size );
+		}
+
+		/// pass filled buffer to the sink
+		virtual void SinkWrite( NetBufferRef* buffer, size_t len ) {
+			m_Writer( buffer, len );
+		}
+
+		/**
+		*	Write compressed bytes array: full blocks of pieces are compressed in place, the rest is gathered to
+		*	block stage first
+		*/
+		template<typename FILL>
+		bool WriteCompressed( size_t len, FILL fill ) {
+			compression::Header header = {};
+			header.codec = static_cast<byte>( m_Compressor->GetCodec() );
+			header.raw_size = static_cast<uint32_t>( len );
+			header.block_size = static_cast<uint32_t>( compression::BlockSize );
+			if( !WriteBlock( header ) ) {
+				return false;
+			}
+
+			bool res = true;
+			size_t written = 0;
+			size_t staged = 0;
+			byte* stage = m_Compressor->GetInputStage();
+			fill( [&]( const byte* data, size_t size ) {
+				size = std::min( size, len - written );
+				written += size;
+				while( res && size > 0 ) {
+					if( staged == 0 && size >= compression::BlockSize ) {
+						res = WriteCompressedBlock( data, compression::BlockSize );
+						data += compression::BlockSize;
+						size -= compression::BlockSize;
+						continue;
+					}
+					size_t copy_size = std::min( compression::BlockSize - staged, size );
+					std::memcpy( stage + staged, data, copy_size );
+					staged += copy_size;
+					data += copy_size;
+					size -= copy_size;
+					if( staged == compression::BlockSize ) {
+						res = WriteCompressedBlock( stage, staged );
+						staged = 0;
+					}
+				}
+			} );
+			if( res && staged != 0 ) {
+				res = WriteCompressedBlock( stage, staged );
+			}
+			return res && written == len;
+		}
+
+		/// block which does not shrink is stored as is
+		bool WriteCompressedBlock( const byte* data, size_t len ) {
+			size_t compressed_size;
+			const byte* compressed = m_Compressor->Compress( data, len, compressed_size );
+			if( compressed != nullptr ) {
+				return CheckAndWrite( static_cast<byte>( traits::ETypes::BytesArray ), compressed, compressed_size );
+			}
+			return CheckAndWrite( static_cast<byte>( traits::ETypes::BytesArray ), data, len );
+		}
+
+		template<typename OBJ, typename FIELD>
+		static size_t VariableSize( const OBJ& obj, const FIELD& field ) {
+			if constexpr( FIELD::is_fixed ) {
+				return 0;
+			} else {
+				return traits::ValueToSize( obj.*field.member );
+			}
+		}
+
+		template<typename OBJ, typename FIELD>
+		bool WriteFieldValue( const OBJ& obj, const FIELD& field ) {
+			return Write( schema::WireValue( obj, field ) );
+		}
+
+		template<typename OBJ, typename FIELD>
+		void WriteField( const OBJ& obj, const FIELD& field, byte* stage, byte*& pos ) {
+			using Wire = typename FIELD::Wire;
+			if constexpr( FIELD::is_fixed ) {
+				Wire val = static_cast<Wire>( obj.*field.member );
+				pos = schema::PutPrefix( pos, FIELD::type, sizeof( val ) );
+				std::memcpy( pos, &val, sizeof( val ) );
+				pos += sizeof( val );
+			} else {
+				const Wire& val = obj.*field.member;
+				size_t len = traits::ValueToSize( val );
+				pos = schema::PutPrefix( pos, FIELD::type, len );
+				WriteSafe( stage, pos - stage );
+				WriteSafe( traits::ValueToData( val ), len );
+				pos = stage;
+			}
+		}
+
 		bool CheckAndAlloc( size_t size ) {
 			size_t available = m_Buffers.empty() ? 0 : m_Buffers[ m_Buffer ]->size - m_PosInBuffer;
 			while( available < size ) {
 				size_t req_size = size - available;
-				NetBufferRef* net_buffer = m_Allocator( req_size );
+				NetBufferRef* net_buffer = SinkAlloc( req_size );
 				if( net_buffer == nullptr ) {
 					return false;
 				}
@@ -99,13 +554,16 @@ namespace utils {
 				NetBufferRef* buffer = m_Buffers[ m_Buffer ];
 				size_t available = buffer->size - m_PosInBuffer;
 				if( available == 0 ) {
-					m_Writer( buffer, m_PosInBuffer );
+					SinkWrite( buffer, m_PosInBuffer );
 					buffer = m_Buffers[ ++m_Buffer ];
 					available = buffer->size;
 					m_PosInBuffer = 0;
 				}
 				size_t copy_size = std::min( available, size );
 				std::memcpy( buffer->data + m_PosInBuffer, data, copy_size );
+				if( m_Checksum ) {
+					m_Crc = utils::Crc32c( m_Crc, buffer->data + m_PosInBuffer, copy_size );
+				}
 				size -= copy_size;
 				data += copy_size;
 				m_PosInBuffer += copy_size;
@@ -114,7 +572,187 @@ namespace utils {
 	};
 
 	/**
-	*	Read data from chunked stream
+	*	Check stream ending with Checksum chunk (ChunkWriter::WriteChecksum)
+	*/
+	inline bool VerifyChecksum( const ConstNetBufferSeq& buffers, EEncoding encoding ) {
+		size_t total = 0;
+		for( const auto buf : buffers ) {
+			total += buf->size;
+		}
+		size_t trailer = EncodedChunkSize( encoding, sizeof( uint32_t ) );
+		if( total < trailer ) {
+			return false;
+		}
+
+		// checksum covers data before the trailer chunk, stored value is the last bytes of the stream
+		size_t covered = total - trailer;
+		size_t pos = 0;
+		uint32_t crc = 0;
+		byte stored[ sizeof( uint32_t ) ];
+		for( const auto buf : buffers ) {
+			size_t in_crc = pos < covered ? std::min( buf->size, covered - pos ) : 0;
+			crc = Crc32c( crc, buf->data, in_crc );
+			size_t tail = total - sizeof( stored );
+			for( size_t i = std::max( pos, tail ); i < pos + buf->size; i++ ) {
+				stored[ i - tail ] = buf->data[ i - pos ];
+			}
+			pos += buf->size;
+		}
+
+		uint32_t value;
+		std::memcpy( &value, stored, sizeof( value ) );
+		return value == crc;
+	}
+
+	/**
+	*	Sink policy writing to composed transport message
+	*/
+	class MsgComposeSink {
+	protected:
+		IMsgCompose& m_Msg;
+
+	public:
+		explicit MsgComposeSink( IMsgCompose& msg )
+			: m_Msg( msg ) {}
+
+		NetBufferRef* Alloc( size_t size ) {
+			return m_Msg.AllocBuffer();
+		}
+
+		void Write( NetBufferRef* buffer, size_t len ) {
+			m_Msg.Write( buffer, len );
+		}
+	};
+
+	/**
+	*	Sink policy appending to contiguous byte vector
+	*/
+	class VectorSink {
+	protected:
+		struct Segment {
+			NetBufferRef ref;
+			size_t offset;
+		};
+
+		std::vector<byte>& m_Output;
+		/// allocated segments, their data pointers follow vector reallocations
+		std::deque<Segment> m_Segments;
+
+	public:
+		explicit VectorSink( std::vector<byte>& output )
+			: m_Output( output ) {}
+
+		NetBufferRef* Alloc( size_t size ) {
+			size_t offset = m_Output.size();
+			byte* base = m_Output.data();
+			m_Output.resize( offset + size );
+			if( m_Output.data() != base ) {
+				for( auto& el : m_Segments ) {
+					el.ref.data = m_Output.data() + el.offset;
+				}
+			}
+			m_Segments.push_back( Segment{ NetBufferRef{ m_Output.data() + offset, size }, offset } );
+			return &m_Segments.back().ref;
+		}
+
+		void Write( NetBufferRef* buffer, size_t len ) {
+			// only the last segment may be partially filled, allocated tail is cut
+			const Segment* segment = reinterpret_cast<const Segment*>( buffer );
+			if( segment == &m_Segments.back() ) {
+				m_Output.resize( segment->offset + len );
+			}
+		}
+	};
+
+	/**
+	*	Sink policy writing to caller supplied contiguous buffer, the size is known from EncodedSize()
+	*/
+	class BufferSink {
+	protected:
+		NetBufferRef m_Buffer;
+		bool m_Allocated{ false };
+		size_t m_Size{ 0 };
+
+	public:
+		BufferSink( byte* data, size_t capacity )
+			: m_Buffer{ data, capacity } {}
+
+		NetBufferRef* Alloc( size_t size ) {
+			if( m_Allocated ) {
+				return nullptr;
+			}
+			m_Allocated = true;
+			return &m_Buffer;
+		}
+
+		void Write( NetBufferRef* buffer, size_t len ) {
+			m_Size = len;
+		}
+
+		/// number of written bytes
+		size_t GetSize() const {
+			return m_Size;
+		}
+	};
+
+	/**
+	*	Sink policy writing to caller supplied buffers (iovec batch), used size of every written buffer is stored
+	*	to its NetBufferRef::size
+	*/
+	class IoVecSink {
+	protected:
+		NetBufferRef* m_Buffers;
+		size_t m_Count;
+		size_t m_Next{ 0 };
+
+	public:
+		IoVecSink( NetBufferRef* buffers, size_t count )
+			: m_Buffers( buffers )
+			, m_Count( count ) {}
+
+		NetBufferRef* Alloc( size_t size ) {
+			return m_Next < m_Count ? &m_Buffers[ m_Next++ ] : nullptr;
+		}
+
+		void Write( NetBufferRef* buffer, size_t len ) {
+			buffer->size = len;
+		}
+
+		/// number of used buffers
+		size_t GetUsed() const {
+			return m_Next;
+		}
+	};
+
+	/**
+	*	Chunk writer with sink policy: SINK::Alloc( size ) -> NetBufferRef*, SINK::Write( NetBufferRef*, len )
+	*/
+	template<typename SINK>
+	class SinkChunkWriter final : public ChunkWriter {
+	protected:
+		SINK m_Sink;
+
+	public:
+		SinkChunkWriter( SINK sink, EEncoding encoding = EEncoding::Fixed )
+			: ChunkWriter( encoding )
+			, m_Sink( std::move( sink ) ) {}
+
+		SINK& GetSink() {
+			return m_Sink;
+		}
+
+	protected:
+		NetBufferRef* SinkAlloc( size_t size ) override {
+			return m_Sink.Alloc( size );
+		}
+
+		void SinkWrite( NetBufferRef* buffer, size_t len ) override {
+			m_Sink.Write( buffer, len );
+		}
+	};
+
+	/**
+	*	Read data from chunked stream: sequence of buffers or contiguous memory
 	*/
 	class ChunkReader {
 	protected:
@@ -123,12 +761,30 @@ namespace utils {
 			size_t pos_in_buffer{ 0 };
 		};
 
-		const ConstNetBufferSeq& m_Buffers;
+		const NetBufferRef* const* m_Buffers;
+		size_t m_BuffersCount;
+		/// source of contiguous memory
+		NetBufferRef m_Contiguous{ nullptr, 0 };
+		const NetBufferRef* m_ContiguousRef{ &m_Contiguous };
 		ReadContext m_Current;
+		EEncoding m_Encoding;
+		/// created by the first compressed bytes array
+		std::unique_ptr<Decompressor> m_Decompressor;
 
 	public:
-		ChunkReader( const ConstNetBufferSeq& buffers )
-			: m_Buffers( buffers ) {}
+		ChunkReader( const ConstNetBufferSeq& buffers, EEncoding encoding = EEncoding::Fixed )
+			: m_Buffers( buffers.data() )
+			, m_BuffersCount( buffers.size() )
+			, m_Encoding( encoding ) {}
+
+		ChunkReader( const byte* data, size_t size, EEncoding encoding = EEncoding::Fixed )
+			: m_Buffers( &m_ContiguousRef )
+			, m_BuffersCount( 1 )
+			, m_Contiguous{ const_cast<byte*>( data ), size }
+			, m_Encoding( encoding ) {}
+
+		ChunkReader( const ChunkReader& ) = delete;
+		ChunkReader& operator=( const ChunkReader& ) = delete;
 
 		/**
 		*	Read data of specified type from stream
@@ -139,9 +795,22 @@ namespace utils {
 		bool Read( TYPE& val ) {
 			uint32_t size;
 			if( !CheckTypeAndSize( traits::TypeToByte<TYPE>(), size ) ) {
+				if constexpr( std::is_same<TYPE, std::vector<byte>>::value ) {
+					return ReadCompressed( val );
+				}
 				return false;
 			}
 
+			if constexpr( std::is_same<TYPE, uint32_t>::value ) {
+				if( m_Encoding == EEncoding::Compact ) {
+					return ReadVarint( val, size );
+				}
+			}
+
+			// size of array is checked before it is allocated
+			if( !HasBytes( size ) ) {
+				return false;
+			}
 			auto output = traits::GetValueBuffer<TYPE>( val, size );
 			if( output.size != size ) {
 				ReadUnSafe( nullptr, size );
@@ -153,7 +822,253 @@ namespace utils {
 			return true;
 		}
 
+		/**
+		*	Read bytes array of known size (plain or compressed) without gathering it to one place
+		*	@param len - expected size of array
+		*	@param put - put( const byte* data, size_t size ) is called for pieces of array in stream buffers or in
+		*	decompressed block
+		*	@return - true - readed, false - error or size of array is different
+		*/
+		template<typename PUT>
+		bool ReadBytes( size_t len, PUT put ) {
+			uint32_t size;
+			if( !CheckTypeAndSize( static_cast<byte>( traits::ETypes::BytesArray ), size ) ) {
+				compression::Header header;
+				if( !ReadCompressionHeader( header ) || header.raw_size != len ) {
+					return false;
+				}
+				for( size_t pos = 0; pos < len; pos += header.block_size ) {
+					size_t block_len = std::min<size_t>( header.block_size, len - pos );
+					byte* block = m_Decompressor->GetBlock( block_len );
+					if( !ReadCompressedBlock( header, block, block_len ) ) {
+						return false;
+					}
+					put( block, block_len );
+				}
+				return true;
+			}
+			if( size != len || !HasBytes( size ) ) {
+				ReadUnSafe( nullptr, size );
+				return false;
+			}
+			return ReadPieces( size, put );
+		}
+
+		/**
+		*	Read POD structure written by WriteBlock. Block of newer (larger) layout is truncated, block of older
+		*	(smaller) layout fills the beginning of val only.
+		*	@param val - output for data
+		*	@param size - [output] size of block in stream
+		*	@return - true - readed, false - error (stream position is not changed if there is no block)
+		*/
+		template<typename TYPE>
+		bool ReadBlock( TYPE& val, uint32_t& size ) {
+			static_assert( std::is_trivially_copyable<TYPE>::value, "block should be trivially copyable" );
+			if( !CheckTypeAndSize( static_cast<byte>( traits::ETypes::Block ), size ) ) {
+				return false;
+			}
+
+			size_t copy_size = std::min<size_t>( size, sizeof( val ) );
+			if( !ReadUnSafe( reinterpret_cast<byte*>( &val ), copy_size ) ) {
+				return false;
+			}
+			return ReadUnSafe( nullptr, size - copy_size );
+		}
+
+		/**
+		*	Read fields declared by OBJ::Schema(), run of adjacent fixed size fields is read by one copy and
+		*	checked against compile-time prefixes
+		*	@return - true - readed, false - error (stream position is undefined)
+		*/
+		template<typename OBJ>
+		bool ReadSchema( OBJ& obj ) {
+			constexpr auto fields = OBJ::Schema();
+			using Fields = std::remove_const_t<decltype( fields )>;
+
+			if( m_Encoding != EEncoding::Fixed ) {
+				bool res = true;
+				std::apply( [&]( const auto&... field ) { ( ( res = res && ReadFieldValue( obj, field ) ), ... ); },
+							fields );
+				return res;
+			}
+			return ReadFields<Fields>( obj, fields, std::make_index_sequence<std::tuple_size<Fields>::value>() );
+		}
+
 	protected:
+		template<typename FIELDS, typename OBJ, size_t... I>
+		bool ReadFields( OBJ& obj, const FIELDS& fields, std::index_sequence<I...> ) {
+			byte stage[ schema::FixedPart<FIELDS>::size ];
+			const byte* pos = stage;
+			return ( ReadField<I, FIELDS>( obj, std::get<I>( fields ), stage, pos ) && ... );
+		}
+
+		template<typename OBJ, typename FIELD>
+		bool ReadFieldValue( OBJ& obj, const FIELD& field ) {
+			using Wire = typename FIELD::Wire;
+			if constexpr( std::is_same<Wire, typename FIELD::Member>::value ) {
+				return Read( obj.*field.member );
+			} else {
+				Wire val;
+				if( !Read( val ) ) {
+					return false;
+				}
+				obj.*field.member = static_cast<typename FIELD::Member>( val );
+				return true;
+			}
+		}
+
+		template<size_t I, typename FIELDS, typename OBJ, typename FIELD>
+		bool ReadField( OBJ& obj, const FIELD& field, byte* stage, const byte*& pos ) {
+			using Wire = typename FIELD::Wire;
+			if constexpr( FIELD::is_fixed ) {
+				if constexpr( schema::IsRunStart<I, FIELDS>() ) {
+					if( !ReadUnSafe( stage, schema::RunSize<I, FIELDS>() ) ) {
+						return false;
+					}
+					pos = stage;
+				}
+
+				uint32_t size;
+				std::memcpy( &size, pos, sizeof( size ) );
+				if( size != traits::ChunkPrefixSize + sizeof( Wire ) || pos[ sizeof( size ) ] != FIELD::type ) {
+					return false;
+				}
+
+				Wire val;
+				std::memcpy( &val, pos + traits::ChunkPrefixSize, sizeof( val ) );
+				obj.*field.member = static_cast<typename FIELD::Member>( val );
+				pos += traits::ChunkPrefixSize + sizeof( val );
+				return true;
+			} else {
+				uint32_t size;
+				if( !CheckTypeAndSize( FIELD::type, size ) ) {
+					if constexpr( std::is_same<Wire, std::vector<byte>>::value ) {
+						return ReadCompressed( obj.*field.member );
+					}
+					return false;
+				}
+				auto output = traits::GetValueBuffer<Wire>( obj.*field.member, size );
+				return output.size == size && ReadUnSafe( output.data, size );
+			}
+		}
+
+		/**
+		*	Read bytes array written by ChunkWriter::WriteCompressed, blocks are decompressed right from stream
+		*	buffers, block split between buffers is gathered to stage first
+		*	@return - true - readed, false - there is no compressed array (position is not changed) or error
+		*/
+		bool ReadCompressed( std::vector<byte>& val ) {
+			compression::Header header;
+			if( !ReadCompressionHeader( header ) ) {
+				return false;
+			}
+
+			// raw_size is trusted for allocation only if the stream may hold it, otherwise array grows block by block
+			val.clear();
+			if( HasBytes( header.raw_size / compression::MaxRatio ) ) {
+				val.reserve( header.raw_size );
+			}
+			for( size_t pos = 0; pos < header.raw_size; pos += header.block_size ) {
+				size_t len = std::min<size_t>( header.block_size, header.raw_size - pos );
+				val.resize( pos + len );
+				if( !ReadCompressedBlock( header, val.data() + pos, len ) ) {
+					return false;
+				}
+			}
+			return true;
+		}
+
+		/// @return - false - there is no compressed array (position is not changed) or header is broken
+		bool ReadCompressionHeader( compression::Header& header ) {
+			uint32_t header_size;
+			if( !ReadBlock( header, header_size ) ) {
+				return false;
+			}
+			if( header_size != sizeof( header ) || header.block_size == 0 || header.block_size > compression::BlockSize ||
+				header.raw_size > compression::MaxSize ) {
+				return false;
+			}
+			if( m_Decompressor == nullptr ) {
+				m_Decompressor.reset( new Decompressor() );
+			}
+			return true;
+		}
+
+		/// read block of compressed array to dst
+		bool ReadCompressedBlock( const compression::Header& header, byte* dst, size_t len ) {
+			uint32_t size;
+			if( !CheckTypeAndSize( static_cast<byte>( traits::ETypes::BytesArray ), size ) || size > len ) {
+				return false;
+			}
+			if( size == len ) {
+				// stored block
+				return ReadUnSafe( dst, len );
+			}
+
+			const byte* data = ReadInPlace( size );
+			if( data == nullptr ) {
+				byte* stage = m_Decompressor->GetStage( size );
+				if( !ReadUnSafe( stage, size ) ) {
+					return false;
+				}
+				data = stage;
+			}
+			return m_Decompressor->Decompress( static_cast<ECodec>( header.codec ), data, size, dst, len );
+		}
+
+		/// pass size bytes of stream to put( data, size ) as pieces of stream buffers
+		template<typename PUT>
+		bool ReadPieces( size_t size, PUT put ) {
+			while( size > 0 ) {
+				if( m_BuffersCount == 0 ) {
+					return false;
+				}
+				auto buf = m_Buffers[ m_Current.buffer ];
+				size_t available = buf->size - m_Current.pos_in_buffer;
+				if( available == 0 ) {
+					if( ( m_Current.buffer + 1 ) >= m_BuffersCount ) {
+						return false;
+					}
+					m_Current.buffer++;
+					m_Current.pos_in_buffer = 0;
+					continue;
+				}
+				size_t piece = std::min( size, available );
+				put( buf->data + m_Current.pos_in_buffer, piece );
+				m_Current.pos_in_buffer += piece;
+				size -= piece;
+			}
+			return true;
+		}
+
+		/// stream has at least size unread bytes (e.g. size of array is not forged)
+		bool HasBytes( size_t size ) const {
+			for( size_t i = m_Current.buffer; i < m_BuffersCount && size > 0; i++ ) {
+				size_t available = m_Buffers[ i ]->size - ( i == m_Current.buffer ? m_Current.pos_in_buffer : 0 );
+				size -= std::min( size, available );
+			}
+			return size == 0;
+		}
+
+		/// pointer to next size bytes if they are in one buffer (position is moved past them), nullptr otherwise
+		const byte* ReadInPlace( size_t size ) {
+			if( m_BuffersCount == 0 ) {
+				return nullptr;
+			}
+			if( m_Buffers[ m_Current.buffer ]->size == m_Current.pos_in_buffer &&
+				m_Current.buffer + 1 < m_BuffersCount ) {
+				m_Current.buffer++;
+				m_Current.pos_in_buffer = 0;
+			}
+			auto buf = m_Buffers[ m_Current.buffer ];
+			if( buf->size - m_Current.pos_in_buffer < size ) {
+				return nullptr;
+			}
+			const byte* data = buf->data + m_Current.pos_in_buffer;
+			m_Current.pos_in_buffer += size;
+			return data;
+		}
+
 		/**
 		*	Read data and monitor for EOS
 		*	@param buffer - pointer to put read data, nullptr - means skip data
@@ -161,11 +1076,14 @@ namespace utils {
 		*	@return true - if all data is copied/skipped, otherwise stream does not have enough data
 		*/
 		bool ReadUnSafe( byte* buffer, size_t size ) {
+			if( m_BuffersCount == 0 ) {
+				return size == 0;
+			}
 			while( size > 0 ) {
 				auto buf = m_Buffers[ m_Current.buffer ];
 				size_t available = buf->size - m_Current.pos_in_buffer;
 				if( available == 0 ) {
-					if( ( m_Current.buffer + 1 ) >= m_Buffers.size() ) {
+					if( ( m_Current.buffer + 1 ) >= m_BuffersCount ) {
 						// no more data
 						return false;
 					}
@@ -196,6 +1114,10 @@ namespace utils {
 		*	@return true - if everyting is ok, otherwise false (stream is broken or expected type is different)
 		*/
 		bool CheckTypeAndSize( byte type, uint32_t& size ) {
+			if( m_Encoding == EEncoding::Compact ) {
+				return CheckTagAndSize( type, size );
+			}
+
 			ReadContext save{ m_Current };
 
 			if( !ReadUnSafe( reinterpret_cast<byte*>( &size ), sizeof( size ) ) ) {
@@ -221,6 +1143,59 @@ namespace utils {
 
 			return true;
 		}
+
+		/// CheckTypeAndSize() for compact encoding
+		bool CheckTagAndSize( byte type, uint32_t& size ) {
+			ReadContext save{ m_Current };
+
+			byte tag;
+			if( !ReadUnSafe( &tag, sizeof( tag ) ) ) {
+				return false;
+			}
+
+			if( ( tag >> compact::TypeShift ) != type ) {
+				m_Current = save;
+				return false;
+			}
+
+			size = tag & compact::LongSize;
+			if( size != compact::LongSize ) {
+				return true;
+			}
+
+			uint32_t value = 0;
+			for( size_t i = 0; i < compact::MaxVarintSize; i++ ) {
+				byte b;
+				if( !ReadUnSafe( &b, sizeof( b ) ) ) {
+					return false;
+				}
+				value |= static_cast<uint32_t>( b & 0x7f ) << ( 7 * i );
+				if( ( b & 0x80 ) == 0 ) {
+					size = value;
+					return true;
+				}
+			}
+			return false;
+		}
+
+		/// read LEB128 value of specified size
+		bool ReadVarint( uint32_t& val, uint32_t size ) {
+			byte data[ compact::MaxVarintSize ];
+			if( size == 0 || size > sizeof( data ) ) {
+				ReadUnSafe( nullptr, size );
+				return false;
+			}
+			if( !ReadUnSafe( data, size ) ) {
+				return false;
+			}
+
+			uint32_t value = 0;
+			for( uint32_t i = 0; i < size; i++ ) {
+				value |= static_cast<uint32_t>( data[ i ] & 0x7f ) << ( 7 * i );
+			}
+			val = value;
+			return ( data[ size - 1 ] & 0x80 ) == 0;
+		}
 	};
 
 }  // namespace utils
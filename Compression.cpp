@@ -0,0 +1,282 @@
+#include "Compression.h"
+#include <cstring>
+#include <algorithm>
+
+#if defined( MFPIPE_HAVE_ZSTD )
+#include <zstd.h>
+#endif
+
+namespace comm {
+namespace utils {
+	namespace compression {
+
+		namespace {
+			constexpr size_t MinMatch = 4;
+			/// the last bytes of block are literals
+			constexpr size_t LastLiterals = 5;
+			/// the last match starts before this distance to the end of block
+			constexpr size_t MatchFindLimit = 12;
+			constexpr size_t MaxOffset = 65535;
+			/// 4-bit lengths of token, larger value continues with 255-based extension bytes
+			constexpr size_t RunMask = 15;
+
+			inline uint32_t Read32( const byte* p ) {
+				uint32_t val;
+				std::memcpy( &val, p, sizeof( val ) );
+				return val;
+			}
+
+			inline uint32_t Hash( uint32_t val ) {
+				return ( val * 2654435761u ) >> ( 32 - Lz4HashLog );
+			}
+
+			/// write length extension bytes
+			inline byte* PutLength( byte* op, size_t len ) {
+				while( len >= 255 ) {
+					*op++ = 255;
+					len -= 255;
+				}
+				*op++ = static_cast<byte>( len );
+				return op;
+			}
+
+			/// read length extension bytes
+			inline bool GetLength( const byte*& ip, const byte* end, size_t& len ) {
+				byte b;
+				do {
+					if( ip >= end ) {
+						return false;
+					}
+					b = *ip++;
+					len += b;
+				} while( b == 255 );
+				return true;
+			}
+
+			/// write sequence: literals [anchor, ip), then match (match_len = 0 - the last sequence)
+			inline byte* PutSequence( byte* op, const byte* op_end, const byte* anchor, const byte* ip, size_t offset,
+									  size_t match_len ) {
+				size_t lit_len = ip - anchor;
+				// token, literals with extension, offset and match length extension
+				size_t need = 1 + lit_len + lit_len / 255 + 1 + ( match_len ? 2 + match_len / 255 + 1 : 0 );
+				if( static_cast<size_t>( op_end - op ) < need ) {
+					return nullptr;
+				}
+
+				byte* token = op++;
+				*token = static_cast<byte>( std::min( lit_len, RunMask ) << 4 );
+				if( lit_len >= RunMask ) {
+					op = PutLength( op, lit_len - RunMask );
+				}
+				std::memcpy( op, anchor, lit_len );
+				op += lit_len;
+
+				if( match_len != 0 ) {
+					*op++ = static_cast<byte>( offset );
+					*op++ = static_cast<byte>( offset >> 8 );
+					size_t len = match_len - MinMatch;
+					*token |= static_cast<byte>( std::min( len, RunMask ) );
+					if( len >= RunMask ) {
+						op = PutLength( op, len - RunMask );
+					}
+				}
+				return op;
+			}
+		}  // namespace
+
+		uint32_t SupportedCodecs() {
+			uint32_t codecs = ( 1u << static_cast<uint32_t>( ECodec::None ) ) |
+							  ( 1u << static_cast<uint32_t>( ECodec::LZ4 ) );
+#if defined( MFPIPE_HAVE_ZSTD )
+			codecs |= 1u << static_cast<uint32_t>( ECodec::Zstd );
+#endif
+			return codecs;
+		}
+
+		ECodec CodecFromString( const std::string& name ) {
+			if( name == "lz4" ) {
+				return ECodec::LZ4;
+			}
+			if( name == "zstd" ) {
+				return ECodec::Zstd;
+			}
+			return ECodec::None;
+		}
+
+		size_t Bound( ECodec codec, size_t size ) {
+#if defined( MFPIPE_HAVE_ZSTD )
+			if( codec == ECodec::Zstd ) {
+				return ZSTD_compressBound( size );
+			}
+#endif
+			return size + size / 255 + 16;
+		}
+
+		size_t Lz4Compress( const byte* src, size_t size, byte* dst, size_t capacity, uint32_t* table ) {
+			const byte* anchor = src;
+			const byte* ip = src;
+			const byte* end = src + size;
+			byte* op = dst;
+			byte* op_end = dst + capacity;
+
+			if( size > MatchFindLimit ) {
+				std::fill( table, table + Lz4TableSize, 0 );
+				const byte* limit = end - MatchFindLimit;
+				const byte* match_limit = end - LastLiterals;
+
+				while( ip < limit ) {
+					uint32_t seq = Read32( ip );
+					uint32_t& entry = table[ Hash( seq ) ];
+					const byte* ref = src + entry;
+					entry = static_cast<uint32_t>( ip - src );
+
+					if( ref >= ip || static_cast<size_t>( ip - ref ) > MaxOffset || Read32( ref ) != seq ) {
+						// skip faster through data without matches
+						ip += 1 + ( ( ip - anchor ) >> 6 );
+						continue;
+					}
+
+					while( ip > anchor && ref > src && ip[ -1 ] == ref[ -1 ] ) {
+						ip--;
+						ref--;
+					}
+					size_t match_len = MinMatch;
+					while( ip + match_len < match_limit && ip[ match_len ] == ref[ match_len ] ) {
+						match_len++;
+					}
+
+					op = PutSequence( op, op_end, anchor, ip, ip - ref, match_len );
+					if( op == nullptr ) {
+						return 0;
+					}
+					ip += match_len;
+					anchor = ip;
+				}
+			}
+
+			op = PutSequence( op, op_end, anchor, end, 0, 0 );
+			return op != nullptr ? op - dst : 0;
+		}
+
+		bool Lz4Decompress( const byte* src, size_t size, byte* dst, size_t dst_size ) {
+			const byte* ip = src;
+			const byte* end = src + size;
+			byte* op = dst;
+			byte* op_end = dst + dst_size;
+
+			while( ip < end ) {
+				byte token = *ip++;
+
+				size_t lit_len = token >> 4;
+				if( lit_len == RunMask && !GetLength( ip, end, lit_len ) ) {
+					return false;
+				}
+				if( static_cast<size_t>( end - ip ) < lit_len || static_cast<size_t>( op_end - op ) < lit_len ) {
+					return false;
+				}
+				std::memcpy( op, ip, lit_len );
+				ip += lit_len;
+				op += lit_len;
+
+				if( ip == end ) {
+					// the last sequence has literals only
+					return op == op_end;
+				}
+
+				if( end - ip < 2 ) {
+					return false;
+				}
+				size_t offset = ip[ 0 ] | ( static_cast<size_t>( ip[ 1 ] ) << 8 );
+				ip += 2;
+				if( offset == 0 || offset > static_cast<size_t>( op - dst ) ) {
+					return false;
+				}
+
+				size_t match_len = token & RunMask;
+				if( match_len == RunMask && !GetLength( ip, end, match_len ) ) {
+					return false;
+				}
+				match_len += MinMatch;
+				if( static_cast<size_t>( op_end - op ) < match_len ) {
+					return false;
+				}
+
+				const byte* ref = op - offset;
+				if( offset >= match_len ) {
+					std::memcpy( op, ref, match_len );
+					op += match_len;
+				} else {
+					// overlapped match repeats the last offset bytes
+					for( size_t i = 0; i < match_len; i++ ) {
+						*op++ = ref[ i ];
+					}
+				}
+			}
+			return false;
+		}
+
+	}  // namespace compression
+
+	Compressor::Compressor( ECodec codec, int level )
+		: m_Codec( codec )
+		, m_Level( level )
+		, m_Stage( compression::Bound( codec, compression::BlockSize ) ) {
+		if( codec == ECodec::LZ4 ) {
+			m_Table.resize( compression::Lz4TableSize );
+		}
+#if defined( MFPIPE_HAVE_ZSTD )
+		if( codec == ECodec::Zstd ) {
+			m_Context = ZSTD_createCCtx();
+		}
+#endif
+	}
+
+	Compressor::~Compressor() {
+#if defined( MFPIPE_HAVE_ZSTD )
+		ZSTD_freeCCtx( static_cast<ZSTD_CCtx*>( m_Context ) );
+#endif
+	}
+
+	const byte* Compressor::Compress( const byte* src, size_t size, size_t& compressed_size ) {
+		compressed_size = 0;
+		if( m_Codec == ECodec::LZ4 ) {
+			compressed_size = compression::Lz4Compress( src, size, m_Stage.data(), m_Stage.size(), m_Table.data() );
+		}
+#if defined( MFPIPE_HAVE_ZSTD )
+		if( m_Codec == ECodec::Zstd && m_Context != nullptr ) {
+			size_t res = ZSTD_compressCCtx( static_cast<ZSTD_CCtx*>( m_Context ), m_Stage.data(), m_Stage.size(), src,
+											size, m_Level != 0 ? m_Level : ZSTD_CLEVEL_DEFAULT );
+			compressed_size = ZSTD_isError( res ) ? 0 : res;
+		}
+#endif
+		// stored block is recognized by its size
+		if( compressed_size == 0 || compressed_size >= size ) {
+			return nullptr;
+		}
+		return m_Stage.data();
+	}
+
+	Decompressor::~Decompressor() {
+#if defined( MFPIPE_HAVE_ZSTD )
+		ZSTD_freeDCtx( static_cast<ZSTD_DCtx*>( m_Context ) );
+#endif
+	}
+
+	bool Decompressor::Decompress( ECodec codec, const byte* src, size_t size, byte* dst, size_t dst_size ) {
+		if( codec == ECodec::LZ4 ) {
+			return compression::Lz4Decompress( src, size, dst, dst_size );
+		}
+#if defined( MFPIPE_HAVE_ZSTD )
+		if( codec == ECodec::Zstd ) {
+			if( m_Context == nullptr ) {
+				m_Context = ZSTD_createDCtx();
+			}
+			size_t res = ZSTD_decompressDCtx( static_cast<ZSTD_DCtx*>( m_Context ), dst, dst_size, src, size );
+			return !ZSTD_isError( res ) && res == dst_size;
+		}
+#endif
+		return false;
+	}
+
+}  // namespace utils
+}  // namespace comm
@@ -0,0 +1,144 @@
+/**
+*	Payload compression: LZ4 block format (built in, low-latency channels) and zstd (bulk channels, available when
+*	the build is configured with MFPIPE_WITH_ZSTD=ON). Data is split to independent blocks of BlockSize bytes, so it
+*	is compressed to/decompressed from stream block by block.
+*/
+#pragma once
+
+#include "MFTypes.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace comm {
+namespace utils {
+
+	enum class ECodec : byte {
+		None = 0,
+		LZ4 = 1,
+		Zstd = 2,
+	};
+
+	namespace compression {
+		/// max size of uncompressed block
+		constexpr size_t BlockSize = 64 * 1024;
+		/// smaller data is not compressed
+		constexpr size_t MinSize = 256;
+		/// sanity limit of uncompressed size read from stream
+		constexpr size_t MaxSize = 1u << 30;
+		/// compression ratio above which uncompressed size read from stream is not preallocated (LZ4 limit is 255)
+		constexpr size_t MaxRatio = 256;
+
+		/**
+		*	Header of compressed bytes array, followed by blocks (chunk of block_size bytes or less is stored as is)
+		*/
+		struct Header {
+			byte codec;
+			byte reserved[ 3 ];
+			uint32_t raw_size;
+			uint32_t block_size;
+		};
+
+		static_assert( sizeof( Header ) == 12, "compression::Header layout is part of wire format" );
+
+		/// codecs of this build, bit per ECodec value
+		uint32_t SupportedCodecs();
+
+		/// codec by name ("lz4", "zstd", "none"), unknown name is None
+		ECodec CodecFromString( const std::string& name );
+
+		/// max size of compressed block
+		size_t Bound( ECodec codec, size_t size );
+
+		/**
+		*	Compress LZ4 block
+		*	@param table - hash table of Lz4TableSize entries, contents are not used between calls
+		*	@return compressed size, 0 - does not fit to capacity
+		*/
+		size_t Lz4Compress( const byte* src, size_t size, byte* dst, size_t capacity, uint32_t* table );
+
+		/// decompress LZ4 block, it should produce exactly dst_size bytes
+		bool Lz4Decompress( const byte* src, size_t size, byte* dst, size_t dst_size );
+
+		constexpr size_t Lz4HashLog = 12;
+		constexpr size_t Lz4TableSize = size_t( 1 ) << Lz4HashLog;
+	}  // namespace compression
+
+	/**
+	*	Block compressor, codec context and output stage are reused for all blocks
+	*/
+	class Compressor {
+	protected:
+		ECodec m_Codec;
+		int m_Level;
+		std::vector<byte> m_Stage;
+		/// input block gathered from pieces
+		std::vector<byte> m_Input;
+		std::vector<uint32_t> m_Table;
+		/// ZSTD_CCtx
+		void* m_Context{ nullptr };
+
+	public:
+		/// @param level - zstd compression level (0 - default)
+		Compressor( ECodec codec, int level );
+		~Compressor();
+
+		Compressor( const Compressor& ) = delete;
+		Compressor& operator=( const Compressor& ) = delete;
+
+		ECodec GetCodec() const {
+			return m_Codec;
+		}
+
+		/// stage of BlockSize bytes for input block
+		byte* GetInputStage() {
+			m_Input.resize( compression::BlockSize );
+			return m_Input.data();
+		}
+
+		/**
+		*	Compress block of up to BlockSize bytes
+		*	@return compressed data (valid until next call), nullptr - block does not shrink
+		*/
+		const byte* Compress( const byte* src, size_t size, size_t& compressed_size );
+	};
+
+	/**
+	*	Block decompressor, keeps stages for compressed block which is split between buffers and for decompressed
+	*	block which is not put to its place directly
+	*/
+	class Decompressor {
+	protected:
+		std::vector<byte> m_Stage;
+		std::vector<byte> m_Block;
+		/// ZSTD_DCtx
+		void* m_Context{ nullptr };
+
+	public:
+		Decompressor() = default;
+		~Decompressor();
+
+		Decompressor( const Decompressor& ) = delete;
+		Decompressor& operator=( const Decompressor& ) = delete;
+
+		byte* GetStage( size_t size ) {
+			if( m_Stage.size() < size ) {
+				m_Stage.resize( size );
+			}
+			return m_Stage.data();
+		}
+
+		byte* GetBlock( size_t size ) {
+			if( m_Block.size() < size ) {
+				m_Block.resize( size );
+			}
+			return m_Block.data();
+		}
+
+		/// @return false - data is broken or codec is not supported
+		bool Decompress( ECodec codec, const byte* src, size_t size, byte* dst, size_t dst_size );
+	};
+
+}  // namespace utils
+}  // namespace comm
@@ -0,0 +1,88 @@
+#include "CpuFeatures.h"
+
+#if defined( _MSC_VER ) && MFPIPE_X86_DISPATCH
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+namespace comm {
+namespace utils {
+	namespace cpu {
+
+#if defined( _MSC_VER ) && MFPIPE_X86_DISPATCH
+		namespace {
+			struct Features {
+				bool sse42 = false;
+				bool ssse3 = false;
+				bool avx2 = false;
+
+				Features() {
+					int regs[ 4 ] = {};
+					__cpuid( regs, 0 );
+					const int max_leaf = regs[ 0 ];
+					if( max_leaf < 1 ) {
+						return;
+					}
+					__cpuid( regs, 1 );
+					ssse3 = ( regs[ 2 ] & ( 1 << 9 ) ) != 0;
+					sse42 = ( regs[ 2 ] & ( 1 << 20 ) ) != 0;
+					// AVX and OSXSAVE, OS saves xmm and ymm state
+					const bool os_avx = ( regs[ 2 ] & ( 1 << 27 ) ) != 0 && ( regs[ 2 ] & ( 1 << 28 ) ) != 0 &&
+										( _xgetbv( 0 ) & 0x6 ) == 0x6;
+					if( max_leaf >= 7 && os_avx ) {
+						__cpuidex( regs, 7, 0 );
+						avx2 = ( regs[ 1 ] & ( 1 << 5 ) ) != 0;
+					}
+				}
+			};
+
+			const Features& GetFeatures() {
+				static const Features features;
+				return features;
+			}
+		}  // namespace
+
+		bool HasSSE42() {
+			return GetFeatures().sse42;
+		}
+
+		bool HasSSSE3() {
+			return GetFeatures().ssse3;
+		}
+
+		bool HasAVX2() {
+			return GetFeatures().avx2;
+		}
+#elif MFPIPE_X86_DISPATCH
+		// __builtin_cpu_supports() checks OS support of ymm state for avx2 too
+		bool HasSSE42() {
+			__builtin_cpu_init();
+			return __builtin_cpu_supports( "sse4.2" );
+		}
+
+		bool HasSSSE3() {
+			__builtin_cpu_init();
+			return __builtin_cpu_supports( "ssse3" );
+		}
+
+		bool HasAVX2() {
+			__builtin_cpu_init();
+			return __builtin_cpu_supports( "avx2" );
+		}
+#else
+		bool HasSSE42() {
+			return false;
+		}
+
+		bool HasSSSE3() {
+			return false;
+		}
+
+		bool HasAVX2() {
+			return false;
+		}
+#endif
+
+	}  // namespace cpu
+}  // namespace utils
+}  // namespace comm
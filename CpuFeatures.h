@@ -0,0 +1,33 @@
+/**
+*	Runtime detection of x86 instruction set extensions for SIMD paths (CRC32C, FEC coding) built without -march
+*/
+#pragma once
+
+#if( defined( __x86_64__ ) || defined( __i386__ ) ) && ( defined( __GNUC__ ) || defined( __clang__ ) )
+#define MFPIPE_X86_DISPATCH 1
+/// compile function for extension not enabled for the whole build, call it only when CPU supports the extension
+#define MFPIPE_TARGET( ext ) __attribute__( ( target( ext ) ) )
+#elif defined( _MSC_VER ) && ( defined( _M_X64 ) || defined( _M_IX86 ) )
+#define MFPIPE_X86_DISPATCH 1
+#define MFPIPE_TARGET( ext )
+#else
+#define MFPIPE_X86_DISPATCH 0
+#define MFPIPE_TARGET( ext )
+#endif
+
+namespace comm {
+namespace utils {
+	namespace cpu {
+
+		/// crc32 instruction
+		bool HasSSE42();
+
+		/// pshufb instruction
+		bool HasSSSE3();
+
+		/// 256-bit integer instructions, also checks that OS saves ymm registers
+		bool HasAVX2();
+
+	}  // namespace cpu
+}  // namespace utils
+}  // namespace comm
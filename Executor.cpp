@@ -0,0 +1,47 @@
+#include "Executor.h"
+#include <algorithm>
+
+namespace comm {
+namespace utils {
+
+	ThreadPoolExecutor::ThreadPoolExecutor( size_t threads ) {
+		for( size_t i = 0; i < std::max<size_t>( 1, threads ); i++ ) {
+			m_Threads.emplace_back( [this]() { Work(); } );
+		}
+	}
+
+	ThreadPoolExecutor::~ThreadPoolExecutor() {
+		{
+			std::unique_lock lock( m_Lock );
+			m_Stopping = true;
+			m_Variable.notify_all();
+		}
+		for( auto& thread : m_Threads ) {
+			thread.join();
+		}
+	}
+
+	void ThreadPoolExecutor::Post( Task task ) {
+		std::unique_lock lock( m_Lock );
+		m_Tasks.push_back( std::move( task ) );
+		m_Variable.notify_one();
+	}
+
+	void ThreadPoolExecutor::Work() {
+		std::unique_lock lock( m_Lock );
+		for( ;; ) {
+			m_Variable.wait( lock, [this]() { return m_Stopping || !m_Tasks.empty(); } );
+			if( m_Tasks.empty() ) {
+				// stopping, queued tasks are run
+				return;
+			}
+			Task task = std::move( m_Tasks.front() );
+			m_Tasks.pop_front();
+			lock.unlock();
+			task();
+			lock.lock();
+		}
+	}
+
+}  // namespace utils
+}  // namespace comm
@@ -0,0 +1,68 @@
+/**
+*	Executors of callbacks (e.g. consumer callbacks of MFPipeImpl::PipeCallbackSet()): pool of threads, the calling
+*	thread or executor of application (e.g. its reactor) implementing IExecutor
+*/
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace comm {
+namespace utils {
+
+	/**
+	*	Runs posted tasks, tasks may run concurrently and in any thread
+	*/
+	class IExecutor {
+	public:
+		using Ptr = std::shared_ptr<IExecutor>;
+		using Task = std::function<void()>;
+
+		virtual ~IExecutor() = default;
+
+		/// run the task, posted tasks should be run (not dropped) while their owner waits for them
+		virtual void Post( Task task ) = 0;
+	};
+
+	/**
+	*	Runs task in the posting thread before Post() returns
+	*/
+	class InlineExecutor : public IExecutor {
+	public:
+		void Post( Task task ) override {
+			task();
+		}
+	};
+
+	/**
+	*	Runs tasks by fixed number of threads in order of posting, queued tasks are run before destruction
+	*/
+	class ThreadPoolExecutor : public IExecutor {
+	protected:
+		std::mutex m_Lock;
+		std::condition_variable m_Variable;
+		std::deque<Task> m_Tasks;
+		bool m_Stopping{ false };
+		std::vector<std::thread> m_Threads;
+
+	public:
+		explicit ThreadPoolExecutor( size_t threads );
+		~ThreadPoolExecutor() override;
+
+		void Post( Task task ) override;
+
+		size_t GetThreads() const {
+			return m_Threads.size();
+		}
+
+	protected:
+		void Work();
+	};
+
+}  // namespace utils
+}  // namespace comm
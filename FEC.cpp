@@ -0,0 +1,209 @@
+#include "FEC.h"
+#include "CpuFeatures.h"
+#include <cassert>
+
+#if MFPIPE_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace comm {
+namespace utils {
+	namespace fec {
+
+		namespace {
+			/// exp/log tables for generator 2 and polynomial x^8 + x^4 + x^3 + x^2 + 1
+			struct Tables {
+				byte exp[ 512 ];
+				byte log[ 256 ];
+
+				Tables() {
+					unsigned x = 1;
+					for( unsigned i = 0; i < 255; i++ ) {
+						exp[ i ] = static_cast<byte>( x );
+						log[ x ] = static_cast<byte>( i );
+						x <<= 1;
+						if( x & 0x100 ) {
+							x ^= 0x11D;
+						}
+					}
+					for( unsigned i = 255; i < 512; i++ ) {
+						exp[ i ] = exp[ i - 255 ];
+					}
+					log[ 0 ] = 0;
+				}
+			};
+
+			const Tables& GetTables() {
+				static const Tables tables;
+				return tables;
+			}
+		}  // namespace
+
+		byte Mul( byte a, byte b ) {
+			if( a == 0 || b == 0 ) {
+				return 0;
+			}
+			const Tables& t = GetTables();
+			return t.exp[ t.log[ a ] + t.log[ b ] ];
+		}
+
+		byte Inv( byte a ) {
+			assert( a != 0 );
+			const Tables& t = GetTables();
+			return t.exp[ 255 - t.log[ a ] ];
+		}
+
+		byte Coefficient( size_t parity, size_t data ) {
+			assert( parity + data < MaxBlocks );
+			// Cauchy element 1 / ( x + y ), x = parity, y = MaxBlocks - 1 - data, column normalized by the first row
+			byte y = static_cast<byte>( MaxBlocks - 1 - data );
+			byte cauchy = Inv( static_cast<byte>( parity ) ^ y );
+			return Mul( cauchy, y );
+		}
+
+		namespace {
+			/// product tables of coef for low and high nibbles: product of byte is product of its low nibble xor
+			/// product of its high nibble
+			struct NibbleTables {
+				alignas( 16 ) byte lo[ 16 ];
+				alignas( 16 ) byte hi[ 16 ];
+
+				explicit NibbleTables( byte coef ) {
+					for( byte k = 0; k < 16; k++ ) {
+						lo[ k ] = Mul( coef, k );
+						hi[ k ] = Mul( coef, static_cast<byte>( k << 4 ) );
+					}
+				}
+			};
+
+			/// @return number of processed bytes, the rest is processed with tables
+			using MulAddFunc = size_t ( * )( byte* dst, const byte* src, const NibbleTables& t, size_t len );
+
+			size_t MulAddNone( byte*, const byte*, const NibbleTables&, size_t ) {
+				return 0;
+			}
+
+#if MFPIPE_X86_DISPATCH
+			MFPIPE_TARGET( "ssse3" )
+			size_t MulAddSSSE3( byte* dst, const byte* src, const NibbleTables& t, size_t len ) {
+				const __m128i tlo = _mm_load_si128( reinterpret_cast<const __m128i*>( t.lo ) );
+				const __m128i thi = _mm_load_si128( reinterpret_cast<const __m128i*>( t.hi ) );
+				const __m128i mask = _mm_set1_epi8( 0x0F );
+				size_t i = 0;
+				for( ; i + 16 <= len; i += 16 ) {
+					__m128i x = _mm_loadu_si128( reinterpret_cast<const __m128i*>( src + i ) );
+					__m128i l = _mm_and_si128( x, mask );
+					__m128i h = _mm_and_si128( _mm_srli_epi16( x, 4 ), mask );
+					__m128i p = _mm_xor_si128( _mm_shuffle_epi8( tlo, l ), _mm_shuffle_epi8( thi, h ) );
+					__m128i d = _mm_loadu_si128( reinterpret_cast<const __m128i*>( dst + i ) );
+					_mm_storeu_si128( reinterpret_cast<__m128i*>( dst + i ), _mm_xor_si128( d, p ) );
+				}
+				return i;
+			}
+
+			MFPIPE_TARGET( "avx2" )
+			size_t MulAddAVX2( byte* dst, const byte* src, const NibbleTables& t, size_t len ) {
+				const __m256i tlo = _mm256_broadcastsi128_si256( _mm_load_si128( reinterpret_cast<const __m128i*>( t.lo ) ) );
+				const __m256i thi = _mm256_broadcastsi128_si256( _mm_load_si128( reinterpret_cast<const __m128i*>( t.hi ) ) );
+				const __m256i mask = _mm256_set1_epi8( 0x0F );
+				size_t i = 0;
+				for( ; i + 32 <= len; i += 32 ) {
+					__m256i x = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( src + i ) );
+					__m256i l = _mm256_and_si256( x, mask );
+					__m256i h = _mm256_and_si256( _mm256_srli_epi16( x, 4 ), mask );
+					__m256i p = _mm256_xor_si256( _mm256_shuffle_epi8( tlo, l ), _mm256_shuffle_epi8( thi, h ) );
+					__m256i d = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( dst + i ) );
+					_mm256_storeu_si256( reinterpret_cast<__m256i*>( dst + i ), _mm256_xor_si256( d, p ) );
+				}
+				// avx2 implies ssse3
+				return i + MulAddSSSE3( dst + i, src + i, t, len - i );
+			}
+#endif
+
+			MulAddFunc SelectMulAdd() {
+#if MFPIPE_X86_DISPATCH
+				if( cpu::HasAVX2() ) {
+					return MulAddAVX2;
+				}
+				if( cpu::HasSSSE3() ) {
+					return MulAddSSSE3;
+				}
+#endif
+				return MulAddNone;
+			}
+
+			void MulAddTail( byte* dst, const byte* src, const NibbleTables& t, size_t len ) {
+				for( size_t i = 0; i < len; i++ ) {
+					dst[ i ] ^= t.lo[ src[ i ] & 0x0F ] ^ t.hi[ src[ i ] >> 4 ];
+				}
+			}
+		}  // namespace
+
+		void MulAdd( byte* dst, const byte* src, byte coef, size_t len ) {
+			if( coef == 0 ) {
+				return;
+			}
+
+			static const MulAddFunc simd = SelectMulAdd();
+			const NibbleTables t( coef );
+			size_t i = simd( dst, src, t, len );
+			MulAddTail( dst + i, src + i, t, len - i );
+		}
+
+		void MulAddTable( byte* dst, const byte* src, byte coef, size_t len ) {
+			if( coef == 0 ) {
+				return;
+			}
+
+			MulAddTail( dst, src, NibbleTables( coef ), len );
+		}
+
+		bool Invert( std::vector<byte>& matrix, size_t n ) {
+			assert( matrix.size() == n * n );
+
+			// Gauss-Jordan elimination on [ matrix | identity ]
+			std::vector<byte> inverse( n * n, 0 );
+			for( size_t i = 0; i < n; i++ ) {
+				inverse[ i * n + i ] = 1;
+			}
+
+			for( size_t col = 0; col < n; col++ ) {
+				size_t pivot = col;
+				while( pivot < n && matrix[ pivot * n + col ] == 0 ) {
+					pivot++;
+				}
+				if( pivot == n ) {
+					return false;
+				}
+				if( pivot != col ) {
+					for( size_t k = 0; k < n; k++ ) {
+						std::swap( matrix[ pivot * n + k ], matrix[ col * n + k ] );
+						std::swap( inverse[ pivot * n + k ], inverse[ col * n + k ] );
+					}
+				}
+
+				byte scale = Inv( matrix[ col * n + col ] );
+				for( size_t k = 0; k < n; k++ ) {
+					matrix[ col * n + k ] = Mul( matrix[ col * n + k ], scale );
+					inverse[ col * n + k ] = Mul( inverse[ col * n + k ], scale );
+				}
+
+				for( size_t row = 0; row < n; row++ ) {
+					byte factor = matrix[ row * n + col ];
+					if( row == col || factor == 0 ) {
+						continue;
+					}
+					for( size_t k = 0; k < n; k++ ) {
+						matrix[ row * n + k ] ^= Mul( factor, matrix[ col * n + k ] );
+						inverse[ row * n + k ] ^= Mul( factor, inverse[ col * n + k ] );
+					}
+				}
+			}
+
+			matrix.swap( inverse );
+			return true;
+		}
+
+	}  // namespace fec
+}  // namespace utils
+}  // namespace comm
@@ -0,0 +1,41 @@
+/**
+*	Forward error correction: systematic Reed-Solomon code over GF(2^8)
+*
+*	Parity block j of group with data blocks D[0..n-1]: P[j] = sum( Coefficient( j, i ) * D[i] )
+*	Coefficients form normalized Cauchy matrix: the first parity row is all ones (plain XOR parity) and any
+*	square sub-matrix is invertible, so any m lost data blocks are recovered from any m parity blocks.
+*/
+#pragma once
+
+#include "MFTypes.h"
+#include <vector>
+
+namespace comm {
+namespace utils {
+	namespace fec {
+
+		/// max number of data + parity blocks in group
+		constexpr size_t MaxBlocks = 255;
+
+		/// multiply in GF(2^8)
+		byte Mul( byte a, byte b );
+
+		/// inverse in GF(2^8), a != 0
+		byte Inv( byte a );
+
+		/// coefficient of data block in parity block
+		byte Coefficient( size_t parity, size_t data );
+
+		/// dst[k] ^= coef * src[k], uses SSSE3/AVX2 shuffles when CPU supports them (checked once at runtime)
+		void MulAdd( byte* dst, const byte* src, byte coef, size_t len );
+
+		/// table implementation of MulAdd(), its fallback on CPUs without SSSE3
+		void MulAddTable( byte* dst, const byte* src, byte coef, size_t len );
+
+		/// invert n x n matrix (row-major) in place
+		/// @return false - matrix is singular
+		bool Invert( std::vector<byte>& matrix, size_t n );
+
+	}  // namespace fec
+}  // namespace utils
+}  // namespace comm
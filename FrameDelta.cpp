@@ -0,0 +1,261 @@
+#include "FrameDelta.h"
+#include <cstring>
+#include <algorithm>
+
+namespace comm {
+
+namespace {
+	/// fn( plane, x, y, width, height ) for every tile in order of bitmap: planes, rows of tiles, tiles of row
+	template<typename FN>
+	void ForEachTile( const utils::video::Layout& layout, size_t tile_width, size_t tile_height, FN fn ) {
+		for( size_t p = 0; p < layout.planes; p++ ) {
+			const auto& plane = layout.plane[ p ];
+			for( size_t y = 0; y < plane.rows; y += tile_height ) {
+				for( size_t x = 0; x < plane.row_size; x += tile_width ) {
+					size_t width = std::min( tile_width, plane.row_size - x );
+					fn( plane, x, y, width, std::min( tile_height, plane.rows - y ) );
+				}
+			}
+		}
+	}
+
+	size_t BitmapSize( const utils::video::Layout& layout, size_t tile_width, size_t tile_height ) {
+		size_t count = 0;
+		for( size_t p = 0; p < layout.planes; p++ ) {
+			const auto& plane = layout.plane[ p ];
+			count += ( ( plane.rows + tile_height - 1 ) / tile_height ) *
+					 ( ( plane.row_size + tile_width - 1 ) / tile_width );
+		}
+		return ( count + 7 ) / 8;
+	}
+
+	/// rows of changed tiles in order of stream
+	/// @return size of tiles data
+	size_t CollectTiles( const utils::video::Layout& layout, byte* data, size_t tile_width, size_t tile_height,
+						 const std::vector<byte>& changed, std::vector<NetBufferRef>& tiles ) {
+		tiles.clear();
+		size_t size = 0;
+		size_t index = 0;
+		ForEachTile( layout, tile_width, tile_height,
+					 [&]( const utils::video::Plane& plane, size_t x, size_t y, size_t width, size_t height ) {
+						 if( ( changed[ index / 8 ] & ( 1 << ( index % 8 ) ) ) != 0 ) {
+							 for( size_t row = 0; row < height; row++ ) {
+								 tiles.push_back( { data + plane.offset + ( y + row ) * plane.stride + x, width } );
+							 }
+							 size += width * height;
+						 }
+						 index++;
+					 } );
+		return size;
+	}
+
+	/// sequence number a is newer than b, numbers wrap around
+	bool After( uint32_t a, uint32_t b ) {
+		return static_cast<int32_t>( a - b ) > 0;
+	}
+}  // namespace
+
+bool FrameDeltaEncoder::Write( utils::ChunkWriter& writer, const MF_FRAME& frame ) {
+	const auto& vid = frame.av_props.vidProps;
+	auto layout = utils::video::GetLayout( vid.fccType, vid.nWidth, vid.nHeight, vid.nRowBytes );
+	bool comparable = layout.IsKnown() && layout.size == frame.vec_video_data.size();
+	bool same_format = m_Valid && vid.fccType == m_Props.fccType && vid.nWidth == m_Props.nWidth &&
+					   vid.nHeight == m_Props.nHeight && vid.nRowBytes == m_Props.nRowBytes;
+
+	FrameDeltaHeader header = {};
+	header.ref_sequence = m_Sequence;
+	header.sequence = ++m_Sequence;
+	header.tile_width = TileWidth;
+	header.tile_height = TileHeight;
+
+	if( !comparable || !same_format || m_SinceKeyframe >= m_KeyframeInterval ) {
+		header.flags = FrameDeltaHeader::Keyframe;
+		bool res = writer.WriteBlock( header );
+		res &= frame.Write( writer );
+		m_Props = vid;
+		m_SinceKeyframe = 0;
+		m_Valid = res && comparable;
+		if( m_Valid ) {
+			m_Reference.assign( frame.vec_video_data.begin(), frame.vec_video_data.end() );
+		}
+		return res;
+	}
+
+	// changed tiles are copied to reference while they are found
+	m_Changed.assign( BitmapSize( layout, TileWidth, TileHeight ), 0 );
+	const byte* current = frame.vec_video_data.data();
+	byte* reference = m_Reference.data();
+	size_t index = 0;
+	ForEachTile( layout, TileWidth, TileHeight,
+				 [&]( const utils::video::Plane& plane, size_t x, size_t y, size_t width, size_t height ) {
+					 size_t offset = plane.offset + y * plane.stride + x;
+					 if( !utils::video::RowsEqual( current + offset, plane.stride, reference + offset, plane.stride,
+												   width, height ) ) {
+						 m_Changed[ index / 8 ] |= static_cast<byte>( 1 << ( index % 8 ) );
+						 utils::video::CopyRows( current + offset, plane.stride, reference + offset, plane.stride,
+												 width, height );
+					 }
+					 index++;
+				 } );
+	size_t size = CollectTiles( layout, const_cast<byte*>( current ), TileWidth, TileHeight, m_Changed, m_Tiles );
+
+	m_SinceKeyframe++;
+	bool res = writer.WriteBlock( header );
+	res &= writer.WriteBlock( MFFrameHeader::From( frame.time, frame.av_props ) );
+	res &= writer.Write( frame.str_user_props );
+	res &= writer.Write( m_Changed );
+	res &= writer.WriteBytes( size, [&]( auto put ) {
+		for( const auto& el : m_Tiles ) {
+			put( el.data, el.size );
+		}
+	} );
+	res &= writer.Write( frame.vec_audio_data );
+	m_Valid = res;
+	return res;
+}
+
+bool FrameDeltaDecoder::Load( utils::ChunkReader& reader, int row_bytes,
+							  std::vector<std::shared_ptr<MF_FRAME>>& frames ) {
+	FrameDeltaHeader header = {};
+	uint32_t header_size = 0;
+	if( !reader.ReadBlock( header, header_size ) || header_size < sizeof( header ) ) {
+		return false;
+	}
+
+	if( ( header.flags & FrameDeltaHeader::Keyframe ) != 0 ) {
+		if( m_Reference != nullptr && !After( header.sequence, m_Sequence ) ) {
+			// late keyframe, the reference is newer
+			return true;
+		}
+		auto frame = std::make_shared<MF_FRAME>();
+		if( !frame->Load( reader, row_bytes ) ) {
+			return false;
+		}
+		m_Reference = frame;
+		m_Sequence = header.sequence;
+		frames.push_back( frame );
+		ApplyPending( frames );
+		return true;
+	}
+
+	if( header.tile_width == 0 || header.tile_height == 0 ) {
+		return false;
+	}
+
+	if( m_Reference != nullptr && header.ref_sequence == m_Sequence ) {
+		m_Delta.header = header;
+		if( !ReadDelta( reader, m_Delta ) ) {
+			return false;
+		}
+		auto frame = Apply( m_Delta, &reader );
+		if( frame == nullptr ) {
+			return false;
+		}
+		frames.push_back( frame );
+		ApplyPending( frames );
+		return true;
+	}
+
+	if( m_Reference != nullptr && !After( header.sequence, m_Sequence ) ) {
+		// late or repeated delta
+		return true;
+	}
+
+	// delta after a missed frame (or before late keyframe) waits for it
+	Delta delta;
+	delta.header = header;
+	if( !ReadDelta( reader, delta ) || !reader.Read( delta.tiles ) || !reader.Read( delta.audio ) ) {
+		return false;
+	}
+	if( m_Pending.size() >= MaxPending && m_Pending.count( header.ref_sequence ) == 0 ) {
+		m_Pending.erase( m_Pending.begin() );
+	}
+	m_Pending[ header.ref_sequence ] = std::move( delta );
+	return true;
+}
+
+bool FrameDeltaDecoder::ReadDelta( utils::ChunkReader& reader, Delta& delta ) {
+	uint32_t frame_header_size = 0;
+	return reader.ReadBlock( delta.frame_header, frame_header_size ) &&
+		   frame_header_size >= MFFrameHeader::Version1Size && reader.Read( delta.user_props ) &&
+		   reader.Read( delta.changed );
+}
+
+std::shared_ptr<MF_FRAME> FrameDeltaDecoder::Apply( Delta& delta, utils::ChunkReader* reader ) {
+	const auto vid = m_Reference->av_props.vidProps;
+	if( static_cast<eMFCC>( delta.frame_header.fcc_type ) != vid.fccType || delta.frame_header.width != vid.nWidth ||
+		delta.frame_header.height != vid.nHeight ) {
+		return nullptr;
+	}
+	const auto& header = delta.header;
+	auto layout = utils::video::GetLayout( vid.fccType, vid.nWidth, vid.nHeight, vid.nRowBytes );
+	if( !layout.IsKnown() || layout.size != m_Reference->vec_video_data.size() ||
+		delta.changed.size() != BitmapSize( layout, header.tile_width, header.tile_height ) ) {
+		return nullptr;
+	}
+
+	// the caller still holds the previous frame
+	bool shared = m_Reference.use_count() > 1;
+	auto frame = shared ? std::make_shared<MF_FRAME>( *m_Reference ) : m_Reference;
+
+	size_t size = CollectTiles( layout, frame->vec_video_data.data(), header.tile_width, header.tile_height,
+								delta.changed, m_Tiles );
+	size_t tile = 0;
+	size_t pos = 0;
+	auto put = [&]( const byte* data, size_t len ) {
+		while( len > 0 && tile < m_Tiles.size() ) {
+			size_t copy_size = std::min( m_Tiles[ tile ].size - pos, len );
+			std::memcpy( m_Tiles[ tile ].data + pos, data, copy_size );
+			data += copy_size;
+			len -= copy_size;
+			pos += copy_size;
+			if( pos == m_Tiles[ tile ].size ) {
+				tile++;
+				pos = 0;
+			}
+		}
+	};
+	bool res;
+	if( reader != nullptr ) {
+		res = reader->ReadBytes( size, put ) && reader->Read( frame->vec_audio_data );
+	} else {
+		res = delta.tiles.size() == size;
+		if( res ) {
+			put( delta.tiles.data(), size );
+			frame->vec_audio_data = std::move( delta.audio );
+		}
+	}
+	if( !res ) {
+		if( !shared ) {
+			// tiles are partly applied to the reference
+			m_Reference.reset();
+		}
+		return nullptr;
+	}
+
+	delta.frame_header.To( frame->time, frame->av_props );
+	frame->av_props.vidProps.nRowBytes = vid.nRowBytes;
+	frame->str_user_props = std::move( delta.user_props );
+	m_Reference = frame;
+	m_Sequence = header.sequence;
+	return frame;
+}
+
+void FrameDeltaDecoder::ApplyPending( std::vector<std::shared_ptr<MF_FRAME>>& frames ) {
+	auto found = m_Pending.find( m_Sequence );
+	while( found != m_Pending.end() && m_Reference != nullptr ) {
+		Delta delta = std::move( found->second );
+		m_Pending.erase( found );
+		auto frame = Apply( delta, nullptr );
+		if( frame == nullptr ) {
+			break;
+		}
+		frames.push_back( frame );
+		found = m_Pending.find( m_Sequence );
+	}
+	for( auto it = m_Pending.begin(); it != m_Pending.end(); ) {
+		it = After( it->first, m_Sequence ) ? std::next( it ) : m_Pending.erase( it );
+	}
+}
+
+}  // namespace comm
@@ -0,0 +1,120 @@
+/**
+*	Delta transmission of MF_FRAME for mostly static channels: video is split to tiles (tile_width bytes of visible
+*	row x tile_height rows of every plane), frame is sent as changed tiles against previously sent frame, full
+*	keyframe is sent periodically and when format changes.
+*
+*	Stream of ObjectType::FrameDelta object:
+*	- FrameDeltaHeader block
+*	- keyframe: MF_FRAME as it is written by MF_FRAME::Write()
+*	- delta: MFFrameHeader block, user props, bitmap of changed tiles, data of changed tiles (bytes array), audio
+*/
+#pragma once
+
+#include "MFObjects.h"
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace comm {
+
+struct FrameDeltaHeader {
+	enum EFlags : uint32_t {
+		Keyframe = 1,
+	};
+
+	/// sequence number of the frame
+	uint32_t sequence;
+	/// sequence number of the frame the delta is made against
+	uint32_t ref_sequence;
+	uint16_t tile_width;
+	uint16_t tile_height;
+	uint32_t flags;
+};
+
+static_assert( sizeof( FrameDeltaHeader ) == 16, "FrameDeltaHeader layout is part of wire format" );
+
+/**
+*	Sender side of channel: keeps copy of the last sent video to compare with
+*/
+class FrameDeltaEncoder {
+public:
+	static constexpr uint16_t TileWidth = 64;
+	static constexpr uint16_t TileHeight = 16;
+
+protected:
+	size_t m_KeyframeInterval;
+	size_t m_SinceKeyframe{ 0 };
+	uint32_t m_Sequence{ 0 };
+	/// reference is valid (the last frame is written completely)
+	bool m_Valid{ false };
+	M_VID_PROPS m_Props = {};
+	std::vector<uint8_t> m_Reference;
+	std::vector<byte> m_Changed;
+	std::vector<NetBufferRef> m_Tiles;
+
+public:
+	/// @param keyframe_interval - keyframe is sent after keyframe_interval deltas
+	explicit FrameDeltaEncoder( size_t keyframe_interval )
+		: m_KeyframeInterval( keyframe_interval ) {}
+
+	/// write the frame as keyframe or as changed tiles against the previously written frame
+	bool Write( utils::ChunkWriter& writer, const MF_FRAME& frame );
+
+	/// the next frame is keyframe (e.g. the last one is not delivered)
+	void ForceKeyframe() {
+		m_Valid = false;
+	}
+};
+
+/**
+*	Receiver side of channel: keeps the last frame to apply tiles to. Frame is shared with the caller, it is copied
+*	before the next delta only if the caller still holds it, so delivered frames should not be modified.
+*	Delta which comes ahead of a missed one waits for it (up to MaxPending deltas), late deltas are dropped and
+*	the reference stays intact.
+*/
+class FrameDeltaDecoder {
+public:
+	static constexpr size_t MaxPending = 8;
+
+protected:
+	/// delta read from stream, tiles and audio are kept for pending delta only
+	struct Delta {
+		FrameDeltaHeader header = {};
+		MFFrameHeader frame_header = {};
+		std::string user_props;
+		std::vector<byte> changed;
+		std::vector<byte> tiles;
+		std::vector<uint8_t> audio;
+	};
+
+	std::shared_ptr<MF_FRAME> m_Reference;
+	uint32_t m_Sequence{ 0 };
+	/// the next delta, it is applied while tiles are read
+	Delta m_Delta;
+	/// ref_sequence -> delta waiting for the frame it is made against
+	std::map<uint32_t, Delta> m_Pending;
+	std::vector<NetBufferRef> m_Tiles;
+
+public:
+	/**
+	*	Load the next frame of the channel
+	*	@param row_bytes - stride of keyframe video (see MF_FRAME::Load), deltas keep stride of reference
+	*	@param frames - [output] the loaded frame and pending deltas applied after it, empty if the delta waits for
+	*	a missed frame or is late
+	*	@return false - stream is broken
+	*/
+	bool Load( utils::ChunkReader& reader, int row_bytes, std::vector<std::shared_ptr<MF_FRAME>>& frames );
+
+protected:
+	/// frame header, user props and bitmap of changed tiles
+	bool ReadDelta( utils::ChunkReader& reader, Delta& delta );
+
+	/// apply delta to the reference, tiles are read from reader or taken from the delta if reader is nullptr
+	/// @return the new reference, nullptr - delta does not fit the reference
+	std::shared_ptr<MF_FRAME> Apply( Delta& delta, utils::ChunkReader* reader );
+
+	/// apply pending deltas which follow the reference, drop outdated ones
+	void ApplyPending( std::vector<std::shared_ptr<MF_FRAME>>& frames );
+};
+
+}  // namespace comm
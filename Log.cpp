@@ -0,0 +1,326 @@
+#include "Log.h"
+#include <algorithm>
+#include <array>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace comm {
+namespace utils {
+	namespace log {
+
+		namespace {
+			Level LevelFromEnvironment() {
+				Level level = Level::Warning;
+				const char* name = std::getenv( "MFPIPE_LOG_LEVEL" );
+				if( name != nullptr ) {
+					ParseLevel( name, level );
+				}
+				return level;
+			}
+
+			struct Record {
+				std::chrono::system_clock::time_point time;
+				Level level;
+				uint32_t thread;
+				const char* event;
+				size_t count;
+				/// string fields keep offset in text as u
+				Field fields[ MaxFields ];
+				char text[ TextSize ];
+			};
+
+			/**
+			*	Single producer (owner thread) / single consumer (writer) ring of records
+			*/
+			class Ring {
+			public:
+				static constexpr size_t Capacity = 1024;
+
+			protected:
+				std::array<Record, Capacity> m_Records;
+				std::atomic<size_t> m_Head{ 0 };
+				std::atomic<size_t> m_Tail{ 0 };
+
+			public:
+				const uint32_t id;
+
+				explicit Ring( uint32_t ring_id )
+					: id( ring_id ) {}
+
+				/// @return nullptr - ring is full
+				Record* Reserve() {
+					size_t head = m_Head.load( std::memory_order_relaxed );
+					if( head - m_Tail.load( std::memory_order_acquire ) == Capacity ) {
+						return nullptr;
+					}
+					return &m_Records[ head % Capacity ];
+				}
+
+				void Commit() {
+					m_Head.store( m_Head.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+				}
+
+				template<typename FN>
+				void Drain( FN fn ) {
+					size_t tail = m_Tail.load( std::memory_order_relaxed );
+					size_t head = m_Head.load( std::memory_order_acquire );
+					for( ; tail != head; tail++ ) {
+						fn( m_Records[ tail % Capacity ] );
+					}
+					m_Tail.store( tail, std::memory_order_release );
+				}
+
+				bool Empty() const {
+					return m_Head.load( std::memory_order_acquire ) == m_Tail.load( std::memory_order_acquire );
+				}
+			};
+
+			void FormatRecord( const Record& record, std::string& line ) {
+				char buf[ 128 ];
+				auto time = std::chrono::system_clock::to_time_t( record.time );
+				auto since_epoch = record.time.time_since_epoch();
+				auto us = std::chrono::duration_cast<std::chrono::microseconds>( since_epoch ).count() % 1000000;
+				std::tm tm = {};
+#if defined( _WIN32 )
+				gmtime_s( &tm, &time );
+#else
+				gmtime_r( &time, &tm );
+#endif
+				size_t len = std::strftime( buf, sizeof( buf ), "%Y-%m-%dT%H:%M:%S", &tm );
+				std::snprintf( buf + len, sizeof( buf ) - len, ".%06dZ %s [%u] %s", static_cast<int>( us ),
+							   LevelName( record.level ), record.thread, record.event );
+				line = buf;
+
+				for( size_t i = 0; i < record.count; i++ ) {
+					const Field& field = record.fields[ i ];
+					switch( field.kind ) {
+					case Field::Kind::Int:
+						std::snprintf( buf, sizeof( buf ), " %s=%lld", field.key, static_cast<long long>( field.i ) );
+						break;
+					case Field::Kind::UInt:
+						std::snprintf( buf, sizeof( buf ), " %s=%llu", field.key,
+									   static_cast<unsigned long long>( field.u ) );
+						break;
+					case Field::Kind::Double:
+						std::snprintf( buf, sizeof( buf ), " %s=%g", field.key, field.d );
+						break;
+					case Field::Kind::Pointer:
+						std::snprintf( buf, sizeof( buf ), " %s=%p", field.key, field.p );
+						break;
+					case Field::Kind::String:
+						std::snprintf( buf, sizeof( buf ), " %s=%s", field.key, record.text + field.u );
+						break;
+					default:
+						buf[ 0 ] = 0;
+						break;
+					}
+					line += buf;
+				}
+			}
+
+			/**
+			*	Registry of thread rings and the writer thread
+			*/
+			class Logger {
+			protected:
+				static constexpr auto DrainPeriod = std::chrono::milliseconds( 10 );
+
+				std::mutex m_Lock;
+				std::condition_variable m_Wake;
+				bool m_Running{ true };
+				std::vector<std::shared_ptr<Ring>> m_Rings;
+				uint32_t m_NextRing{ 1 };
+				std::thread m_Writer;
+
+				/// serializes draining of writer thread and Flush()
+				std::mutex m_DrainLock;
+				std::mutex m_SinkLock;
+				Sink m_Sink;
+				std::vector<Record> m_Drained;
+				std::string m_Line;
+
+			public:
+				std::atomic<uint64_t> dropped{ 0 };
+
+				Logger() {
+					m_Writer = std::thread( [this]() { WriterWork(); } );
+				}
+
+				~Logger() {
+					{
+						std::unique_lock lock( m_Lock );
+						m_Running = false;
+					}
+					m_Wake.notify_all();
+					m_Writer.join();
+					Drain();
+				}
+
+				static Logger& Instance() {
+					static Logger logger;
+					return logger;
+				}
+
+				std::shared_ptr<Ring> Register() {
+					std::unique_lock lock( m_Lock );
+					auto ring = std::make_shared<Ring>( m_NextRing++ );
+					m_Rings.push_back( ring );
+					return ring;
+				}
+
+				void SetSink( Sink sink ) {
+					std::unique_lock lock( m_SinkLock );
+					m_Sink = std::move( sink );
+				}
+
+				/// write records of all rings ordered by time, forget rings of finished threads
+				void Drain() {
+					std::unique_lock drain_lock( m_DrainLock );
+					std::vector<std::shared_ptr<Ring>> rings;
+					{
+						std::unique_lock lock( m_Lock );
+						rings = m_Rings;
+						m_Rings.erase( std::remove_if( m_Rings.begin(), m_Rings.end(),
+													   []( const auto& ring ) {
+														   // registry and local copy are the only owners
+														   return ring.use_count() == 2 && ring->Empty();
+													   } ),
+									   m_Rings.end() );
+					}
+
+					m_Drained.clear();
+					for( const auto& ring : rings ) {
+						ring->Drain( [&]( const Record& record ) { m_Drained.push_back( record ); } );
+					}
+					if( m_Drained.empty() ) {
+						return;
+					}
+					std::stable_sort( m_Drained.begin(), m_Drained.end(),
+									  []( const Record& a, const Record& b ) { return a.time < b.time; } );
+
+					std::unique_lock lock( m_SinkLock );
+					for( const auto& record : m_Drained ) {
+						FormatRecord( record, m_Line );
+						if( m_Sink ) {
+							m_Sink( m_Line );
+						} else {
+							std::fprintf( stderr, "%s\n", m_Line.c_str() );
+						}
+					}
+					if( !m_Sink ) {
+						std::fflush( stderr );
+					}
+				}
+
+			protected:
+				void WriterWork() {
+					std::unique_lock lock( m_Lock );
+					while( m_Running ) {
+						m_Wake.wait_for( lock, DrainPeriod );
+						lock.unlock();
+						Drain();
+						lock.lock();
+					}
+				}
+			};
+
+			/// ring of the calling thread, it is drained by the writer after the thread exits
+			Ring* ThreadRing() {
+				thread_local std::shared_ptr<Ring> ring = Logger::Instance().Register();
+				return ring.get();
+			}
+		}  // namespace
+
+		std::atomic<int> g_Level{ static_cast<int>( LevelFromEnvironment() ) };
+
+		void SetLevel( Level level ) {
+			g_Level.store( static_cast<int>( level ), std::memory_order_relaxed );
+		}
+
+		Level GetLevel() {
+			return static_cast<Level>( g_Level.load( std::memory_order_relaxed ) );
+		}
+
+		bool ParseLevel( const std::string& name, Level& level ) {
+			static const char* const names[] = { "trace", "debug", "info", "warning", "error", "off" };
+			for( size_t i = 0; i < sizeof( names ) / sizeof( names[ 0 ] ); i++ ) {
+				if( name == names[ i ] ) {
+					level = static_cast<Level>( i );
+					return true;
+				}
+			}
+			return false;
+		}
+
+		const char* LevelName( Level level ) {
+			switch( level ) {
+			case Level::Trace:
+				return "TRACE";
+			case Level::Debug:
+				return "DEBUG";
+			case Level::Info:
+				return "INFO";
+			case Level::Warning:
+				return "WARN";
+			case Level::Error:
+				return "ERROR";
+			default:
+				return "OFF";
+			}
+		}
+
+		void Write( Level level, const char* event, const Field& f1, const Field& f2, const Field& f3,
+					const Field& f4, const Field& f5, const Field& f6 ) {
+			Ring* ring = ThreadRing();
+			Record* record = ring->Reserve();
+			if( record == nullptr ) {
+				Logger::Instance().dropped.fetch_add( 1, std::memory_order_relaxed );
+				return;
+			}
+
+			record->time = std::chrono::system_clock::now();
+			record->level = level;
+			record->thread = ring->id;
+			record->event = event;
+			record->count = 0;
+			size_t text_pos = 0;
+			for( const Field* field : { &f1, &f2, &f3, &f4, &f5, &f6 } ) {
+				if( field->kind == Field::Kind::None ) {
+					continue;
+				}
+				Field& dst = record->fields[ record->count++ ];
+				dst = *field;
+				if( field->kind == Field::Kind::String ) {
+					// truncated to the rest of text storage
+					size_t len = std::min( std::strlen( field->s ), TextSize - 1 - text_pos );
+					std::memcpy( record->text + text_pos, field->s, len );
+					record->text[ text_pos + len ] = 0;
+					dst.u = text_pos;
+					text_pos += std::min( len + 1, TextSize - 1 - text_pos );
+				}
+			}
+			ring->Commit();
+		}
+
+		void SetSink( Sink sink ) {
+			Logger::Instance().SetSink( std::move( sink ) );
+		}
+
+		void Flush() {
+			Logger::Instance().Drain();
+		}
+
+		uint64_t Dropped() {
+			return Logger::Instance().dropped.load( std::memory_order_relaxed );
+		}
+
+	}  // namespace log
+}  // namespace utils
+}  // namespace comm
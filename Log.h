@@ -0,0 +1,155 @@
+/**
+*	Leveled structured logging: record is event name plus up to MaxFields key=value fields. Level is checked against
+*	compile-time MFPIPE_LOG_MIN_LEVEL (disabled calls are not compiled) and runtime level (one relaxed atomic load).
+*	Enabled record is copied to the lock-free ring of the calling thread without formatting, background writer
+*	drains rings, formats records and passes lines to the sink (stderr by default). Record is dropped when the ring
+*	of the thread is full, so logging never blocks the data path.
+*
+*	MFPIPE_LOG( Debug, "PipePut", { "pipe", this }, { "channel", strChannel }, { "result", result } );
+*
+*	Runtime level is taken from MFPIPE_LOG_LEVEL environment variable (trace, debug, info, warning, error, off),
+*	default is warning.
+*/
+#pragma once
+
+#include "MFTypes.h"
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <type_traits>
+
+/// records of lower levels are not compiled: 0 - trace ... 5 - off
+#ifndef MFPIPE_LOG_MIN_LEVEL
+#define MFPIPE_LOG_MIN_LEVEL 0
+#endif
+
+namespace comm {
+namespace utils {
+	namespace log {
+
+		enum class Level : int {
+			Trace = 0,
+			Debug = 1,
+			Info = 2,
+			Warning = 3,
+			Error = 4,
+			Off = 5,
+		};
+
+		constexpr size_t MaxFields = 6;
+		/// storage of string values of record, longer strings are truncated
+		constexpr size_t TextSize = 96;
+
+		/**
+		*	Value of record, strings are copied to the record by Write()
+		*/
+		struct Field {
+			enum class Kind : byte {
+				None,
+				Int,
+				UInt,
+				Double,
+				Pointer,
+				String,
+			};
+
+			const char* key{ nullptr };
+			Kind kind{ Kind::None };
+			union {
+				int64_t i;
+				uint64_t u;
+				double d;
+				const void* p;
+				const char* s;
+			};
+
+			Field()
+				: u( 0 ) {}
+
+			template<typename TYPE, typename std::enable_if<std::is_integral<TYPE>::value &&
+																 std::is_signed<TYPE>::value,
+															 int>::type = 0>
+			Field( const char* name, TYPE value )
+				: key( name )
+				, kind( Kind::Int )
+				, i( value ) {}
+
+			template<typename TYPE, typename std::enable_if<std::is_integral<TYPE>::value &&
+																 !std::is_signed<TYPE>::value,
+															 int>::type = 0>
+			Field( const char* name, TYPE value )
+				: key( name )
+				, kind( Kind::UInt )
+				, u( value ) {}
+
+			/// enums (e.g. comm::Error) are written as numbers
+			template<typename TYPE, typename std::enable_if<std::is_enum<TYPE>::value, int>::type = 0>
+			Field( const char* name, TYPE value )
+				: key( name )
+				, kind( Kind::Int )
+				, i( static_cast<int64_t>( value ) ) {}
+
+			Field( const char* name, double value )
+				: key( name )
+				, kind( Kind::Double )
+				, d( value ) {}
+
+			Field( const char* name, const void* value )
+				: key( name )
+				, kind( Kind::Pointer )
+				, p( value ) {}
+
+			Field( const char* name, const char* value )
+				: key( name )
+				, kind( Kind::String )
+				, s( value != nullptr ? value : "" ) {}
+
+			Field( const char* name, const std::string& value )
+				: key( name )
+				, kind( Kind::String )
+				, s( value.c_str() ) {}
+		};
+
+		/// runtime level, use Enabled()/SetLevel()
+		extern std::atomic<int> g_Level;
+
+		inline bool Enabled( Level level ) {
+			return static_cast<int>( level ) >= g_Level.load( std::memory_order_relaxed );
+		}
+
+		void SetLevel( Level level );
+		Level GetLevel();
+		/// @return false - unknown name
+		bool ParseLevel( const std::string& name, Level& level );
+		const char* LevelName( Level level );
+
+		/// put record to the ring of the calling thread (level is not checked, use MFPIPE_LOG)
+		void Write( Level level, const char* event, const Field& f1 = Field(), const Field& f2 = Field(),
+					const Field& f3 = Field(), const Field& f4 = Field(), const Field& f5 = Field(),
+					const Field& f6 = Field() );
+
+		/// receives formatted lines (without new line) on the writer thread, nullptr - stderr
+		using Sink = std::function<void( const std::string& line )>;
+		void SetSink( Sink sink );
+
+		/// write records of all threads to the sink before return
+		void Flush();
+
+		/// number of records dropped because ring of the thread was full
+		uint64_t Dropped();
+
+	}  // namespace log
+}  // namespace utils
+}  // namespace comm
+
+#define MFPIPE_LOG( level, event, ... )                                                                              \
+	do {                                                                                                             \
+		if constexpr( static_cast<int>( comm::utils::log::Level::level ) >= MFPIPE_LOG_MIN_LEVEL ) {                 \
+			if( comm::utils::log::Enabled( comm::utils::log::Level::level ) ) {                                      \
+				comm::utils::log::Write( comm::utils::log::Level::level, event, ##__VA_ARGS__ );                     \
+			}                                                                                                        \
+		}                                                                                                            \
+	} while( 0 )
@@ -2,6 +2,7 @@
 
 #include "MFTypes.h"
 #include "ChunkReaderWriter.h"
+#include "VideoLayout.h"
 
 namespace comm {
 
@@ -9,6 +10,8 @@ enum class ObjectType : uint32_t {
 	Base = 0,
 	Frame = 1,
 	Buffer = 2,
+	/// MF_FRAME sent as changed tiles or keyframe (FrameDelta.h), it is loaded by pipe
+	FrameDelta = 3,
 };
 
 typedef struct MF_BASE_TYPE {
@@ -28,9 +31,86 @@ typedef struct MF_BASE_TYPE {
 		return true;
 	}
 
+	/// exact size of data written by Write() with the encoding
+	virtual size_t EncodedSize( utils::EEncoding encoding ) const {
+		return 0;
+	}
+
 	static MF_BASE_TYPE::Ptr CreateByObjectType( ObjectType ot );
 } MF_BASE_TYPE;
 
+/**
+*	MF_FRAME header on the wire: M_TIME and M_AV_PROPS in fixed layout (explicit padding, little-endian),
+*	so it is decoded with one copy. New fields are appended with the next version, readers accept headers of
+*	older and newer versions.
+*	Version 2: source_row_bytes - video rows are sent without stride padding (row_bytes is the smallest stride of
+*	format), receiver restores stride of sender or applies own one. Older readers get valid frame with the smallest
+*	stride.
+*/
+struct MFFrameHeader {
+	static constexpr uint32_t CurrentVersion = 2;
+	/// size of the first version, smaller header is broken
+	static constexpr size_t Version1Size = 72;
+	static constexpr size_t Version2Size = 80;
+
+	uint32_t version;
+	uint32_t reserved0;
+	int64_t start_time;
+	int64_t end_time;
+	uint32_t fcc_type;
+	int32_t width;
+	int32_t height;
+	int32_t row_bytes;
+	int16_t aspect_x;
+	int16_t aspect_y;
+	uint32_t reserved1;
+	double rate;
+	int32_t channels;
+	int32_t samples_per_sec;
+	int32_t bits_per_sample;
+	int32_t track_split_bits;
+	/// stride of sender, 0 - video data is sent as is
+	int32_t source_row_bytes;
+	uint32_t reserved2;
+
+	static MFFrameHeader From( const M_TIME& time, const M_AV_PROPS& props ) {
+		MFFrameHeader header = {};
+		header.version = CurrentVersion;
+		header.start_time = time.rtStartTime;
+		header.end_time = time.rtEndTime;
+		header.fcc_type = static_cast<uint32_t>( props.vidProps.fccType );
+		header.width = props.vidProps.nWidth;
+		header.height = props.vidProps.nHeight;
+		header.row_bytes = props.vidProps.nRowBytes;
+		header.aspect_x = props.vidProps.nAspectX;
+		header.aspect_y = props.vidProps.nAspectY;
+		header.rate = props.vidProps.dblRate;
+		header.channels = props.audProps.nChannels;
+		header.samples_per_sec = props.audProps.nSamplesPerSec;
+		header.bits_per_sample = props.audProps.nBitsPerSample;
+		header.track_split_bits = props.audProps.nTrackSplitBits;
+		return header;
+	}
+
+	void To( M_TIME& time, M_AV_PROPS& props ) const {
+		time.rtStartTime = start_time;
+		time.rtEndTime = end_time;
+		props.vidProps.fccType = static_cast<eMFCC>( fcc_type );
+		props.vidProps.nWidth = width;
+		props.vidProps.nHeight = height;
+		props.vidProps.nRowBytes = row_bytes;
+		props.vidProps.nAspectX = aspect_x;
+		props.vidProps.nAspectY = aspect_y;
+		props.vidProps.dblRate = rate;
+		props.audProps.nChannels = channels;
+		props.audProps.nSamplesPerSec = samples_per_sec;
+		props.audProps.nBitsPerSample = bits_per_sample;
+		props.audProps.nTrackSplitBits = track_split_bits;
+	}
+};
+
+static_assert( sizeof( MFFrameHeader ) == MFFrameHeader::Version2Size, "MFFrameHeader layout is part of wire format" );
+
 typedef struct MF_FRAME : public MF_BASE_TYPE {
 	typedef std::shared_ptr<MF_FRAME> TPtr;
 
@@ -44,20 +124,139 @@ typedef struct MF_FRAME : public MF_BASE_TYPE {
 		return ObjectType::Frame;
 	}
 
+	/// fields following the header block
+	static constexpr auto Schema() {
+		using namespace utils::schema;
+		return Fields( Field( &MF_FRAME::str_user_props ), Field( &MF_FRAME::vec_video_data ),
+					   Field( &MF_FRAME::vec_audio_data ) );
+	}
+
+	size_t EncodedSize( utils::EEncoding encoding ) const override {
+		utils::video::Layout layout;
+		utils::video::Layout packed;
+		if( GetPackedLayout( layout, packed ) ) {
+			return utils::EncodedBlockSize<MFFrameHeader>( encoding ) + utils::EncodedSize( encoding, str_user_props ) +
+				   utils::EncodedChunkSize( encoding, packed.size ) + utils::EncodedSize( encoding, vec_audio_data );
+		}
+		return utils::EncodedBlockSize<MFFrameHeader>( encoding ) + utils::EncodedSchemaSize( encoding, *this );
+	}
+
 	bool Write( utils::ChunkWriter& writer ) const override {
-		// TODO: implement all types & all values
-		bool res = writer.Write( str_user_props );
-		res &= writer.Write( vec_video_data );
+		utils::video::Layout layout;
+		utils::video::Layout packed;
+		if( !GetPackedLayout( layout, packed ) ) {
+			bool res = writer.WriteBlock( MFFrameHeader::From( time, av_props ) );
+			res &= writer.WriteSchema( *this );
+			return res;
+		}
+
+		// rows of packed stride are taken from rows of source stride, so padding is not sent
+		MFFrameHeader header = MFFrameHeader::From( time, av_props );
+		header.row_bytes = static_cast<int32_t>( packed.plane[ 0 ].stride );
+		header.source_row_bytes = av_props.vidProps.nRowBytes;
+		bool res = writer.WriteBlock( header );
+		res &= writer.Write( str_user_props );
+		res &= writer.WriteBytes( packed.size, [&]( auto put ) {
+			for( size_t p = 0; p < layout.planes; p++ ) {
+				const auto& plane = layout.plane[ p ];
+				for( size_t row = 0; row < plane.rows; row++ ) {
+					put( vec_video_data.data() + plane.offset + row * plane.stride, packed.plane[ p ].stride );
+				}
+			}
+		} );
 		res &= writer.Write( vec_audio_data );
 		return res;
 	}
 
 	bool Load( utils::ChunkReader& reader ) override {
-		// TODO: implement all types & all values
-		bool res = reader.Read( str_user_props );
-		res &= reader.Read( vec_video_data );
-		res &= reader.Read( vec_audio_data );
-		return res;
+		return Load( reader, -1 );
+	}
+
+	/**
+	*	Load frame with specified stride of video
+	*	@param row_bytes - stride of the first plane: -1 - stride of sender, 0 - no padding
+	*/
+	bool Load( utils::ChunkReader& reader, int row_bytes ) {
+		// frame of older peer has no header
+		MFFrameHeader header = {};
+		uint32_t header_size = 0;
+		if( reader.ReadBlock( header, header_size ) ) {
+			if( header.version == 0 || header_size < MFFrameHeader::Version1Size ) {
+				return false;
+			}
+			header.To( time, av_props );
+		}
+
+		const auto& vid = av_props.vidProps;
+		utils::video::Layout packed = utils::video::GetLayout( vid.fccType, vid.nWidth, vid.nHeight, vid.nRowBytes );
+		if( header.source_row_bytes <= 0 || !packed.IsKnown() ) {
+			if( !reader.ReadSchema( *this ) ) {
+				return false;
+			}
+			if( row_bytes >= 0 ) {
+				ChangeRowBytes( row_bytes );
+			}
+			return true;
+		}
+
+		// rows are scattered from stream to rows of requested stride
+		int dst_row_bytes = std::max( row_bytes < 0 ? header.source_row_bytes : row_bytes, vid.nRowBytes );
+		utils::video::Layout layout = utils::video::GetLayout( vid.fccType, vid.nWidth, vid.nHeight, dst_row_bytes );
+		if( !layout.IsKnown() || !reader.Read( str_user_props ) ) {
+			return false;
+		}
+		// buffer is allocated with the first piece, when size of array in stream is checked against packed size
+		vec_video_data.clear();
+		std::unique_ptr<utils::video::RowScatter> scatter;
+		bool res = reader.ReadBytes( packed.size, [&]( const byte* data, size_t size ) {
+			if( scatter == nullptr ) {
+				vec_video_data.resize( layout.size );
+				scatter.reset( new utils::video::RowScatter( packed, layout, vec_video_data.data() ) );
+			}
+			( *scatter )( data, size );
+		} );
+		if( !res ) {
+			return false;
+		}
+		av_props.vidProps.nRowBytes = dst_row_bytes;
+		return reader.Read( vec_audio_data );
+	}
+
+	/**
+	*	Change stride of video data, rows are copied (stride is not less than the smallest stride of format)
+	*	@return false - format is unknown or size of video data does not match properties
+	*/
+	bool ChangeRowBytes( int row_bytes ) {
+		const auto& vid = av_props.vidProps;
+		utils::video::Layout layout = utils::video::GetLayout( vid.fccType, vid.nWidth, vid.nHeight, vid.nRowBytes );
+		if( !layout.IsKnown() || layout.size != vec_video_data.size() ) {
+			return false;
+		}
+		row_bytes = std::max( row_bytes, utils::video::PackedRowBytes( vid.fccType, vid.nWidth ) );
+		if( row_bytes == vid.nRowBytes ) {
+			return true;
+		}
+
+		utils::video::Layout dst_layout = utils::video::GetLayout( vid.fccType, vid.nWidth, vid.nHeight, row_bytes );
+		std::vector<uint8_t> data( dst_layout.size );
+		utils::video::CopyPlanes( layout, vec_video_data.data(), dst_layout, data.data() );
+		vec_video_data.swap( data );
+		av_props.vidProps.nRowBytes = row_bytes;
+		return true;
+	}
+
+protected:
+	/// layouts of video data with stride padding and without it
+	/// @return false - format is unknown or there is no padding
+	bool GetPackedLayout( utils::video::Layout& layout, utils::video::Layout& packed ) const {
+		const auto& vid = av_props.vidProps;
+		layout = utils::video::GetLayout( vid.fccType, vid.nWidth, vid.nHeight, vid.nRowBytes );
+		int packed_row_bytes = utils::video::PackedRowBytes( vid.fccType, vid.nWidth );
+		if( !layout.IsKnown() || layout.size != vec_video_data.size() || packed_row_bytes >= vid.nRowBytes ) {
+			return false;
+		}
+		packed = utils::video::GetLayout( vid.fccType, vid.nWidth, vid.nHeight, packed_row_bytes );
+		return true;
 	}
 
 } MF_FRAME;
@@ -83,18 +282,21 @@ typedef struct MF_BUFFER : public MF_BASE_TYPE {
 		return ObjectType::Buffer;
 	}
 
+	static constexpr auto Schema() {
+		using namespace utils::schema;
+		return Fields( FieldAs<uint32_t>( &MF_BUFFER::flags ), Field( &MF_BUFFER::data ) );
+	}
+
+	size_t EncodedSize( utils::EEncoding encoding ) const override {
+		return utils::EncodedSchemaSize( encoding, *this );
+	}
+
 	bool Write( utils::ChunkWriter& writer ) const override {
-		bool res = writer.Write( static_cast<uint32_t>( flags ) );
-		res &= writer.Write( data );
-		return res;
+		return writer.WriteSchema( *this );
 	}
 
 	bool Load( utils::ChunkReader& reader ) override {
-		uint32_t fl;
-		bool res = reader.Read( fl );
-		flags = static_cast<eMFBufferFlags>( fl );
-		res &= reader.Read( data );
-		return res;
+		return reader.ReadSchema( *this );
 	}
 } MF_BUFFER;
 
@@ -40,6 +40,8 @@ public:
 	virtual Error PipeCreate( /*[in]*/ const std::string &strPipeID, /*[in]*/ const std::string &strHints ) = 0;
 	virtual Error PipeOpen( /*[in]*/ const std::string &strPipeID, /*[in]*/ int _nMaxBuffers,
 							/*[in]*/ const std::string &strHints ) = 0;
+	/// listening pipe without connected peers (or subscribers of the channel) drops the object and returns
+	/// Error::Ok, PipeInfoGet() reports the number of peers in nPipesConnected
 	virtual Error PipePut( /*[in]*/ const std::string &strChannel,
 						   /*[in]*/ const std::shared_ptr<MF_BASE_TYPE> &pBufferOrFrame, /*[in]*/ int _nMaxWaitMs,
 						   /*[in]*/ const std::string &strHints ) = 0;
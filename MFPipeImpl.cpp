@@ -1,22 +1,104 @@
 #include "MFPipeImpl.h"
 #include "ChunkReaderWriter.h"
+#include "URL.h"
+#include "Log.h"
+#include "Trace.h"
 #include <thread>
+#include <algorithm>
 #include <chrono>
 #include <condition_variable>
 #include <atomic>
+#include <filesystem>
 
 using namespace std::chrono_literals;
 
 namespace comm {
 
+namespace {
+	/**
+	*	Record read back from spill queue
+	*/
+	class SpilledMsg : public IMsgReceived {
+	protected:
+		std::vector<byte> m_Data;
+		NetBufferRef m_Buffer;
+		MessageID m_MessageID;
+		SessionID m_SessionID;
+
+	public:
+		SpilledMsg( std::vector<byte> data, MessageID msg_id, SessionID session_id )
+			: m_Data( std::move( data ) )
+			, m_Buffer{ m_Data.data(), m_Data.size() }
+			, m_MessageID( msg_id )
+			, m_SessionID( session_id ) {}
+
+		MessageID GetMessageID() const override {
+			return m_MessageID;
+		}
+
+		SessionID GetSessionID() const override {
+			return m_SessionID;
+		}
+
+		ConstNetBufferSeq GetBuffers() const override {
+			return { &m_Buffer };
+		}
+	};
+
+	/// reports of sent messages, shared with send callbacks which may outlive SendAndWait()
+	struct SendCompletion {
+		std::mutex lock;
+		std::condition_variable check;
+		size_t complete = 0;
+		std::vector<Error> results;
+	};
+
+	/// wait of PipeGet/PipeMessageGet: 0 - no wait, at least 100 ms otherwise
+	std::chrono::milliseconds WaitDuration( int max_wait_ms ) {
+		return std::chrono::milliseconds( max_wait_ms == 0 ? 0 : std::max( 100, max_wait_ms ) );
+	}
+
+	/// load object written by MF_BASE_TYPE::Write(), frames are loaded with video stride row_bytes
+	MF_BASE_TYPE::Ptr LoadObject( utils::ChunkReader &chunk_reader, ObjectType type, int row_bytes ) {
+		auto object = MF_BASE_TYPE::CreateByObjectType( type );
+		if( object == nullptr ) {
+			return nullptr;
+		}
+		auto frame = std::dynamic_pointer_cast<MF_FRAME>( object );
+		bool res = frame != nullptr ? frame->Load( chunk_reader, row_bytes ) : object->Load( chunk_reader );
+		return res ? object : nullptr;
+	}
+}  // namespace
+
+MFPipeImpl::~MFPipeImpl() {
+	// collector and delivery tasks refer to the pipe
+	StopMetrics();
+	StopCallbacks();
+}
+
 Error MFPipeImpl::PipeCreate( /*[in]*/ const std::string &strPipeID, /*[in]*/ const std::string &strHints ) {
 	m_Transport = comm::TransportFactory::CreateTransport( strPipeID );
 	if( m_Transport == nullptr ) {
 		return Error::InvalidSettings;
 	}
-	auto onmsg = &MFPipeImpl::OnNewMessage; 
-	return m_Transport->Open( strPipeID, comm::ITransport::EOpen::Listen,
-							  [=]( ITransport *transport, const IMsgReceived::Ptr &msg ) { ( this->*onmsg )( msg ); } );
+	m_Listening = true;
+	m_PipeID = strPipeID;
+	ApplySettings( strPipeID, strHints );
+	Error err = StartCapture( strPipeID, strHints );
+	if( err != Error::Ok ) {
+		return err;
+	}
+	auto onmsg = &MFPipeImpl::OnNewMessage;
+	auto onclosed = &MFPipeImpl::OnSessionClosed;
+	m_Transport->SetOnSessionClosed(
+		[=]( ITransport *transport, SessionID session ) { ( this->*onclosed )( session ); } );
+	err =
+		m_Transport->Open( strPipeID, strHints, comm::ITransport::EOpen::Listen,
+						   [=]( ITransport *transport, const IMsgReceived::Ptr &msg ) { ( this->*onmsg )( msg ); } );
+	if( err != Error::Ok ) {
+		return err;
+	}
+	return StartMetrics( strPipeID, strHints );
 }
 
 Error MFPipeImpl::PipeOpen( /*[in]*/ const std::string &strPipeID, /*[in]*/ int _nMaxBuffers,
@@ -26,49 +108,130 @@ Error MFPipeImpl::PipeOpen( /*[in]*/ const std::string &strPipeID, /*[in]*/ int
 		return Error::InvalidSettings;
 	}
 
+	m_Listening = false;
+	m_PipeID = strPipeID;
+	m_MaxBuffers = _nMaxBuffers;
+	ApplySettings( strPipeID, strHints );
+	Error err = StartCapture( strPipeID, strHints );
+	if( err != Error::Ok ) {
+		return err;
+	}
+
 	auto onmsg = &MFPipeImpl::OnNewMessage;
-	return m_Transport->Open( strPipeID, comm::ITransport::EOpen::Connect,
-							  [=]( ITransport *transport, const IMsgReceived::Ptr &msg ) { ( this->*onmsg )( msg ); } );
+	err =
+		m_Transport->Open( strPipeID, strHints, comm::ITransport::EOpen::Connect,
+						   [=]( ITransport *transport, const IMsgReceived::Ptr &msg ) { ( this->*onmsg )( msg ); } );
+	if( err != Error::Ok ) {
+		return err;
+	}
+
+	err = StartMetrics( strPipeID, strHints );
+	if( err != Error::Ok ) {
+		return err;
+	}
+
+	// listening side answers by own Hello, records are written in fixed encoding and uncompressed until then
+	err = SendHello( {}, true );
+	if( err != Error::Ok ) {
+		return err;
+	}
+
+	std::string channels = utils::Params::Parse( strHints ).Get( "channels" );
+	size_t pos = 0;
+	while( pos < channels.length() ) {
+		size_t end = channels.find( ',', pos );
+		if( end == std::string::npos ) {
+			end = channels.length();
+		}
+		if( end != pos ) {
+			err = PipeSubscribe( channels.substr( pos, end - pos ), 100 );
+			if( err != Error::Ok ) {
+				return err;
+			}
+		}
+		pos = end + 1;
+	}
+
+	return Error::Ok;
 }
 
 Error MFPipeImpl::PipePut( /*[in]*/ const std::string &strChannel,
 						   /*[in]*/ const std::shared_ptr<MF_BASE_TYPE> &pBufferOrFrame,
 			   /*[in]*/ int _nMaxWaitMs, /*[in]*/ const std::string &strHints ) {
 
-	std::atomic<bool> complete{ false };
-	std::mutex complete_lock;
-	std::condition_variable complete_check;
-	Error result = Error::Timeout;
+	auto started = std::chrono::steady_clock::now();
+	int64_t origin = m_TraceInterval != 0 || m_Capture != nullptr ? utils::trace::Now() : 0;
+	PeerCaps caps;
+	auto msg = ComposeMsg( strChannel, strHints, caps );
+	SetTrace( *msg, origin );
+	auto deadline = GetDeadline( strChannel, strHints, *pBufferOrFrame );
+	if( deadline != std::chrono::steady_clock::time_point::max() ) {
+		msg->SetDeadline( deadline );
+	}
+
+	utils::SinkChunkWriter<utils::MsgComposeSink> chunk_writer( utils::MsgComposeSink( *msg ), caps.encoding );
+
+	byte record_type = static_cast<byte>( ERecordType::Data ) | ( m_Checksum ? RecordChecksumFlag : 0 );
 
-	auto msg = m_Transport->ComposeMsg();
+	utils::ECodec codec = SelectCodec( strChannel, strHints, caps.codecs );
+	chunk_writer.EnableCompression( codec, m_CodecLevel );
 
-	auto allocator = [=]( size_t size ) -> comm::NetBufferRef * { return msg->AllocBuffer(); };
-	auto writer = [=]( comm::NetBufferRef *buf, size_t len ) { msg->Write( buf, len ); };
-	utils::ChunkWriter chunk_writer( allocator, writer );
+	// frames of delta channel are written by encoder of the channel
+	auto frame = std::dynamic_pointer_cast<MF_FRAME>( pBufferOrFrame );
+	bool delta = frame != nullptr && ( caps.features & FeatureDeltaFrames ) != 0 &&
+				 IsDeltaChannel( strChannel, strHints );
+	byte object_type = static_cast<byte>( delta ? ObjectType::FrameDelta : pBufferOrFrame->GetObjectType() );
 
-	bool res = chunk_writer.Write( static_cast<byte>( ERecordType::Data ) );
+	// packets for whole record are taken at once, size of compressed and delta records is not known
+	bool res = true;
+	if( codec == utils::ECodec::None && !delta ) {
+		size_t size = chunk_writer.EncodedSize( record_type ) + chunk_writer.EncodedSize( strChannel ) +
+					  chunk_writer.EncodedSize( object_type ) + pBufferOrFrame->EncodedSize( caps.encoding ) +
+					  ( m_Checksum ? utils::EncodedChunkSize( caps.encoding, sizeof( uint32_t ) ) : 0 );
+		res = msg->Reserve( size ) == Error::Ok;
+	}
+
+	if( m_Checksum ) {
+		chunk_writer.EnableChecksum();
+	}
+	res &= chunk_writer.Write( record_type );
 	res &= chunk_writer.Write( strChannel );
-	res &= chunk_writer.Write( static_cast<byte>( pBufferOrFrame->GetObjectType() ) );
-	res &= pBufferOrFrame->Write( chunk_writer );
+	res &= chunk_writer.Write( object_type );
+	if( delta ) {
+		std::unique_lock lock( m_DeltaLock );
+		auto &encoder = m_DeltaEncoders[ strChannel ];
+		if( encoder == nullptr ) {
+			encoder.reset( new FrameDeltaEncoder( m_KeyframeInterval ) );
+		}
+		res &= encoder->Write( chunk_writer, *frame );
+	} else {
+		res &= pBufferOrFrame->Write( chunk_writer );
+	}
+	if( m_Checksum ) {
+		res &= chunk_writer.WriteChecksum();
+	}
 	chunk_writer.Flush();
-	msg->Send( !res, [&]( const Error &err ) {
-		std::unique_lock l( complete_lock );
-		complete = true;
-		result = err;
-		complete_check.notify_all();
-	} );
 
-	std::unique_lock lock( complete_lock );
-	auto status = complete_check.wait_for( lock, std::max( 100, _nMaxWaitMs ) * 1ms,
-										   [&]() { return complete.load(); } );
-	if( !status && _nMaxWaitMs != 0 ) {
-		// timeout
-		printf( "%p::MFPipeImpl - PipePut() - Timeout()\n", this );
+	Error result = SendAndWait( msg, !res, _nMaxWaitMs );
+
+	ChannelMetrics &metrics = GetChannelMetrics( strChannel );
+	( result == Error::Ok ? metrics.objects_put : metrics.put_failed ).fetch_add( 1, std::memory_order_relaxed );
+	if( result == Error::Expired ) {
+		metrics.dropped.fetch_add( 1, std::memory_order_relaxed );
+	}
+	if( result == Error::Ok && m_Capture != nullptr ) {
+		m_Capture->AppendObject( utils::capture::Direction::Sent, strChannel, *pBufferOrFrame, origin );
 	}
+	m_PutLatency.Record( std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - started )
+							 .count() );
 
-	msg->Close();
+	if( delta && result != Error::Ok ) {
+		// receivers may miss the frame, the next one is keyframe
+		std::unique_lock lock( m_DeltaLock );
+		m_DeltaEncoders[ strChannel ]->ForceKeyframe();
+	}
 
-	printf( "%p::MFPipeImpl - PipePut()=%i\n", this, static_cast<int>( result ) );
+	MFPIPE_LOG( Debug, "PipePut", { "pipe", this }, { "channel", strChannel }, { "result", result } );
 
 	return result;
 }
@@ -80,22 +243,191 @@ Error MFPipeImpl::PipeGet( /*[in]*/ const std::string &strChannel,
 	Error result = Error::Ok;
 	std::unique_lock lock( m_ReceivingLock );
 
+	int row_bytes = utils::Params::Parse( strHints ).GetInt( "row_bytes", m_RowBytes );
+
 	auto check_received = &MFPipeImpl::CheckReceived;
-	auto status = m_ReceivingVariable.wait_for( lock, std::max( 100, _nMaxWaitMs ) * 1ms, [&]() {
-		auto record = ( this->*check_received )( strChannel, ERecordType::Data );
+	auto status = m_ReceivingVariable.wait_for( lock, WaitDuration( _nMaxWaitMs ), [&]() {
+		auto record = ( this->*check_received )( strChannel, ERecordType::Data, row_bytes );
 		if( record != nullptr ) {
 			pBufferOrFrame = record->object;
 		}
 		return record != nullptr;
 	} );
 
-	if( !status && _nMaxWaitMs != 0 ) {
-		// timeout
+	if( !status ) {
+		// timeout or nothing is ready for _nMaxWaitMs = 0
+		pBufferOrFrame = nullptr;
 		result = Error::Timeout;
-		printf( "%p::MFPipeImpl - PipeGet() - Timeout()\n", this );
+	} else {
+		GetChannelMetrics( strChannel ).objects_got.fetch_add( 1, std::memory_order_relaxed );
 	}
 
-	printf( "%p::MFPipeImpl - PipeGet()=%i\n", this, static_cast<int>( result ) );
+	MFPIPE_LOG( Debug, "PipeGet", { "pipe", this }, { "channel", strChannel }, { "result", result } );
+	return result;
+}
+
+Error MFPipeImpl::PipePutBatch( /*[in]*/ const std::string &strChannel,
+								/*[in]*/ const std::vector<std::shared_ptr<MF_BASE_TYPE>> &arrObjects,
+								/*[in]*/ int _nMaxWaitMs, /*[in]*/ const std::string &strHints ) {
+	if( arrObjects.empty() ) {
+		return Error::Ok;
+	}
+
+	auto started = std::chrono::steady_clock::now();
+	int64_t origin = m_TraceInterval != 0 || m_Capture != nullptr ? utils::trace::Now() : 0;
+	PeerCaps caps;
+	SelectPeers( strChannel, caps );
+
+	// peers without batch records take objects one by one, frames of delta channel are written by its encoder
+	bool delta_channel = IsDeltaChannel( strChannel, strHints );
+	auto batch_supported = [&]( const PeerCaps &peer_caps ) {
+		return ( peer_caps.features & FeatureBatch ) != 0 &&
+			   ( ( peer_caps.features & FeatureDeltaFrames ) == 0 || !delta_channel );
+	};
+	if( !batch_supported( caps ) ) {
+		Error result = Error::Ok;
+		for( const auto &object : arrObjects ) {
+			Error err = PipePut( strChannel, object, _nMaxWaitMs, strHints );
+			result = result == Error::Ok ? err : result;
+		}
+		return result;
+	}
+
+	byte record_type = static_cast<byte>( ERecordType::Batch ) | ( m_Checksum ? RecordChecksumFlag : 0 );
+
+	// objects are split to records of batch_bytes, one object may exceed it
+	std::vector<IMsgCompose::Ptr> msgs;
+	std::vector<bool> failed;
+	std::vector<size_t> ends;
+	size_t pos = 0;
+	while( pos < arrObjects.size() ) {
+		// every record is written for its own destination peers, they may change during the batch
+		PeerCaps msg_caps;
+		auto msg = ComposeMsg( strChannel, strHints, msg_caps );
+		if( !batch_supported( msg_caps ) ) {
+			msg->Close();
+			break;
+		}
+		SetTrace( *msg, origin );
+		utils::ECodec codec = SelectCodec( strChannel, strHints, msg_caps.codecs );
+
+		utils::SinkChunkWriter<utils::MsgComposeSink> chunk_writer( utils::MsgComposeSink( *msg ), msg_caps.encoding );
+		size_t size = chunk_writer.EncodedSize( record_type ) + chunk_writer.EncodedSize( strChannel ) +
+					  chunk_writer.EncodedSize( uint32_t( 0 ) ) +
+					  ( m_Checksum ? utils::EncodedChunkSize( msg_caps.encoding, sizeof( uint32_t ) ) : 0 );
+		auto deadline = std::chrono::steady_clock::time_point::max();
+		size_t end = pos;
+		do {
+			const MF_BASE_TYPE &object = *arrObjects[ end ];
+			size_t object_size = chunk_writer.EncodedSize( static_cast<byte>( object.GetObjectType() ) ) +
+								 object.EncodedSize( msg_caps.encoding );
+			if( end != pos && size + object_size > m_BatchBytes ) {
+				break;
+			}
+			size += object_size;
+			deadline = std::min( deadline, GetDeadline( strChannel, strHints, object ) );
+			end++;
+		} while( end < arrObjects.size() );
+
+		if( deadline != std::chrono::steady_clock::time_point::max() ) {
+			msg->SetDeadline( deadline );
+		}
+		chunk_writer.EnableCompression( codec, m_CodecLevel );
+
+		// packets for whole record are taken at once, size of compressed records is not known
+		bool res = true;
+		if( codec == utils::ECodec::None ) {
+			res = msg->Reserve( size ) == Error::Ok;
+		}
+		if( m_Checksum ) {
+			chunk_writer.EnableChecksum();
+		}
+		res &= chunk_writer.Write( record_type );
+		res &= chunk_writer.Write( strChannel );
+		res &= chunk_writer.Write( static_cast<uint32_t>( end - pos ) );
+		for( ; pos < end; pos++ ) {
+			res &= chunk_writer.Write( static_cast<byte>( arrObjects[ pos ]->GetObjectType() ) );
+			res &= arrObjects[ pos ]->Write( chunk_writer );
+		}
+		if( m_Checksum ) {
+			res &= chunk_writer.WriteChecksum();
+		}
+		chunk_writer.Flush();
+
+		msgs.push_back( std::move( msg ) );
+		failed.push_back( !res );
+		ends.push_back( end );
+	}
+
+	std::vector<Error> results;
+	Error result = msgs.empty() ? Error::Ok : SendAndWait( msgs, failed, _nMaxWaitMs, results );
+
+	// peers which lost batch support take the rest one by one
+	for( size_t rest = pos; rest < arrObjects.size(); rest++ ) {
+		Error err = PipePut( strChannel, arrObjects[ rest ], _nMaxWaitMs, strHints );
+		result = result == Error::Ok ? err : result;
+	}
+
+	ChannelMetrics &metrics = GetChannelMetrics( strChannel );
+	pos = 0;
+	for( size_t i = 0; i < msgs.size(); i++ ) {
+		uint64_t count = ends[ i ] - pos;
+		( results[ i ] == Error::Ok ? metrics.objects_put : metrics.put_failed )
+			.fetch_add( count, std::memory_order_relaxed );
+		if( results[ i ] == Error::Expired ) {
+			metrics.dropped.fetch_add( count, std::memory_order_relaxed );
+		}
+		for( ; pos < ends[ i ]; pos++ ) {
+			if( results[ i ] == Error::Ok && m_Capture != nullptr ) {
+				m_Capture->AppendObject( utils::capture::Direction::Sent, strChannel, *arrObjects[ pos ], origin );
+			}
+		}
+	}
+	m_PutLatency.Record( std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now() - started )
+							 .count() );
+
+	MFPIPE_LOG( Debug, "PipePutBatch", { "pipe", this }, { "channel", strChannel }, { "objects", arrObjects.size() },
+				{ "records", msgs.size() }, { "result", result } );
+
+	return result;
+}
+
+Error MFPipeImpl::PipeGetBatch( /*[in]*/ const std::string &strChannel,
+								/*[out]*/ std::vector<std::shared_ptr<MF_BASE_TYPE>> &arrObjects,
+								/*[in]*/ size_t _nMaxCount, /*[in]*/ int _nMaxWaitMs,
+								/*[in]*/ const std::string &strHints ) {
+	arrObjects.clear();
+	if( _nMaxCount == 0 ) {
+		return Error::Ok;
+	}
+
+	Error result = Error::Ok;
+	int row_bytes = utils::Params::Parse( strHints ).GetInt( "row_bytes", m_RowBytes );
+
+	std::unique_lock lock( m_ReceivingLock );
+
+	auto check_received = &MFPipeImpl::CheckReceived;
+	auto status = m_ReceivingVariable.wait_for( lock, WaitDuration( _nMaxWaitMs ), [&]() {
+		// all ready objects are taken at once
+		while( arrObjects.size() < _nMaxCount ) {
+			auto record = ( this->*check_received )( strChannel, ERecordType::Data, row_bytes );
+			if( record == nullptr ) {
+				break;
+			}
+			arrObjects.push_back( record->object );
+		}
+		return !arrObjects.empty();
+	} );
+
+	if( !status ) {
+		// timeout or nothing is ready for _nMaxWaitMs = 0
+		result = Error::Timeout;
+	} else {
+		GetChannelMetrics( strChannel ).objects_got.fetch_add( arrObjects.size(), std::memory_order_relaxed );
+	}
+
+	MFPIPE_LOG( Debug, "PipeGetBatch", { "pipe", this }, { "channel", strChannel }, { "objects", arrObjects.size() },
+				{ "result", result } );
 	return result;
 }
 
@@ -105,40 +437,35 @@ Error MFPipeImpl::PipeMessagePut(
 	/*[in]*/ const std::string &strEventParam,
 	/*[in]*/ int _nMaxWaitMs ) {
 
-	std::atomic<bool> complete{ false };
-	std::mutex complete_lock;
-	std::condition_variable complete_check;
-	Error result = Error::Timeout;
-
-	auto msg = m_Transport->ComposeMsg();
+	int64_t origin = m_TraceInterval != 0 || m_Capture != nullptr ? utils::trace::Now() : 0;
+	PeerCaps caps;
+	auto msg = ComposeMsg( strChannel, std::string(), caps );
+	SetTrace( *msg, origin );
 
-	auto allocator = [=]( size_t size ) -> comm::NetBufferRef * { return msg->AllocBuffer(); };
-	auto writer = [=]( comm::NetBufferRef *buf, size_t len ) { msg->Write( buf, len ); };
-	utils::ChunkWriter chunk_writer( allocator, writer );
+	utils::SinkChunkWriter<utils::MsgComposeSink> chunk_writer( utils::MsgComposeSink( *msg ), caps.encoding );
 
-	bool res = chunk_writer.Write( static_cast<byte>( ERecordType::Message ) );
+	byte record_type = static_cast<byte>( ERecordType::Message ) | ( m_Checksum ? RecordChecksumFlag : 0 );
+	if( m_Checksum ) {
+		chunk_writer.EnableChecksum();
+	}
+	bool res = chunk_writer.Write( record_type );
 	res &= chunk_writer.Write( strChannel );
 	res &= chunk_writer.Write( strEventName );
 	res &= chunk_writer.Write( strEventParam );
+	if( m_Checksum ) {
+		res &= chunk_writer.WriteChecksum();
+	}
 	chunk_writer.Flush();
-	msg->Send( !res, [&]( const Error &err ) {
-		std::unique_lock l( complete_lock );
-		complete = true;
-		result = err;
-		complete_check.notify_all();
-	} );
 
-	std::unique_lock lock( complete_lock );
-	auto status = complete_check.wait_for( lock, std::max( 100, _nMaxWaitMs ) * 1ms,
-										   [&]() { return complete.load(); } );
-	if( !status && _nMaxWaitMs != 0 ) {
-		// timeout
-		printf( "%p::MFPipeImpl - PipeMessagePut() - Timeout()\n", this );
-	}
+	Error result = SendAndWait( msg, !res, _nMaxWaitMs );
 
-	msg->Close();
+	ChannelMetrics &metrics = GetChannelMetrics( strChannel );
+	( result == Error::Ok ? metrics.messages_put : metrics.put_failed ).fetch_add( 1, std::memory_order_relaxed );
+	if( result == Error::Ok && m_Capture != nullptr ) {
+		m_Capture->AppendMessage( utils::capture::Direction::Sent, strChannel, strEventName, strEventParam, origin );
+	}
 
-	printf( "%p::MFPipeImpl - PipeMessagePut()=%i\n", this, static_cast<int>( result ) );
+	MFPIPE_LOG( Debug, "PipeMessagePut", { "pipe", this }, { "channel", strChannel }, { "result", result } );
 
 	return result;
 }
@@ -153,8 +480,8 @@ Error MFPipeImpl::PipeMessageGet(
 	std::unique_lock lock( m_ReceivingLock );
 
 	auto check_received = &MFPipeImpl::CheckReceived;
-	auto status = m_ReceivingVariable.wait_for( lock, std::max( 100, _nMaxWaitMs ) * 1ms, [&]() {
-		auto record = ( this->*check_received )( strChannel, ERecordType::Message );
+	auto status = m_ReceivingVariable.wait_for( lock, WaitDuration( _nMaxWaitMs ), [&]() {
+		auto record = ( this->*check_received )( strChannel, ERecordType::Message, -1 );
 		if( record != nullptr ) {
 			if( pStrEventName != nullptr ) {
 				*pStrEventName = record->msg_name;
@@ -166,86 +493,1061 @@ Error MFPipeImpl::PipeMessageGet(
 		return record != nullptr;
 	} );
 
-	if( !status && _nMaxWaitMs != 0 ) {
-		// timeout
+	if( !status ) {
+		// timeout or nothing is ready for _nMaxWaitMs = 0
+		if( pStrEventName != nullptr ) {
+			pStrEventName->clear();
+		}
+		if( pStrEventParam != nullptr ) {
+			pStrEventParam->clear();
+		}
 		result = Error::Timeout;
-		printf( "%p::MFPipeImpl - PipeMessageGet() - Timeout()\n", this );
+	} else {
+		GetChannelMetrics( strChannel ).messages_got.fetch_add( 1, std::memory_order_relaxed );
 	}
 
-	printf( "%p::MFPipeImpl - PipeMessageGet()=%i\n", this, static_cast<int>( result ) );
+	MFPIPE_LOG( Debug, "PipeMessageGet", { "pipe", this }, { "channel", strChannel }, { "result", result } );
 	return result;
 }
 
+Error MFPipeImpl::PipeInfoGet( /*[out]*/ std::string *pStrPipeName, /*[in]*/ const std::string &strChannel,
+							   MF_PIPE_INFO *_pPipeInfo ) {
+	if( m_Transport == nullptr ) {
+		return Error::Fatal;
+	}
+	if( pStrPipeName != nullptr ) {
+		*pStrPipeName = m_PipeID;
+	}
+	if( _pPipeInfo == nullptr ) {
+		return Error::Ok;
+	}
+
+	MF_PIPE_INFO info = {};
+	info.nPipeMode = static_cast<int>( m_Listening ? ITransport::EOpen::Listen : ITransport::EOpen::Connect );
+	if( m_Listening ) {
+		info.nPipesConnected = static_cast<int>( m_Transport->GetSessions().size() );
+	} else {
+		// the listening side is connected when it answered by Hello
+		std::unique_lock lock( m_PeersLock );
+		info.nPipesConnected = static_cast<int>( m_Peers.size() );
+	}
+	info.nObjectsMax = m_MaxBuffers;
+	info.nMessagesMax = m_MaxBuffers;
+
+	std::set<std::string> channels;
+	{
+		std::unique_lock lock( m_ReceivingLock );
+		for( auto rec = m_ReceivedRecords.begin(); rec != m_ReceivedRecords.end(); ) {
+			if( ( *rec )->type == ERecordType::Unparsed && !ParseRecord( **rec, false, m_RowBytes ) ) {
+				rec = m_ReceivedRecords.erase( rec );
+				continue;
+			}
+			const Record &record = **rec;
+			channels.insert( record.channel );
+			if( strChannel.empty() || record.channel == strChannel ) {
+				if( record.type == ERecordType::Data ) {
+					// objects of batch record are taken one by one
+					info.nObjectsHave += static_cast<int>( record.count - record.next );
+				} else {
+					info.nMessagesHave++;
+				}
+			}
+			++rec;
+		}
+		m_ReceivedWaiting = m_ReceivedRecords.size();
+		for( const auto &el : m_Spills ) {
+			channels.insert( el.first );
+			if( strChannel.empty() || el.first == strChannel ) {
+				info.nObjectsHave += static_cast<int>( el.second.objects );
+				info.nMessagesHave += static_cast<int>( el.second.messages );
+			}
+		}
+	}
+	{
+		std::unique_lock lock( m_ChannelsLock );
+		for( const auto &el : m_ChannelMetrics ) {
+			channels.insert( el.first );
+			if( strChannel.empty() || el.first == strChannel ) {
+				info.nObjectsDropped += static_cast<int>( el.second->dropped.load( std::memory_order_relaxed ) );
+			}
+		}
+	}
+	{
+		std::unique_lock lock( m_SubscriptionsLock );
+		for( const auto &el : m_Subscriptions ) {
+			channels.insert( el.first );
+		}
+	}
+	info.nChannels = static_cast<int>( channels.size() );
+
+	if( strChannel.empty() ) {
+		TransportStats stats = m_Transport->GetStats();
+		info.nObjectsDropped += static_cast<int>( stats.received_expired + stats.received_timeout );
+	}
+
+	*_pPipeInfo = info;
+	return Error::Ok;
+}
+
 Error MFPipeImpl::PipeFlush( /*[in]*/ const std::string &strChannel, /*[in]*/ eMFFlashFlags _eFlashFlags ) {
 	return Error::Ok;
 }
 
 Error MFPipeImpl::PipeClose() {
+	StopMetrics();
 	m_Transport->Close();
 	m_Transport = nullptr;
+	StopCallbacks();
+	{
+		// spill files are removed
+		std::unique_lock lock( m_ReceivingLock );
+		m_Spills.clear();
+	}
+	if( m_Capture != nullptr ) {
+		m_Capture->Close();
+	}
+	if( !m_TraceFile.empty() && !utils::trace::WriteChromeTrace( m_TraceFile ) ) {
+		MFPIPE_LOG( Warning, "unable write trace file", { "pipe", this }, { "path", m_TraceFile } );
+	}
 	return Error::Ok;
 }
 
-void MFPipeImpl::OnNewMessage( const IMsgReceived::Ptr &msg ) {
+Error MFPipeImpl::PipeSubscribe( /*[in]*/ const std::string &strChannel, /*[in]*/ int _nMaxWaitMs ) {
+	auto msg = m_Transport->ComposeMsg( strChannel );
+
+	utils::SinkChunkWriter<utils::MsgComposeSink> chunk_writer{ utils::MsgComposeSink( *msg ) };
+
+	bool res = chunk_writer.Write( static_cast<byte>( ERecordType::Subscribe ) );
+	res &= chunk_writer.Write( strChannel );
+	chunk_writer.Flush();
+
+	Error result = SendAndWait( msg, !res, _nMaxWaitMs );
+
+	MFPIPE_LOG( Info, "PipeSubscribe", { "pipe", this }, { "result", result } );
+
+	return result;
+}
+
+Error MFPipeImpl::PipeChannelSet( /*[in]*/ const std::string &strChannel, /*[in]*/ const std::string &strHints ) {
+	utils::Params params = utils::Params::Parse( strHints );
+	std::unique_lock lock( m_ChannelsLock );
+	for( const auto &el : params.Values ) {
+		SetChannelParam( strChannel, el.first, el.second );
+	}
+	return Error::Ok;
+}
+
+Error MFPipeImpl::PipeCallbackSet( /*[in]*/ const std::string &strChannel, /*[in]*/ FnOnObject fnOnObject,
+								   /*[in]*/ FnOnMessage fnOnMessage ) {
+	utils::IExecutor::Ptr executor;
+	{
+		std::unique_lock lock( m_ReceivingLock );
+		ChannelCallbacks &callbacks = m_Callbacks[ strChannel ];
+		callbacks.onobject = std::move( fnOnObject );
+		callbacks.onmessage = std::move( fnOnMessage );
+		if( callbacks.onobject != nullptr || callbacks.onmessage != nullptr ) {
+			m_CallbacksEnabled = true;
+			// objects/messages received before are delivered too
+			executor = ScheduleCallbacks( strChannel );
+		}
+	}
+	if( executor != nullptr ) {
+		PostCallbacks( executor, strChannel );
+	}
+	MFPIPE_LOG( Info, "PipeCallbackSet", { "pipe", this }, { "channel", strChannel } );
+	return Error::Ok;
+}
+
+Error MFPipeImpl::PipeExecutorSet( /*[in]*/ utils::IExecutor::Ptr pExecutor ) {
 	std::unique_lock lock( m_ReceivingLock );
-	m_ReceivedRecords.emplace_back( new Record{ msg } );
-	m_ReceivingVariable.notify_all();
+	m_Executor = std::move( pExecutor );
+	return Error::Ok;
 }
 
-MFPipeImpl::Record::Ptr MFPipeImpl::CheckReceived( const std::string channel, ERecordType type ) {
-	for( auto rec = m_ReceivedRecords.begin(); rec != m_ReceivedRecords.end(); ++rec ) {
-		if( (*rec)->type == ERecordType::Unparsed ) {
-			ConstNetBufferSeq seq = ( *rec )->msg->GetBuffers();
-			utils::ChunkReader chunk_reader( seq );
-
-			byte msg_type;
-			bool res = chunk_reader.Read( msg_type );
-			res &= chunk_reader.Read( ( *rec )->channel );
-			res &= ByteToRecordType( msg_type, ( *rec )->type );
-			if( res ) {
-				switch( ( *rec )->type ) {
-				case ERecordType::Data: {
-					byte obj_type;
-					res = chunk_reader.Read( obj_type );
-					if( res ) {
-						(*rec)->object = MF_BASE_TYPE::CreateByObjectType( static_cast<ObjectType>( obj_type ) );
-						if( ( *rec )->object != nullptr ) {
-							res = ( *rec )->object->Load( chunk_reader );
-						} else {
-							res = false;
-						}
-					}
-				} break;
-				case ERecordType::Message: {
-					res = chunk_reader.Read( ( *rec )->msg_name );
-					res &= chunk_reader.Read( ( *rec )->msg_value );
-				} break;
-				default:
-					res = false;
+Error MFPipeImpl::PipeReadyGet( /*[out]*/ intptr_t *pHandle ) {
+	if( pHandle == nullptr ) {
+		return Error::InvalidSettings;
+	}
+	std::unique_lock lock( m_ReceivingLock );
+	if( m_ReadyEvent == nullptr ) {
+		m_ReadyEvent = utils::ReadyEvent::Create();
+		if( m_ReadyEvent == nullptr ) {
+			MFPIPE_LOG( Warning, "unable create readiness descriptor", { "pipe", this } );
+			return Error::Fatal;
+		}
+		// records received before are ready, spill entries stay for channels with empty queue
+		bool spilled = std::any_of( m_Spills.begin(), m_Spills.end(), []( const auto &el ) {
+			return el.second.objects != 0 || el.second.messages != 0;
+		} );
+		if( !m_ReceivedRecords.empty() || spilled ) {
+			m_ReadyEvent->Signal();
+		}
+	}
+	*pHandle = m_ReadyEvent->GetHandle();
+	return Error::Ok;
+}
+
+Error MFPipeImpl::PipeReadyClear( /*[out]*/ std::vector<std::string> *pChannels ) {
+	std::unique_lock lock( m_ReceivingLock );
+	if( m_ReadyEvent != nullptr ) {
+		m_ReadyEvent->Clear();
+	}
+	if( pChannels == nullptr ) {
+		return Error::Ok;
+	}
+
+	std::set<std::string> channels;
+	for( auto rec = m_ReceivedRecords.begin(); rec != m_ReceivedRecords.end(); ) {
+		if( ( *rec )->type == ERecordType::Unparsed && !ParseRecord( **rec, false, m_RowBytes ) ) {
+			rec = m_ReceivedRecords.erase( rec );
+			continue;
+		}
+		if( !HasCallback( ( *rec )->channel, ( *rec )->type ) ) {
+			channels.insert( ( *rec )->channel );
+		}
+		++rec;
+	}
+	m_ReceivedWaiting = m_ReceivedRecords.size();
+	for( const auto &el : m_Spills ) {
+		if( ( el.second.objects != 0 && !HasCallback( el.first, ERecordType::Data ) ) ||
+			( el.second.messages != 0 && !HasCallback( el.first, ERecordType::Message ) ) ) {
+			channels.insert( el.first );
+		}
+	}
+	pChannels->assign( channels.begin(), channels.end() );
+	return Error::Ok;
+}
+
+IMsgCompose::Ptr MFPipeImpl::ComposeMsg( const std::string &channel, const std::string &strHints,
+										 PeerCaps &caps ) {
+	std::vector<SessionID> sessions = SelectPeers( channel, caps );
+
+	// nobody subscribed to the channel, send to all
+	auto msg = sessions.empty() ? m_Transport->ComposeMsg( channel ) : m_Transport->ComposeMsg( sessions, channel );
+	msg->SetClass( GetMsgClass( channel, strHints ) );
+	return msg;
+}
+
+std::vector<SessionID> MFPipeImpl::SelectPeers( const std::string &channel, PeerCaps &caps ) {
+	std::vector<SessionID> sessions;
+	{
+		std::unique_lock lock( m_SubscriptionsLock );
+		auto found = m_Subscriptions.find( channel );
+		if( found != m_Subscriptions.end() ) {
+			sessions.assign( found->second.begin(), found->second.end() );
+		}
+	}
+
+	// the message is serialized once, so all destination peers should support the encoding
+	std::vector<SessionID> peers = sessions;
+	if( peers.empty() && m_Listening ) {
+		peers = m_Transport->GetSessions();
+	}
+	{
+		std::unique_lock lock( m_PeersLock );
+		if( peers.empty() && !m_Listening ) {
+			// connecting side has the only peer
+			for( const auto &el : m_Peers ) {
+				peers.push_back( el.first );
+			}
+		}
+
+		caps.encoding = peers.empty() ? utils::EEncoding::Fixed : m_Encoding;
+		caps.codecs = peers.empty() ? 0 : utils::compression::SupportedCodecs();
+		caps.features = peers.empty() ? 0 : Features;
+		for( SessionID id : peers ) {
+			auto found = m_Peers.find( id );
+			if( found == m_Peers.end() ) {
+				caps = PeerCaps();
+				break;
+			}
+			if( found->second.encoding != utils::EEncoding::Compact ) {
+				caps.encoding = utils::EEncoding::Fixed;
+			}
+			caps.codecs &= found->second.codecs;
+			caps.features &= found->second.features;
+		}
+	}
+	return sessions;
+}
+
+MsgClass MFPipeImpl::GetMsgClass( const std::string &channel, const std::string &strHints ) const {
+	MsgClass cls;
+	{
+		std::unique_lock lock( m_ChannelsLock );
+		auto found = m_ChannelClasses.find( channel );
+		if( found != m_ChannelClasses.end() ) {
+			cls = found->second;
+		}
+	}
+	cls.name = channel;
+	utils::Params params = utils::Params::Parse( strHints );
+	cls.priority = params.GetInt( "priority", cls.priority );
+	cls.weight = static_cast<uint32_t>( std::max( 1, params.GetInt( "weight", static_cast<int>( cls.weight ) ) ) );
+	return cls;
+}
+
+std::chrono::steady_clock::time_point MFPipeImpl::GetDeadline( const std::string &channel,
+																const std::string &strHints,
+																const MF_BASE_TYPE &object ) const {
+	int deadline = m_Deadline;
+	{
+		std::unique_lock lock( m_ChannelsLock );
+		auto found = m_ChannelDeadlines.find( channel );
+		if( found != m_ChannelDeadlines.end() ) {
+			deadline = found->second;
+		}
+	}
+	utils::Params params = utils::Params::Parse( strHints );
+	if( params.Has( "deadline" ) ) {
+		deadline = ParseDeadline( params.Get( "deadline" ) );
+	}
+
+	auto ms = std::chrono::milliseconds( deadline );
+	if( deadline == DeadlineFrame ) {
+		// REFERENCE_TIME is in 100 ns units
+		auto frame = dynamic_cast<const MF_FRAME *>( &object );
+		REFERENCE_TIME duration = frame != nullptr ? frame->time.rtEndTime - frame->time.rtStartTime : 0;
+		ms = std::chrono::milliseconds( ( duration + 9999 ) / 10000 );
+	}
+	if( ms.count() <= 0 ) {
+		return std::chrono::steady_clock::time_point::max();
+	}
+	return std::chrono::steady_clock::now() + ms;
+}
+
+int MFPipeImpl::ParseDeadline( const std::string &value ) {
+	return value == "frame" ? DeadlineFrame : std::max( 0, std::atoi( value.c_str() ) );
+}
+
+MFPipeImpl::ChannelMetrics &MFPipeImpl::GetChannelMetrics( const std::string &channel ) {
+	std::unique_lock lock( m_ChannelsLock );
+	auto &metrics = m_ChannelMetrics[ channel ];
+	if( metrics == nullptr ) {
+		metrics.reset( new ChannelMetrics() );
+		metrics->name = channel;
+		// the only writer is under m_ChannelsLock, collector reads the list from the head
+		metrics->next = m_ChannelsList.load( std::memory_order_relaxed );
+		m_ChannelsList.store( metrics.get(), std::memory_order_release );
+	}
+	return *metrics;
+}
+
+Error MFPipeImpl::StartMetrics( const std::string &strPipeID, const std::string &strHints ) {
+	utils::Params params = utils::Params::Parse( utils::Uri::Parse( strPipeID ).QueryString );
+	params.Merge( utils::Params::Parse( strHints ) );
+	int port = params.GetInt( "metrics_port", 0 );
+	std::string file = params.Get( "metrics_file" );
+	if( port == 0 && file.empty() ) {
+		return Error::Ok;
+	}
+	if( port < 0 || port > 65535 ) {
+		return Error::InvalidSettings;
+	}
+
+	m_MetricsSource = utils::metrics::Register( [this]( utils::metrics::Writer &writer ) { CollectMetrics( writer ); } );
+	m_MetricsExporter.reset( new utils::metrics::Exporter() );
+	Error err = port != 0 ? m_MetricsExporter->StartHttp( static_cast<uint16_t>( port ) )
+						  : m_MetricsExporter->StartFile( file, params.GetInt( "metrics_interval", 1000 ) );
+	if( err != Error::Ok ) {
+		StopMetrics();
+	}
+	return err;
+}
+
+void MFPipeImpl::StopMetrics() {
+	if( m_MetricsExporter != nullptr ) {
+		m_MetricsExporter->Stop();
+		m_MetricsExporter = nullptr;
+	}
+	if( m_MetricsSource != 0 ) {
+		utils::metrics::Unregister( m_MetricsSource );
+		m_MetricsSource = 0;
+	}
+}
+
+void MFPipeImpl::CollectMetrics( utils::metrics::Writer &writer ) {
+	auto load = []( const std::atomic<uint64_t> &counter ) { return counter.load( std::memory_order_relaxed ); };
+	utils::metrics::Labels labels = { { "pipe", m_PipeID },
+									  { "role", m_Listening ? "listen" : "connect" },
+									  { "id", std::to_string( m_MetricsSource ) } };
+
+	writer.Gauge( "mfpipe_pipe_received_waiting", "Received objects and messages waiting for PipeGet", labels,
+				  static_cast<double>( m_ReceivedWaiting.load( std::memory_order_relaxed ) ) );
+	writer.Histogram( "mfpipe_pipe_put_seconds", "Duration of PipePut", labels, m_PutLatency );
+
+	for( const ChannelMetrics *ch = m_ChannelsList.load( std::memory_order_acquire ); ch != nullptr; ch = ch->next ) {
+		utils::metrics::Labels ch_labels = labels;
+		ch_labels.emplace_back( "channel", ch->name );
+		writer.Counter( "mfpipe_channel_objects_put", "Objects sent by PipePut", ch_labels, load( ch->objects_put ) );
+		writer.Counter( "mfpipe_channel_messages_put", "Messages sent by PipeMessagePut", ch_labels,
+						load( ch->messages_put ) );
+		writer.Counter( "mfpipe_channel_put_failed", "Failed PipePut and PipeMessagePut", ch_labels,
+						load( ch->put_failed ) );
+		writer.Counter( "mfpipe_channel_objects_dropped", "Objects dropped by deadline", ch_labels,
+						load( ch->dropped ) );
+		writer.Counter( "mfpipe_channel_objects_got", "Objects taken by PipeGet", ch_labels, load( ch->objects_got ) );
+		writer.Counter( "mfpipe_channel_messages_got", "Messages taken by PipeMessageGet", ch_labels,
+						load( ch->messages_got ) );
+		writer.Counter( "mfpipe_channel_spilled", "Received objects and messages written to spill queue", ch_labels,
+						load( ch->spilled ) );
+	}
+
+	TransportStats stats = m_Transport->GetStats();
+	writer.Counter( "mfpipe_transport_packets_sent", "Sent packets", labels, stats.packets_sent );
+	writer.Counter( "mfpipe_transport_sent_bytes", "Sent bytes", labels, stats.bytes_sent );
+	writer.Counter( "mfpipe_transport_packets_retransmitted", "Packets sent again on request of receiving side",
+					labels, stats.packets_retransmitted );
+	writer.Counter( "mfpipe_transport_packets_received", "Received packets", labels, stats.packets_received );
+	writer.Counter( "mfpipe_transport_received_bytes", "Received bytes", labels, stats.bytes_received );
+	writer.Counter( "mfpipe_transport_packets_dropped", "Received packets dropped before reassembly", labels,
+					stats.packets_dropped );
+	writer.Counter( "mfpipe_transport_packets_recovered", "Lost packets recovered by FEC", labels,
+					stats.packets_recovered );
+	writer.Counter( "mfpipe_transport_messages_received", "Reassembled messages", labels, stats.messages_received );
+	writer.Counter( "mfpipe_transport_sent_expired", "Messages not sent completely because of deadline", labels,
+					stats.sent_expired );
+	writer.Counter( "mfpipe_transport_received_expired", "Incomplete messages dropped because of deadline", labels,
+					stats.received_expired );
+	writer.Counter( "mfpipe_transport_reassembly_timeouts", "Incomplete messages dropped by reassembly timeout",
+					labels, stats.received_timeout );
+	writer.Gauge( "mfpipe_transport_queued_packets", "Packets waiting in sending queues", labels,
+				  static_cast<double>( stats.queued_packets ) );
+	writer.Gauge( "mfpipe_transport_reassembling_messages", "Incomplete messages waiting for packets", labels,
+				  static_cast<double>( stats.reassembling_messages ) );
+	writer.Gauge( "mfpipe_transport_buffers", "Network buffers created by transport", labels,
+				  static_cast<double>( stats.buffers_total ) );
+	writer.Gauge( "mfpipe_transport_buffers_free", "Free network buffers", labels,
+				  static_cast<double>( stats.buffers_free ) );
+}
+
+void MFPipeImpl::SetTrace( IMsgCompose &msg, int64_t origin ) {
+	if( m_TraceInterval != 0 && m_TraceCounter++ % m_TraceInterval == 0 ) {
+		msg.SetTrace( origin );
+	}
+}
+
+void MFPipeImpl::TraceDelivered( const Record &record ) {
+	const MsgTrace *trace = record.msg->GetTrace();
+	if( trace == nullptr ) {
+		return;
+	}
+	using utils::trace::Stage;
+	int64_t now = utils::trace::Now();
+	MessageID msg_id = record.msg->GetMessageID();
+	utils::trace::Record( Stage::Transfer, trace->queued, trace->received, msg_id, record.channel );
+	utils::trace::Record( Stage::Reassemble, trace->received, trace->completed, msg_id, record.channel );
+	utils::trace::Record( Stage::Wait, trace->completed, now, msg_id, record.channel );
+	utils::trace::Record( Stage::Total, trace->origin, now, msg_id, record.channel );
+}
+
+Error MFPipeImpl::StartCapture( const std::string &strPipeID, const std::string &strHints ) {
+	utils::Params params = utils::Params::Parse( utils::Uri::Parse( strPipeID ).QueryString );
+	params.Merge( utils::Params::Parse( strHints ) );
+	std::string path = params.Get( "capture" );
+	if( path.empty() ) {
+		return Error::Ok;
+	}
+	int segment_mb = params.GetInt( "capture_segment", 64 );
+	if( segment_mb <= 0 ) {
+		return Error::InvalidSettings;
+	}
+	m_Capture = utils::capture::Writer::Create( path, static_cast<size_t>( segment_mb ) * 1024 * 1024 );
+	if( m_Capture == nullptr ) {
+		MFPIPE_LOG( Warning, "unable create capture file", { "pipe", this }, { "path", path } );
+		return Error::InvalidSettings;
+	}
+	return Error::Ok;
+}
+
+void MFPipeImpl::CaptureDelivered( const Record &record ) {
+	if( m_Capture == nullptr ) {
+		return;
+	}
+	if( record.type == ERecordType::Data ) {
+		m_Capture->AppendObject( utils::capture::Direction::Received, record.channel, *record.object, record.arrived );
+	} else {
+		m_Capture->AppendMessage( utils::capture::Direction::Received, record.channel, record.msg_name,
+								  record.msg_value, record.arrived );
+	}
+}
+
+size_t MFPipeImpl::GetSpillLimit( const std::string &channel ) const {
+	std::unique_lock lock( m_ChannelsLock );
+	auto it = m_ChannelSpillLimits.find( channel );
+	return it != m_ChannelSpillLimits.end() ? it->second : m_SpillLimit;
+}
+
+bool MFPipeImpl::SpillRecord( const Record &record, size_t limit ) {
+	ChannelSpill &spill = m_Spills[ record.channel ];
+	utils::SpillQueue::Ptr &queue = spill.Queue( record.type );
+	// records go to the queue of their type while it is not empty, so they are read back in order
+	if( spill.in_memory < limit && ( queue == nullptr || queue->Empty() ) ) {
+		spill.in_memory++;
+		return false;
+	}
+	if( queue == nullptr ) {
+		static std::atomic<uint32_t> counter{ 0 };
+		std::string prefix = ( std::filesystem::path( m_SpillDir ) /
+							   ( "mfpipe-" + std::to_string( utils::trace::Now() ) + "-" + std::to_string( counter++ ) ) )
+								 .string();
+		queue = utils::SpillQueue::Create( prefix, m_SpillSegment, m_SpillDirect );
+	}
+	utils::SpillMeta meta{ record.msg->GetSessionID(), record.msg->GetMessageID(), static_cast<uint32_t>( record.type ),
+						   record.arrived };
+	if( queue == nullptr || !queue->Push( record.msg->GetBuffers(), meta ) ) {
+		MFPIPE_LOG( Warning, "record is not spilled", { "pipe", this }, { "channel", record.channel } );
+		spill.in_memory++;
+		return false;
+	}
+	( record.type == ERecordType::Data ? spill.objects : spill.messages ) += record.count;
+	GetChannelMetrics( record.channel ).spilled.fetch_add( 1, std::memory_order_relaxed );
+	return true;
+}
+
+void MFPipeImpl::OnRecordTaken( const std::string &channel ) {
+	auto it = m_Spills.find( channel );
+	if( it != m_Spills.end() && it->second.in_memory != 0 ) {
+		it->second.in_memory--;
+	}
+}
+
+bool MFPipeImpl::HasCallback( const std::string &channel, ERecordType type ) const {
+	auto it = m_Callbacks.find( channel );
+	if( it == m_Callbacks.end() ) {
+		return false;
+	}
+	return type == ERecordType::Data ? it->second.onobject != nullptr : it->second.onmessage != nullptr;
+}
+
+utils::IExecutor::Ptr MFPipeImpl::ScheduleCallbacks( const std::string &channel ) {
+	ChannelCallbacks &callbacks = m_Callbacks[ channel ];
+	if( callbacks.scheduled ) {
+		return nullptr;
+	}
+	if( m_Executor == nullptr ) {
+		m_Executor = m_ExecutorInline ? utils::IExecutor::Ptr( std::make_shared<utils::InlineExecutor>() )
+									  : std::make_shared<utils::ThreadPoolExecutor>( m_ExecutorThreads );
+	}
+	callbacks.scheduled = true;
+	m_CallbackTasks++;
+	return m_Executor;
+}
+
+void MFPipeImpl::PostCallbacks( const utils::IExecutor::Ptr &executor, const std::string &channel ) {
+	executor->Post( [this, channel]() { RunCallbacks( channel ); } );
+}
+
+void MFPipeImpl::RunCallbacks( const std::string &channel ) {
+	std::unique_lock lock( m_ReceivingLock );
+	for( ;; ) {
+		// callbacks may be changed while they are called
+		ChannelCallbacks &callbacks = m_Callbacks[ channel ];
+		FnOnObject onobject = callbacks.onobject;
+		FnOnMessage onmessage = callbacks.onmessage;
+
+		// ready records are taken at once, the next ones are taken by the next pass
+		std::vector<Record::Ptr> objects;
+		std::vector<Record::Ptr> messages;
+		Record::Ptr record;
+		while( onobject != nullptr && ( record = CheckReceived( channel, ERecordType::Data, m_RowBytes ) ) != nullptr ) {
+			objects.push_back( std::move( record ) );
+		}
+		while( onmessage != nullptr && ( record = CheckReceived( channel, ERecordType::Message, -1 ) ) != nullptr ) {
+			messages.push_back( std::move( record ) );
+		}
+		if( objects.empty() && messages.empty() ) {
+			callbacks.scheduled = false;
+			break;
+		}
+
+		lock.unlock();
+		ChannelMetrics &metrics = GetChannelMetrics( channel );
+		for( const auto &el : objects ) {
+			onobject( channel, el->object );
+		}
+		metrics.objects_got.fetch_add( objects.size(), std::memory_order_relaxed );
+		for( const auto &el : messages ) {
+			onmessage( channel, el->msg_name, el->msg_value );
+		}
+		metrics.messages_got.fetch_add( messages.size(), std::memory_order_relaxed );
+		lock.lock();
+	}
+	m_CallbackTasks--;
+	m_CallbackTasksVariable.notify_all();
+}
+
+void MFPipeImpl::StopCallbacks() {
+	utils::IExecutor::Ptr executor;
+	{
+		std::unique_lock lock( m_ReceivingLock );
+		for( auto &el : m_Callbacks ) {
+			el.second.onobject = nullptr;
+			el.second.onmessage = nullptr;
+		}
+		m_CallbackTasksVariable.wait( lock, [this]() { return m_CallbackTasks == 0; } );
+		executor = std::move( m_Executor );
+	}
+	// threads of default executor are joined without the lock
+	executor = nullptr;
+}
+
+bool MFPipeImpl::TakeSpilled( const std::string &channel, ERecordType type ) {
+	auto it = m_Spills.find( channel );
+	if( it == m_Spills.end() || it->second.Queue( type ) == nullptr ) {
+		return false;
+	}
+	ChannelSpill &spill = it->second;
+	size_t &waiting = type == ERecordType::Data ? spill.objects : spill.messages;
+	std::vector<byte> data;
+	utils::SpillMeta meta;
+	while( spill.Queue( type )->Pop( data, meta ) ) {
+		Record::Ptr record( new Record{ std::make_shared<SpilledMsg>( std::move( data ), meta.msg_id, meta.session ) } );
+		record->arrived = meta.time;
+		bool res = ParseRecord( *record, false, m_RowBytes ) && record->type == type;
+		waiting -= std::min<size_t>( waiting, res ? record->count : 1 );
+		if( !res ) {
+			continue;
+		}
+		// the record waits in memory for its getter, it is older than the rest of queue
+		m_ReceivedRecords.push_back( record );
+		spill.in_memory++;
+		return true;
+	}
+	return false;
+}
+
+utils::ECodec MFPipeImpl::SelectCodec( const std::string &channel, const std::string &strHints,
+									   uint32_t codecs ) const {
+	utils::ECodec codec = m_Codec;
+	{
+		std::unique_lock lock( m_ChannelsLock );
+		auto found = m_ChannelCodecs.find( channel );
+		if( found != m_ChannelCodecs.end() ) {
+			codec = found->second;
+		}
+	}
+	utils::Params params = utils::Params::Parse( strHints );
+	if( params.Has( "compress" ) ) {
+		codec = utils::compression::CodecFromString( params.Get( "compress" ) );
+	}
+
+	auto supported = [&]( utils::ECodec c ) { return ( codecs & ( 1u << static_cast<uint32_t>( c ) ) ) != 0; };
+	if( codec == utils::ECodec::Zstd && !supported( codec ) ) {
+		codec = utils::ECodec::LZ4;
+	}
+	return supported( codec ) ? codec : utils::ECodec::None;
+}
+
+void MFPipeImpl::ForceKeyframes( const std::string &channel ) {
+	std::unique_lock lock( m_DeltaLock );
+	for( auto &el : m_DeltaEncoders ) {
+		if( channel.empty() || el.first == channel ) {
+			el.second->ForceKeyframe();
+		}
+	}
+}
+
+bool MFPipeImpl::IsDeltaChannel( const std::string &channel, const std::string &strHints ) const {
+	bool delta = m_Delta;
+	{
+		std::unique_lock lock( m_ChannelsLock );
+		auto found = m_ChannelDeltas.find( channel );
+		if( found != m_ChannelDeltas.end() ) {
+			delta = found->second;
+		}
+	}
+	return utils::Params::Parse( strHints ).GetInt( "delta", delta ? 1 : 0 ) != 0;
+}
+
+Error MFPipeImpl::SendHello( const std::vector<SessionID> &sessions, bool wait ) {
+	auto msg = sessions.empty() ? m_Transport->ComposeMsg() : m_Transport->ComposeMsg( sessions );
+
+	utils::SinkChunkWriter<utils::MsgComposeSink> chunk_writer{ utils::MsgComposeSink( *msg ) };
+
+	// Hello is always written in fixed encoding, peers without compact encoding just drop it
+	uint32_t encodings = ( 1u << static_cast<uint32_t>( utils::EEncoding::Fixed ) ) |
+						 ( 1u << static_cast<uint32_t>( m_Encoding ) );
+	bool res = chunk_writer.Write( static_cast<byte>( ERecordType::Hello ) );
+	res &= chunk_writer.Write( std::string() );
+	res &= chunk_writer.Write( encodings );
+	res &= chunk_writer.Write( utils::compression::SupportedCodecs() );
+	res &= chunk_writer.Write( Features );
+	chunk_writer.Flush();
+
+	if( !wait ) {
+		return msg->Send( !res, []( const Error &err ) {} );
+	}
+	return SendAndWait( msg, !res, 100 );
+}
+
+void MFPipeImpl::ApplySettings( const std::string &strPipeID, const std::string &strHints ) {
+	utils::Params params = utils::Params::Parse( utils::Uri::Parse( strPipeID ).QueryString );
+	params.Merge( utils::Params::Parse( strHints ) );
+
+	m_Encoding = params.Get( "encoding", "compact" ) == "fixed" ? utils::EEncoding::Fixed : utils::EEncoding::Compact;
+	m_Checksum = params.GetInt( "checksum", 0 ) != 0;
+
+	m_Codec = utils::compression::CodecFromString( params.Get( "compress", "none" ) );
+	m_CodecLevel = params.GetInt( "compress_level", 0 );
+	m_RowBytes = params.GetInt( "row_bytes", -1 );
+	m_Delta = params.GetInt( "delta", 0 ) != 0;
+	m_KeyframeInterval = static_cast<size_t>( std::max( 0, params.GetInt( "keyframe_interval", 30 ) ) );
+	m_Deadline = ParseDeadline( params.Get( "deadline", "0" ) );
+	m_TraceInterval = static_cast<uint32_t>( std::max( 0, params.GetInt( "trace", 0 ) ) );
+	m_TraceFile = params.Get( "trace_file" );
+	m_SpillLimit = static_cast<size_t>( std::max( 0, params.GetInt( "spill", 0 ) ) );
+	m_SpillDir = params.Get( "spill_dir" );
+	if( m_SpillDir.empty() ) {
+		std::error_code ec;
+		m_SpillDir = std::filesystem::temp_directory_path( ec ).string();
+	}
+	m_SpillSegment = static_cast<size_t>( std::max( 1, params.GetInt( "spill_segment", 64 ) ) ) * 1024 * 1024;
+	m_SpillDirect = params.GetInt( "spill_direct", 0 ) != 0;
+	m_ExecutorInline = params.Get( "executor", "pool" ) == "inline";
+	m_ExecutorThreads = static_cast<size_t>( std::max( 1, params.GetInt( "executor_threads", 1 ) ) );
+	m_BatchBytes = static_cast<size_t>(
+		std::max( 1, params.GetInt( "batch_bytes", static_cast<int>( DefaultBatchBytes ) ) ) );
+
+	// per channel settings "<key>.<channel>"
+	std::unique_lock lock( m_ChannelsLock );
+	for( const auto &el : params.Values ) {
+		size_t pos = el.first.find( '.' );
+		if( pos != std::string::npos ) {
+			SetChannelParam( el.first.substr( pos + 1 ), el.first.substr( 0, pos ), el.second );
+		}
+	}
+	m_SpillEnabled = m_SpillEnabled || m_SpillLimit != 0;
+}
+
+void MFPipeImpl::SetChannelParam( const std::string &channel, const std::string &key, const std::string &value ) {
+	if( key == "compress" ) {
+		m_ChannelCodecs[ channel ] = utils::compression::CodecFromString( value );
+	} else if( key == "delta" ) {
+		m_ChannelDeltas[ channel ] = std::atoi( value.c_str() ) != 0;
+	} else if( key == "priority" ) {
+		m_ChannelClasses[ channel ].priority = std::atoi( value.c_str() );
+	} else if( key == "weight" ) {
+		m_ChannelClasses[ channel ].weight = static_cast<uint32_t>( std::max( 1, std::atoi( value.c_str() ) ) );
+	} else if( key == "deadline" ) {
+		m_ChannelDeadlines[ channel ] = ParseDeadline( value );
+	} else if( key == "spill" ) {
+		m_ChannelSpillLimits[ channel ] = static_cast<size_t>( std::max( 0, std::atoi( value.c_str() ) ) );
+		m_SpillEnabled = true;
+	}
+}
+
+utils::EEncoding MFPipeImpl::DetectEncoding( const ConstNetBufferSeq &seq ) {
+	// every record starts with record type, its compact tag differs from low byte of fixed chunk size (6)
+	constexpr byte compact_tag = ( static_cast<byte>( utils::traits::ETypes::Byte ) << utils::compact::TypeShift ) | 1;
+	for( const auto buf : seq ) {
+		if( buf->size != 0 ) {
+			return buf->data[ 0 ] == compact_tag ? utils::EEncoding::Compact : utils::EEncoding::Fixed;
+		}
+	}
+	return utils::EEncoding::Fixed;
+}
+
+Error MFPipeImpl::SendAndWait( const IMsgCompose::Ptr &msg, bool failed, int _nMaxWaitMs ) {
+	std::vector<Error> results;
+	return SendAndWait( { msg }, { failed }, _nMaxWaitMs, results );
+}
+
+Error MFPipeImpl::SendAndWait( const std::vector<IMsgCompose::Ptr> &msgs, const std::vector<bool> &failed,
+								int _nMaxWaitMs, std::vector<Error> &results ) {
+	// late reports may come after the wait is over, so they update shared state only
+	auto completion = std::make_shared<SendCompletion>();
+	completion->results.assign( msgs.size(), Error::Timeout );
+
+	for( size_t i = 0; i < msgs.size(); i++ ) {
+		msgs[ i ]->Send( failed[ i ], [completion, i]( const Error &err ) {
+			std::unique_lock l( completion->lock );
+			completion->complete++;
+			completion->results[ i ] = err;
+			completion->check.notify_all();
+		} );
+	}
+
+	{
+		std::unique_lock lock( completion->lock );
+		completion->check.wait_for( lock, std::max( 100, _nMaxWaitMs ) * 1ms,
+									[&]() { return completion->complete == msgs.size(); } );
+		results = completion->results;
+	}
+
+	for( const auto &msg : msgs ) {
+		msg->Close();
+	}
+
+	for( Error err : results ) {
+		if( err != Error::Ok ) {
+			return err;
+		}
+	}
+	return Error::Ok;
+}
+
+void MFPipeImpl::OnNewMessage( const IMsgReceived::Ptr &msg ) {
+	{
+		// subscriptions and hello are control records, they are processed right away
+		ConstNetBufferSeq seq = msg->GetBuffers();
+		utils::EEncoding encoding = DetectEncoding( seq );
+		utils::ChunkReader chunk_reader( seq, encoding );
+
+		byte msg_type;
+		if( !chunk_reader.Read( msg_type ) ) {
+			return;
+		}
+
+		if( ( msg_type & RecordChecksumFlag ) != 0 ) {
+			if( !utils::VerifyChecksum( seq, encoding ) ) {
+				MFPIPE_LOG( Warning, "wrong checksum", { "pipe", this }, { "msg_id", msg->GetMessageID() } );
+				return;
+			}
+			msg_type &= ~RecordChecksumFlag;
+		}
+
+		if( static_cast<ERecordType>( msg_type ) == ERecordType::Subscribe ) {
+			std::string channel;
+			if( chunk_reader.Read( channel ) ) {
+				bool subscribed;
+				{
+					std::unique_lock lock( m_SubscriptionsLock );
+					subscribed = m_Subscriptions[ channel ].insert( msg->GetSessionID() ).second;
+				}
+				if( subscribed ) {
+					// new subscriber has no reference frame
+					ForceKeyframes( channel );
+				}
+			}
+			return;
+		}
+
+		if( static_cast<ERecordType>( msg_type ) == ERecordType::Hello ) {
+			std::string channel;
+			uint32_t encodings;
+			if( chunk_reader.Read( channel ) && chunk_reader.Read( encodings ) ) {
+				bool compact = ( encodings & ( 1u << static_cast<uint32_t>( utils::EEncoding::Compact ) ) ) != 0 &&
+							   m_Encoding == utils::EEncoding::Compact;
+				// codecs and features are announced by newer peers only
+				uint32_t codecs = 0;
+				uint32_t features = 0;
+				if( chunk_reader.Read( codecs ) ) {
+					chunk_reader.Read( features );
+				}
+				bool joined;
+				{
+					std::unique_lock lock( m_PeersLock );
+					joined = m_Peers.count( msg->GetSessionID() ) == 0;
+					PeerCaps &peer = m_Peers[ msg->GetSessionID() ];
+					peer.encoding = compact ? utils::EEncoding::Compact : utils::EEncoding::Fixed;
+					peer.codecs = codecs;
+					peer.features = features;
+				}
+				if( joined && ( features & FeatureDeltaFrames ) != 0 ) {
+					// deltas of all channels go to the new peer from now on
+					ForceKeyframes( std::string() );
+				}
+				if( m_Listening ) {
+					SendHello( { msg->GetSessionID() }, false );
 				}
 			}
+			return;
+		}
+	}
 
-			printf( "%p::MFPipeImpl - CheckReceived() - parse msg_id=%u\n", this, ( *rec )->msg->GetMessageID() );
+	Record::Ptr record( new Record{ msg } );
+	if( m_Capture != nullptr ) {
+		record->arrived = utils::trace::Now();
+	}
+	size_t spill_limit = 0;
+	if( m_SpillEnabled || m_CallbacksEnabled ) {
+		// channel of the record decides whether it is spilled and delivered to callback
+		if( !ParseRecord( *record, false, m_RowBytes ) ) {
+			return;
+		}
+		spill_limit = m_SpillEnabled ? GetSpillLimit( record->channel ) : 0;
+	}
+
+	std::string channel = record->channel;
+	utils::IExecutor::Ptr executor;
+	{
+		std::unique_lock lock( m_ReceivingLock );
+		bool callback = m_CallbacksEnabled && HasCallback( record->channel, record->type );
+		if( spill_limit == 0 || !SpillRecord( *record, spill_limit ) ) {
+			m_ReceivedRecords.push_back( std::move( record ) );
+			m_ReceivedWaiting = m_ReceivedRecords.size();
+		}
+		if( callback ) {
+			executor = ScheduleCallbacks( channel );
+		} else if( m_ReadyEvent != nullptr ) {
+			m_ReadyEvent->Signal();
+		}
+		m_ReceivingVariable.notify_all();
+	}
+	// inline executor takes the lock
+	if( executor != nullptr ) {
+		PostCallbacks( executor, channel );
+	}
+}
+
+void MFPipeImpl::OnSessionClosed( SessionID session ) {
+	MFPIPE_LOG( Debug, "OnSessionClosed", { "pipe", this }, { "session", session } );
+	{
+		std::unique_lock lock( m_SubscriptionsLock );
+		for( auto it = m_Subscriptions.begin(); it != m_Subscriptions.end(); ) {
+			it->second.erase( session );
+			it = it->second.empty() ? m_Subscriptions.erase( it ) : std::next( it );
+		}
+	}
+	{
+		std::unique_lock lock( m_PeersLock );
+		m_Peers.erase( session );
+	}
+	// received records of the peer stay in channels
+	std::unique_lock lock( m_ReceivingLock );
+	auto it = m_DeltaDecoders.lower_bound( { session, std::string() } );
+	while( it != m_DeltaDecoders.end() && it->first.first == session ) {
+		it = m_DeltaDecoders.erase( it );
+	}
+}
+
+MFPipeImpl::Record::Ptr MFPipeImpl::CheckReceived( const std::string channel, ERecordType type, int row_bytes ) {
+	auto result = FindReceived( channel, type, row_bytes );
+	// spilled records are newer than records of the channel in memory
+	while( result == nullptr && TakeSpilled( channel, type ) ) {
+		result = FindReceived( channel, type, row_bytes );
+	}
+	m_ReceivedWaiting = m_ReceivedRecords.size();
+	return result;
+}
+
+MFPipeImpl::Record::Ptr MFPipeImpl::FindReceived( const std::string &channel, ERecordType type, int row_bytes ) {
+	auto rec = m_ReceivedRecords.begin();
+	while( rec != m_ReceivedRecords.end() ) {
+		if( (*rec)->type == ERecordType::Unparsed ) {
+			bool res = ParseRecord( **rec, false, row_bytes );
+
+			MFPIPE_LOG( Trace, "CheckReceived parse", { "pipe", this }, { "msg_id", ( *rec )->msg->GetMessageID() },
+						{ "result", res } );
 
 			if( !res ) {
-				auto rec_copy = rec--;
-				m_ReceivedRecords.erase( rec_copy );
+				rec = m_ReceivedRecords.erase( rec );
 				continue;
 			}
 		}
-		if( (*rec)->type == type && (*rec)->channel == channel ) {
-			// found
-			auto result = *rec;
-			m_ReceivedRecords.erase( rec );
-			return result;
+		if( (*rec)->type != type || (*rec)->channel != channel ) {
+			++rec;
+			continue;
+		}
+		// found, object is loaded for the caller (e.g. with requested stride), objects of batch record are
+		// loaded by the first getter and the record is removed with the last object
+		auto result = *rec;
+		bool parsed = result->next != 0 || ParseRecord( *result, true, row_bytes );
+		if( !parsed || !result->batch || result->next + 1 >= result->objects.size() ) {
+			rec = m_ReceivedRecords.erase( rec );
+			OnRecordTaken( result->channel );
 		}
+		if( !parsed ) {
+			continue;
+		}
+		if( result->next == 0 ) {
+			TraceDelivered( *result );
+		}
+		if( result->batch ) {
+			Record::Ptr taken( new Record{ result->msg, ERecordType::Data, result->channel,
+										   std::move( result->objects[ result->next++ ] ) } );
+			taken->arrived = result->arrived;
+			result = taken;
+		}
+		CaptureDelivered( *result );
+		return result;
 	}
-
 	return nullptr;
 }
 
+bool MFPipeImpl::ParseRecord( Record &record, bool body, int row_bytes ) {
+	ConstNetBufferSeq seq = record.msg->GetBuffers();
+	utils::ChunkReader chunk_reader( seq, DetectEncoding( seq ) );
+
+	byte msg_type;
+	bool res = chunk_reader.Read( msg_type );
+	res &= chunk_reader.Read( record.channel );
+	res &= ByteToRecordType( msg_type, record.type );
+	record.batch = static_cast<ERecordType>( msg_type & ~RecordChecksumFlag ) == ERecordType::Batch;
+	if( res && record.batch ) {
+		res = chunk_reader.Read( record.count ) && record.count != 0;
+	}
+	if( !res || !body ) {
+		return res;
+	}
+
+	switch( record.type ) {
+	case ERecordType::Data: {
+		if( record.batch ) {
+			record.objects.resize( record.count );
+			for( auto &object : record.objects ) {
+				byte obj_type;
+				if( !chunk_reader.Read( obj_type ) ||
+					( object = LoadObject( chunk_reader, static_cast<ObjectType>( obj_type ), row_bytes ) ) == nullptr ) {
+					return false;
+				}
+			}
+			return true;
+		}
+		byte obj_type;
+		if( !chunk_reader.Read( obj_type ) ) {
+			return false;
+		}
+		if( static_cast<ObjectType>( obj_type ) == ObjectType::FrameDelta ) {
+			// frames of delta channel are applied to the previous frame of the same peer
+			auto key = std::make_pair( record.msg->GetSessionID(), record.channel );
+			auto &decoder = m_DeltaDecoders[ key ];
+			bool created = decoder == nullptr;
+			if( created ) {
+				decoder.reset( new FrameDeltaDecoder() );
+			}
+			std::vector<std::shared_ptr<MF_FRAME>> frames;
+			bool loaded = decoder->Load( chunk_reader, row_bytes, frames );
+			if( created && m_Listening ) {
+				// frame of removed session is decoded after OnSessionClosed(), its decoder is not kept
+				std::vector<SessionID> sessions = m_Transport->GetSessions();
+				if( std::find( sessions.begin(), sessions.end(), key.first ) == sessions.end() ) {
+					m_DeltaDecoders.erase( key );
+				}
+			}
+			if( !loaded || frames.empty() ) {
+				return false;
+			}
+			if( frames.size() > 1 ) {
+				// frames of pending deltas are taken one by one like objects of batch record
+				record.batch = true;
+				record.count = static_cast<uint32_t>( frames.size() );
+				record.objects.assign( frames.begin(), frames.end() );
+				return true;
+			}
+			record.object = frames.front();
+			return true;
+		}
+		record.object = LoadObject( chunk_reader, static_cast<ObjectType>( obj_type ), row_bytes );
+		return record.object != nullptr;
+	}
+	case ERecordType::Message: {
+		res = chunk_reader.Read( record.msg_name );
+		res &= chunk_reader.Read( record.msg_value );
+		return res;
+	}
+	default:
+		return false;
+	}
+}
+
 bool MFPipeImpl::ByteToRecordType( byte msg_type, ERecordType &type ) {
-	ERecordType rtype = static_cast<ERecordType>( msg_type );
+	ERecordType rtype = static_cast<ERecordType>( msg_type & ~RecordChecksumFlag );
+	if( rtype == ERecordType::Batch ) {
+		type = ERecordType::Data;
+		return true;
+	}
 	if( rtype == ERecordType::Data || rtype == ERecordType::Message ) {
 		type = rtype;
 		return true;
@@ -3,16 +3,72 @@
 #include "MFTypes.h"
 #include "MFPipe.h"
 #include "Transport.h"
+#include "FrameDelta.h"
+#include "Metrics.h"
+#include "Capture.h"
+#include "SpillQueue.h"
+#include "Executor.h"
+#include "ReadyEvent.h"
 #include <string>
 #include <vector>
 #include <memory>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <map>
+#include <set>
+#include <functional>
 
 namespace comm {
 
 /**
-*	Implements comminication between two instances of MFPipeImpl
+*	Implements comminication between instances of MFPipeImpl
+*	- connecting side (PipeOpen) talks to the listening side
+*	- listening side (PipeCreate) serves many connecting sides (sessions), objects/messages put by listening side are
+*	  sent to subscribers of the channel, or to all sessions if the channel has no subscribers; session is removed
+*	  when the connecting side closes or after "session_timeout" ms without its packets (10000 by default), with its
+*	  subscriptions, capabilities and delta decoders
+*	- records are written with compact encoding to peers which announced it by Hello record, the encoding of
+*	  received record is detected by its first byte ("encoding=fixed" hint disables compact encoding)
+*	- "checksum=1" hint appends CRC32C of data records, records with checksum are always verified
+*	- bytes arrays of objects are compressed by codec of the channel: "compress=lz4|zstd|none" hint of PipePut,
+*	  "compress.<channel>=..." or "compress=..." hint of PipeCreate/PipeOpen; codec is used if all destination peers
+*	  announced it by Hello record (zstd falls back to lz4)
+*	- "delta=1" (all channels) or "delta.<channel>=1" hint of PipeCreate/PipeOpen, or "delta=1" hint of PipePut sends
+*	  frames of the channel as changed tiles against the previous frame, keyframe is sent every "keyframe_interval"
+*	  frames and when a peer or subscriber joins; receiver holds deltas which come ahead of a missed frame and
+*	  drops them after lost frame until keyframe. Delivered frames of such channel are shared with the pipe and
+*	  should not be modified.
+*	- packets of channels are scheduled by sending class: "priority.<channel>=N" (higher goes first) and
+*	  "weight.<channel>=N" (share of link among channels of the same priority) hints of PipeCreate/PipeOpen,
+*	  PipeChannelSet() or "priority"/"weight" hints of PipePut, so small records of e.g. audio channel are not
+*	  queued behind packets of large video frames
+*	- "deadline=ms" hint of PipePut (or "deadline=ms", "deadline.<channel>=ms" hints of PipeCreate/PipeOpen) drops
+*	  the object if it is not sent within ms, "deadline=frame" takes ms from duration of MF_FRAME (M_TIME);
+*	  PipePut of dropped object returns Error::Expired, drops are counted by PipeInfoGet()
+*	- video of known formats is sent without stride padding, "row_bytes=N" hint of PipeGet (or PipeCreate/PipeOpen)
+*	  sets stride of received frames (0 - no padding), stride of sender is restored by default
+*	- "trace=N" hint of PipeCreate/PipeOpen traces every N-th object/message put by the pipe: stamps of sending side
+*	  go with its packets, stages are recorded to utils::trace histograms by both sides (see Trace.h);
+*	  "trace_file=path" writes Chrome trace-event JSON of recorded stages by PipeClose()
+*	- "metrics_port=N" hint serves OpenMetrics text of pipe, channel and transport counters on 127.0.0.1:N,
+*	  "metrics_file=path" writes it every "metrics_interval" ms (1000 by default); collection reads atomics only
+*	- "spill=N" (all channels) or "spill.<channel>=N" hint of PipeCreate/PipeOpen keeps up to N received records of the
+*	  channel in memory, next ones are written to disk-backed spill queue in "spill_dir" (system temp directory by
+*	  default) while the consumer falls behind and they are read back by PipeGet/PipeMessageGet in order;
+*	  "spill_segment=MB" sets size of segment files (64 by default), "spill_direct=1" writes them with O_DIRECT
+*	- PipePutBatch() writes many objects of the channel as batch records of up to "batch_bytes" (64 KB by default),
+*	  sends them at once and waits for completion once; objects are put one by one to peers without batch records
+*	  and to delta channels. PipeGetBatch() takes up to N ready objects of the channel under one lock.
+*	- PipeCallbackSet() delivers objects/messages of the channel to callbacks instead of PipeGet/PipeMessageGet, they
+*	  are called on executor of the pipe: pool of "executor_threads" threads (1 by default), the receiving thread for
+*	  "executor=inline" hint or executor of application set by PipeExecutorSet(); callbacks of one channel are not
+*	  called concurrently
+*	- PipeReadyGet() gives descriptor for epoll/poll of application which is readable after arrival of object/message
+*	  for PipeGet/PipeMessageGet, PipeReadyClear() resets it and lists channels with waiting objects/messages, which
+*	  are taken by PipeGet/PipeGetBatch/PipeMessageGet with _nMaxWaitMs = 0 (no wait) till Error::Timeout
+*	- "capture=path" hint of PipeCreate/PipeOpen appends put objects/messages and objects/messages taken by
+*	  PipeGet/PipeMessageGet to memory-mapped capture file (see Capture.h), the file is closed by PipeClose()
 */
 class MFPipeImpl : public MFPipe {
 public:
@@ -20,8 +76,32 @@ public:
 		Unparsed = 255,
 		Data = 0,
 		Message = 1,
+		Subscribe = 2,
+		Hello = 3,
+		/// objects of one channel: count and object records without channel, it is parsed as Data
+		Batch = 4,
 	};
 
+	/// flag of record type byte: record ends with checksum chunk
+	static constexpr byte RecordChecksumFlag = 0x80;
+
+	/// deadline setting: deadline is duration of MF_FRAME
+	static constexpr int DeadlineFrame = -1;
+
+	/// features announced by Hello record
+	static constexpr uint32_t FeatureDeltaFrames = 1;
+	static constexpr uint32_t FeatureBatch = 2;
+	/// all features of this pipe
+	static constexpr uint32_t Features = FeatureDeltaFrames | FeatureBatch;
+
+	/// consumer callbacks of channel (PipeCallbackSet)
+	using FnOnObject = std::function<void( const std::string &channel, const std::shared_ptr<MF_BASE_TYPE> &object )>;
+	using FnOnMessage =
+		std::function<void( const std::string &channel, const std::string &name, const std::string &param )>;
+
+	/// default size of batch record ("batch_bytes" hint)
+	static constexpr size_t DefaultBatchBytes = 64 * 1024;
+
 	struct Record {
 		using Ptr = std::shared_ptr<Record>;
 
@@ -31,23 +111,180 @@ public:
 		MF_BASE_TYPE::Ptr object;
 		std::string msg_name;
 		std::string msg_value;
+		/// wall clock ns of arrival, it is stamped for capture only
+		int64_t arrived{ 0 };
+		/// batch record: objects of the record and the next one to take
+		bool batch{ false };
+		uint32_t count{ 1 };
+		std::vector<MF_BASE_TYPE::Ptr> objects;
+		size_t next{ 0 };
 	};
 
 protected:
 	/// transport
 	comm::ITransport::Ptr m_Transport;
+	/// pipe id of PipeCreate/PipeOpen
+	std::string m_PipeID;
+	/// _nMaxBuffers of PipeOpen
+	int m_MaxBuffers{ 0 };
 	/// lock for receiving queue/records list
 	std::mutex m_ReceivingLock;
 	/// synchronization
 	std::condition_variable m_ReceivingVariable;
 	/// receiving queue/records list
 	std::vector<Record::Ptr> m_ReceivedRecords;
+	/// lock for subscriptions
+	std::mutex m_SubscriptionsLock;
+	/// channel -> sessions subscribed to the channel
+	std::map<std::string, std::set<SessionID>> m_Subscriptions;
+	/// pipe is created by PipeCreate
+	bool m_Listening{ false };
+	/// best encoding supported by this pipe
+	utils::EEncoding m_Encoding{ utils::EEncoding::Compact };
+	/// append checksum to data records ("checksum=1" hint)
+	bool m_Checksum{ false };
+	/// default codec of channels
+	utils::ECodec m_Codec{ utils::ECodec::None };
+	/// codec level ("compress_level" hint), 0 - default
+	int m_CodecLevel{ 0 };
+	/// channel -> codec ("compress.<channel>" hints)
+	std::map<std::string, utils::ECodec> m_ChannelCodecs;
+	/// stride of received video ("row_bytes" hint): -1 - stride of sender, 0 - no padding
+	int m_RowBytes{ -1 };
+	/// lock for per channel settings, they may be changed by PipeChannelSet()
+	mutable std::mutex m_ChannelsLock;
+	/// channel -> sending class ("priority.<channel>" and "weight.<channel>" hints)
+	std::map<std::string, MsgClass> m_ChannelClasses;
+	/// default deadline of objects in ms ("deadline" hint), 0 - none, DeadlineFrame - duration of frame
+	int m_Deadline{ 0 };
+	/// channel -> deadline ("deadline.<channel>" hints)
+	std::map<std::string, int> m_ChannelDeadlines;
+
+	/// counters of channel, they are read by metrics collector without locks
+	struct ChannelMetrics {
+		std::string name;
+		std::atomic<uint64_t> objects_put{ 0 };
+		std::atomic<uint64_t> messages_put{ 0 };
+		/// failed PipePut/PipeMessagePut (dropped objects included)
+		std::atomic<uint64_t> put_failed{ 0 };
+		/// objects dropped by deadline
+		std::atomic<uint64_t> dropped{ 0 };
+		std::atomic<uint64_t> objects_got{ 0 };
+		std::atomic<uint64_t> messages_got{ 0 };
+		/// received records written to spill queue
+		std::atomic<uint64_t> spilled{ 0 };
+		/// next item of m_ChannelsList
+		ChannelMetrics *next{ nullptr };
+	};
+	/// channel -> counters, protected by m_ChannelsLock, items are not removed
+	std::map<std::string, std::unique_ptr<ChannelMetrics>> m_ChannelMetrics;
+	/// lock-free list of m_ChannelMetrics items for metrics collector, new items are pushed to the head
+	std::atomic<ChannelMetrics *> m_ChannelsList{ nullptr };
+	/// duration of PipePut in ns
+	utils::trace::Histogram m_PutLatency;
+	/// number of received records in m_ReceivedRecords
+	std::atomic<size_t> m_ReceivedWaiting{ 0 };
+	/// id of registered metrics source, 0 - not registered
+	uint64_t m_MetricsSource{ 0 };
+	/// exporter of "metrics_port"/"metrics_file" hints
+	utils::metrics::Exporter::Ptr m_MetricsExporter;
+	/// every N-th put object/message is traced ("trace" hint), 0 - tracing is disabled
+	uint32_t m_TraceInterval{ 0 };
+	/// number of put objects/messages for trace sampling
+	std::atomic<uint32_t> m_TraceCounter{ 0 };
+	/// Chrome trace file written by PipeClose() ("trace_file" hint)
+	std::string m_TraceFile;
+	/// received records of the channel kept in memory before spilling ("spill" hint), 0 - spill is disabled
+	size_t m_SpillLimit{ 0 };
+	/// channel -> limit ("spill.<channel>" hints)
+	std::map<std::string, size_t> m_ChannelSpillLimits;
+	/// a channel has spill limit, received records are parsed before queueing
+	std::atomic<bool> m_SpillEnabled{ false };
+	/// directory of spill segments ("spill_dir" hint)
+	std::string m_SpillDir;
+	/// size of spill segments ("spill_segment" hint in MB)
+	size_t m_SpillSegment{ 64 * 1024 * 1024 };
+	/// O_DIRECT writes of spill segments ("spill_direct" hint)
+	bool m_SpillDirect{ false };
+	/// received records of channel with spill limit
+	struct ChannelSpill {
+		/// records of the channel in m_ReceivedRecords
+		size_t in_memory{ 0 };
+		/// spilled objects and messages waiting for PipeGet/PipeMessageGet
+		size_t objects{ 0 };
+		size_t messages{ 0 };
+		/// objects and messages are spilled to own queues, so getter of one type does not read back the other one;
+		/// queue is created by the first spilled record of its type
+		utils::SpillQueue::Ptr object_queue;
+		utils::SpillQueue::Ptr message_queue;
+
+		utils::SpillQueue::Ptr &Queue( ERecordType type ) {
+			return type == ERecordType::Data ? object_queue : message_queue;
+		}
+	};
+	/// channel -> spill, protected by m_ReceivingLock
+	std::map<std::string, ChannelSpill> m_Spills;
+	/// consumer callbacks of channel
+	struct ChannelCallbacks {
+		FnOnObject onobject;
+		FnOnMessage onmessage;
+		/// delivery task of the channel is posted, the next one is posted after it
+		bool scheduled{ false };
+	};
+	/// channel -> callbacks, protected by m_ReceivingLock, items are not removed
+	std::map<std::string, ChannelCallbacks> m_Callbacks;
+	/// a channel has callbacks, received records are parsed before queueing
+	std::atomic<bool> m_CallbacksEnabled{ false };
+	/// executor of callbacks (PipeExecutorSet()), default one is created by the first delivery, protected by
+	/// m_ReceivingLock
+	utils::IExecutor::Ptr m_Executor;
+	/// default executor runs callbacks in receiving thread ("executor=inline" hint), otherwise by pool of threads
+	bool m_ExecutorInline{ false };
+	/// threads of default executor ("executor_threads" hint)
+	size_t m_ExecutorThreads{ 1 };
+	/// posted delivery tasks, protected by m_ReceivingLock
+	size_t m_CallbackTasks{ 0 };
+	std::condition_variable m_CallbackTasksVariable;
+	/// readiness of records for PipeGet/PipeMessageGet, created by PipeReadyGet(), protected by m_ReceivingLock
+	utils::ReadyEvent::Ptr m_ReadyEvent;
+	/// max size of batch record ("batch_bytes" hint)
+	size_t m_BatchBytes{ DefaultBatchBytes };
+	/// capture of traffic ("capture" hint), nullptr - disabled
+	utils::capture::Writer::Ptr m_Capture;
+
+	/// default delta mode of channels
+	bool m_Delta{ false };
+	/// channel -> delta mode ("delta.<channel>" hints)
+	std::map<std::string, bool> m_ChannelDeltas;
+	/// deltas between keyframes
+	size_t m_KeyframeInterval{ 30 };
+	/// lock for delta encoders, it is held while frame is written
+	std::mutex m_DeltaLock;
+	/// channel -> encoder
+	std::map<std::string, std::unique_ptr<FrameDeltaEncoder>> m_DeltaEncoders;
+	/// (session, channel) -> decoder, protected by m_ReceivingLock
+	std::map<std::pair<SessionID, std::string>, std::unique_ptr<FrameDeltaDecoder>> m_DeltaDecoders;
+
+	/// capabilities announced by the peer
+	struct PeerCaps {
+		utils::EEncoding encoding{ utils::EEncoding::Fixed };
+		/// bit per utils::ECodec
+		uint32_t codecs{ 0 };
+		/// Feature* bits
+		uint32_t features{ 0 };
+	};
+	/// lock for peers
+	std::mutex m_PeersLock;
+	/// session -> peer capabilities
+	std::map<SessionID, PeerCaps> m_Peers;
 
 public:
+	~MFPipeImpl() override;
+
+	/// statistics of the channel, of all channels if strChannel is empty (incomplete messages dropped by transport
+	/// are counted for all channels only as the channel of them is unknown)
 	Error PipeInfoGet( /*[out]*/ std::string *pStrPipeName, /*[in]*/ const std::string &strChannel,
-					   MF_PIPE_INFO *_pPipeInfo ) override {
-		return Error::NotImplemented;
-	}
+					   MF_PIPE_INFO *_pPipeInfo ) override;
 
 	Error PipeCreate( /*[in]*/ const std::string &strPipeID, /*[in]*/ const std::string &strHints ) override;
 
@@ -57,6 +294,9 @@ public:
 	Error PipePut( /*[in]*/ const std::string &strChannel, /*[in]*/ const std::shared_ptr<MF_BASE_TYPE> &pBufferOrFrame,
 				   /*[in]*/ int _nMaxWaitMs, /*[in]*/ const std::string &strHints ) override;
 
+	/// _nMaxWaitMs = 0 takes received object without waiting (as PipeGetBatch and PipeMessageGet)
+	/// @return Error::Timeout - nothing is taken (pBufferOrFrame is reset, event name and param of PipeMessageGet are
+	/// cleared), so drain loop stops on it
 	Error PipeGet( /*[in]*/ const std::string &strChannel, /*[out]*/ std::shared_ptr<MF_BASE_TYPE> &pBufferOrFrame,
 				   /*[in]*/ int _nMaxWaitMs, /*[in]*/ const std::string &strHints ) override;
 
@@ -82,9 +322,122 @@ public:
 
 	Error PipeClose() override;
 
+	/// ask the listening side to send the channel to this pipe (it is done for "channels=ch1,ch2" hint of PipeOpen)
+	Error PipeSubscribe( /*[in]*/ const std::string &strChannel, /*[in]*/ int _nMaxWaitMs );
+
+	/// put objects to the channel with one completion wait: objects are written to batch records of "batch_bytes"
+	/// size, "deadline" of the batch is the earliest deadline of its objects
+	/// @return the first error of sent records, Error::Ok - all objects were put
+	Error PipePutBatch( /*[in]*/ const std::string &strChannel,
+						/*[in]*/ const std::vector<std::shared_ptr<MF_BASE_TYPE>> &arrObjects, /*[in]*/ int _nMaxWaitMs,
+						/*[in]*/ const std::string &strHints );
+
+	/// take up to _nMaxCount ready objects of the channel (arrObjects is cleared), it waits for the first object only
+	/// @return Error::Timeout - no object within _nMaxWaitMs
+	Error PipeGetBatch( /*[in]*/ const std::string &strChannel,
+						/*[out]*/ std::vector<std::shared_ptr<MF_BASE_TYPE>> &arrObjects, /*[in]*/ size_t _nMaxCount,
+						/*[in]*/ int _nMaxWaitMs, /*[in]*/ const std::string &strHints );
+
+	/// deliver objects and/or messages of the channel to callbacks instead of PipeGet/PipeMessageGet, nullptr leaves the
+	/// kind for PipeGet/PipeMessageGet; callbacks are called by executor of the pipe in order of arrival (objects and
+	/// messages separately), waiting objects/messages are delivered too. Callbacks should not call PipeClose().
+	Error PipeCallbackSet( /*[in]*/ const std::string &strChannel, /*[in]*/ FnOnObject fnOnObject,
+						   /*[in]*/ FnOnMessage fnOnMessage );
+
+	/// executor of callbacks, nullptr - default executor ("executor" and "executor_threads" hints); it should run
+	/// posted tasks till PipeClose() of the pipe
+	Error PipeExecutorSet( /*[in]*/ utils::IExecutor::Ptr pExecutor );
+
+	/// descriptor which is readable (signaled on Windows) after arrival of object/message for PipeGet/PipeMessageGet
+	/// till PipeReadyClear(), it is owned by the pipe
+	Error PipeReadyGet( /*[out]*/ intptr_t *pHandle );
+
+	/// reset readiness descriptor before waiting objects/messages are taken
+	/// @param pChannels - [output] channels with objects/messages waiting for PipeGet/PipeMessageGet (optional)
+	Error PipeReadyClear( /*[out]*/ std::vector<std::string> *pChannels );
+
+	/// change settings of the channel: "priority", "weight", "compress", "delta", "deadline" hints (as
+	/// "<key>.<channel>" hints of PipeCreate/PipeOpen)
+	Error PipeChannelSet( /*[in]*/ const std::string &strChannel, /*[in]*/ const std::string &strHints );
+
 protected:
+	/// create message addressed to subscribers of the channel, with sending class of the channel
+	/// @param caps - [output] encoding, codecs and features supported by all destination peers
+	IMsgCompose::Ptr ComposeMsg( const std::string &channel, const std::string &strHints, PeerCaps &caps );
+	/// subscribers of the channel, empty if the message goes to all peers
+	/// @param caps - [output] encoding, codecs and features supported by all destination peers
+	std::vector<SessionID> SelectPeers( const std::string &channel, PeerCaps &caps );
+	/// sending class of the channel, "priority" and "weight" hints override settings of the channel
+	MsgClass GetMsgClass( const std::string &channel, const std::string &strHints ) const;
+	/// channel is sent in delta mode
+	bool IsDeltaChannel( const std::string &channel, const std::string &strHints ) const;
+	/// the next frame of delta channel is keyframe (e.g. for a new peer), empty channel - all delta channels
+	void ForceKeyframes( const std::string &channel );
+	/// deadline of object put to the channel, time_point::max() - none
+	std::chrono::steady_clock::time_point GetDeadline( const std::string &channel, const std::string &strHints,
+													   const MF_BASE_TYPE &object ) const;
+	static int ParseDeadline( const std::string &value );
+	/// counters of the channel, they are created on first use
+	ChannelMetrics &GetChannelMetrics( const std::string &channel );
+	/// register metrics source and start exporter of "metrics_port"/"metrics_file" hints
+	Error StartMetrics( const std::string &strPipeID, const std::string &strHints );
+	void StopMetrics();
+	/// write counters of the pipe, its channels and transport (atomics only)
+	void CollectMetrics( utils::metrics::Writer &writer );
+	/// carry trace stamps with the message if it is sampled for tracing
+	/// @param origin - stamp of PipePut/PipeMessagePut start
+	void SetTrace( IMsgCompose &msg, int64_t origin );
+	/// record stages of receiving side for traced record taken by the caller
+	void TraceDelivered( const Record &record );
+	/// create capture file of "capture" hint
+	Error StartCapture( const std::string &strPipeID, const std::string &strHints );
+	/// append delivered record to capture
+	void CaptureDelivered( const Record &record );
+	/// spill limit of the channel, 0 - records are kept in memory
+	size_t GetSpillLimit( const std::string &channel ) const;
+	/// write received record to spill queue of its channel if the channel is over limit, m_ReceivingLock is held
+	/// @return false - the record is kept in memory
+	bool SpillRecord( const Record &record, size_t limit );
+	/// the record of the channel is taken from m_ReceivedRecords, m_ReceivingLock is held
+	void OnRecordTaken( const std::string &channel );
+	/// the type of records of the channel is delivered to callback, m_ReceivingLock is held
+	bool HasCallback( const std::string &channel, ERecordType type ) const;
+	/// mark delivery task of the channel posted, m_ReceivingLock is held
+	/// @return executor to post the task to after the lock is released, nullptr - the task is posted already
+	utils::IExecutor::Ptr ScheduleCallbacks( const std::string &channel );
+	void PostCallbacks( const utils::IExecutor::Ptr &executor, const std::string &channel );
+	/// deliver received records of the channel to its callbacks (delivery task)
+	void RunCallbacks( const std::string &channel );
+	/// drop callbacks and wait for posted delivery tasks
+	void StopCallbacks();
+	/// move the oldest spilled record of the channel and type to m_ReceivedRecords, m_ReceivingLock is held
+	/// @return false - no spilled record of the type
+	bool TakeSpilled( const std::string &channel, ERecordType type );
+	/// codec for object put to the channel
+	utils::ECodec SelectCodec( const std::string &channel, const std::string &strHints, uint32_t codecs ) const;
+	/// announce supported encodings, codecs and features to the sessions (all if empty)
+	Error SendHello( const std::vector<SessionID> &sessions, bool wait );
+	/// apply "encoding", "checksum" and "compress" settings from URI query/hints
+	void ApplySettings( const std::string &strPipeID, const std::string &strHints );
+	/// apply per channel setting, m_ChannelsLock should be held
+	void SetChannelParam( const std::string &channel, const std::string &key, const std::string &value );
+	static utils::EEncoding DetectEncoding( const ConstNetBufferSeq &seq );
+	/// send composed message and wait for completion
+	Error SendAndWait( const IMsgCompose::Ptr &msg, bool failed, int _nMaxWaitMs );
+	/// send composed messages and wait for completion of all of them
+	/// @param results - [output] result of every message
+	/// @return the first error of messages
+	Error SendAndWait( const std::vector<IMsgCompose::Ptr> &msgs, const std::vector<bool> &failed, int _nMaxWaitMs,
+					   std::vector<Error> &results );
+	/// find and remove record of the channel from m_ReceivedRecords, objects of batch record are taken one by one
+	Record::Ptr FindReceived( const std::string &channel, ERecordType type, int row_bytes );
 	void OnNewMessage( const IMsgReceived::Ptr &msg );
-	Record::Ptr CheckReceived( const std::string channel, ERecordType type );
+	/// transport removed session of the peer: drop its subscriptions, capabilities and delta decoders
+	void OnSessionClosed( SessionID session );
+	/// find record of the channel, frames are loaded with video stride row_bytes (-1 - stride of sender)
+	Record::Ptr CheckReceived( const std::string channel, ERecordType type, int row_bytes );
+	/// parse record type and channel, and the object/message if body is requested
+	bool ParseRecord( Record &record, bool body, int row_bytes );
 	bool ByteToRecordType( byte msg_type, ERecordType &type );
 };
 
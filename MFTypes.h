@@ -14,6 +14,7 @@ enum class Error : uint32_t {
 	NotImplemented,   // not implemented
 	SentError,        // sent data error
 	Timeout,          // Timeout
+	Expired,          // deadline of data is passed, data is dropped
 };
 
 typedef long long int REFERENCE_TIME;
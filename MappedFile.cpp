@@ -0,0 +1,156 @@
+#include "MappedFile.h"
+
+#if defined( WIN32 )
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace comm {
+namespace utils {
+
+	namespace {
+#if defined( WIN32 )
+		HANDLE Native( intptr_t file ) {
+			return reinterpret_cast<HANDLE>( file );
+		}
+#else
+		int Native( intptr_t file ) {
+			return static_cast<int>( file );
+		}
+#endif
+	}  // namespace
+
+	MappedFile::~MappedFile() {
+		UnmapAll();
+		if( m_File != -1 ) {
+#if defined( WIN32 )
+			::CloseHandle( Native( m_File ) );
+#else
+			::close( Native( m_File ) );
+#endif
+		}
+	}
+
+	std::unique_ptr<MappedFile> MappedFile::Open( const std::string& path, bool writable, bool direct ) {
+		std::unique_ptr<MappedFile> file( new MappedFile() );
+		file->m_Writable = writable;
+#if defined( WIN32 )
+		// no-buffering writes are not coherent with mapped views, direct I/O is not used
+		HANDLE handle = ::CreateFileA( path.c_str(), writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ,
+									   FILE_SHARE_READ, nullptr, writable ? CREATE_ALWAYS : OPEN_EXISTING,
+									   FILE_ATTRIBUTE_NORMAL, nullptr );
+		if( handle == INVALID_HANDLE_VALUE ) {
+			return nullptr;
+		}
+		file->m_File = reinterpret_cast<intptr_t>( handle );
+#else
+		int flags = writable ? O_RDWR | O_CREAT | O_TRUNC : O_RDONLY;
+#if defined( O_DIRECT )
+		if( writable && direct ) {
+			flags |= O_DIRECT;
+			file->m_Direct = true;
+		}
+#endif
+		int fd = ::open( path.c_str(), flags, 0644 );
+#if defined( O_DIRECT )
+		if( fd == -1 && file->m_Direct ) {
+			// e.g. tmpfs does not support O_DIRECT
+			file->m_Direct = false;
+			fd = ::open( path.c_str(), flags & ~O_DIRECT, 0644 );
+		}
+#endif
+		if( fd == -1 ) {
+			return nullptr;
+		}
+		file->m_File = fd;
+#endif
+		return file;
+	}
+
+	uint64_t MappedFile::GetSize() const {
+#if defined( WIN32 )
+		LARGE_INTEGER size;
+		return ::GetFileSizeEx( Native( m_File ), &size ) ? static_cast<uint64_t>( size.QuadPart ) : 0;
+#else
+		struct stat st;
+		return ::fstat( Native( m_File ), &st ) == 0 ? static_cast<uint64_t>( st.st_size ) : 0;
+#endif
+	}
+
+	bool MappedFile::Resize( uint64_t size ) {
+#if defined( WIN32 )
+		LARGE_INTEGER pos;
+		pos.QuadPart = static_cast<LONGLONG>( size );
+		return ::SetFilePointerEx( Native( m_File ), pos, nullptr, FILE_BEGIN ) && ::SetEndOfFile( Native( m_File ) );
+#else
+		return ::ftruncate( Native( m_File ), static_cast<off_t>( size ) ) == 0;
+#endif
+	}
+
+	byte* MappedFile::Map( uint64_t offset, size_t size ) {
+#if defined( WIN32 )
+		uint64_t end = offset + size;
+		HANDLE mapping = ::CreateFileMappingA( Native( m_File ), nullptr, m_Writable ? PAGE_READWRITE : PAGE_READONLY,
+											   static_cast<DWORD>( end >> 32 ), static_cast<DWORD>( end ),
+											   nullptr );
+		if( mapping == nullptr ) {
+			return nullptr;
+		}
+		// the view keeps the mapping
+		void* data = ::MapViewOfFile( mapping, m_Writable ? FILE_MAP_WRITE : FILE_MAP_READ,
+									  static_cast<DWORD>( offset >> 32 ), static_cast<DWORD>( offset ), size );
+		::CloseHandle( mapping );
+		if( data == nullptr ) {
+			return nullptr;
+		}
+#else
+		void* data = ::mmap( nullptr, size, m_Writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED,
+							 Native( m_File ), static_cast<off_t>( offset ) );
+		if( data == MAP_FAILED ) {
+			return nullptr;
+		}
+#endif
+		m_Views.push_back( View{ data, size } );
+		return static_cast<byte*>( data );
+	}
+
+	void MappedFile::UnmapAll() {
+		for( const auto& view : m_Views ) {
+#if defined( WIN32 )
+			::UnmapViewOfFile( view.data );
+#else
+			::munmap( view.data, view.size );
+#endif
+		}
+		m_Views.clear();
+	}
+
+	bool MappedFile::WriteAt( uint64_t offset, const void* data, size_t size ) {
+#if defined( WIN32 )
+		OVERLAPPED overlapped = {};
+		overlapped.Offset = static_cast<DWORD>( offset );
+		overlapped.OffsetHigh = static_cast<DWORD>( offset >> 32 );
+		DWORD written = 0;
+		return ::WriteFile( Native( m_File ), data, static_cast<DWORD>( size ), &written, &overlapped ) &&
+			   written == size;
+#else
+		const byte* pos = static_cast<const byte*>( data );
+		while( size != 0 ) {
+			ssize_t res = ::pwrite( Native( m_File ), pos, size, static_cast<off_t>( offset ) );
+			if( res <= 0 ) {
+				return false;
+			}
+			pos += res;
+			offset += res;
+			size -= res;
+		}
+		return true;
+#endif
+	}
+
+}  // namespace utils
+}  // namespace comm
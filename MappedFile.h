@@ -0,0 +1,68 @@
+/**
+*	File with memory-mapped views (POSIX mmap, Windows file mapping), storage of capture and spill logs
+*/
+#pragma once
+
+#include "MFTypes.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace comm {
+namespace utils {
+
+	/**
+	*	File and its mapped views, views stay mapped till UnmapAll() or destruction
+	*/
+	class MappedFile {
+	public:
+		/// offset of view is multiple of the granularity (64 KB on Windows)
+		static constexpr size_t MapAlign = 64 * 1024;
+		/// alignment of offset, size and memory of writes to file opened with direct I/O
+		static constexpr size_t DirectAlign = 4096;
+
+	protected:
+		struct View {
+			void* data;
+			size_t size;
+		};
+
+		/// file descriptor or HANDLE, -1 - not opened
+		intptr_t m_File{ -1 };
+		bool m_Writable{ false };
+		bool m_Direct{ false };
+		std::vector<View> m_Views;
+
+	public:
+		~MappedFile();
+
+		/// writable file is created or truncated; direct - writes bypass page cache (O_DIRECT) where it is supported
+		/// and coherent with mapped views, WriteAt() arguments should be aligned to DirectAlign then
+		/// @return nullptr - the file can not be opened
+		static std::unique_ptr<MappedFile> Open( const std::string& path, bool writable, bool direct = false );
+
+		uint64_t GetSize() const;
+
+		/// direct I/O is used by WriteAt()
+		bool IsDirect() const {
+			return m_Direct;
+		}
+
+		/// file is not truncated below mapped views on Windows
+		bool Resize( uint64_t size );
+
+		/// map part of the file, offset is multiple of MapAlign
+		/// @return nullptr - the part is not mapped
+		byte* Map( uint64_t offset, size_t size );
+
+		void UnmapAll();
+
+		bool WriteAt( uint64_t offset, const void* data, size_t size );
+
+	protected:
+		MappedFile() = default;
+	};
+
+}  // namespace utils
+}  // namespace comm
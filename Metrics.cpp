@@ -0,0 +1,342 @@
+#include "Metrics.h"
+#include "SocketUDP.h"
+#include "Log.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <mutex>
+
+namespace comm {
+namespace utils {
+	namespace metrics {
+
+		namespace {
+			/**
+			*	Registered sources, the lock is held while they are collected
+			*/
+			struct Registry {
+				std::mutex lock;
+				uint64_t next_id{ 1 };
+				std::map<uint64_t, Collector> collectors;
+
+				static Registry& Instance() {
+					static Registry registry;
+					return registry;
+				}
+			};
+
+			void AppendEscaped( std::string& out, const std::string& value ) {
+				for( char c : value ) {
+					if( c == '"' || c == '\\' ) {
+						out += '\\';
+						out += c;
+					} else if( c == '\n' ) {
+						out += "\\n";
+					} else {
+						out += c;
+					}
+				}
+			}
+
+			std::string FormatDouble( double value ) {
+				if( std::isinf( value ) ) {
+					return value > 0 ? "+Inf" : "-Inf";
+				}
+				char buf[ 32 ];
+				std::snprintf( buf, sizeof( buf ), "%.9g", value );
+				return buf;
+			}
+
+			std::string FormatUInt( uint64_t value ) {
+				return std::to_string( value );
+			}
+
+#if defined( MSG_NOSIGNAL )
+			constexpr int SendFlags = MSG_NOSIGNAL;
+#else
+			constexpr int SendFlags = 0;
+#endif
+
+			bool WaitReadable( net::basesocket socket, int timeout_ms ) {
+				FD_SET fds;
+				FD_ZERO( &fds );
+				FD_SET( socket, &fds );
+				timeval timeout = { timeout_ms / 1000, ( timeout_ms % 1000 ) * 1000 };
+				return ::select( static_cast<int>( socket + 1 ), &fds, nullptr, nullptr, &timeout ) > 0;
+			}
+		}  // namespace
+
+		const char* const ContentType = "application/openmetrics-text; version=1.0.0; charset=utf-8";
+
+		/***************************************************************************
+		*	                         Writer
+		***************************************************************************/
+
+		void Writer::Counter( const std::string& name, const char* help, const Labels& labels, uint64_t value ) {
+			Family& family = GetFamily( name, "counter", help );
+			AppendSample( family.samples, name + "_total", labels, nullptr, std::string(), FormatUInt( value ) );
+		}
+
+		void Writer::Gauge( const std::string& name, const char* help, const Labels& labels, double value ) {
+			Family& family = GetFamily( name, "gauge", help );
+			AppendSample( family.samples, name, labels, nullptr, std::string(), FormatDouble( value ) );
+		}
+
+		void Writer::Histogram( const std::string& name, const char* help, const Labels& labels,
+								const trace::Histogram& histogram ) {
+			Family& family = GetFamily( name, "histogram", help );
+			// count is read first, so buckets (updated before count) are not below it
+			uint64_t count = histogram.Count();
+			for( double bound : HistogramBounds ) {
+				uint64_t below = histogram.CountBelow( static_cast<int64_t>( bound * 1e9 ) );
+				AppendSample( family.samples, name + "_bucket", labels, "le", FormatDouble( bound ),
+							  FormatUInt( std::min( below, count ) ) );
+			}
+			AppendSample( family.samples, name + "_bucket", labels, "le", "+Inf", FormatUInt( count ) );
+			AppendSample( family.samples, name + "_count", labels, nullptr, std::string(), FormatUInt( count ) );
+			AppendSample( family.samples, name + "_sum", labels, nullptr, std::string(),
+						  FormatDouble( histogram.Sum() / 1e9 ) );
+		}
+
+		std::string Writer::Text() const {
+			std::string out;
+			for( const auto& el : m_Families ) {
+				out += "# TYPE " + el.first + " " + el.second.type + "\n";
+				out += "# HELP " + el.first + " " + el.second.help + "\n";
+				out += el.second.samples;
+			}
+			out += "# EOF\n";
+			return out;
+		}
+
+		Writer::Family& Writer::GetFamily( const std::string& name, const char* type, const char* help ) {
+			Family& family = m_Families[ name ];
+			if( family.type.empty() ) {
+				family.type = type;
+				family.help = help;
+			}
+			return family;
+		}
+
+		void Writer::AppendSample( std::string& out, const std::string& name, const Labels& labels,
+								   const char* extra_key, const std::string& extra_value, const std::string& value ) {
+			out += name;
+			if( !labels.empty() || extra_key != nullptr ) {
+				out += '{';
+				bool first = true;
+				auto add = [&]( const std::string& key, const std::string& label ) {
+					out += first ? "" : ",";
+					out += key + "=\"";
+					AppendEscaped( out, label );
+					out += '"';
+					first = false;
+				};
+				for( const auto& label : labels ) {
+					add( label.first, label.second );
+				}
+				if( extra_key != nullptr ) {
+					add( extra_key, extra_value );
+				}
+				out += '}';
+			}
+			out += ' ';
+			out += value;
+			out += '\n';
+		}
+
+		/***************************************************************************
+		*	                         Registry
+		***************************************************************************/
+
+		uint64_t Register( Collector collector ) {
+			Registry& registry = Registry::Instance();
+			std::unique_lock lock( registry.lock );
+			uint64_t id = registry.next_id++;
+			registry.collectors[ id ] = std::move( collector );
+			return id;
+		}
+
+		void Unregister( uint64_t id ) {
+			Registry& registry = Registry::Instance();
+			std::unique_lock lock( registry.lock );
+			registry.collectors.erase( id );
+		}
+
+		std::string Collect() {
+			Writer writer;
+			{
+				Registry& registry = Registry::Instance();
+				std::unique_lock lock( registry.lock );
+				for( const auto& el : registry.collectors ) {
+					el.second( writer );
+				}
+			}
+			for( size_t i = 0; i < trace::StagesCount; i++ ) {
+				auto stage = static_cast<trace::Stage>( i );
+				writer.Histogram( "mfpipe_trace_stage_seconds", "Time of traced messages in hot path stages",
+								  { { "stage", trace::StageName( stage ) } }, trace::GetHistogram( stage ) );
+			}
+			return writer.Text();
+		}
+
+		/***************************************************************************
+		*	                         Exporter
+		***************************************************************************/
+
+		Exporter::~Exporter() {
+			Stop();
+		}
+
+		Error Exporter::StartHttp( uint16_t port ) {
+			if( m_Running ) {
+				return Error::Fatal;
+			}
+			net::basesocket socket = ::socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+			if( socket == INVALID_SOCKET ) {
+				return Error::Fatal;
+			}
+			int reuse = 1;
+			::setsockopt( socket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>( &reuse ), sizeof( reuse ) );
+
+			::sockaddr_in addrin;
+			std::memset( &addrin, 0, sizeof( addrin ) );
+			addrin.sin_family = AF_INET;
+			addrin.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+			addrin.sin_port = htons( port );
+			if( ::bind( socket, reinterpret_cast<const ::sockaddr*>( &addrin ), sizeof( addrin ) ) == SOCKET_ERROR ||
+				::listen( socket, 8 ) == SOCKET_ERROR ) {
+				MFPIPE_LOG( Warning, "metrics endpoint bind failed", { "port", port },
+							{ "error", ::WSAGetLastError() } );
+				::closesocket( socket );
+				return Error::InvalidSettings;
+			}
+
+			m_Socket = static_cast<intptr_t>( socket );
+			m_Running = true;
+			m_Thread = std::thread( [this]() { HttpWork(); } );
+			return Error::Ok;
+		}
+
+		Error Exporter::StartFile( const std::string& path, int interval_ms ) {
+			if( m_Running || path.empty() || interval_ms <= 0 ) {
+				return Error::InvalidSettings;
+			}
+			m_Running = true;
+			m_Thread = std::thread( [this, path, interval_ms]() {
+				auto next = std::chrono::steady_clock::now();
+				while( m_Running ) {
+					if( std::chrono::steady_clock::now() >= next ) {
+						if( !WriteFile( path ) ) {
+							MFPIPE_LOG( Warning, "metrics file write failed", { "path", path } );
+						}
+						next += std::chrono::milliseconds( interval_ms );
+					}
+					std::this_thread::sleep_for( std::chrono::milliseconds( std::min( interval_ms, 100 ) ) );
+				}
+				// final values
+				WriteFile( path );
+			} );
+			return Error::Ok;
+		}
+
+		uint16_t Exporter::GetPort() const {
+			if( m_Socket == -1 ) {
+				return 0;
+			}
+			::sockaddr_in addrin;
+			net::socklen_t len = sizeof( addrin );
+			if( ::getsockname( static_cast<net::basesocket>( m_Socket ), reinterpret_cast<::sockaddr*>( &addrin ),
+							   &len ) == SOCKET_ERROR ) {
+				return 0;
+			}
+			return ntohs( addrin.sin_port );
+		}
+
+		void Exporter::Stop() {
+			m_Running = false;
+			if( m_Thread.joinable() ) {
+				m_Thread.join();
+			}
+			if( m_Socket != -1 ) {
+				::closesocket( static_cast<net::basesocket>( m_Socket ) );
+				m_Socket = -1;
+			}
+		}
+
+		bool Exporter::WriteFile( const std::string& path ) {
+			std::string text = Collect();
+			std::string tmp = path + ".tmp";
+			FILE* file = std::fopen( tmp.c_str(), "wb" );
+			if( file == nullptr ) {
+				return false;
+			}
+			bool res = std::fwrite( text.data(), 1, text.size(), file ) == text.size();
+			res &= std::fclose( file ) == 0;
+#if defined( WIN32 )
+			std::remove( path.c_str() );
+#endif
+			return res && std::rename( tmp.c_str(), path.c_str() ) == 0;
+		}
+
+		void Exporter::HttpWork() {
+			net::basesocket socket = static_cast<net::basesocket>( m_Socket );
+			while( m_Running ) {
+				if( !WaitReadable( socket, 100 ) ) {
+					continue;
+				}
+				net::basesocket client = ::accept( socket, nullptr, nullptr );
+				if( client == INVALID_SOCKET ) {
+					continue;
+				}
+				ServeClient( static_cast<intptr_t>( client ) );
+				::closesocket( client );
+			}
+		}
+
+		void Exporter::ServeClient( intptr_t client_socket ) {
+			net::basesocket client = static_cast<net::basesocket>( client_socket );
+
+			// request line and headers, the body is not expected
+			std::string request;
+			char buf[ 1024 ];
+			while( request.find( "\r\n\r\n" ) == std::string::npos && request.size() < 8192 ) {
+				if( !WaitReadable( client, 1000 ) ) {
+					return;
+				}
+				int res = ::recv( client, buf, sizeof( buf ), 0 );
+				if( res <= 0 ) {
+					return;
+				}
+				request.append( buf, res );
+			}
+
+			std::string status = "200 OK";
+			std::string body;
+			size_t path_end = request.find( ' ', 4 );
+			std::string path = request.compare( 0, 4, "GET " ) == 0 && path_end != std::string::npos
+								   ? request.substr( 4, path_end - 4 )
+								   : std::string();
+			if( request.compare( 0, 4, "GET " ) != 0 ) {
+				status = "405 Method Not Allowed";
+			} else if( path != "/" && path.compare( 0, 8, "/metrics" ) != 0 ) {
+				status = "404 Not Found";
+			} else {
+				body = Collect();
+			}
+
+			std::string response = "HTTP/1.1 " + status + "\r\nContent-Type: " + ContentType +
+								   "\r\nContent-Length: " + std::to_string( body.size() ) +
+								   "\r\nConnection: close\r\n\r\n" + body;
+			size_t sent = 0;
+			while( sent < response.size() ) {
+				int res = ::send( client, response.data() + sent, static_cast<int>( response.size() - sent ), SendFlags );
+				if( res <= 0 ) {
+					return;
+				}
+				sent += res;
+			}
+		}
+
+	}  // namespace metrics
+}  // namespace utils
+}  // namespace comm
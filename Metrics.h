@@ -0,0 +1,116 @@
+/**
+*	Metrics in OpenMetrics text format (Prometheus):
+*	- sources (e.g. pipes) register collectors, collector writes current values of its counters, gauges and
+*	  histograms to Writer; collectors should read atomics only, so collection never blocks the data path
+*	- Collect() renders all sources and the stage histograms of utils::trace
+*	- Exporter serves Collect() on local HTTP port (GET /metrics) or writes it to a file periodically (the file is
+*	  replaced atomically, e.g. for node_exporter textfile collector)
+*/
+#pragma once
+
+#include "MFTypes.h"
+#include "Trace.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace comm {
+namespace utils {
+	namespace metrics {
+
+		using Labels = std::vector<std::pair<std::string, std::string>>;
+
+		/// upper bounds of histogram buckets in seconds (+Inf is added)
+		constexpr double HistogramBounds[] = { 1e-6, 1e-5, 1e-4, 2.5e-4, 5e-4, 1e-3, 2.5e-3, 5e-3,
+											   1e-2, 2.5e-2, 5e-2, 0.1, 0.25, 0.5, 1.0, 5.0 };
+
+		/**
+		*	Builder of OpenMetrics text, samples of one metric family are grouped together regardless of order of calls
+		*/
+		class Writer {
+		protected:
+			struct Family {
+				std::string type;
+				std::string help;
+				std::string samples;
+			};
+			std::map<std::string, Family> m_Families;
+
+		public:
+			/// monotonic counter, sample is written as name_total
+			void Counter( const std::string& name, const char* help, const Labels& labels, uint64_t value );
+
+			void Gauge( const std::string& name, const char* help, const Labels& labels, double value );
+
+			/// histogram of ns values, buckets are in seconds (bucket bound precision is precision of the histogram)
+			void Histogram( const std::string& name, const char* help, const Labels& labels,
+							const trace::Histogram& histogram );
+
+			/// rendered text terminated by "# EOF"
+			std::string Text() const;
+
+		protected:
+			Family& GetFamily( const std::string& name, const char* type, const char* help );
+			static void AppendSample( std::string& out, const std::string& name, const Labels& labels,
+									  const char* extra_key, const std::string& extra_value, const std::string& value );
+		};
+
+		using Collector = std::function<void( Writer& )>;
+
+		/// register metrics source
+		/// @return id for Unregister()
+		uint64_t Register( Collector collector );
+
+		/// remove metrics source, collection in progress is finished before return
+		void Unregister( uint64_t id );
+
+		/// OpenMetrics text of all sources
+		std::string Collect();
+
+		/// content type of OpenMetrics text
+		extern const char* const ContentType;
+
+		/**
+		*	Background exporter of Collect(): HTTP endpoint or file
+		*/
+		class Exporter {
+		public:
+			using Ptr = std::unique_ptr<Exporter>;
+
+		protected:
+			std::atomic<bool> m_Running{ false };
+			std::thread m_Thread;
+			/// listening socket of HTTP endpoint, -1 - none
+			intptr_t m_Socket{ -1 };
+
+		public:
+			~Exporter();
+
+			/// serve GET /metrics on 127.0.0.1:port (0 - any free port, see GetPort())
+			Error StartHttp( uint16_t port );
+
+			/// write metrics to the file every interval_ms
+			Error StartFile( const std::string& path, int interval_ms );
+
+			/// local port of HTTP endpoint, 0 - not listening
+			uint16_t GetPort() const;
+
+			void Stop();
+
+			/// write Collect() to the file through temporary file
+			static bool WriteFile( const std::string& path );
+
+		protected:
+			void HttpWork();
+			void ServeClient( intptr_t client );
+		};
+
+	}  // namespace metrics
+}  // namespace utils
+}  // namespace comm
@@ -0,0 +1,191 @@
+#include "NetSimulator.h"
+#include "Log.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace comm {
+namespace net {
+
+	namespace {
+		/// "2%" -> 0.02, "0.02" -> 0.02
+		bool ParseProbability( const std::string& value, double& probability ) {
+			char* end = nullptr;
+			double v = std::strtod( value.c_str(), &end );
+			if( end == value.c_str() ) {
+				return false;
+			}
+			std::string suffix( end );
+			if( suffix == "%" ) {
+				v /= 100.0;
+			} else if( !suffix.empty() ) {
+				return false;
+			}
+			probability = v;
+			return v >= 0.0 && v <= 1.0;
+		}
+
+		/// "20ms", "500us", "1s", "20" (ms)
+		bool ParseTime( const std::string& value, std::chrono::microseconds& time ) {
+			char* end = nullptr;
+			double v = std::strtod( value.c_str(), &end );
+			if( end == value.c_str() || v < 0 ) {
+				return false;
+			}
+			std::string suffix( end );
+			double scale = 0;
+			if( suffix.empty() || suffix == "ms" ) {
+				scale = 1000.0;
+			} else if( suffix == "us" ) {
+				scale = 1.0;
+			} else if( suffix == "s" ) {
+				scale = 1000000.0;
+			} else {
+				return false;
+			}
+			time = std::chrono::microseconds( static_cast<int64_t>( v * scale ) );
+			return true;
+		}
+
+		/// "100mbit", "1gbit", "500kbit", "64000" (bit/sec)
+		bool ParseRate( const std::string& value, uint64_t& rate ) {
+			char* end = nullptr;
+			double v = std::strtod( value.c_str(), &end );
+			if( end == value.c_str() || v < 0 ) {
+				return false;
+			}
+			std::string suffix( end );
+			double scale = 0;
+			if( suffix.empty() || suffix == "bit" ) {
+				scale = 1.0;
+			} else if( suffix == "kbit" ) {
+				scale = 1e3;
+			} else if( suffix == "mbit" ) {
+				scale = 1e6;
+			} else if( suffix == "gbit" ) {
+				scale = 1e9;
+			} else {
+				return false;
+			}
+			rate = static_cast<uint64_t>( v * scale );
+			return true;
+		}
+	}  // namespace
+
+	bool NetSimSettings::Parse( const utils::Params& params, NetSimSettings& settings ) {
+		bool res = true;
+		if( params.Has( "loss" ) ) {
+			res &= ParseProbability( params.Get( "loss" ), settings.loss );
+		}
+		if( params.Has( "reorder" ) ) {
+			res &= ParseProbability( params.Get( "reorder" ), settings.reorder );
+		}
+		if( params.Has( "reorder_gap" ) ) {
+			res &= ParseTime( params.Get( "reorder_gap" ), settings.reorder_gap );
+		}
+		if( params.Has( "delay" ) ) {
+			res &= ParseTime( params.Get( "delay" ), settings.delay );
+		}
+		if( params.Has( "jitter" ) ) {
+			res &= ParseTime( params.Get( "jitter" ), settings.jitter );
+		}
+		if( params.Has( "rate" ) ) {
+			res &= ParseRate( params.Get( "rate" ), settings.rate );
+		}
+		int limit = params.GetInt( "limit", static_cast<int>( settings.limit ) );
+		res &= limit > 0;
+		settings.limit = static_cast<size_t>( limit );
+		settings.seed = std::strtoull( params.Get( "seed", "1" ).c_str(), nullptr, 10 );
+		return res;
+	}
+
+	NetSimulator::NetSimulator( const NetSimSettings& settings, basesocket socket )
+		: m_Settings( settings )
+		, m_Socket( socket )
+		, m_Random( settings.seed )
+		, m_LinkFree( Clock::now() ) {
+		m_Thread = std::thread( [this]() { SendingWork(); } );
+	}
+
+	NetSimulator::~NetSimulator() {
+		{
+			std::unique_lock lock( m_Lock );
+			m_Running = false;
+		}
+		m_Wake.notify_all();
+		m_Thread.join();
+	}
+
+	int NetSimulator::Send( const char* data, int len, const socket_addr& to ) {
+		std::uniform_real_distribution<double> chance( 0.0, 1.0 );
+
+		std::unique_lock lock( m_Lock );
+		// decisions are taken in order of datagrams, so they are the same for the same seed
+		bool lost = chance( m_Random ) < m_Settings.loss;
+		bool reordered = chance( m_Random ) < m_Settings.reorder;
+		int64_t jitter = m_Settings.jitter.count();
+		int64_t shift = jitter != 0 ? std::uniform_int_distribution<int64_t>( -jitter, jitter )( m_Random ) : 0;
+
+		if( lost ) {
+			m_Lost.fetch_add( 1, std::memory_order_relaxed );
+			return len;
+		}
+		if( m_Queue.size() >= m_Settings.limit ) {
+			// tail drop of full link queue
+			m_Overflow.fetch_add( 1, std::memory_order_relaxed );
+			return len;
+		}
+
+		// serialization of the datagram on the link
+		auto now = Clock::now();
+		auto departure = std::max( now, m_LinkFree );
+		if( m_Settings.rate != 0 ) {
+			departure += std::chrono::nanoseconds( static_cast<uint64_t>( len ) * 8 * 1000000000ull / m_Settings.rate );
+		}
+		m_LinkFree = departure;
+
+		auto delay = std::max<int64_t>( 0, m_Settings.delay.count() + shift );
+		if( reordered ) {
+			delay += m_Settings.reorder_gap.count();
+			m_Reordered.fetch_add( 1, std::memory_order_relaxed );
+		}
+
+		Datagram datagram;
+		datagram.due = departure + std::chrono::microseconds( delay );
+		datagram.seq = m_Seq++;
+		datagram.to = to;
+		datagram.data.assign( data, data + len );
+		bool first = m_Queue.empty() || datagram.due < m_Queue.top().due;
+		m_Queue.push( std::move( datagram ) );
+		if( first ) {
+			m_Wake.notify_one();
+		}
+		return len;
+	}
+
+	void NetSimulator::SendingWork() {
+		std::unique_lock lock( m_Lock );
+		while( m_Running ) {
+			if( m_Queue.empty() ) {
+				m_Wake.wait( lock );
+				continue;
+			}
+			auto due = m_Queue.top().due;
+			if( Clock::now() < due ) {
+				m_Wake.wait_until( lock, due );
+				continue;
+			}
+			Datagram datagram = std::move( const_cast<Datagram&>( m_Queue.top() ) );
+			m_Queue.pop();
+			lock.unlock();
+			int res = ::sendto( m_Socket, reinterpret_cast<const char*>( datagram.data.data() ),
+								static_cast<int>( datagram.data.size() ), 0, &datagram.to, sizeof( datagram.to ) );
+			if( res == -1 ) {
+				MFPIPE_LOG( Warning, "simulated sendto failed", { "error", ::WSAGetLastError() } );
+			}
+			lock.lock();
+		}
+	}
+
+}  // namespace net
+}  // namespace comm
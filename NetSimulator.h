@@ -0,0 +1,119 @@
+/**
+*	Network impairment simulator for "sim+udp://" transport: datagrams are passed through the simulator instead of
+*	sendto(), it drops, reorders, delays and shapes them like WAN link and sends them by own thread when they are due.
+*
+*	All random decisions are taken from PRNG seeded by "seed", so the same sequence of sent datagrams gets the same
+*	impairments in every run.
+*
+*	URI/hints parameters:
+*	- loss=P% - probability of datagram loss (e.g. 2% or 0.02)
+*	- reorder=P% - probability of datagram to be held for reorder_gap, later datagrams overtake it
+*	- reorder_gap=T - extra delay of reordered datagram (default 1ms)
+*	- delay=T - one-way delay, jitter=T - delay is uniformly distributed in [delay - jitter, delay + jitter]
+*	  (T is number with us, ms or s suffix, ms by default)
+*	- rate=R - link rate (e.g. 100mbit, 1gbit, 500kbit, bits/sec without suffix), 0 - unlimited
+*	- limit=N - max number of datagrams waiting for the link, excess ones are dropped (default 10000)
+*	- seed=N - seed of PRNG (default 1)
+*/
+#pragma once
+
+#include "SocketUDP.h"
+#include "URL.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace comm {
+namespace net {
+
+	struct NetSimSettings {
+		/// probability of loss, 0..1
+		double loss{ 0.0 };
+		/// probability of reorder, 0..1
+		double reorder{ 0.0 };
+		std::chrono::microseconds reorder_gap{ 1000 };
+		std::chrono::microseconds delay{ 0 };
+		std::chrono::microseconds jitter{ 0 };
+		/// bits per second, 0 - unlimited
+		uint64_t rate{ 0 };
+		size_t limit{ 10000 };
+		uint64_t seed{ 1 };
+
+		/// @return false - invalid value of parameter
+		static bool Parse( const utils::Params& params, NetSimSettings& settings );
+	};
+
+	/**
+	*	Impaired link of one socket, Send() may be called by several threads
+	*/
+	class NetSimulator {
+	public:
+		using Clock = std::chrono::steady_clock;
+
+	protected:
+		struct Datagram {
+			Clock::time_point due;
+			/// order of sending, datagrams due at the same time keep it
+			uint64_t seq;
+			socket_addr to;
+			std::vector<byte> data;
+
+			bool operator>( const Datagram& other ) const {
+				return due != other.due ? due > other.due : seq > other.seq;
+			}
+		};
+
+		NetSimSettings m_Settings;
+		basesocket m_Socket;
+
+		std::mutex m_Lock;
+		std::condition_variable m_Wake;
+		std::priority_queue<Datagram, std::vector<Datagram>, std::greater<Datagram>> m_Queue;
+		std::mt19937_64 m_Random;
+		uint64_t m_Seq{ 0 };
+		/// the link is busy with previous datagrams until the time point (rate)
+		Clock::time_point m_LinkFree;
+		bool m_Running{ true };
+		std::thread m_Thread;
+
+		std::atomic<uint64_t> m_Lost{ 0 };
+		std::atomic<uint64_t> m_Reordered{ 0 };
+		std::atomic<uint64_t> m_Overflow{ 0 };
+
+	public:
+		NetSimulator( const NetSimSettings& settings, basesocket socket );
+		~NetSimulator();
+
+		NetSimulator( const NetSimulator& ) = delete;
+		NetSimulator& operator=( const NetSimulator& ) = delete;
+
+		/// take datagram for sending, lost datagram is accepted as well
+		/// @return len - like sendto()
+		int Send( const char* data, int len, const socket_addr& to );
+
+		/// datagrams dropped by loss probability
+		uint64_t GetLost() const {
+			return m_Lost.load( std::memory_order_relaxed );
+		}
+
+		uint64_t GetReordered() const {
+			return m_Reordered.load( std::memory_order_relaxed );
+		}
+
+		/// datagrams dropped because of queue limit
+		uint64_t GetOverflow() const {
+			return m_Overflow.load( std::memory_order_relaxed );
+		}
+
+	protected:
+		void SendingWork();
+	};
+
+}  // namespace net
+}  // namespace comm
@@ -0,0 +1,92 @@
+#include "ReadyEvent.h"
+
+#if defined( WIN32 )
+#include <windows.h>
+#elif defined( __linux__ )
+#include <sys/eventfd.h>
+#include <unistd.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace comm {
+namespace utils {
+
+	ReadyEvent::~ReadyEvent() {
+#if defined( WIN32 )
+		::CloseHandle( reinterpret_cast<HANDLE>( m_Handle ) );
+#else
+		::close( static_cast<int>( m_Handle ) );
+		if( m_WriteHandle != -1 ) {
+			::close( static_cast<int>( m_WriteHandle ) );
+		}
+#endif
+	}
+
+	ReadyEvent::Ptr ReadyEvent::Create() {
+		Ptr event( new ReadyEvent() );
+#if defined( WIN32 )
+		HANDLE handle = ::CreateEventA( nullptr, TRUE, FALSE, nullptr );
+		if( handle == nullptr ) {
+			return nullptr;
+		}
+		event->m_Handle = reinterpret_cast<intptr_t>( handle );
+#elif defined( __linux__ )
+		int fd = ::eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC );
+		if( fd == -1 ) {
+			return nullptr;
+		}
+		event->m_Handle = fd;
+#else
+		int fds[ 2 ];
+		if( ::pipe( fds ) != 0 ) {
+			return nullptr;
+		}
+		for( int fd : fds ) {
+			::fcntl( fd, F_SETFL, ::fcntl( fd, F_GETFL ) | O_NONBLOCK );
+			::fcntl( fd, F_SETFD, FD_CLOEXEC );
+		}
+		event->m_Handle = fds[ 0 ];
+		event->m_WriteHandle = fds[ 1 ];
+#endif
+		return event;
+	}
+
+	void ReadyEvent::Signal() {
+		if( m_Signaled.exchange( true ) ) {
+			return;
+		}
+#if defined( WIN32 )
+		::SetEvent( reinterpret_cast<HANDLE>( m_Handle ) );
+#elif defined( __linux__ )
+		uint64_t value = 1;
+		ssize_t res = ::write( static_cast<int>( m_Handle ), &value, sizeof( value ) );
+		(void)res;
+#else
+		char value = 1;
+		ssize_t res = ::write( static_cast<int>( m_WriteHandle ), &value, sizeof( value ) );
+		(void)res;
+#endif
+	}
+
+	void ReadyEvent::Clear() {
+		// the descriptor is reset before the flag: Signal() in between does not write, but its state is seen by the
+		// caller after Clear(); Signal() after the flag is reset writes again. The descriptor is read even if the flag
+		// is not set, write of Signal() may come after previous Clear().
+#if defined( WIN32 )
+		::ResetEvent( reinterpret_cast<HANDLE>( m_Handle ) );
+#elif defined( __linux__ )
+		uint64_t value;
+		ssize_t res = ::read( static_cast<int>( m_Handle ), &value, sizeof( value ) );
+		(void)res;
+#else
+		char buf[ 64 ];
+		while( ::read( static_cast<int>( m_Handle ), buf, sizeof( buf ) ) > 0 ) {
+		}
+#endif
+		m_Signaled = false;
+	}
+
+}  // namespace utils
+}  // namespace comm
@@ -0,0 +1,54 @@
+/**
+*	Pollable readiness event (eventfd on Linux, non-blocking pipe on other POSIX systems, manual-reset event on
+*	Windows), so reactors of application (epoll, poll, WaitForMultipleObjects) wait for it with their descriptors
+*/
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace comm {
+namespace utils {
+
+	/**
+	*	Event is readable after Signal() till Clear(), repeated Signal() does not write to the descriptor
+	*/
+	class ReadyEvent {
+	public:
+		using Ptr = std::unique_ptr<ReadyEvent>;
+
+	protected:
+		/// eventfd, read end of pipe or HANDLE of event
+		intptr_t m_Handle{ -1 };
+		/// write end of pipe, -1 - eventfd or event
+		intptr_t m_WriteHandle{ -1 };
+		std::atomic<bool> m_Signaled{ false };
+
+	public:
+		~ReadyEvent();
+
+		/// @return nullptr - descriptor can not be created
+		static Ptr Create();
+
+		/// descriptor for poll/epoll (readable when signaled) or HANDLE for WaitForMultipleObjects on Windows,
+		/// it is owned by the event
+		intptr_t GetHandle() const {
+			return m_Handle;
+		}
+
+		void Signal();
+
+		/// reset the descriptor, it should be called before the state (e.g. received records) is checked
+		void Clear();
+
+		bool IsSignaled() const {
+			return m_Signaled.load();
+		}
+
+	protected:
+		ReadyEvent() = default;
+	};
+
+}  // namespace utils
+}  // namespace comm
@@ -1,7 +1,9 @@
 #include "SocketUDP.h"
 #include "URL.h"
+#if defined( WIN32 )
 #include <WS2tcpip.h>
 #define s6_addr16 s6_words
+#endif
 
 namespace comm {
 namespace net {
@@ -40,7 +42,7 @@ namespace net {
 				while( curr != NULL ) {
 					// NOTE: Just IPV4
 					::sockaddr_in addrin = *reinterpret_cast<const ::sockaddr_in*>( curr->ai_addr );
-					addrin.sin_port = port;
+					addrin.sin_port = htons( port );
 					result.emplace_back( new SocketAddress( addrin ) );
 					curr = curr->ai_next;
 				}
@@ -77,6 +79,76 @@ namespace net {
 		return Error::Fatal;
 	}
 
+	Error SocketUDP::SetReusePort( bool enable ) {
+		Error err = SetReuseAddress( enable );
+		if( err != Error::Ok ) {
+			return err;
+		}
+#if defined( SO_REUSEPORT )
+		int value = enable ? 1 : 0;
+		int res = ::setsockopt( m_Socket, SOL_SOCKET, SO_REUSEPORT, reinterpret_cast<const char*>( &value ),
+								sizeof( value ) );
+		return res != -1 ? Error::Ok : Error::Fatal;
+#else
+		// platform can not balance datagrams between sockets
+		return enable ? Error::NotImplemented : Error::Ok;
+#endif
+	}
+
+	Error SocketUDP::SetReuseAddress( bool enable ) {
+		int value = enable ? 1 : 0;
+		int res = ::setsockopt( m_Socket, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>( &value ),
+								sizeof( value ) );
+		return res != -1 ? Error::Ok : Error::Fatal;
+	}
+
+	Error SocketUDP::JoinGroup( const SocketAddress::Ptr& group, const std::string& iface ) {
+		::ip_mreq mreq;
+		std::memset( &mreq, 0, sizeof( mreq ) );
+		mreq.imr_multiaddr = reinterpret_cast<const ::sockaddr_in*>( &group->GetSockAddress() )->sin_addr;
+		mreq.imr_interface.s_addr = iface.empty() ? htonl( INADDR_ANY ) : ::inet_addr( iface.c_str() );
+		int res = ::setsockopt( m_Socket, IPPROTO_IP, IP_ADD_MEMBERSHIP, reinterpret_cast<const char*>( &mreq ),
+								sizeof( mreq ) );
+		return res != -1 ? Error::Ok : Error::Fatal;
+	}
+
+	Error SocketUDP::SetMulticastInterface( const std::string& iface ) {
+		::in_addr addr;
+		addr.s_addr = ::inet_addr( iface.c_str() );
+		if( addr.s_addr == INADDR_NONE ) {
+			return Error::InvalidSettings;
+		}
+		int res = ::setsockopt( m_Socket, IPPROTO_IP, IP_MULTICAST_IF, reinterpret_cast<const char*>( &addr ),
+								sizeof( addr ) );
+		return res != -1 ? Error::Ok : Error::Fatal;
+	}
+
+	Error SocketUDP::SetMulticastTTL( int ttl ) {
+		int res = ::setsockopt( m_Socket, IPPROTO_IP, IP_MULTICAST_TTL, reinterpret_cast<const char*>( &ttl ),
+								sizeof( ttl ) );
+		return res != -1 ? Error::Ok : Error::Fatal;
+	}
+
+	Error SocketUDP::SetMulticastLoop( bool enable ) {
+		int value = enable ? 1 : 0;
+		int res = ::setsockopt( m_Socket, IPPROTO_IP, IP_MULTICAST_LOOP, reinterpret_cast<const char*>( &value ),
+								sizeof( value ) );
+		return res != -1 ? Error::Ok : Error::Fatal;
+	}
+
+	bool SocketUDP::WaitReadable( int timeout_ms ) const {
+		FD_SET read_set;
+		FD_ZERO( &read_set );
+		FD_SET( m_Socket, &read_set );
+
+		struct timeval timeout;
+		timeout.tv_sec = timeout_ms / 1000;
+		timeout.tv_usec = ( timeout_ms % 1000 ) * 1000;
+
+		int res = ::select( static_cast<int>( m_Socket ) + 1, &read_set, nullptr, nullptr, &timeout );
+		return res > 0 && FD_ISSET( m_Socket, &read_set );
+	}
+
 	Error SocketUDP::ReceiveFrom() {
 		return Error::NotImplemented;
 	}
@@ -1,14 +1,46 @@
 #pragma once
 
 #include "MFTypes.h"
-#include <WinSock2.h>
 #include <memory>
+#include <vector>
+#include <cstring>
+
+#if defined( WIN32 )
+#include <WinSock2.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/select.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <errno.h>
+
+using SOCKET = int;
+using FD_SET = fd_set;
+
+#define INVALID_SOCKET ( -1 )
+#define SOCKET_ERROR ( -1 )
+
+inline int closesocket( SOCKET s ) {
+	return ::close( s );
+}
+
+inline int WSAGetLastError() {
+	return errno;
+}
+#endif
 
 namespace comm {
 namespace net {
 
 	using basesocket = SOCKET;
+#if defined( WIN32 )
 	using socklen_t = int;
+#else
+	using socklen_t = ::socklen_t;
+#endif
 	using socket_address_ipv4 = uint32_t;
 	using socket_addr = ::sockaddr;
 	using socket_port = uint16_t;
@@ -35,6 +67,29 @@ namespace net {
 			return m_Address;
 		}
 
+		/// IPv4 address and port packed to integer (to use as a key)
+		uint64_t GetKey() const {
+			return ToKey( m_Address );
+		}
+
+		static uint64_t ToKey( const socket_addr& addr ) {
+			const ::sockaddr_in* addrin = reinterpret_cast<const ::sockaddr_in*>( &addr );
+			return ( static_cast<uint64_t>( addrin->sin_addr.s_addr ) << 16 ) | addrin->sin_port;
+		}
+
+		/// address is IPv4 multicast group (224.0.0.0/4)
+		bool IsMulticast() const {
+			const ::sockaddr_in* addrin = reinterpret_cast<const ::sockaddr_in*>( &m_Address );
+			return ( ntohl( addrin->sin_addr.s_addr ) & 0xF0000000 ) == 0xE0000000;
+		}
+
+		/// the same port with wildcard IP address
+		SocketAddress::Ptr ToAnyAddress() const {
+			::sockaddr_in addrin = *reinterpret_cast<const ::sockaddr_in*>( &m_Address );
+			addrin.sin_addr.s_addr = htonl( INADDR_ANY );
+			return std::make_shared<SocketAddress>( addrin );
+		}
+
 	public:
 		/// parse string to list of addresses, zero items - means unable to parse or error
 		static std::vector<SocketAddress::Ptr> Parse( const std::string& address, socket_port port );
@@ -64,6 +119,27 @@ namespace net {
 
 		Error Bind( const SocketAddress::Ptr& local_addr );
 
+		/// allow several sockets to bind the same address, kernel balances datagrams between them by flow
+		Error SetReusePort( bool enable );
+
+		/// allow several sockets to bind the same address (multicast receivers on one host)
+		Error SetReuseAddress( bool enable );
+
+		/// join multicast group on interface (IPv4 address of interface, empty - default interface)
+		Error JoinGroup( const SocketAddress::Ptr& group, const std::string& iface );
+
+		/// set interface (IPv4 address) for outgoing multicast datagrams
+		Error SetMulticastInterface( const std::string& iface );
+
+		/// set TTL of outgoing multicast datagrams
+		Error SetMulticastTTL( int ttl );
+
+		/// enable/disable delivery of outgoing multicast datagrams to local receivers
+		Error SetMulticastLoop( bool enable );
+
+		/// wait until the socket becomes readable, false - timeout or error
+		bool WaitReadable( int timeout_ms ) const;
+
 		Error ReceiveFrom();
 
 		Error SendTo( const SocketAddress::Ptr& remote_addr, const byte* data, size_t len );
@@ -0,0 +1,191 @@
+#include "SpillQueue.h"
+#include "Log.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <new>
+
+namespace comm {
+namespace utils {
+
+	namespace {
+		size_t AlignUp( size_t size, size_t align ) {
+			return ( size + align - 1 ) / align * align;
+		}
+	}  // namespace
+
+	static_assert( SpillQueue::BlockSize % MappedFile::MapAlign == 0, "segments are mapped as a whole" );
+	static_assert( SpillQueue::BlockSize % MappedFile::DirectAlign == 0, "blocks are written by direct I/O" );
+
+	void SpillQueue::AlignedDelete::operator()( byte* data ) const {
+		::operator delete[]( data, std::align_val_t( MappedFile::DirectAlign ) );
+	}
+
+	SpillQueue::SpillQueue( const std::string& prefix, size_t segment_size, bool direct )
+		: m_Prefix( prefix )
+		, m_SegmentSize( segment_size )
+		, m_Direct( direct )
+		, m_Block( static_cast<byte*>( ::operator new[]( BlockSize, std::align_val_t( MappedFile::DirectAlign ) ) ) ) {}
+
+	SpillQueue::~SpillQueue() {
+		for( auto& el : m_Active ) {
+			Remove( std::move( el ) );
+		}
+		for( auto& el : m_Free ) {
+			Remove( std::move( el ) );
+		}
+	}
+
+	SpillQueue::Ptr SpillQueue::Create( const std::string& prefix, size_t segment_size, bool direct ) {
+		if( prefix.empty() || segment_size == 0 ) {
+			return nullptr;
+		}
+		return Ptr( new SpillQueue( prefix, AlignUp( segment_size, BlockSize ), direct ) );
+	}
+
+	bool SpillQueue::Push( const ConstNetBufferSeq& buffers, const SpillMeta& meta ) {
+		size_t size = 0;
+		for( const NetBufferRef* buffer : buffers ) {
+			size += buffer->size;
+		}
+
+		if( m_Active.empty() || m_BlockOffset + m_BlockUsed + size > m_Active.back()->size ) {
+			// the rest of written segment is not used
+			if( !m_Active.empty() && m_BlockUsed != 0 && !FlushBlock() ) {
+				return false;
+			}
+			if( !NextSegment( size ) ) {
+				return false;
+			}
+		}
+
+		const Segment& segment = *m_Active.back();
+		size_t offset = m_BlockOffset + m_BlockUsed;
+		size_t saved_offset = m_BlockOffset;
+		size_t saved_used = m_BlockUsed;
+		for( const NetBufferRef* buffer : buffers ) {
+			const byte* data = buffer->data;
+			size_t rest = buffer->size;
+			while( rest != 0 ) {
+				size_t len = std::min( rest, BlockSize - m_BlockUsed );
+				std::memcpy( m_Block.get() + m_BlockUsed, data, len );
+				m_BlockUsed += len;
+				data += len;
+				rest -= len;
+				if( m_BlockUsed == BlockSize ) {
+					if( !FlushBlock() ) {
+						// written blocks of previous records are taken back to staging block
+						if( m_BlockOffset != saved_offset ) {
+							std::memcpy( m_Block.get(), segment.data + saved_offset, saved_used );
+						}
+						m_BlockOffset = saved_offset;
+						m_BlockUsed = saved_used;
+						return false;
+					}
+					m_BlockOffset += BlockSize;
+					m_BlockUsed = 0;
+				}
+			}
+		}
+
+		m_Records.push_back( Location{ &segment, offset, size, meta } );
+		m_Bytes += size;
+		return true;
+	}
+
+	bool SpillQueue::Pop( std::vector<byte>& data, SpillMeta& meta ) {
+		if( m_Records.empty() ) {
+			return false;
+		}
+		const Location& location = m_Records.front();
+		data.resize( location.size );
+
+		// data below the staging block of written segment is in the file
+		size_t written = location.segment == m_Active.back().get() ? m_BlockOffset : location.segment->size;
+		size_t end = location.offset + location.size;
+		size_t from_file = location.offset < written ? std::min( end, written ) - location.offset : 0;
+		std::memcpy( data.data(), location.segment->data + location.offset, from_file );
+		if( from_file < location.size ) {
+			size_t pos = location.offset + from_file;
+			std::memcpy( data.data() + from_file, m_Block.get() + ( pos - m_BlockOffset ), location.size - from_file );
+		}
+		meta = location.meta;
+		m_Bytes -= location.size;
+		m_Records.pop_front();
+
+		if( m_Records.empty() ) {
+			// everything is consumed, the next record starts from recycled segment
+			while( !m_Active.empty() ) {
+				Recycle( std::move( m_Active.front() ) );
+				m_Active.pop_front();
+			}
+			m_BlockOffset = 0;
+			m_BlockUsed = 0;
+			return true;
+		}
+		while( m_Active.front().get() != m_Records.front().segment ) {
+			Recycle( std::move( m_Active.front() ) );
+			m_Active.pop_front();
+		}
+		return true;
+	}
+
+	bool SpillQueue::IsDirect() const {
+		return !m_Active.empty() && m_Active.back()->file->IsDirect();
+	}
+
+	bool SpillQueue::NextSegment( size_t size ) {
+		std::unique_ptr<Segment> segment;
+		if( size <= m_SegmentSize && !m_Free.empty() ) {
+			segment = std::move( m_Free.back() );
+			m_Free.pop_back();
+		} else {
+			segment.reset( new Segment() );
+			segment->path = m_Prefix + "-" + std::to_string( m_Files++ ) + ".spill";
+			segment->size = std::max( m_SegmentSize, AlignUp( size, BlockSize ) );
+			segment->file = MappedFile::Open( segment->path, true, m_Direct );
+			if( segment->file == nullptr ) {
+				MFPIPE_LOG( Warning, "spill segment is not created", { "path", segment->path } );
+				return false;
+			}
+			if( !segment->file->Resize( segment->size ) ||
+				( segment->data = segment->file->Map( 0, segment->size ) ) == nullptr ) {
+				MFPIPE_LOG( Warning, "spill segment is not mapped", { "path", segment->path },
+							{ "size", segment->size } );
+				Remove( std::move( segment ) );
+				return false;
+			}
+		}
+		m_Active.push_back( std::move( segment ) );
+		m_BlockOffset = 0;
+		m_BlockUsed = 0;
+		return true;
+	}
+
+	bool SpillQueue::FlushBlock() {
+		Segment& segment = *m_Active.back();
+		size_t len = segment.file->IsDirect() ? AlignUp( m_BlockUsed, MappedFile::DirectAlign ) : m_BlockUsed;
+		if( !segment.file->WriteAt( m_BlockOffset, m_Block.get(), len ) ) {
+			MFPIPE_LOG( Warning, "spill write failed", { "path", segment.path }, { "offset", m_BlockOffset } );
+			return false;
+		}
+		return true;
+	}
+
+	void SpillQueue::Recycle( std::unique_ptr<Segment> segment ) {
+		if( segment->size == m_SegmentSize && m_Free.size() < MaxFreeSegments ) {
+			m_Free.push_back( std::move( segment ) );
+		} else {
+			Remove( std::move( segment ) );
+		}
+	}
+
+	void SpillQueue::Remove( std::unique_ptr<Segment> segment ) {
+		std::string path = segment->path;
+		// the file is closed before removal (Windows)
+		segment.reset();
+		std::remove( path.c_str() );
+	}
+
+}  // namespace utils
+}  // namespace comm
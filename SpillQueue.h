@@ -0,0 +1,129 @@
+/**
+*	Disk-backed FIFO of received records for channels whose consumer falls behind ("spill" hints of MFPipeImpl):
+*	- records are appended sequentially to segment files through aligned staging block, every full block is written
+*	  by one large aligned write (O_DIRECT with "direct" where it is supported), so RAM does not grow with the backlog
+*	- records are read back in order from mapped segments, the tail which is not written yet is read from the block
+*	- consumed segments are recycled for next records, segment of a record larger than segment size is removed
+*	- files are removed with the queue, records do not survive the process
+*/
+#pragma once
+
+#include "MFTypes.h"
+#include "Transport.h"
+#include "MappedFile.h"
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace comm {
+namespace utils {
+
+	/// description of spilled record, it is kept in memory
+	struct SpillMeta {
+		SessionID session{ 0 };
+		MessageID msg_id{ 0 };
+		/// user value (e.g. record type)
+		uint32_t tag{ 0 };
+		/// user value (e.g. arrival time)
+		int64_t time{ 0 };
+	};
+
+	/**
+	*	FIFO of records in segment files, it is not thread safe
+	*/
+	class SpillQueue {
+	public:
+		using Ptr = std::unique_ptr<SpillQueue>;
+
+		/// size of staging block, segments are multiple of it
+		static constexpr size_t BlockSize = 1024 * 1024;
+		/// number of consumed segments kept for recycling
+		static constexpr size_t MaxFreeSegments = 2;
+
+	protected:
+		struct Segment {
+			std::unique_ptr<MappedFile> file;
+			std::string path;
+			const byte* data{ nullptr };
+			size_t size{ 0 };
+		};
+
+		struct Location {
+			const Segment* segment;
+			size_t offset;
+			size_t size;
+			SpillMeta meta;
+		};
+
+		struct AlignedDelete {
+			void operator()( byte* data ) const;
+		};
+
+		std::string m_Prefix;
+		size_t m_SegmentSize;
+		bool m_Direct;
+		/// number of created files, part of file name
+		size_t m_Files{ 0 };
+		/// segments with records in order of writing, the last one is written
+		std::deque<std::unique_ptr<Segment>> m_Active;
+		std::vector<std::unique_ptr<Segment>> m_Free;
+		std::deque<Location> m_Records;
+		uint64_t m_Bytes{ 0 };
+		/// staging block of written segment
+		std::unique_ptr<byte, AlignedDelete> m_Block;
+		/// offset of staging block in written segment, data below it is written to the file
+		size_t m_BlockOffset{ 0 };
+		size_t m_BlockUsed{ 0 };
+
+	public:
+		~SpillQueue();
+
+		/// files are named "<prefix>-N.spill", segment_size is rounded up to BlockSize
+		/// @return nullptr - invalid settings
+		static Ptr Create( const std::string& prefix, size_t segment_size, bool direct );
+
+		/// append record, data is copied
+		/// @return false - the record can not be written (the queue is not changed)
+		bool Push( const ConstNetBufferSeq& buffers, const SpillMeta& meta );
+
+		/// take the oldest record
+		/// @return false - the queue is empty
+		bool Pop( std::vector<byte>& data, SpillMeta& meta );
+
+		bool Empty() const {
+			return m_Records.empty();
+		}
+
+		size_t GetCount() const {
+			return m_Records.size();
+		}
+
+		/// bytes of queued records
+		uint64_t GetBytes() const {
+			return m_Bytes;
+		}
+
+		/// number of segment files (active and free)
+		size_t GetSegments() const {
+			return m_Active.size() + m_Free.size();
+		}
+
+		/// direct I/O is used for writes
+		bool IsDirect() const;
+
+	protected:
+		SpillQueue( const std::string& prefix, size_t segment_size, bool direct );
+
+		/// make recycled or new segment written
+		bool NextSegment( size_t size );
+		/// write staging block to the file, the block is padded to direct I/O alignment
+		bool FlushBlock();
+		/// consumed segment goes to free list or it is removed
+		void Recycle( std::unique_ptr<Segment> segment );
+		static void Remove( std::unique_ptr<Segment> segment );
+	};
+
+}  // namespace utils
+}  // namespace comm
@@ -0,0 +1,271 @@
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+
+namespace comm {
+namespace utils {
+	namespace trace {
+
+		namespace {
+			struct Event {
+				Stage stage;
+				int64_t begin;
+				int64_t end;
+				uint32_t msg_id;
+				std::string channel;
+			};
+
+			/**
+			*	Histograms of stages and the last MaxEvents events
+			*/
+			class Tracer {
+			public:
+				std::array<Histogram, StagesCount> histograms;
+
+				std::mutex lock;
+				std::deque<Event> events;
+
+				static Tracer& Instance() {
+					static Tracer tracer;
+					return tracer;
+				}
+			};
+
+			/// channel names are written as JSON strings
+			void AppendEscaped( std::string& out, const std::string& value ) {
+				for( char c : value ) {
+					if( c == '"' || c == '\\' ) {
+						out += '\\';
+						out += c;
+					} else if( static_cast<unsigned char>( c ) < 0x20 ) {
+						char buf[ 8 ];
+						std::snprintf( buf, sizeof( buf ), "\\u%04x", c );
+						out += buf;
+					} else {
+						out += c;
+					}
+				}
+			}
+		}  // namespace
+
+		const char* StageName( Stage stage ) {
+			switch( stage ) {
+			case Stage::Compose:
+				return "compose";
+			case Stage::Send:
+				return "send";
+			case Stage::Transfer:
+				return "transfer";
+			case Stage::Reassemble:
+				return "reassemble";
+			case Stage::Wait:
+				return "wait";
+			case Stage::Total:
+				return "total";
+			default:
+				return "unknown";
+			}
+		}
+
+		int64_t Now() {
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(
+					   std::chrono::system_clock::now().time_since_epoch() )
+				.count();
+		}
+
+		/***************************************************************************
+		*	                         Histogram
+		***************************************************************************/
+
+		Histogram::Histogram() {
+			Reset();
+		}
+
+		void Histogram::Record( int64_t value ) {
+			value = std::max<int64_t>( 0, value );
+			m_Buckets[ BucketIndex( value ) ].fetch_add( 1, std::memory_order_relaxed );
+			m_Count.fetch_add( 1, std::memory_order_relaxed );
+			m_Sum.fetch_add( static_cast<uint64_t>( value ), std::memory_order_relaxed );
+
+			int64_t min = m_Min.load( std::memory_order_relaxed );
+			while( value < min && !m_Min.compare_exchange_weak( min, value, std::memory_order_relaxed ) ) {
+			}
+			int64_t max = m_Max.load( std::memory_order_relaxed );
+			while( value > max && !m_Max.compare_exchange_weak( max, value, std::memory_order_relaxed ) ) {
+			}
+		}
+
+		void Histogram::Reset() {
+			for( auto& bucket : m_Buckets ) {
+				bucket.store( 0, std::memory_order_relaxed );
+			}
+			m_Count.store( 0, std::memory_order_relaxed );
+			m_Sum.store( 0, std::memory_order_relaxed );
+			m_Min.store( INT64_MAX, std::memory_order_relaxed );
+			m_Max.store( 0, std::memory_order_relaxed );
+		}
+
+		uint64_t Histogram::Count() const {
+			return m_Count.load( std::memory_order_relaxed );
+		}
+
+		int64_t Histogram::Min() const {
+			return Count() != 0 ? m_Min.load( std::memory_order_relaxed ) : 0;
+		}
+
+		int64_t Histogram::Max() const {
+			return m_Max.load( std::memory_order_relaxed );
+		}
+
+		int64_t Histogram::Sum() const {
+			return static_cast<int64_t>( m_Sum.load( std::memory_order_relaxed ) );
+		}
+
+		uint64_t Histogram::CountBelow( int64_t value ) const {
+			uint64_t count = 0;
+			for( size_t i = 0; i < BucketsCount && BucketUpper( i ) <= value; i++ ) {
+				count += m_Buckets[ i ].load( std::memory_order_relaxed );
+			}
+			return count;
+		}
+
+		double Histogram::Mean() const {
+			uint64_t count = Count();
+			return count != 0 ? static_cast<double>( m_Sum.load( std::memory_order_relaxed ) ) / count : 0.0;
+		}
+
+		int64_t Histogram::Percentile( double quantile ) const {
+			uint64_t count = Count();
+			if( count == 0 ) {
+				return 0;
+			}
+			quantile = std::min( 1.0, std::max( 0.0, quantile ) );
+			uint64_t rank = std::max<uint64_t>( 1, static_cast<uint64_t>( quantile * count + 0.5 ) );
+			uint64_t seen = 0;
+			for( size_t i = 0; i < BucketsCount; i++ ) {
+				seen += m_Buckets[ i ].load( std::memory_order_relaxed );
+				if( seen >= rank ) {
+					return std::min( BucketUpper( i ), Max() );
+				}
+			}
+			return Max();
+		}
+
+		size_t Histogram::BucketIndex( int64_t value ) {
+			uint64_t v = static_cast<uint64_t>( value );
+			if( v < SubCount ) {
+				return static_cast<size_t>( v );
+			}
+			int msb = 63;
+			while( ( v >> msb ) == 0 ) {
+				msb--;
+			}
+			int shift = msb - SubBits;
+			return ( shift + 1 ) * SubCount + static_cast<size_t>( ( v >> shift ) - SubCount );
+		}
+
+		int64_t Histogram::BucketUpper( size_t index ) {
+			if( index < SubCount ) {
+				return static_cast<int64_t>( index );
+			}
+			int shift = static_cast<int>( index / SubCount ) - 1;
+			uint64_t sub = index % SubCount + SubCount;
+			return static_cast<int64_t>( ( ( sub + 1 ) << shift ) - 1 );
+		}
+
+		/***************************************************************************
+		*	                         Recording and export
+		***************************************************************************/
+
+		void Record( Stage stage, int64_t begin, int64_t end, uint32_t msg_id, const std::string& channel ) {
+			Tracer& tracer = Tracer::Instance();
+			tracer.histograms[ static_cast<size_t>( stage ) ].Record( end - begin );
+
+			std::unique_lock lock( tracer.lock );
+			if( tracer.events.size() == MaxEvents ) {
+				tracer.events.pop_front();
+			}
+			tracer.events.push_back( { stage, begin, end, msg_id, channel } );
+		}
+
+		const Histogram& GetHistogram( Stage stage ) {
+			return Tracer::Instance().histograms[ static_cast<size_t>( stage ) ];
+		}
+
+		std::string ExportHistograms() {
+			std::string out = "{";
+			char buf[ 256 ];
+			for( size_t i = 0; i < StagesCount; i++ ) {
+				const Histogram& h = Tracer::Instance().histograms[ i ];
+				std::snprintf( buf, sizeof( buf ),
+							   "%s\"%s\": { \"count\": %llu, \"min\": %lld, \"mean\": %.0f, \"p50\": %lld, \"p90\": %lld, "
+							   "\"p99\": %lld, \"p999\": %lld, \"max\": %lld }",
+							   i == 0 ? " " : ", ", StageName( static_cast<Stage>( i ) ),
+							   static_cast<unsigned long long>( h.Count() ), static_cast<long long>( h.Min() ), h.Mean(),
+							   static_cast<long long>( h.Percentile( 0.5 ) ), static_cast<long long>( h.Percentile( 0.9 ) ),
+							   static_cast<long long>( h.Percentile( 0.99 ) ),
+							   static_cast<long long>( h.Percentile( 0.999 ) ), static_cast<long long>( h.Max() ) );
+				out += buf;
+			}
+			out += " }";
+			return out;
+		}
+
+		std::string ExportChromeTrace() {
+			std::deque<Event> events;
+			{
+				Tracer& tracer = Tracer::Instance();
+				std::unique_lock lock( tracer.lock );
+				events = tracer.events;
+			}
+
+			// complete events ("X") in us, one row (tid) per stage
+			std::string out = "{ \"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+			char buf[ 256 ];
+			for( size_t i = 0; i < StagesCount; i++ ) {
+				std::snprintf( buf, sizeof( buf ),
+							   "%s\n{ \"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, \"args\": "
+							   "{ \"name\": \"%s\" } }",
+							   i == 0 ? "" : ",", static_cast<int>( i ), StageName( static_cast<Stage>( i ) ) );
+				out += buf;
+			}
+			for( const auto& event : events ) {
+				std::snprintf( buf, sizeof( buf ),
+							   ",\n{ \"name\": \"%s\", \"cat\": \"mfpipe\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+							   "\"ts\": %.3f, \"dur\": %.3f, \"args\": { \"msg_id\": %u, \"channel\": \"",
+							   StageName( event.stage ), static_cast<int>( event.stage ), event.begin / 1000.0,
+							   std::max<int64_t>( 0, event.end - event.begin ) / 1000.0, event.msg_id );
+				out += buf;
+				AppendEscaped( out, event.channel );
+				out += "\" } }";
+			}
+			out += "\n] }\n";
+			return out;
+		}
+
+		bool WriteChromeTrace( const std::string& path ) {
+			std::string json = ExportChromeTrace();
+			FILE* file = std::fopen( path.c_str(), "wb" );
+			if( file == nullptr ) {
+				return false;
+			}
+			bool res = std::fwrite( json.data(), 1, json.size(), file ) == json.size();
+			res &= std::fclose( file ) == 0;
+			return res;
+		}
+
+		void Reset() {
+			Tracer& tracer = Tracer::Instance();
+			for( auto& h : tracer.histograms ) {
+				h.Reset();
+			}
+			std::unique_lock lock( tracer.lock );
+			tracer.events.clear();
+		}
+
+	}  // namespace trace
+}  // namespace utils
+}  // namespace comm
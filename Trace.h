@@ -0,0 +1,108 @@
+/**
+*	Per-message tracing of hot path: traced message carries stamps of sending side in its packets (see MsgTrace),
+*	every side records spans of stages it observes:
+*	- Compose - sending side: serialization of the object (PipePut start -> message is handed to sending queue)
+*	- Send - sending side: waiting in sending queue and sendto() of all packets (queued -> sending is reported)
+*	- Transfer - receiving side: sending queue and wire (queued -> the first packet is received)
+*	- Reassemble - receiving side: the first packet is received -> the message is reassembled
+*	- Wait - receiving side: the message is reassembled -> it is taken by PipeGet/PipeMessageGet
+*	- Total - receiving side: PipePut start -> PipeGet
+*
+*	Spans go to per-stage HDR-like histograms (log-linear buckets, ~1.5% precision, lock-free) and to a bounded
+*	list of events exported as Chrome trace-event JSON (chrome://tracing, Perfetto).
+*
+*	Stamps are wall clock ns, stages which compare stamps of different hosts need synchronized clocks.
+*/
+#pragma once
+
+#include <atomic>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace comm {
+namespace utils {
+	namespace trace {
+
+		enum class Stage : int {
+			Compose = 0,
+			Send,
+			Transfer,
+			Reassemble,
+			Wait,
+			Total,
+			Count,
+		};
+
+		constexpr size_t StagesCount = static_cast<size_t>( Stage::Count );
+
+		/// max number of kept events for Chrome trace, older ones are dropped
+		constexpr size_t MaxEvents = 65536;
+
+		const char* StageName( Stage stage );
+
+		/// wall clock ns since epoch
+		int64_t Now();
+
+		/**
+		*	Histogram of ns values: values below 2^SubBits are exact, every next power of 2 range is split into
+		*	2^SubBits buckets. Record() is lock-free, readers may see a histogram in the middle of update.
+		*/
+		class Histogram {
+		public:
+			static constexpr int SubBits = 6;
+			static constexpr size_t SubCount = size_t( 1 ) << SubBits;
+			static constexpr size_t BucketsCount = ( 64 - SubBits ) * SubCount;
+
+		protected:
+			std::array<std::atomic<uint64_t>, BucketsCount> m_Buckets;
+			std::atomic<uint64_t> m_Count{ 0 };
+			std::atomic<uint64_t> m_Sum{ 0 };
+			std::atomic<int64_t> m_Min{ INT64_MAX };
+			std::atomic<int64_t> m_Max{ 0 };
+
+		public:
+			Histogram();
+
+			/// negative values (e.g. clock skew between hosts) are recorded as 0
+			void Record( int64_t value );
+			void Reset();
+
+			uint64_t Count() const;
+			int64_t Min() const;
+			int64_t Max() const;
+			/// sum of recorded values
+			int64_t Sum() const;
+			double Mean() const;
+			/// number of values in buckets which are not above the value (cumulative bucket of the value)
+			uint64_t CountBelow( int64_t value ) const;
+			/// the highest value equivalent to value at the quantile (0..1), 0 - empty histogram
+			int64_t Percentile( double quantile ) const;
+
+			static size_t BucketIndex( int64_t value );
+			/// the highest value of bucket
+			static int64_t BucketUpper( size_t index );
+		};
+
+		/// record span of the stage of the message to histogram of the stage and to events list
+		void Record( Stage stage, int64_t begin, int64_t end, uint32_t msg_id, const std::string& channel );
+
+		const Histogram& GetHistogram( Stage stage );
+
+		/// histograms of all stages as JSON: { "compose": { "count": N, "min": ns, "mean": ns, "p50": ns, ... }, ... }
+		std::string ExportHistograms();
+
+		/// kept events as Chrome trace-event JSON
+		std::string ExportChromeTrace();
+
+		/// write ExportChromeTrace() to the file
+		/// @return false - the file is not written
+		bool WriteChromeTrace( const std::string& path );
+
+		/// clear histograms and events
+		void Reset();
+
+	}  // namespace trace
+}  // namespace utils
+}  // namespace comm
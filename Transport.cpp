@@ -6,7 +6,7 @@ namespace comm {
 
 ITransport::Ptr TransportFactory::CreateTransport( const std::string& proto ) {
 	utils::Uri uri = utils::Uri::Parse( proto );
-	if( uri.Protocol == "udp" ) {
+	if( uri.Protocol == "udp" || uri.Protocol == "sim+udp" ) {
 		return std::make_shared<transports::TransportUDP>();
 	}
 
@@ -7,6 +7,8 @@
 #include <memory>
 #include <functional>
 #include <vector>
+#include <string>
+#include <chrono>
 
 namespace comm {
 
@@ -20,11 +22,42 @@ struct NetBufferRef {
 
 using MessageID = uint32_t;
 
+/// id of session (remote peer) of transport
+using SessionID = uint32_t;
+
 // TODO: implement class to handle buffers seq with automated release buffers into packets store
 
 using NetBufferSeq = std::vector<NetBufferRef*>;
 using ConstNetBufferSeq = std::vector<const NetBufferRef*>;
 
+/**
+*	Sending class of message: messages of one class are sent in order of sending, classes share the link by
+*	strict priority and by weight among classes of the same priority
+*/
+struct MsgClass {
+	/// class name (e.g. channel), messages without class belong to class ""
+	std::string name;
+	/// packets of higher priority class go first
+	int priority{ 0 };
+	/// share of link among classes of the same priority
+	uint32_t weight{ 1 };
+};
+
+/**
+*	Stamps of traced message, wall clock ns since epoch (stamps of sending side are compared with stamps of receiving
+*	side, so clocks of hosts should be synchronized)
+*/
+struct MsgTrace {
+	/// sending side started to compose the message
+	int64_t origin{ 0 };
+	/// the message is handed to the sending queue
+	int64_t queued{ 0 };
+	/// the first packet is received
+	int64_t received{ 0 };
+	/// the message is reassembled
+	int64_t completed{ 0 };
+};
+
 /**
 *	Interface to received mesage
 */
@@ -37,8 +70,16 @@ public:
 	/// get mesage id
 	virtual MessageID GetMessageID() const = 0;
 
+	/// get id of session the message is received from
+	virtual SessionID GetSessionID() const = 0;
+
 	/// get message data as seq of network buffers
 	virtual ConstNetBufferSeq GetBuffers() const = 0;
+
+	/// stamps of the message if sending side traced it, nullptr - not traced
+	virtual const MsgTrace* GetTrace() const {
+		return nullptr;
+	}
 };
 
 /**
@@ -54,6 +95,23 @@ public:
 	/// Alloc new buffer for data
 	virtual NetBufferRef* AllocBuffer() = 0;
 
+	/// prepare buffers for size bytes of data in one step (optional), AllocBuffer() takes them first
+	virtual Error Reserve( size_t size ) {
+		return Error::Ok;
+	}
+
+	/// set sending class of the message (optional), it should be called before Send()
+	virtual void SetClass( const MsgClass& cls ) {}
+
+	/// set time after which the message is useless (optional), it should be called before AllocBuffer():
+	/// not sent packets of expired message are dropped and it is reported with Error::Expired, receiving side
+	/// drops it if it is not reassembled in time
+	virtual void SetDeadline( std::chrono::steady_clock::time_point deadline ) {}
+
+	/// carry trace stamps with the message (optional), it should be called before AllocBuffer()
+	/// @param origin - wall clock ns when composing is started, see MsgTrace
+	virtual void SetTrace( int64_t origin ) {}
+
 	/// specify how many data is written
 	virtual Error Write( NetBufferRef* buf, size_t len ) = 0;
 
@@ -64,6 +122,39 @@ public:
 	virtual void Close() = 0;
 };
 
+/**
+*	Counters of transport
+*/
+struct TransportStats {
+	/// messages which are not sent completely because of deadline
+	uint64_t sent_expired{ 0 };
+	/// incomplete received messages dropped because of deadline
+	uint64_t received_expired{ 0 };
+	/// incomplete received messages dropped by reassembly timeout
+	uint64_t received_timeout{ 0 };
+
+	uint64_t packets_sent{ 0 };
+	uint64_t bytes_sent{ 0 };
+	/// packets sent again on request of receiving side
+	uint64_t packets_retransmitted{ 0 };
+	uint64_t packets_received{ 0 };
+	uint64_t bytes_received{ 0 };
+	/// received packets dropped before reassembly (malformed, corrupted, duplicates)
+	uint64_t packets_dropped{ 0 };
+	/// lost packets recovered by forward error correction
+	uint64_t packets_recovered{ 0 };
+	/// reassembled messages
+	uint64_t messages_received{ 0 };
+
+	/// packets waiting in sending queues
+	uint64_t queued_packets{ 0 };
+	/// incomplete messages waiting for packets
+	uint64_t reassembling_messages{ 0 };
+	/// network buffers created by transport and free ones among them
+	uint64_t buffers_total{ 0 };
+	uint64_t buffers_free{ 0 };
+};
+
 /**
 *	Transport interface
 *
@@ -71,6 +162,7 @@ public:
 *	- Sending message:
 *		- msg = ComposeMsg() - return message for composing
 *		- serialize:
+*			- msg->Reserve( size ) - optional, size is known from EncodedSize()
 *			- buf = msg->AllocBuffer()
 *			- msg->Write( buf, size ) - tell how many data written to the buffer
 *		- msg->Send( false, handler ) - start sending message and specify notification handler
@@ -88,17 +180,38 @@ class ITransport {
 public:
 	using Ptr = std::shared_ptr<ITransport>;
 
+	virtual ~ITransport() = default;
+
 	enum EOpen { Listen, Connect };
 
 	/// prototype for notification handler
 	using OnReceiveMsg = std::function<void( ITransport*, const IMsgReceived::Ptr& )>;
 
+	/// prototype for notification about removed session (the peer said goodbye or was idle too long)
+	using OnSessionClosed = std::function<void( ITransport*, SessionID )>;
+
 public:
-	/// open transport
-	virtual Error Open( const std::string& uri, EOpen mode, OnReceiveMsg onmsg ) = 0;
+	/// set handler of removed sessions (optional), it should be called before Open()
+	virtual void SetOnSessionClosed( OnSessionClosed onclosed ) {}
+
+	/// open transport, hints - parameters in form "key1=value1&key2=value2", they override URI query parameters
+	virtual Error Open( const std::string& uri, const std::string& hints, EOpen mode, OnReceiveMsg onmsg ) = 0;
+
+	/// create compoing message, it is sent to all sessions
+	/// @param flow - ordering key (e.g. channel name), messages with the same key are sent in order through one flow
+	virtual IMsgCompose::Ptr ComposeMsg( const std::string& flow = std::string() ) = 0;
+
+	/// create compoing message for specified sessions, the message is serialized once for all of them
+	virtual IMsgCompose::Ptr ComposeMsg( const std::vector<SessionID>& sessions,
+										 const std::string& flow = std::string() ) = 0;
+
+	/// get ids of known sessions (peers)
+	virtual std::vector<SessionID> GetSessions() = 0;
 
-	/// create compoing message
-	virtual IMsgCompose::Ptr ComposeMsg() = 0;
+	/// get counters of all sessions, it does not block sending and receiving (e.g. for metrics exporter)
+	virtual TransportStats GetStats() {
+		return TransportStats();
+	}
 
 	/// close transport
 	virtual Error Close() = 0;
@@ -106,7 +219,7 @@ public:
 
 /**
 *	Transport factory - creates transport based on settings(proto)
-*	Limitation: 'udp' supported only
+*	Limitation: 'udp' and 'sim+udp' (UDP with simulated network impairments) supported only
 */
 class TransportFactory {
 public:
@@ -1,6 +1,9 @@
 #include "TransportUDP.h"
+#include "URL.h"
+#include "Log.h"
 #include <thread>
 #include <chrono>
+#include <random>
 #include <cassert>
 
 namespace comm {
@@ -12,32 +15,63 @@ namespace transports {
 	protected:
 		/// message id
 		MessageID m_MessageID;
+		/// session id for packet headers
+		SessionID m_SessionID;
 		/// reference to packets store
 		NetBuffersStore::Ptr m_BuffersStoreRef;
-		/// reference to sending queue (for output data)
-		SendingQueue::Ptr m_SendingQueue;
+		/// destination sessions (their sending queues get the same packets)
+		std::vector<Session::Ptr> m_Targets;
 		/// message data
 		std::list<NetBuffer> m_Data;
+		/// buffers prepared by Reserve()
+		std::list<NetBuffer> m_Reserved;
+		/// FEC settings
+		FECSettings m_FEC;
+		/// append checksum to packets
+		bool m_Checksum;
+		/// sending class
+		MsgClass m_Class;
+		/// the message is dropped after the time point
+		SendingQueue::Clock::time_point m_Deadline{ SendingQueue::Clock::time_point::max() };
+		/// trace stamps carried by packets, origin is 0 if the message is not traced
+		UDPTraceStamps m_Trace{};
 		/// next packet number
 		uint32_t m_Packet;
+		/// lock for sending reports
+		std::mutex m_ReportLock;
+		/// number of sessions which did not report yet
+		size_t m_Pending{ 0 };
+		/// combined status of sessions reports
+		Error m_Status{ Error::Ok };
 		/// onsent notification handler
 		FnOnSent m_OnSent;
 
 	public:
-		MsgComposeUDP( MessageID msg_id, const NetBuffersStore::Ptr& store, const SendingQueue::Ptr& queue )
+		MsgComposeUDP( MessageID msg_id, SessionID session_id, const NetBuffersStore::Ptr& store,
+					   std::vector<Session::Ptr>&& targets, const FECSettings& fec, bool checksum )
 			: m_MessageID( msg_id )
+			, m_SessionID( session_id )
 			, m_BuffersStoreRef( store )
-			, m_SendingQueue( queue )
+			, m_Targets( std::move( targets ) )
+			, m_FEC( fec )
+			, m_Checksum( checksum )
 			, m_Packet( 0 )
 		{
 			assert( m_BuffersStoreRef != nullptr );
-			assert( m_SendingQueue != nullptr );
+		}
+
+		~MsgComposeUDP() override {
+			// sending queues dropped their references (reports and repair window hold the message)
+			m_BuffersStoreRef->Release( m_Data );
+			m_BuffersStoreRef->Release( m_Reserved );
 		}
 
 		NetBufferRef* AllocBuffer() override {
 			assert( m_BuffersStoreRef != nullptr );
 
-			if( !m_BuffersStoreRef->Alloc( m_Data, 1500 ) ) {
+			if( !m_Reserved.empty() ) {
+				m_Data.splice( m_Data.end(), m_Reserved, m_Reserved.begin() );
+			} else if( !m_BuffersStoreRef->Alloc( m_Data, 1500 ) ) {
 				return nullptr;
 			}
 
@@ -46,19 +80,42 @@ namespace transports {
 
 			// fill header
 			UDPPacketHeader* ph = reinterpret_cast<UDPPacketHeader*>( net_buffer.buffer.data() );
-			if( m_Packet == 0 ) {
-				ph->flags = static_cast<byte>( UDPPacketFlag::First );
-			}
+			ph->flags = m_Packet == 0 ? static_cast<byte>( UDPPacketFlag::First ) : 0;
 			ph->msg_id = m_MessageID;
 			ph->packet = m_Packet++;
+			ph->session = m_SessionID;
 
 			// move payload pointer behind the packet header
 			net_buffer.ref.data = net_buffer.buffer.data() + sizeof( UDPPacketHeader );
-			net_buffer.ref.size = net_buffer.buffer.size() - sizeof( UDPPacketHeader );
+			net_buffer.ref.size = GetPayloadCapacity();
 
 			return &net_buffer.ref;
 		}
 
+		Error Reserve( size_t size ) override {
+			size_t capacity = GetPayloadCapacity();
+			size_t count = ( size + capacity - 1 ) / capacity;
+			if( count > m_Reserved.size() &&
+				!m_BuffersStoreRef->Alloc( m_Reserved, 1500, count - m_Reserved.size() ) ) {
+				return Error::Fatal;
+			}
+			return Error::Ok;
+		}
+
+		void SetClass( const MsgClass& cls ) override {
+			m_Class = cls;
+		}
+
+		void SetDeadline( std::chrono::steady_clock::time_point deadline ) override {
+			assert( m_Data.empty() && m_Reserved.empty() );
+			m_Deadline = deadline;
+		}
+
+		void SetTrace( int64_t origin ) override {
+			assert( m_Data.empty() && m_Reserved.empty() );
+			m_Trace.origin = origin;
+		}
+
 		Error Write( NetBufferRef* buf, size_t len ) override {
 			assert( buf != nullptr );
 			buf->size = len;
@@ -75,29 +132,195 @@ namespace transports {
 				return Error::Fatal;
 			}
 
-			m_OnSent = onsent;
+			{
+				std::unique_lock lock( m_ReportLock );
+				m_OnSent = onsent;
+			}
 
 			auto& net_buffer = m_Data.back();
 
 			UDPPacketHeader* ph = reinterpret_cast<UDPPacketHeader*>( net_buffer.buffer.data() );
 			ph->flags |= static_cast<byte>( UDPPacketFlag::Last );
 
+			if( m_FEC.parity != 0 && !AddParity() ) {
+				return Error::Fatal;
+			}
+
+			if( IsTraced() ) {
+				// serialization is done, the rest is sending queue
+				m_Trace.queued = utils::trace::Now();
+				utils::trace::Record( utils::trace::Stage::Compose, m_Trace.origin, m_Trace.queued, m_MessageID,
+									  m_Class.name );
+				for( auto& el : m_Data ) {
+					reinterpret_cast<UDPPacketHeader*>( el.GetBuffer() )->flags |=
+						static_cast<byte>( UDPPacketFlag::Trace );
+					ReceivingQueue::AddTrace( el, m_Trace );
+				}
+			}
+
+			if( HasDeadline() ) {
+				auto now = SendingQueue::Clock::now();
+				if( now >= m_Deadline ) {
+					OnSentReport( 0, Error::Expired );
+					return Error::Ok;
+				}
+				// receiving side counts lifetime from the first received packet
+				auto lifetime = std::chrono::duration_cast<std::chrono::milliseconds>( m_Deadline - now ).count();
+				uint32_t ms = static_cast<uint32_t>(
+					std::min<long long>( lifetime, std::numeric_limits<uint32_t>::max() - 1 ) );
+				for( auto& el : m_Data ) {
+					reinterpret_cast<UDPPacketHeader*>( el.GetBuffer() )->flags |=
+						static_cast<byte>( UDPPacketFlag::Deadline );
+					ReceivingQueue::AddDeadline( el, ms );
+				}
+			}
+
+			if( m_Checksum ) {
+				// set flag first, it is covered by checksum
+				for( auto& el : m_Data ) {
+					reinterpret_cast<UDPPacketHeader*>( el.GetBuffer() )->flags |=
+						static_cast<byte>( UDPPacketFlag::Checksum );
+					ReceivingQueue::AddChecksum( el );
+				}
+			}
+
+			if( m_Targets.empty() ) {
+				// nobody to send to
+				OnSentReport( 0, Error::Ok );
+				return Error::Ok;
+			}
+
+			m_Pending = m_Targets.size();
+
 			auto sthis = shared_from_this();
-			m_SendingQueue->Send( m_MessageID, m_Data, [sthis]( size_t sent_size, const Error& status ) {
-				sthis->OnSentReport( sent_size, status );
-			} );
+			auto report = [sthis]( size_t sent_size, const Error& status ) {
+				sthis->OnSessionSentReport( sent_size, status );
+			};
+			for( const auto& target : m_Targets ) {
+				if( target->sending_queue->Send( m_MessageID, m_Data, m_Class, report, m_Deadline ) ) {
+					target->shard->Schedule( target );
+				}
+			}
 
 			return Error::Ok;
 		}
 
 		void Close() override {
+			// sessions may report after the sender stopped waiting
+			std::unique_lock lock( m_ReportLock );
 			m_OnSent = nullptr;
 		}
 
+		/// payload size of data packet, parity packet carries payload with its size
+		size_t GetPayloadCapacity() const {
+			size_t capacity = 1500 - sizeof( UDPPacketHeader );
+			if( m_FEC.parity != 0 ) {
+				capacity -= sizeof( UDPParityHeader ) + sizeof( uint16_t );
+			}
+			if( m_Checksum ) {
+				capacity -= UDPChecksumSize;
+			}
+			if( HasDeadline() ) {
+				capacity -= UDPDeadlineSize;
+			}
+			if( IsTraced() ) {
+				capacity -= UDPTraceSize;
+			}
+			return capacity;
+		}
+
+		bool HasDeadline() const {
+			return m_Deadline != SendingQueue::Clock::time_point::max();
+		}
+
+		bool IsTraced() const {
+			return m_Trace.origin != 0;
+		}
+
+		/// append parity packets after data packets, every group of m_FEC.data packets gets m_FEC.parity ones
+		bool AddParity() {
+			std::vector<const NetBuffer*> data;
+			for( const auto& el : m_Data ) {
+				data.push_back( &el );
+			}
+
+			uint32_t total = static_cast<uint32_t>( data.size() );
+			for( uint32_t first = 0; first < total; first += m_FEC.data ) {
+				uint32_t count = std::min( m_FEC.data, total - first );
+				size_t max_size = 0;
+				for( uint32_t i = 0; i < count; i++ ) {
+					max_size = std::max( max_size, data[ first + i ]->ref.size );
+				}
+				size_t block = sizeof( uint16_t ) + max_size;
+
+				for( uint32_t index = 0; index < m_FEC.parity; index++ ) {
+					std::list<NetBuffer> parity;
+					// room for trace stamps, deadline and checksum
+					size_t size = sizeof( UDPPacketHeader ) + sizeof( UDPParityHeader ) + block + UDPTraceSize +
+								  UDPDeadlineSize + UDPChecksumSize;
+					if( !m_BuffersStoreRef->Alloc( parity, size ) ) {
+						return false;
+					}
+
+					auto& net_buffer = parity.back();
+					UDPPacketHeader* ph = reinterpret_cast<UDPPacketHeader*>( net_buffer.buffer.data() );
+					ph->flags = static_cast<byte>( UDPPacketFlag::Parity );
+					ph->msg_id = m_MessageID;
+					ph->packet = m_Packet++;
+					ph->session = m_SessionID;
+
+					net_buffer.ref.data = net_buffer.buffer.data() + sizeof( UDPPacketHeader );
+					net_buffer.ref.size = sizeof( UDPParityHeader ) + block;
+
+					UDPParityHeader* fh = reinterpret_cast<UDPParityHeader*>( net_buffer.ref.data );
+					fh->first = first;
+					fh->total = total;
+					fh->count = static_cast<uint16_t>( count );
+					fh->index = static_cast<uint8_t>( index );
+					fh->parity_count = static_cast<uint8_t>( m_FEC.parity );
+
+					byte* coded = net_buffer.ref.data + sizeof( UDPParityHeader );
+					std::memset( coded, 0, block );
+					for( uint32_t i = 0; i < count; i++ ) {
+						const NetBuffer* src = data[ first + i ];
+						byte coef = utils::fec::Coefficient( index, i );
+						uint16_t len = static_cast<uint16_t>( src->ref.size );
+						utils::fec::MulAdd( coded, reinterpret_cast<const byte*>( &len ), coef, sizeof( len ) );
+						utils::fec::MulAdd( coded + sizeof( len ), src->ref.data, coef, len );
+					}
+
+					m_Data.splice( m_Data.end(), parity );
+				}
+			}
+			return true;
+		}
+
+		/// report from one of destination sessions, the message is sent when all of them reported
+		void OnSessionSentReport( size_t sent_size, const Error& status ) {
+			std::unique_lock lock( m_ReportLock );
+			if( status != Error::Ok ) {
+				m_Status = status;
+			}
+			if( --m_Pending != 0 ) {
+				return;
+			}
+			Error result = m_Status;
+			lock.unlock();
+			OnSentReport( sent_size, result );
+		}
+
 		void OnSentReport( size_t sent_size, const Error& status ) {
-			//printf( "OnReport( %i, %i )\n", (int)sent_size, (int)status );
-			if( m_OnSent ) {
-				m_OnSent( status );
+			if( IsTraced() && status == Error::Ok ) {
+				utils::trace::Record( utils::trace::Stage::Send, m_Trace.queued, utils::trace::Now(), m_MessageID,
+									  m_Class.name );
+			}
+			FnOnSent onsent;
+			{
+				std::unique_lock lock( m_ReportLock );
+				onsent = m_OnSent;
+			}
+			if( onsent ) {
+				onsent( status );
 			}
 		}
 
@@ -116,14 +339,25 @@ namespace transports {
 		NetBuffersStore::Ptr m_BuffersStoreRef;
 		/// message id
 		MessageID m_MessageID;
+		/// session id
+		SessionID m_SessionID;
 		/// message data
 		std::list<NetBuffer> m_Data;
+		/// stamps of traced message
+		MsgTrace m_Trace;
+		bool m_Traced;
 
 	public:
-		MsgReceivedUDP( const NetBuffersStore::Ptr& store, MessageID msg_id, std::list<NetBuffer>& buffers )
+		MsgReceivedUDP( const NetBuffersStore::Ptr& store, MessageID msg_id, SessionID session_id,
+						std::list<NetBuffer>& buffers, const MsgTrace* trace )
 			: m_BuffersStoreRef( store )
-			, m_MessageID( msg_id ) {
+			, m_MessageID( msg_id )
+			, m_SessionID( session_id )
+			, m_Traced( trace != nullptr ) {
 			m_Data.splice( m_Data.end(), buffers );
+			if( trace != nullptr ) {
+				m_Trace = *trace;
+			}
 		}
 
 		~MsgReceivedUDP() override {
@@ -134,6 +368,10 @@ namespace transports {
 			return m_MessageID;
 		}
 
+		SessionID GetSessionID() const override {
+			return m_SessionID;
+		}
+
 		ConstNetBufferSeq GetBuffers() const override {
 			ConstNetBufferSeq result;
 			for( const auto& buf : m_Data ) {
@@ -141,6 +379,10 @@ namespace transports {
 			}
 			return result;
 		}
+
+		const MsgTrace* GetTrace() const override {
+			return m_Traced ? &m_Trace : nullptr;
+		}
 	};
 
 
@@ -148,165 +390,546 @@ namespace transports {
 	*	                         UDP transport methods
 	***************************************************************************/
 
-	Error TransportUDP::Open( const std::string& uri, EOpen mode, OnReceiveMsg onmsg ) {
+	Error TransportUDP::Open( const std::string& uri, const std::string& hints, EOpen mode, OnReceiveMsg onmsg ) {
 		std::vector<net::SocketAddress::Ptr> addresses = net::SocketAddress::Parse( uri, 30000 );
 		if( addresses.empty() ) {
 			return Error::InvalidSettings;
 		}
 
-		m_Socket = net::SocketUDP::Create();
-		if( m_Socket == nullptr ) {
-			return Error::Fatal;
+		utils::Params params = utils::Params::Parse( utils::Uri::Parse( uri ).QueryString );
+		params.Merge( utils::Params::Parse( hints ) );
+
+		int shards = params.GetInt( "shards", 1 );
+		if( shards < 1 ) {
+			return Error::InvalidSettings;
+		}
+
+		bool multicast = params.GetInt( "multicast", 0 ) != 0;
+		if( multicast && !addresses[ 0 ]->IsMulticast() ) {
+			return Error::InvalidSettings;
+		}
+		if( multicast && mode == EOpen::Listen ) {
+			// every socket joined to the group receives all datagrams
+			shards = 1;
+		}
+
+		int repair = params.GetInt( "repair", multicast ? 64 : 0 );
+		int nack = params.GetInt( "nack", multicast ? 20 : 0 );
+		int reassembly_timeout = params.GetInt( "reassembly_timeout", 1000 );
+		int session_timeout = params.GetInt( "session_timeout", 10000 );
+		if( repair < 0 || nack < 0 || reassembly_timeout <= 0 || session_timeout < 0 ) {
+			return Error::InvalidSettings;
+		}
+
+		int fec_n = params.GetInt( "fec_n", 0 );
+		int fec_k = params.GetInt( "fec_k", 0 );
+		if( fec_n < 0 || fec_k < 0 || ( fec_k != 0 && fec_n == 0 ) ||
+			static_cast<size_t>( fec_n + fec_k ) > utils::fec::MaxBlocks ) {
+			return Error::InvalidSettings;
+		}
+
+		m_Mode = mode;
+		m_RepairWindow = repair;
+		m_FEC.data = fec_k != 0 ? fec_n : 0;
+		m_FEC.parity = fec_k;
+		m_Checksum = params.GetInt( "crc", 0 ) != 0;
+		m_ReceivingSettings.timeout = std::chrono::milliseconds( reassembly_timeout );
+		m_ReceivingSettings.response_delay = std::chrono::milliseconds( nack );
+		m_SessionTimeout = std::chrono::milliseconds( session_timeout );
+
+		m_Simulated = utils::Uri::Parse( uri ).Protocol == "sim+udp";
+		if( m_Simulated && !net::NetSimSettings::Parse( params, m_SimSettings ) ) {
+			return Error::InvalidSettings;
 		}
 
+		net::SocketAddress::Ptr local_addr;
 		if( mode == EOpen::Listen ) {
-			Error err = m_Socket->Bind( addresses[ 0 ] );
-			if( err != Error::Ok ) {
-				return err;
-			}
-		} else if( mode == EOpen::Connect ) {
-			m_RemoteAddress = addresses[ 0 ];
+			local_addr = addresses[ 0 ];
 		}
 
-		m_BuffersStore = std::make_shared<NetBuffersStore>();
-		m_SendingQueue = std::make_shared<SendingQueue>();
+		for( int i = 0; i < shards; i++ ) {
+			Shard::Ptr shard =
+				multicast ? CreateMulticastShard( addresses[ 0 ], params ) : CreateShard( local_addr, shards > 1 );
+			if( shard == nullptr ) {
+				if( i == 0 ) {
+					Close();
+					return Error::Fatal;
+				}
+				// SO_REUSEPORT is not available, continue with created shards
+				break;
+			}
+			if( m_Simulated ) {
+				net::NetSimSettings settings = m_SimSettings;
+				settings.seed += i;
+				shard->simulator.reset( new net::NetSimulator( settings, shard->socket->GetSocket() ) );
+			}
+			m_Shards.push_back( shard );
+		}
 
-		auto fn_onreceive = &TransportUDP::OnReceive;
-		m_ReceivingQueue = std::make_shared<ReceivingQueue>(
-			[=]( MessageID msg_id, std::list<NetBuffer>& buffers ) { ( this->*fn_onreceive )( msg_id, buffers ); } );
+		if( mode == EOpen::Connect ) {
+			// every shard is a separate flow of the same session
+			SessionID session_id = 0;
+			std::random_device rd;
+			while( session_id == 0 ) {
+				session_id = rd();
+			}
+			for( auto& shard : m_Shards ) {
+				shard->connected = CreateSession( shard.get(), session_id, addresses[ 0 ] );
+				shard->keepalive = ReceivingQueue::Clock::now() + m_SessionTimeout / 4;
+			}
+		}
 
 		m_OnNewMessage = onmsg;
 
 		m_IsRunning = true;
-		m_NetworkThread = std::make_unique<std::thread>( &TransportUDP::NetworkWork, this );
+		for( auto& shard : m_Shards ) {
+			shard->sending_thread = std::make_unique<std::thread>( &TransportUDP::SendingWork, this, shard.get() );
+			shard->receiving_thread = std::make_unique<std::thread>( &TransportUDP::ReceivingWork, this, shard.get() );
+		}
 
 		return Error::Ok;
 	}
 
-	IMsgCompose::Ptr TransportUDP::ComposeMsg() {
-		assert( m_BuffersStore != nullptr );
-		assert( m_SendingQueue != nullptr );
-		return std::make_shared<MsgComposeUDP>( m_MessageID++, m_BuffersStore, m_SendingQueue );
+	IMsgCompose::Ptr TransportUDP::ComposeMsg( const std::string& flow ) {
+		return ComposeMsg( std::vector<SessionID>(), flow );
+	}
+
+	IMsgCompose::Ptr TransportUDP::ComposeMsg( const std::vector<SessionID>& sessions, const std::string& flow ) {
+		assert( !m_Shards.empty() );
+		MessageID msg_id = m_MessageID++ & UDPMessageIDMask;
+		// messages of one flow key go through one shard and one flow of every peer, so they keep their order
+		size_t key = std::hash<std::string>{}( flow );
+		const auto& shard = m_Shards[ key % m_Shards.size() ];
+
+		if( m_Mode == EOpen::Connect ) {
+			// message goes through the flow of its shard
+			return std::make_shared<MsgComposeUDP>( msg_id, shard->connected->id, shard->buffers_store,
+													std::vector<Session::Ptr>{ shard->connected }, m_FEC,
+													m_Checksum );
+		}
+
+		std::vector<Session::Ptr> targets;
+		std::unique_lock lock( m_SessionsLock );
+		auto add_target = [&]( SessionID id ) {
+			auto range = m_Sessions.equal_range( id );
+			size_t flows = std::distance( range.first, range.second );
+			if( flows != 0 ) {
+				// the peer receives the message through one of its flows
+				targets.push_back( std::next( range.first, key % flows )->second );
+			}
+		};
+		if( sessions.empty() ) {
+			for( auto it = m_Sessions.begin(); it != m_Sessions.end(); it = m_Sessions.upper_bound( it->first ) ) {
+				add_target( it->first );
+			}
+		} else {
+			for( SessionID id : sessions ) {
+				add_target( id );
+			}
+		}
+		lock.unlock();
+
+		return std::make_shared<MsgComposeUDP>( msg_id, 0, shard->buffers_store, std::move( targets ), m_FEC,
+												m_Checksum );
+	}
+
+	std::vector<SessionID> TransportUDP::GetSessions() {
+		std::vector<SessionID> result;
+		std::unique_lock lock( m_SessionsLock );
+		for( auto it = m_Sessions.begin(); it != m_Sessions.end(); it = m_Sessions.upper_bound( it->first ) ) {
+			result.push_back( it->first );
+		}
+		return result;
+	}
+
+	void TransportUDP::SetOnSessionClosed( OnSessionClosed onclosed ) {
+		m_OnSessionClosed = onclosed;
+	}
+
+	TransportStats TransportUDP::GetStats() {
+		TransportStats stats;
+		auto get = []( const auto& counter ) {
+			return static_cast<uint64_t>( std::max<int64_t>( 0, counter.load( std::memory_order_relaxed ) ) );
+		};
+		for( const auto& shard : m_Shards ) {
+			const UDPCounters& c = *shard->counters;
+			stats.sent_expired += get( c.sent_expired );
+			stats.received_expired += get( c.received_expired );
+			stats.received_timeout += get( c.received_timeout );
+			stats.packets_sent += get( c.packets_sent );
+			stats.bytes_sent += get( c.bytes_sent );
+			stats.packets_retransmitted += get( c.packets_retransmitted );
+			stats.packets_received += get( c.packets_received );
+			stats.bytes_received += get( c.bytes_received );
+			stats.packets_dropped += get( c.packets_dropped );
+			stats.packets_recovered += get( c.packets_recovered );
+			stats.messages_received += get( c.messages_received );
+			stats.queued_packets += get( c.queued_packets );
+			stats.reassembling_messages += get( c.reassembling );
+			stats.buffers_total += shard->buffers_store->GetTotal();
+			stats.buffers_free += shard->buffers_store->GetFree();
+		}
+		return stats;
 	}
 
 	Error TransportUDP::Close() {
 		m_IsRunning = false;
 
-		if( m_NetworkThread != nullptr ) {
-			if( m_NetworkThread->joinable() ) {
-				m_NetworkThread->join();
+		for( auto& shard : m_Shards ) {
+			for( auto thread : { shard->sending_thread.get(), shard->receiving_thread.get() } ) {
+				if( thread != nullptr && thread->joinable() ) {
+					thread->join();
+				}
 			}
-			m_NetworkThread = nullptr;
-		}
+			shard->sending_thread = nullptr;
+			shard->receiving_thread = nullptr;
+			if( shard->connected != nullptr && shard->socket != nullptr ) {
+				// listening side removes the session right away instead of waiting for session timeout
+				SendControl( shard->connected.get(), UDPControl::Goodbye );
+			}
+			// datagrams waiting in simulated link are dropped
+			shard->simulator = nullptr;
 
-		if( m_Socket != nullptr ) {
-			m_Socket->Close();
-			m_Socket = nullptr;
+			if( shard->socket != nullptr ) {
+				shard->socket->Close();
+				shard->socket = nullptr;
+			}
+
+			shard->sessions.clear();
+			shard->connected = nullptr;
+			shard->ready.clear();
 		}
-		
-		m_SendingQueue = nullptr;
-		m_BuffersStore = nullptr;
+
+		m_Shards.clear();
+
+		std::unique_lock lock( m_SessionsLock );
+		m_Sessions.clear();
 		return Error::Ok;
 	}
 
-	void TransportUDP::NetworkWork() {
+	Shard::Ptr TransportUDP::CreateShard( const net::SocketAddress::Ptr& local_addr, bool reuse_port ) {
+		auto shard = std::make_shared<Shard>();
+
+		shard->socket = net::SocketUDP::Create();
+		if( shard->socket == nullptr ) {
+			return nullptr;
+		}
+
+		if( local_addr != nullptr ) {
+			if( reuse_port && shard->socket->SetReusePort( true ) != Error::Ok ) {
+				shard->socket->Close();
+				return nullptr;
+			}
+			if( shard->socket->Bind( local_addr ) != Error::Ok ) {
+				shard->socket->Close();
+				return nullptr;
+			}
+		}
+
+		shard->buffers_store = std::make_shared<NetBuffersStore>();
+
+		return shard;
+	}
+
+	Shard::Ptr TransportUDP::CreateMulticastShard( const net::SocketAddress::Ptr& group, const utils::Params& params ) {
+		std::string iface = params.Get( "iface" );
+
+		Shard::Ptr shard;
+		Error err = Error::Ok;
+		if( m_Mode == EOpen::Listen ) {
+			// several receivers may share the group port on one host
+			shard = std::make_shared<Shard>();
+			shard->socket = net::SocketUDP::Create();
+			if( shard->socket == nullptr ) {
+				return nullptr;
+			}
+			err = shard->socket->SetReuseAddress( true );
+			if( err == Error::Ok ) {
+				err = shard->socket->Bind( group->ToAnyAddress() );
+			}
+			if( err == Error::Ok ) {
+				err = shard->socket->JoinGroup( group, iface );
+			}
+			shard->buffers_store = std::make_shared<NetBuffersStore>();
+		} else {
+			shard = CreateShard( nullptr, false );
+			if( shard == nullptr ) {
+				return nullptr;
+			}
+			err = shard->socket->SetMulticastTTL( params.GetInt( "ttl", 1 ) );
+			if( err == Error::Ok ) {
+				err = shard->socket->SetMulticastLoop( params.GetInt( "loop", 1 ) != 0 );
+			}
+			if( err == Error::Ok && !iface.empty() ) {
+				err = shard->socket->SetMulticastInterface( iface );
+			}
+		}
+
+		if( err != Error::Ok ) {
+			shard->socket->Close();
+			return nullptr;
+		}
+		return shard;
+	}
+
+	Session::Ptr TransportUDP::CreateSession( Shard* shard, SessionID id, const net::SocketAddress::Ptr& address ) {
+		auto session = std::make_shared<Session>();
+		session->id = id;
+		session->address = address;
+		session->shard = shard;
+		session->sending_queue = std::make_shared<SendingQueue>( m_RepairWindow, shard->counters );
+		session->active = ReceivingQueue::Clock::now();
+
+		auto fn_onreceive = &TransportUDP::OnReceive;
+		auto fn_onresponse = &TransportUDP::SendResponse;
+		Session* psession = session.get();
+		session->receiving_queue = std::make_shared<ReceivingQueue>(
+			shard->buffers_store,
+			[=]( MessageID msg_id, std::list<NetBuffer>& buffers, const MsgTrace* trace ) {
+				( this->*fn_onreceive )( psession, msg_id, buffers, trace );
+			},
+			[=]( MessageID msg_id, const std::vector<UDPPacketRange>& ranges ) {
+				( this->*fn_onresponse )( psession, msg_id, ranges );
+			},
+			m_ReceivingSettings, shard->counters );
+
+		return session;
+	}
+
+	Session::Ptr TransportUDP::FindSession( Shard* shard, SessionID id, const ::sockaddr& from ) {
+		if( m_Mode == EOpen::Connect ) {
+			return shard->connected;
+		}
+
+		Shard::SessionKey key{ id, net::SocketAddress::ToKey( from ) };
+		auto found = shard->sessions.find( key );
+		if( found != shard->sessions.end() ) {
+			return found->second;
+		}
+
+		// new peer
+		Session::Ptr session = CreateSession( shard, id, std::make_shared<net::SocketAddress>( from ) );
+		shard->sessions[ key ] = session;
+
+		std::unique_lock lock( m_SessionsLock );
+		m_Sessions.emplace( id, session );
+		return session;
+	}
+
+	void TransportUDP::SendingWork( Shard* shard ) {
 		using namespace std::chrono_literals;
 
-		FD_SET read_set;
-		FD_SET write_set;
-		FD_SET err_set;
+		while( m_IsRunning ) {
+			Session::Ptr session = shard->WaitReady( 100ms );
+			if( session == nullptr ) {
+				continue;
+			}
 
-		struct timeval timeout;
-		timeout.tv_sec = 0;
-		timeout.tv_usec = 100000;
+			// one packet per turn, sessions are served round-robin
+			bool reschedule = false;
+			const NetBuffer* net_buffer = session->sending_queue->GetNextBufferPacket( reschedule );
+			if( reschedule ) {
+				shard->Schedule( session );
+			}
+			if( net_buffer == nullptr ) {
+				continue;
+			}
 
-		while( m_IsRunning && m_Socket != nullptr ) {
-			FD_ZERO( &read_set );
-			FD_ZERO( &write_set );
-			FD_ZERO( &err_set );
+			Error err;
+			auto data = net_buffer->GetData();
+			int data_len = net_buffer->GetDataSize();
+			int res = shard->SendTo( data, data_len, session->address->GetSockAddress() );
+			MFPIPE_LOG( Trace, "sendto", { "transport", this }, { "size", data_len }, { "result", res } );
+			if( res != -1 ) {
+				err = Error::Ok;
+				UDPCounters::Add( shard->counters->packets_sent, 1 );
+				UDPCounters::Add( shard->counters->bytes_sent, static_cast<uint64_t>( res ) );
+			} else {
+				err = Error::SentError;
+				MFPIPE_LOG( Error, "sendto failed", { "transport", this }, { "error", ::WSAGetLastError() } );
+			}
+			session->sending_queue->SentReport( net_buffer, err );
+		}
+	}
 
-			net::basesocket socket = m_Socket->GetSocket();
-			FD_SET( socket, &read_set );
-			FD_SET( socket, &write_set );
-			FD_SET( socket, &err_set );
+	void TransportUDP::ReceivingWork( Shard* shard ) {
+		using namespace std::chrono_literals;
 
-			int res = ::select( 1, &read_set, &write_set, &err_set, &timeout );
-			if( !m_IsRunning ) {
-				// stop thread asap
-				break;
+		net::basesocket socket = shard->socket->GetSocket();
+
+		// responses need finer timer
+		auto check_period = m_ReceivingSettings.response_delay.count() != 0 ? 10ms : 100ms;
+		auto next_check = ReceivingQueue::Clock::now() + check_period;
+
+		while( m_IsRunning ) {
+			bool readable = shard->socket->WaitReadable( static_cast<int>( check_period.count() ) );
+
+			auto now = ReceivingQueue::Clock::now();
+			if( now >= next_check ) {
+				CheckTimeouts( shard );
+				next_check = now + check_period;
 			}
 
-			//printf( "%p::NetworkWork() - select()=%i\n", this, res );
-			if( res != SOCKET_ERROR ) {
-				if( FD_ISSET( socket, &err_set ) ) {
-					// TODO: handle it
-					printf( "%p::NetworkWork() - error set!\n", this );
-				}
+			if( !readable ) {
+				continue;
+			}
+
+			std::list<NetBuffer> read_list;
+			if( !shard->buffers_store->Alloc( read_list, m_MTUSize ) ) {
+				// TODO: handle it
+				MFPIPE_LOG( Warning, "unable allocate NetBuffer", { "transport", this } );
+				continue;
+			}
 
-				// TODO: refactor: split to functions
-				if( FD_ISSET( socket, &read_set ) ) {
-					std::list<NetBuffer> read_list;
-					if( m_BuffersStore->Alloc( read_list, m_MTUSize ) ) {
-						auto& buf = read_list.back();
-						// NOTE: IPV4 only
-						::sockaddr from;
-						int fromlen = sizeof( from );
-						res = ::recvfrom( socket, buf.GetBuffer(), buf.GetBufferSize(), 0, &from, &fromlen );
-						printf( "%p::NetworkWork() - recvfrom()=%i/%i\n", this, res, ::WSAGetLastError() );
-						if( res != -1 ) {
-							if( m_RemoteAddress == nullptr ) {
-								m_RemoteAddress = std::make_shared<net::SocketAddress>( from );
-							}
-
-							UDPPacketHeader* ph = reinterpret_cast<UDPPacketHeader*>( buf.GetBuffer() );
-							buf.ref.data = buf.buffer.data() + sizeof( UDPPacketHeader );
-							buf.ref.size = res - sizeof( UDPPacketHeader );
-
-							if( ( ph->flags & static_cast<byte>( UDPPacketFlag::Response ) ) != 0 ) {
-								// reponse
-								m_SendingQueue->ProcessResponse( ph->msg_id, read_list );
-							} else {
-								// payload
-								m_ReceivingQueue->ProcessBuffer( ph->msg_id, read_list );
-							}
-						} else {
-							// TODO: handle it
+			auto& buf = read_list.back();
+			// NOTE: IPV4 only
+			::sockaddr from;
+			net::socklen_t fromlen = sizeof( from );
+			int res = ::recvfrom( socket, buf.GetBuffer(), buf.GetBufferSize(), 0, &from, &fromlen );
+			MFPIPE_LOG( Trace, "recvfrom", { "transport", this }, { "result", res } );
+			if( res > 0 ) {
+				UDPCounters::Add( shard->counters->packets_received, 1 );
+				UDPCounters::Add( shard->counters->bytes_received, static_cast<uint64_t>( res ) );
+			}
+			if( res >= static_cast<int>( sizeof( UDPPacketHeader ) ) ) {
+				UDPPacketHeader* ph = reinterpret_cast<UDPPacketHeader*>( buf.GetBuffer() );
+				buf.ref.data = buf.buffer.data() + sizeof( UDPPacketHeader );
+				buf.ref.size = res - sizeof( UDPPacketHeader );
+
+				if( ( ph->flags & static_cast<byte>( UDPPacketFlag::Control ) ) != 0 ) {
+					// control packets of connecting side
+					if( m_Mode == EOpen::Listen && static_cast<UDPControl>( ph->packet ) == UDPControl::Goodbye ) {
+						auto found = shard->sessions.find( { ph->session, net::SocketAddress::ToKey( from ) } );
+						if( found != shard->sessions.end() ) {
+							CloseSession( shard, found );
 						}
-						m_BuffersStore->Release( read_list );
-					} else {
-						// TODO: handle it
-						printf( "%p::NetworkWork() - unable allocate NetBuffer!\n", this );
+					} else if( m_Mode == EOpen::Listen ) {
+						FindSession( shard, ph->session, from )->active = now;
 					}
+					shard->buffers_store->Release( read_list );
+					continue;
 				}
-				if( FD_ISSET( socket, &write_set ) && m_RemoteAddress != nullptr ) {
-					const NetBuffer* net_buffer = m_SendingQueue->GetNextBufferPacket();
-					if( net_buffer != nullptr ) {
-						Error err;
-						const auto addr = &m_RemoteAddress->GetSockAddress();
-						int addr_len = sizeof( sockaddr );
-						auto data = net_buffer->GetData();
-						int data_len = net_buffer->GetDataSize();
-						res = ::sendto( socket, data, data_len, 0, addr, addr_len );
-						printf( "%p::NetworkWork() - sendto()=%i/%i\n", this, res, ::WSAGetLastError() );
-						if( res != -1 ) {
-							err = Error::Ok;
-						} else {
-							err = Error::SentError;
-						}
-						auto ph = net_buffer->GetPacketHeader();
-						if( ( ph.flags & static_cast<byte>( UDPPacketFlag::Last ) ) != 0 ) {
-							m_SendingQueue->SentReport( ph.msg_id, err );
-							printf( "%p::NetworkWork() - SentReport( %u, %i )\n", this, ph.msg_id,
-									static_cast<int>( err ) );
-						}
+
+				Session::Ptr session = FindSession( shard, ph->session, from );
+				session->active = now;
+				if( ( ph->flags & static_cast<byte>( UDPPacketFlag::Response ) ) != 0 ) {
+					// reponse
+					if( session->sending_queue->ProcessResponse( ph->msg_id, read_list ) ) {
+						shard->Schedule( session );
 					}
+				} else {
+					// payload
+					session->receiving_queue->ProcessBuffer( ph->msg_id, read_list );
 				}
+			} else if( res > 0 ) {
+				// shorter than header
+				UDPCounters::Add( shard->counters->packets_dropped, 1 );
+			}
+			shard->buffers_store->Release( read_list );
+		}
+	}
+
+	void TransportUDP::CloseSession( Shard* shard, std::map<Shard::SessionKey, Session::Ptr>::iterator it ) {
+		Session::Ptr session = it->second;
+		shard->sessions.erase( it );
+
+		std::list<NetBuffer> released;
+		session->receiving_queue->Clear( released );
+		shard->buffers_store->Release( released );
+
+		// queued packets are still sent, the sending thread holds the session until its queue is empty
+		std::unique_lock lock( m_SessionsLock );
+		auto range = m_Sessions.equal_range( session->id );
+		for( auto el = range.first; el != range.second; ++el ) {
+			if( el->second == session ) {
+				m_Sessions.erase( el );
+				break;
+			}
+		}
+		bool last = m_Sessions.count( session->id ) == 0;
+		lock.unlock();
+
+		MFPIPE_LOG( Debug, "session closed", { "transport", this }, { "session", session->id }, { "last", last } );
+		if( last && m_OnSessionClosed ) {
+			m_OnSessionClosed( this, session->id );
+		}
+	}
+
+	void TransportUDP::SendControl( Session* session, UDPControl control ) {
+		std::list<NetBuffer> packet;
+		if( !session->shard->buffers_store->Alloc( packet, sizeof( UDPPacketHeader ) ) ) {
+			return;
+		}
+
+		auto& buf = packet.back();
+		UDPPacketHeader* ph = reinterpret_cast<UDPPacketHeader*>( buf.GetBuffer() );
+		ph->flags = static_cast<byte>( UDPPacketFlag::Control );
+		ph->msg_id = 0;
+		ph->packet = static_cast<uint32_t>( control );
+		ph->session = session->id;
+
+		int res = session->shard->SendTo( buf.GetBuffer(), static_cast<int>( sizeof( UDPPacketHeader ) ),
+										  session->address->GetSockAddress() );
+		if( res != -1 ) {
+			UDPCounters::Add( session->shard->counters->packets_sent, 1 );
+			UDPCounters::Add( session->shard->counters->bytes_sent, static_cast<uint64_t>( res ) );
+		}
+
+		session->shard->buffers_store->Release( packet );
+	}
+
+	void TransportUDP::SendResponse( Session* session, MessageID msg_id, const std::vector<UDPPacketRange>& ranges ) {
+		std::list<NetBuffer> response;
+		size_t size = sizeof( UDPPacketHeader ) + ranges.size() * sizeof( UDPPacketRange );
+		if( !session->shard->buffers_store->Alloc( response, size ) ) {
+			return;
+		}
+
+		auto& buf = response.back();
+		UDPPacketHeader* ph = reinterpret_cast<UDPPacketHeader*>( buf.GetBuffer() );
+		ph->flags = static_cast<byte>( UDPPacketFlag::Response );
+		ph->msg_id = msg_id;
+		ph->packet = 0;
+		ph->session = m_Mode == EOpen::Connect ? session->id : 0;
+		std::memcpy( buf.buffer.data() + sizeof( UDPPacketHeader ), ranges.data(), size - sizeof( UDPPacketHeader ) );
+
+		int res = session->shard->SendTo( buf.GetBuffer(), static_cast<int>( size ), session->address->GetSockAddress() );
+		MFPIPE_LOG( Trace, "SendResponse", { "transport", this }, { "msg_id", msg_id }, { "ranges", ranges.size() },
+					{ "result", res } );
+		if( res != -1 ) {
+			UDPCounters::Add( session->shard->counters->packets_sent, 1 );
+			UDPCounters::Add( session->shard->counters->bytes_sent, static_cast<uint64_t>( res ) );
+		}
+
+		session->shard->buffers_store->Release( response );
+	}
+
+	void TransportUDP::CheckTimeouts( Shard* shard ) {
+		auto now = ReceivingQueue::Clock::now();
+		std::list<NetBuffer> released;
+		if( shard->connected != nullptr ) {
+			shard->connected->receiving_queue->CheckTimeouts( now, released );
+			if( m_SessionTimeout.count() != 0 && now >= shard->keepalive ) {
+				SendControl( shard->connected.get(), UDPControl::Keepalive );
+				shard->keepalive = now + m_SessionTimeout / 4;
+			}
+		}
+		for( auto it = shard->sessions.begin(); it != shard->sessions.end(); ) {
+			it->second->receiving_queue->CheckTimeouts( now, released );
+			if( m_SessionTimeout.count() != 0 && now - it->second->active >= m_SessionTimeout ) {
+				// the peer is gone without goodbye
+				CloseSession( shard, it++ );
+			} else {
+				++it;
 			}
 		}
+		shard->buffers_store->Release( released );
 	}
 
-	void TransportUDP::OnReceive( MessageID msg_id, std::list<NetBuffer>& buffers ) {
-		MsgReceivedUDP::Ptr msg = std::make_shared<MsgReceivedUDP>( m_BuffersStore, msg_id, buffers );
+	void TransportUDP::OnReceive( Session* session, MessageID msg_id, std::list<NetBuffer>& buffers,
+								  const MsgTrace* trace ) {
+		MsgReceivedUDP::Ptr msg =
+			std::make_shared<MsgReceivedUDP>( session->shard->buffers_store, msg_id, session->id, buffers, trace );
 		if( m_OnNewMessage ) {
 			m_OnNewMessage( this, std::static_pointer_cast<IMsgReceived>( msg ) );
 		}
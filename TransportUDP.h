@@ -5,19 +5,37 @@
 *	- NetBuffer - single network buffer
 *	- SendingQueue - sending queue
 *	- ReceivingQueue - receiving queue
+*	- Session - remote peer with own sending and receiving queues
+*	- Shard - socket with own sending/receiving threads, packets store and sessions
 *	- TransportUDP - UDP transport itself
 *
-*	Data/Packets flow:
+*	Data/Packets flow (per shard):
 *
-*            +--------------------------------NetBuffersStore<----------------------------------------+
-*            !                                  ^         !                                           !
-*            V                                  !         V                                           !
-*      MsgCompose -> SendingQueue(sync) -> TransportUDP[NetworkThread] -> ReceivingQueue(sync) -> MsgReceived
+*            +--------------------------------NetBuffersStore<-------------------------------------------+
+*            !                                  ^         !                                              !
+*            V                                  !         V                                              !
+*      MsgCompose -> SendingQueue(sync) -> [SendingThread]   [ReceivingThread] -> ReceivingQueue -> MsgReceived
+*                    (per session)                                                (per session)
+*
+*	Message is assigned to shard by its id, so all packets of the message go through one socket (one flow).
+*	Listening side binds all shard sockets to the same address with SO_REUSEPORT, the kernel keeps a flow on
+*	one socket, so packets of one message are reassembled by one receiving thread.
+*
+*	Listening side keeps session per peer address and session id (connecting side generates the id and puts it
+*	to every packet). Composed message may be addressed to many sessions, the same packets are put to sending
+*	queue of every session, so the message is serialized once.
+*	Connecting side sends keepalive packets to the session and goodbye packet on close, listening side removes
+*	the session on goodbye or when nothing is received from the peer during session timeout.
 *
 *******************************************************************************************************************/
 
 #include "Transport.h"
 #include "SocketUDP.h"
+#include "NetSimulator.h"
+#include "URL.h"
+#include "FEC.h"
+#include "CRC32C.h"
+#include "Trace.h"
 #include <mutex>
 #include <list>
 #include <vector>
@@ -26,6 +44,11 @@
 #include <algorithm>
 #include <map>
 #include <queue>
+#include <deque>
+#include <limits>
+#include <thread>
+#include <condition_variable>
+#include <cstring>
 #include <cassert>
 
 namespace comm {
@@ -34,19 +57,110 @@ namespace transports {
 	enum class UDPPacketFlag : byte {
 		First = 0x1,    // mark packet as first
 		Last = 0x2,     // mark packet as last
-		Response = 0x4  // make packet as response stats from receiving side for sending side
+		Response = 0x4,  // make packet as response stats from receiving side for sending side
+		Parity = 0x8,    // mark packet as FEC parity packet, payload starts with UDPParityHeader
+		Checksum = 0x10,  // packet ends with CRC32C of header and payload
+		Deadline = 0x20,  // payload is followed by uint32 lifetime of message in ms (before checksum)
+		Trace = 0x40,     // payload is followed by UDPTraceStamps (before lifetime)
+		Control = 0x80    // session control packet without payload, packet number is UDPControl
+	};
+
+	/// packet number of UDPPacketFlag::Control packet
+	enum class UDPControl : uint32_t {
+		Keepalive = 0,  // connecting side is alive, the session is not removed by timeout
+		Goodbye = 1     // connecting side is closed, the session is removed
 	};
 
 	/**
 	*	UDP packet header
 	*/
 	struct UDPPacketHeader {
-		uint32_t flags : 4;
-		uint32_t msg_id : 8;
-		uint32_t packet : 20;
+		uint32_t flags : 8;
+		uint32_t msg_id : 24;
+		/// packet number in the message
+		uint32_t packet;
+		/// session id of connecting side, 0 - packet is sent by listening side
+		uint32_t session;
+	};
+
+	static_assert( sizeof( UDPPacketHeader ) == 3 * sizeof( uint32_t ), "UDPPacketHeader should be 3 x uint32" );
+
+	/// message id is truncated to width of UDPPacketHeader::msg_id on the wire
+	constexpr MessageID UDPMessageIDMask = ( 1u << 24 ) - 1;
+
+	/**
+	*	Header of FEC parity packet payload, it is followed by coded block: [uint16 payload size][payload]
+	*	of data packets of the group (shorter payloads are padded by zeros)
+	*/
+	struct UDPParityHeader {
+		/// first data packet of the group
+		uint32_t first;
+		/// number of data packets in the message
+		uint32_t total;
+		/// number of data packets in the group
+		uint16_t count;
+		/// index of the parity packet in the group
+		uint8_t index;
+		/// number of parity packets in the group
+		uint8_t parity_count;
+	};
+
+	static_assert( sizeof( UDPParityHeader ) == 3 * sizeof( uint32_t ), "UDPParityHeader should be 3 x uint32" );
+
+	/// size of packet checksum (UDPPacketFlag::Checksum)
+	constexpr size_t UDPChecksumSize = sizeof( uint32_t );
+
+	/// size of message lifetime (UDPPacketFlag::Deadline)
+	constexpr size_t UDPDeadlineSize = sizeof( uint32_t );
+
+	/// trace stamps of message (UDPPacketFlag::Trace), see MsgTrace
+	struct UDPTraceStamps {
+		int64_t origin;
+		int64_t queued;
+	};
+
+	/// size of trace stamps (UDPPacketFlag::Trace)
+	constexpr size_t UDPTraceSize = sizeof( UDPTraceStamps );
+
+	/// FEC settings of sending side: 'parity' packets per group of 'data' packets, 0 - FEC is disabled
+	struct FECSettings {
+		uint32_t data{ 0 };
+		uint32_t parity{ 0 };
 	};
 
-	static_assert( sizeof( UDPPacketHeader ) == sizeof( uint32_t ), "UDPPacketHeader should have size of uint32" );
+	/**
+	*	Counters of shard, they are updated by queues and threads of the shard and are read by GetStats() without locks
+	*/
+	struct UDPCounters {
+		using Ptr = std::shared_ptr<UDPCounters>;
+
+		std::atomic<uint64_t> packets_sent{ 0 };
+		std::atomic<uint64_t> bytes_sent{ 0 };
+		/// packets queued again by NACK
+		std::atomic<uint64_t> packets_retransmitted{ 0 };
+		std::atomic<uint64_t> packets_received{ 0 };
+		std::atomic<uint64_t> bytes_received{ 0 };
+		/// received packets dropped before reassembly: malformed, corrupted, duplicates
+		std::atomic<uint64_t> packets_dropped{ 0 };
+		/// data packets recovered by FEC
+		std::atomic<uint64_t> packets_recovered{ 0 };
+		std::atomic<uint64_t> messages_received{ 0 };
+		std::atomic<uint64_t> sent_expired{ 0 };
+		std::atomic<uint64_t> received_expired{ 0 };
+		std::atomic<uint64_t> received_timeout{ 0 };
+		/// packets in sending queues
+		std::atomic<int64_t> queued_packets{ 0 };
+		/// incomplete messages in receiving queues
+		std::atomic<int64_t> reassembling{ 0 };
+
+		static void Add( std::atomic<uint64_t>& counter, uint64_t value ) {
+			counter.fetch_add( value, std::memory_order_relaxed );
+		}
+
+		static void Add( std::atomic<int64_t>& gauge, int64_t value ) {
+			gauge.fetch_add( value, std::memory_order_relaxed );
+		}
+	};
 
 	/**
 	*	Network Buffer and helper functions
@@ -89,208 +203,1061 @@ namespace transports {
 	protected:
 		std::mutex m_Lock;
 		std::list<NetBuffer> m_Data;
+		/// number of free and of all created buffers, they are read without lock
+		std::atomic<size_t> m_Free{ 0 };
+		std::atomic<size_t> m_Total{ 0 };
 
 	public:
 		bool Alloc( std::list<NetBuffer>& out_list, size_t size ) {
-			std::unique_lock lock( m_Lock );
-			if( !m_Data.empty() ) {
-				out_list.splice( out_list.end(), m_Data, std::prev( m_Data.end() ) );
-			} else {
-				out_list.emplace_back();
+			return Alloc( out_list, size, 1 );
+		}
+
+		/// alloc count packets of the size at once
+		bool Alloc( std::list<NetBuffer>& out_list, size_t size, size_t count ) {
+			std::list<NetBuffer> allocated;
+			{
+				std::unique_lock lock( m_Lock );
+				size_t reused = std::min( count, m_Data.size() );
+				auto first = m_Data.end();
+				std::advance( first, -static_cast<ptrdiff_t>( reused ) );
+				allocated.splice( allocated.end(), m_Data, first, m_Data.end() );
+				m_Free.store( m_Data.size(), std::memory_order_relaxed );
+			}
+			if( allocated.size() < count ) {
+				m_Total.fetch_add( count - allocated.size(), std::memory_order_relaxed );
+			}
+			while( allocated.size() < count ) {
+				allocated.emplace_back();
 			}
-			// TODO: Improve packet allocation to avoid possible re-allocations
-			out_list.back().buffer.resize( size );
+			for( auto& el : allocated ) {
+				// TODO: Improve packet allocation to avoid possible re-allocations
+				el.buffer.resize( size );
+			}
+			out_list.splice( out_list.end(), allocated );
 			return true;
 		}
 
 		void Release( std::list<NetBuffer>& l ) {
 			std::unique_lock lock( m_Lock );
 			m_Data.splice( m_Data.end(), l );
+			m_Free.store( m_Data.size(), std::memory_order_relaxed );
+		}
+
+		/// buffers in the store
+		size_t GetFree() const {
+			return m_Free.load( std::memory_order_relaxed );
+		}
+
+		/// buffers created by the store (free and in use)
+		size_t GetTotal() const {
+			return m_Total.load( std::memory_order_relaxed );
 		}
 	};
 
+	/**
+	*	Inclusive range of packet numbers, payload of response packet is array of ranges of missing packets (NACK)
+	*/
+	struct UDPPacketRange {
+		uint32_t start;
+		uint32_t end;
+	};
+
 	/**
 	*	Sending queue:
 	*	- contains reference to network buffers for sending
-	*	- provides logic to select packets for actual sending
-	*	- process response from receiving side (not implemented)
+	*	- provides logic to select packets for actual sending: every message class (MsgClass) has own flow of
+	*	  packets, flows of higher priority go first, flows of the same priority share the link by deficit round-robin
+	*	  with quantum of weight * Quantum bytes
+	*	- drops not sent packets of message after its deadline, expired message is not repaired
+	*	- process response (missing packets) from receiving side, sent messages are kept for repair in window
 	*	- notify about sending completion
 	*/
 	class SendingQueue {
 	public:
 		using Ptr = std::shared_ptr<SendingQueue>;
 		using FnSentReport = std::function<void( size_t, const Error& )>;
+		using Clock = std::chrono::steady_clock;
 
-	protected:
-		struct Range {
-			uint32_t start;
-			uint32_t end;
-		};
+		/// bytes sent by flow of weight 1 per round
+		static constexpr size_t Quantum = 1500;
 
+	protected:
 		struct Record {
 			using Ptr = std::shared_ptr<Record>;
 
 			const std::list<NetBuffer>& buffers;
 			FnSentReport fn_report;
-			std::vector<Range> incomplete;
+			/// class of the message, repairs go to its flow
+			MsgClass cls;
+			/// time point after which the message is dropped
+			Clock::time_point deadline{ Clock::time_point::max() };
+			/// sending is reported, the record is kept for repair
+			bool reported{ false };
+			/// number of packets of the message in sending list
+			size_t queued{ 0 };
+			/// sending status
+			Error status{ Error::Ok };
 
-			Record( const std::list<NetBuffer>& bufs, const FnSentReport& report )
+			Record( const std::list<NetBuffer>& bufs, const MsgClass& c, const FnSentReport& report )
 				: buffers( bufs )
-				, fn_report( report ) {}
+				, fn_report( report )
+				, cls( c ) {}
 		};
 
+		/// packets of one message class
+		struct Flow {
+			int priority{ 0 };
+			size_t weight{ 1 };
+			/// bytes the flow may send in current round
+			size_t deficit{ 0 };
+			/// flow is in the round of its priority
+			bool active{ false };
+			std::list<const NetBuffer*> packets;
+		};
+		using FlowIt = std::map<std::string, Flow>::iterator;
+
 	protected:
 		std::mutex m_Lock;
 		std::map<MessageID, Record::Ptr> m_Records;
-		std::list<const NetBuffer*> m_ToSend;
+		/// class name -> flow, flow is removed when it has no packets
+		std::map<std::string, Flow> m_Flows;
+		/// priority -> round of flows with packets, the first flow is served
+		std::map<int, std::list<FlowIt>, std::greater<int>> m_Rounds;
+		/// the queue is in ready list of sending thread
+		bool m_Scheduled{ false };
+		/// number of sent messages kept for repair, 0 - repair is disabled
+		size_t m_RepairWindow;
+		/// sent messages kept for repair, oldest first
+		std::deque<MessageID> m_Retained;
+		/// number of records with deadline, packets are checked for expiry if there are any
+		size_t m_Deadlines{ 0 };
+		/// number of messages dropped because of deadline
+		size_t m_Expired{ 0 };
+		/// counters of shard
+		UDPCounters::Ptr m_Counters;
 
 	public:
+		SendingQueue( size_t repair_window = 0, const UDPCounters::Ptr& counters = std::make_shared<UDPCounters>() )
+			: m_RepairWindow( repair_window )
+			, m_Counters( counters ) {}
+
 		/// Put network buffers of message to sending queue and create control record
-		void Send( MessageID msg_id, const std::list<NetBuffer>& buffers, const FnSentReport& report ) {
+		/// @return true - queue was idle, caller should schedule it for sending thread
+		bool Send( MessageID msg_id, const std::list<NetBuffer>& buffers, const FnSentReport& report ) {
+			return Send( msg_id, buffers, MsgClass(), report );
+		}
+
+		/// Put network buffers of message to flow of its class and create control record
+		/// @param deadline - not sent packets are dropped after the time point
+		/// @return true - queue was idle, caller should schedule it for sending thread
+		bool Send( MessageID msg_id, const std::list<NetBuffer>& buffers, const MsgClass& cls,
+				   const FnSentReport& report, Clock::time_point deadline = Clock::time_point::max() ) {
 			assert( !buffers.empty() );
 
 			std::list<const NetBuffer*> send;
-			uint32_t min_packet = buffers.front().GetPacketHeader().packet;
-			uint32_t max_packet = min_packet;
-			auto record = std::make_shared<Record>( buffers, report );
+			auto record = std::make_shared<Record>( buffers, cls, report );
+			record->deadline = deadline;
 			for( const auto& el : buffers ) {
 				const NetBuffer* pn = &el;
 				send.push_back( pn );
 			}
-			record->incomplete.push_back( { min_packet, max_packet } );
+			record->queued = send.size();
 
 			std::unique_lock lock( m_Lock );
 			m_Records[ msg_id ] = record;
-			m_ToSend.splice( m_ToSend.end(), send );
+			if( deadline != Clock::time_point::max() ) {
+				m_Deadlines++;
+			}
+			UDPCounters::Add( m_Counters->queued_packets, static_cast<int64_t>( send.size() ) );
+			FlowIt flow = GetFlow( cls );
+			flow->second.packets.splice( flow->second.packets.end(), send );
+			Activate( flow );
+			return Schedule();
 		}
 
 		/// select next packet for sending
-		const NetBuffer* GetNextBufferPacket() {
+		/// @param reschedule - [output] queue has more packets and should stay in ready list
+		const NetBuffer* GetNextBufferPacket( bool& reschedule ) {
+			std::vector<Record::Ptr> expired;
 			std::unique_lock lock( m_Lock );
-			if( m_ToSend.empty() ) {
-				return nullptr;
+			const NetBuffer* result = nullptr;
+			while( result == nullptr && !m_Rounds.empty() ) {
+				auto round = m_Rounds.begin();
+				FlowIt it = round->second.front();
+				Flow& flow = it->second;
+				if( m_Deadlines != 0 && DropExpired( it, expired ) ) {
+					continue;
+				}
+				size_t size = static_cast<size_t>( flow.packets.front()->GetDataSize() );
+				if( flow.deficit < size ) {
+					// turn of the next flow, quantum is not smaller than packet, so the loop ends within round
+					round->second.splice( round->second.end(), round->second, round->second.begin() );
+					NextTurn( round->second );
+					continue;
+				}
+
+				result = flow.packets.front();
+				flow.packets.pop_front();
+				flow.deficit -= size;
+				UDPCounters::Add( m_Counters->queued_packets, -1 );
+				if( flow.packets.empty() ) {
+					Deactivate( it );
+					m_Flows.erase( it );
+				}
+			}
+			reschedule = !m_Rounds.empty();
+			m_Scheduled = reschedule;
+			lock.unlock();
+			// notify
+			for( const auto& record : expired ) {
+				record->fn_report( 0, record->status );
 			}
-			auto result = m_ToSend.front();
-			m_ToSend.pop_front();
 			return result;
 		}
 
-		/// process response stats from receiving side (incomplete)
-		void ProcessResponse( MessageID msg_id, std::list<NetBuffer>& buffer ) {
+		/// process response from receiving side: put requested packets of kept message ahead of its flow
+		/// @return true - queue was idle, caller should schedule it for sending thread
+		bool ProcessResponse( MessageID msg_id, std::list<NetBuffer>& buffer ) {
 			assert( !buffer.empty() );
 
+			const UDPPacketRange* begin = reinterpret_cast<const UDPPacketRange*>( buffer.front().ref.data );
+			const UDPPacketRange* end = begin + buffer.front().ref.size / sizeof( UDPPacketRange );
+
 			std::unique_lock lock( m_Lock );
 			auto found = m_Records.find( msg_id );
-			if( found != m_Records.end() ) {
-				// found
-				Record::Ptr record = found->second;
-				auto& ranges = record->incomplete;
-
-				const Range* cur = reinterpret_cast<const Range*>( buffer.front().ref.data );
-				const Range* end = reinterpret_cast<const Range*>( buffer.front().ref.data + buffer.front().ref.size );
-				while( cur < end ) {
-					//TODO: Remove completed ranges
-					cur++;
-				}
+			if( found == m_Records.end() ) {
+				// unknown or already dropped from repair window
+				return false;
+			}
 
-				if( ranges.empty() ) {
-					// all data received
-					m_Records.erase( found );
-					lock.unlock();
-					// notify
-					record->fn_report( 0, Error::Ok );
+			Record::Ptr record = found->second;
+			if( record->deadline <= Clock::now() ) {
+				// useless for receiving side
+				return false;
+			}
+			std::list<const NetBuffer*> send;
+			for( const auto& el : record->buffers ) {
+				uint32_t packet = el.GetPacketHeader().packet;
+				for( auto range = begin; range < end; range++ ) {
+					if( packet >= range->start && packet <= range->end ) {
+						send.push_back( &el );
+						break;
+					}
 				}
 			}
+
+			if( send.empty() ) {
+				return false;
+			}
+
+			record->queued += send.size();
+			UDPCounters::Add( m_Counters->queued_packets, static_cast<int64_t>( send.size() ) );
+			UDPCounters::Add( m_Counters->packets_retransmitted, send.size() );
+			FlowIt flow = GetFlow( record->cls );
+			flow->second.packets.splice( flow->second.packets.begin(), send );
+			Activate( flow );
+			return Schedule();
 		}
 
-		/// Network thread notify the sending queue that last packet sent
-		/// This is temporal solution (just to run the tests)
-		void SentReport( MessageID msg_id, const Error& err ) {
+		/// Network thread notify the sending queue that packet is sent, the message is reported when all its
+		/// queued packets are sent (the buffer should not be used after the call)
+		void SentReport( const NetBuffer* buffer, const Error& err ) {
+			MessageID msg_id = buffer->GetPacketHeader().msg_id;
+
 			std::unique_lock lock( m_Lock );
 			auto found = m_Records.find( msg_id );
-			if( found != m_Records.end() ) {
-				Record::Ptr record = found->second;
-				m_Records.erase( found );
-				lock.unlock();
-				// notify
-				record->fn_report( 0, err );
+			if( found == m_Records.end() ) {
+				return;
+			}
+
+			Record::Ptr record = found->second;
+			if( err != Error::Ok ) {
+				record->status = err;
+			}
+			if( --record->queued != 0 || record->reported ) {
+				return;
+			}
+
+			Complete( found );
+			lock.unlock();
+			// notify
+			record->fn_report( 0, record->status );
+		}
+
+		/// number of messages dropped because of deadline
+		size_t GetExpired() {
+			std::unique_lock lock( m_Lock );
+			return m_Expired;
+		}
+
+	protected:
+		/// mark queue as scheduled, true - it was idle
+		bool Schedule() {
+			if( m_Scheduled ) {
+				return false;
+			}
+			m_Scheduled = true;
+			return true;
+		}
+
+		/// flow of the class, priority and weight are taken from the last message
+		FlowIt GetFlow( const MsgClass& cls ) {
+			FlowIt it = m_Flows.try_emplace( cls.name ).first;
+			Flow& flow = it->second;
+			if( flow.active && flow.priority != cls.priority ) {
+				// moves to round of new priority
+				Deactivate( it );
+			}
+			flow.priority = cls.priority;
+			flow.weight = std::max<size_t>( 1, cls.weight );
+			return it;
+		}
+
+		/// put flow with packets to the end of round of its priority
+		void Activate( FlowIt it ) {
+			Flow& flow = it->second;
+			if( flow.active ) {
+				return;
+			}
+			auto& round = m_Rounds[ flow.priority ];
+			round.push_back( it );
+			flow.active = true;
+			flow.deficit = 0;
+			if( round.size() == 1 ) {
+				// turn of the flow starts right away
+				NextTurn( round );
+			}
+		}
+
+		/// remove flow from round of its priority
+		void Deactivate( FlowIt it ) {
+			Flow& flow = it->second;
+			auto round = m_Rounds.find( flow.priority );
+			assert( round != m_Rounds.end() );
+			bool served = round->second.front() == it;
+			round->second.remove( it );
+			flow.active = false;
+			if( round->second.empty() ) {
+				m_Rounds.erase( round );
+			} else if( served ) {
+				NextTurn( round->second );
+			}
+		}
+
+		/// the first flow of round starts its turn
+		static void NextTurn( std::list<FlowIt>& round ) {
+			Flow& flow = round.front()->second;
+			flow.deficit += flow.weight * Quantum;
+		}
+
+		/// mark message as reported, it is kept for repair within window
+		void Complete( std::map<MessageID, Record::Ptr>::iterator found ) {
+			found->second->reported = true;
+			if( m_RepairWindow == 0 ) {
+				EraseRecord( found );
+			} else {
+				m_Retained.push_back( found->first );
+				TrimRetained();
+			}
+		}
+
+		void EraseRecord( std::map<MessageID, Record::Ptr>::iterator found ) {
+			if( found->second->deadline != Clock::time_point::max() ) {
+				m_Deadlines--;
+			}
+			m_Records.erase( found );
+		}
+
+		/// drop queued packets of the message of the first packet of flow if it is expired
+		/// @param expired - [output] records to report
+		/// @return true - packets are dropped
+		bool DropExpired( FlowIt it, std::vector<Record::Ptr>& expired ) {
+			Flow& flow = it->second;
+			MessageID msg_id = flow.packets.front()->GetPacketHeader().msg_id;
+			auto found = m_Records.find( msg_id );
+			if( found == m_Records.end() || found->second->deadline > Clock::now() ) {
+				return false;
+			}
+
+			Record::Ptr record = found->second;
+			size_t removed = 0;
+			flow.packets.remove_if( [&]( const NetBuffer* packet ) {
+				bool remove = packet->GetPacketHeader().msg_id == msg_id;
+				removed += remove ? 1 : 0;
+				return remove;
+			} );
+			record->queued -= removed;
+			UDPCounters::Add( m_Counters->queued_packets, -static_cast<int64_t>( removed ) );
+			if( record->status != Error::Expired ) {
+				m_Expired++;
+				UDPCounters::Add( m_Counters->sent_expired, 1 );
+			}
+			record->status = Error::Expired;
+			if( record->queued == 0 && !record->reported ) {
+				// packets in flight are reported by SentReport() otherwise
+				Complete( found );
+				expired.push_back( record );
+			}
+			if( flow.packets.empty() ) {
+				Deactivate( it );
+				m_Flows.erase( it );
+			}
+			return true;
+		}
+
+		/// drop oldest kept messages out of repair window, message with queued packets is kept until they are sent
+		void TrimRetained() {
+			while( m_Retained.size() > m_RepairWindow ) {
+				auto found = m_Records.find( m_Retained.front() );
+				if( found != m_Records.end() ) {
+					if( found->second->queued != 0 ) {
+						break;
+					}
+					EraseRecord( found );
+				}
+				m_Retained.pop_front();
 			}
 		}
 	};
 
 	/**
 	*	ReceivingQueue:
-	*	- contains receivied network packets grouped by mesage_id
+	*	- contains receivied network packets grouped by mesage_id, packets may come in any order
+	*	- recovers lost packets from FEC parity packets
 	*	- generate notification about received message
+	*	- generate responses with missing packets (NACK) for incomplete messages
+	*	- drop incomplete messages by timeout and by deadline of sending side
 	*/
 	class ReceivingQueue {
 	public:
 		using Ptr = std::shared_ptr<ReceivingQueue>;
-		using FnReceiveMessage = std::function<void( MessageID, std::list<NetBuffer>& )>;
+		/// trace is nullptr if the message is not traced
+		using FnReceiveMessage = std::function<void( MessageID, std::list<NetBuffer>&, const MsgTrace* )>;
+		using FnResponse = std::function<void( MessageID, const std::vector<UDPPacketRange>& )>;
+		using Clock = std::chrono::steady_clock;
+
+		struct Settings {
+			/// incomplete message is dropped if no packets received during timeout
+			std::chrono::milliseconds timeout{ 1000 };
+			/// response is sent if no packets received during delay, 0 - responses are disabled
+			std::chrono::milliseconds response_delay{ 0 };
+			/// max number of responses per message
+			int max_responses{ 5 };
+		};
+
+		/// number of last delivered messages to detect late duplicates
+		static constexpr size_t CompletedHistory = 64;
+		/// max number of ranges in one response (fits into packet)
+		static constexpr size_t MaxResponseRanges = 128;
 
 	protected:
 		struct Record {
 			using Ptr = std::shared_ptr<Record>;
 
+			/// packets ordered by packet number
 			std::list<NetBuffer> buffers;
+			/// FEC parity packets
+			std::list<NetBuffer> parity;
+			/// number of last packet, it is known when the last packet is received
+			uint32_t last{ std::numeric_limits<uint32_t>::max() };
+			/// time of last received packet
+			Clock::time_point updated;
+			/// time of last response
+			Clock::time_point responded;
+			/// number of sent responses
+			int responses{ 0 };
+			/// the message is useless after the time point (UDPPacketFlag::Deadline)
+			Clock::time_point deadline{ Clock::time_point::max() };
+			/// stamps of traced message (UDPPacketFlag::Trace), origin is 0 if the message is not traced
+			MsgTrace trace;
 		};
 
+		/// packets store for recovered packets and for release of parity packets
+		NetBuffersStore::Ptr m_BuffersStoreRef;
 		FnReceiveMessage m_OnReceiveMessage;
+		FnResponse m_OnResponse;
+		Settings m_Settings;
 		std::map<MessageID, Record::Ptr> m_Records;
+		std::deque<MessageID> m_Completed;
+		/// number of dropped packets with wrong checksum
+		size_t m_Corrupted{ 0 };
+		/// number of incomplete messages dropped by deadline and by timeout, they are read by other threads
+		std::atomic<size_t> m_Expired{ 0 };
+		std::atomic<size_t> m_TimedOut{ 0 };
+		/// counters of shard
+		UDPCounters::Ptr m_Counters;
 
 	public:
-		ReceivingQueue( const FnReceiveMessage& onreceive )
-			: m_OnReceiveMessage( onreceive ) {}
+		ReceivingQueue( const NetBuffersStore::Ptr& store, const FnReceiveMessage& onreceive,
+						const FnResponse& onresponse, const Settings& settings,
+						const UDPCounters::Ptr& counters = std::make_shared<UDPCounters>() )
+			: m_BuffersStoreRef( store )
+			, m_OnReceiveMessage( onreceive )
+			, m_OnResponse( onresponse )
+			, m_Settings( settings )
+			, m_Counters( counters ) {}
 
 		/// process received network packet from the network thread
 		void ProcessBuffer( MessageID msg_id, std::list<NetBuffer>& buffer ) {
 			assert( !buffer.empty() );
 
-			auto& record = m_Records[ msg_id ];
-			if( record == nullptr ) {
-				record = std::make_shared<Record>();
+			const UDPPacketHeader& header = buffer.front().GetPacketHeader();
+			uint32_t packet = header.packet;
+			bool is_last = ( header.flags & static_cast<byte>( UDPPacketFlag::Last ) ) != 0;
+
+			if( ( header.flags & static_cast<byte>( UDPPacketFlag::Checksum ) ) != 0 &&
+				!VerifyChecksum( buffer.front() ) ) {
+				m_Corrupted++;
+				UDPCounters::Add( m_Counters->packets_dropped, 1 );
+				return;
+			}
+
+			uint32_t lifetime = std::numeric_limits<uint32_t>::max();
+			if( ( header.flags & static_cast<byte>( UDPPacketFlag::Deadline ) ) != 0 &&
+				!ReadDeadline( buffer.front(), lifetime ) ) {
+				UDPCounters::Add( m_Counters->packets_dropped, 1 );
+				return;
+			}
+
+			UDPTraceStamps stamps = {};
+			if( ( header.flags & static_cast<byte>( UDPPacketFlag::Trace ) ) != 0 &&
+				!ReadTrace( buffer.front(), stamps ) ) {
+				UDPCounters::Add( m_Counters->packets_dropped, 1 );
+				return;
+			}
+
+			auto found = m_Records.find( msg_id );
+			if( found == m_Records.end() ) {
+				if( std::find( m_Completed.begin(), m_Completed.end(), msg_id ) != m_Completed.end() ) {
+					// late duplicate of delivered message
+					UDPCounters::Add( m_Counters->packets_dropped, 1 );
+					return;
+				}
+				found = m_Records.emplace( msg_id, std::make_shared<Record>() ).first;
+				UDPCounters::Add( m_Counters->reassembling, 1 );
+			}
+
+			Record::Ptr record = found->second;
+			record->updated = Clock::now();
+			if( stamps.origin != 0 && record->trace.origin == 0 ) {
+				record->trace.origin = stamps.origin;
+				record->trace.queued = stamps.queued;
+				record->trace.received = utils::trace::Now();
+			}
+			if( lifetime != std::numeric_limits<uint32_t>::max() ) {
+				record->deadline =
+					std::min( record->deadline, record->updated + std::chrono::milliseconds( lifetime ) );
+			}
+
+			if( ( header.flags & static_cast<byte>( UDPPacketFlag::Parity ) ) != 0 ) {
+				if( buffer.front().ref.size < sizeof( UDPParityHeader ) ) {
+					UDPCounters::Add( m_Counters->packets_dropped, 1 );
+					return;
+				}
+				UDPParityHeader parity = *GetParityHeader( buffer.front() );
+				if( parity.count == 0 || parity.total == 0 || FindParity( *record, parity.first, parity.index ) ) {
+					// broken or duplicate
+					UDPCounters::Add( m_Counters->packets_dropped, 1 );
+					return;
+				}
+				record->last = parity.total - 1;
+				record->parity.splice( record->parity.end(), buffer );
+				Recover( *record, parity.first );
+			} else {
+				if( !InsertBuffer( *record, buffer ) ) {
+					// duplicate
+					UDPCounters::Add( m_Counters->packets_dropped, 1 );
+					return;
+				}
+				if( is_last ) {
+					record->last = packet;
+				}
+				if( !record->parity.empty() ) {
+					for( const auto& el : record->parity ) {
+						const UDPParityHeader* parity = GetParityHeader( el );
+						if( packet >= parity->first && packet < parity->first + parity->count ) {
+							Recover( *record, parity->first );
+							break;
+						}
+					}
+				}
+			}
+
+			if( record->last != std::numeric_limits<uint32_t>::max() && record->buffers.size() == record->last + 1 ) {
+				if( record->trace.origin != 0 ) {
+					record->trace.completed = utils::trace::Now();
+				}
+				m_OnReceiveMessage( msg_id, record->buffers, record->trace.origin != 0 ? &record->trace : nullptr );
+				m_BuffersStoreRef->Release( record->parity );
+				m_Records.erase( found );
+				UDPCounters::Add( m_Counters->reassembling, -1 );
+				UDPCounters::Add( m_Counters->messages_received, 1 );
+
+				AddCompleted( msg_id );
+			}
+		}
+
+		/// send responses for incomplete messages and drop expired ones
+		/// @param released - [output] packets of dropped messages
+		/// @return number of dropped messages
+		size_t CheckTimeouts( Clock::time_point now, std::list<NetBuffer>& released ) {
+			size_t dropped = 0;
+			for( auto it = m_Records.begin(); it != m_Records.end(); ) {
+				Record& record = *it->second;
+				bool expired = now > record.deadline;
+				if( expired || now - record.updated > m_Settings.timeout ) {
+					released.splice( released.end(), record.buffers );
+					released.splice( released.end(), record.parity );
+					if( expired ) {
+						// late packets of the message are ignored
+						AddCompleted( it->first );
+						m_Expired++;
+						UDPCounters::Add( m_Counters->received_expired, 1 );
+					} else {
+						m_TimedOut++;
+						UDPCounters::Add( m_Counters->received_timeout, 1 );
+					}
+					it = m_Records.erase( it );
+					UDPCounters::Add( m_Counters->reassembling, -1 );
+					dropped++;
+					continue;
+				}
+
+				if( m_OnResponse && m_Settings.response_delay.count() != 0 &&
+					record.responses < m_Settings.max_responses && now - record.updated >= m_Settings.response_delay &&
+					now - record.responded >= m_Settings.response_delay ) {
+					std::vector<UDPPacketRange> ranges = GetMissingRanges( record );
+					if( !ranges.empty() ) {
+						m_OnResponse( it->first, ranges );
+						record.responses++;
+						record.responded = now;
+					}
+				}
+				++it;
+			}
+			return dropped;
+		}
+
+		/// drop all incomplete messages (e.g. the session is removed)
+		/// @param released - [output] packets of dropped messages
+		void Clear( std::list<NetBuffer>& released ) {
+			for( auto& el : m_Records ) {
+				released.splice( released.end(), el.second->buffers );
+				released.splice( released.end(), el.second->parity );
+				UDPCounters::Add( m_Counters->reassembling, -1 );
+			}
+			m_Records.clear();
+		}
+
+		size_t GetCorrupted() const {
+			return m_Corrupted;
+		}
+
+		size_t GetExpired() const {
+			return m_Expired;
+		}
+
+		size_t GetTimedOut() const {
+			return m_TimedOut;
+		}
+
+		/// append lifetime of message behind the payload, buffer should have room for it
+		static void AddDeadline( NetBuffer& buffer, uint32_t lifetime ) {
+			size_t size = buffer.GetDataSize();
+			assert( buffer.buffer.size() >= size + UDPDeadlineSize );
+			std::memcpy( buffer.buffer.data() + size, &lifetime, sizeof( lifetime ) );
+			buffer.ref.size += UDPDeadlineSize;
+		}
+
+		/// read and remove lifetime of message from received packet
+		static bool ReadDeadline( NetBuffer& buffer, uint32_t& lifetime ) {
+			if( buffer.ref.size < UDPDeadlineSize ) {
+				return false;
+			}
+			buffer.ref.size -= UDPDeadlineSize;
+			std::memcpy( &lifetime, buffer.ref.data + buffer.ref.size, sizeof( lifetime ) );
+			return true;
+		}
+
+		/// append trace stamps behind the payload, buffer should have room for them
+		static void AddTrace( NetBuffer& buffer, const UDPTraceStamps& stamps ) {
+			size_t size = buffer.GetDataSize();
+			assert( buffer.buffer.size() >= size + UDPTraceSize );
+			std::memcpy( buffer.buffer.data() + size, &stamps, sizeof( stamps ) );
+			buffer.ref.size += UDPTraceSize;
+		}
+
+		/// read and remove trace stamps from received packet
+		static bool ReadTrace( NetBuffer& buffer, UDPTraceStamps& stamps ) {
+			if( buffer.ref.size < UDPTraceSize ) {
+				return false;
+			}
+			buffer.ref.size -= UDPTraceSize;
+			std::memcpy( &stamps, buffer.ref.data + buffer.ref.size, sizeof( stamps ) );
+			return true;
+		}
+
+		/// append checksum of header and payload behind the payload, buffer should have room for it
+		static void AddChecksum( NetBuffer& buffer ) {
+			size_t size = buffer.GetDataSize();
+			assert( buffer.buffer.size() >= size + UDPChecksumSize );
+			uint32_t crc = utils::Crc32c( 0, buffer.buffer.data(), size );
+			std::memcpy( buffer.buffer.data() + size, &crc, sizeof( crc ) );
+			buffer.ref.size += UDPChecksumSize;
+		}
+
+		/// check and remove checksum of received packet
+		static bool VerifyChecksum( NetBuffer& buffer ) {
+			if( buffer.ref.size < UDPChecksumSize ) {
+				return false;
+			}
+			size_t size = buffer.GetDataSize() - UDPChecksumSize;
+			uint32_t crc;
+			std::memcpy( &crc, buffer.buffer.data() + size, sizeof( crc ) );
+			if( crc != utils::Crc32c( 0, buffer.buffer.data(), size ) ) {
+				return false;
+			}
+			buffer.ref.size -= UDPChecksumSize;
+			return true;
+		}
+
+	protected:
+		void AddCompleted( MessageID msg_id ) {
+			m_Completed.push_back( msg_id );
+			if( m_Completed.size() > CompletedHistory ) {
+				m_Completed.pop_front();
+			}
+		}
+
+		static const UDPParityHeader* GetParityHeader( const NetBuffer& buffer ) {
+			return reinterpret_cast<const UDPParityHeader*>( buffer.ref.data );
+		}
+
+		/// put data packet to ordered list, packet in order is appended
+		/// @return false - duplicate
+		static bool InsertBuffer( Record& record, std::list<NetBuffer>& buffer ) {
+			uint32_t packet = buffer.front().GetPacketHeader().packet;
+			auto pos = record.buffers.end();
+			while( pos != record.buffers.begin() && std::prev( pos )->GetPacketHeader().packet > packet ) {
+				--pos;
 			}
-			record->buffers.splice( record->buffers.end(), buffer );
+			if( pos != record.buffers.begin() && std::prev( pos )->GetPacketHeader().packet == packet ) {
+				return false;
+			}
+			record.buffers.splice( pos, buffer );
+			return true;
+		}
 
-			if( ( record->buffers.back().GetPacketHeader().flags & static_cast<byte>( UDPPacketFlag::Last ) ) != 0 ) {
-				m_OnReceiveMessage( msg_id, record->buffers );
-				m_Records.erase( msg_id );
+		static bool FindParity( const Record& record, uint32_t first, uint8_t index ) {
+			for( const auto& el : record.parity ) {
+				const UDPParityHeader* parity = GetParityHeader( el );
+				if( parity->first == first && parity->index == index ) {
+					return true;
+				}
 			}
+			return false;
+		}
+
+		/// recover lost data packets of the group if there are enough parity packets
+		void Recover( Record& record, uint32_t first ) {
+			std::vector<const NetBuffer*> parity;
+			for( const auto& el : record.parity ) {
+				if( GetParityHeader( el )->first == first ) {
+					parity.push_back( &el );
+				}
+			}
+			if( parity.empty() ) {
+				return;
+			}
+
+			uint32_t count = GetParityHeader( *parity[ 0 ] )->count;
+			std::vector<const NetBuffer*> data( count, nullptr );
+			for( const auto& el : record.buffers ) {
+				uint32_t packet = el.GetPacketHeader().packet;
+				if( packet >= first && packet < first + count ) {
+					data[ packet - first ] = &el;
+				}
+			}
+
+			std::vector<uint32_t> missing;
+			for( uint32_t i = 0; i < count; i++ ) {
+				if( data[ i ] == nullptr ) {
+					missing.push_back( i );
+				}
+			}
+			if( missing.empty() || missing.size() > parity.size() ) {
+				return;
+			}
+
+			size_t m = missing.size();
+			size_t block = parity[ 0 ]->ref.size - sizeof( UDPParityHeader );
+
+			// parity minus contribution of received data packets, coefficients of missing ones
+			std::vector<std::vector<byte>> rhs( m );
+			std::vector<byte> matrix( m * m );
+			for( size_t r = 0; r < m; r++ ) {
+				const UDPParityHeader* ph = GetParityHeader( *parity[ r ] );
+				if( parity[ r ]->ref.size - sizeof( UDPParityHeader ) != block || ph->count != count ) {
+					return;
+				}
+				const byte* coded = parity[ r ]->ref.data + sizeof( UDPParityHeader );
+				rhs[ r ].assign( coded, coded + block );
+				for( uint32_t i = 0; i < count; i++ ) {
+					if( data[ i ] != nullptr ) {
+						byte coef = utils::fec::Coefficient( ph->index, i );
+						uint16_t len = static_cast<uint16_t>( data[ i ]->ref.size );
+						byte* dst = rhs[ r ].data();
+						utils::fec::MulAdd( dst, reinterpret_cast<const byte*>( &len ), coef, sizeof( len ) );
+						utils::fec::MulAdd( dst + sizeof( len ), data[ i ]->ref.data, coef, len );
+					}
+				}
+				for( size_t c = 0; c < m; c++ ) {
+					matrix[ r * m + c ] = utils::fec::Coefficient( ph->index, missing[ c ] );
+				}
+			}
+
+			if( !utils::fec::Invert( matrix, m ) ) {
+				return;
+			}
+
+			const UDPPacketHeader& parity_header = parity[ 0 ]->GetPacketHeader();
+			for( size_t c = 0; c < m; c++ ) {
+				std::list<NetBuffer> recovered;
+				if( !m_BuffersStoreRef->Alloc( recovered, sizeof( UDPPacketHeader ) + block ) ) {
+					return;
+				}
+
+				auto& buf = recovered.back();
+				byte* out = buf.buffer.data() + sizeof( UDPPacketHeader );
+				std::memset( out, 0, block );
+				for( size_t r = 0; r < m; r++ ) {
+					utils::fec::MulAdd( out, rhs[ r ].data(), matrix[ c * m + r ], block );
+				}
+
+				uint16_t len;
+				std::memcpy( &len, out, sizeof( len ) );
+				if( len > block - sizeof( len ) ) {
+					m_BuffersStoreRef->Release( recovered );
+					return;
+				}
+
+				uint32_t packet = first + missing[ c ];
+				UDPPacketHeader* ph = reinterpret_cast<UDPPacketHeader*>( buf.GetBuffer() );
+				ph->flags = ( packet == 0 ? static_cast<byte>( UDPPacketFlag::First ) : 0 ) |
+							( packet == record.last ? static_cast<byte>( UDPPacketFlag::Last ) : 0 );
+				ph->msg_id = parity_header.msg_id;
+				ph->packet = packet;
+				ph->session = parity_header.session;
+				buf.ref.data = out + sizeof( len );
+				buf.ref.size = len;
+
+				InsertBuffer( record, recovered );
+				UDPCounters::Add( m_Counters->packets_recovered, 1 );
+			}
+		}
+
+		/// ranges of missing packets, if the last packet is not received the tail range is open
+		static std::vector<UDPPacketRange> GetMissingRanges( const Record& record ) {
+			std::vector<UDPPacketRange> ranges;
+			uint32_t expected = 0;
+			for( const auto& buf : record.buffers ) {
+				uint32_t packet = buf.GetPacketHeader().packet;
+				if( packet > expected && ranges.size() < MaxResponseRanges ) {
+					ranges.push_back( { expected, packet - 1 } );
+				}
+				expected = packet + 1;
+			}
+			if( expected <= record.last && ranges.size() < MaxResponseRanges ) {
+				ranges.push_back( { expected, record.last } );
+			}
+			return ranges;
+		}
+	};
+
+	struct Shard;
+
+	/**
+	*	Session - remote peer (address + session id):
+	*	- sending queue - packets for the peer, served by the sending thread of the shard
+	*	- receiving queue - messages reassembly, used by the receiving thread of the shard only
+	*/
+	struct Session {
+		using Ptr = std::shared_ptr<Session>;
+
+		SessionID id;
+		net::SocketAddress::Ptr address;
+		/// shard which sends/receives packets of the session
+		Shard* shard;
+		SendingQueue::Ptr sending_queue;
+		ReceivingQueue::Ptr receiving_queue;
+		/// time of last packet from the peer, used by receiving thread only
+		ReceivingQueue::Clock::time_point active;
+	};
+
+	/**
+	*	I/O shard:
+	*	- socket (shards of listening transport share local address via SO_REUSEPORT)
+	*	- sending thread - round-robin sends packets of ready sessions
+	*	- receiving thread - reads packets and routes them to sessions, sessions map is used by this thread only
+	*/
+	struct Shard {
+		using Ptr = std::shared_ptr<Shard>;
+		using SessionKey = std::pair<SessionID, uint64_t>;
+
+		net::SocketUDP::Ptr socket;
+		/// impaired link of "sim+udp" transport, nullptr - datagrams are sent to the socket directly
+		std::unique_ptr<net::NetSimulator> simulator;
+		NetBuffersStore::Ptr buffers_store;
+		/// counters of the shard sessions and threads
+		UDPCounters::Ptr counters{ std::make_shared<UDPCounters>() };
+		std::unique_ptr<std::thread> sending_thread;
+		std::unique_ptr<std::thread> receiving_thread;
+		/// sessions which received packets through the shard
+		std::map<SessionKey, Session::Ptr> sessions;
+		/// session of connecting transport, the peer is fixed
+		Session::Ptr connected;
+		/// time of next keepalive packet of connected session
+		ReceivingQueue::Clock::time_point keepalive;
+
+		/// lock for ready list
+		std::mutex lock;
+		std::condition_variable has_ready;
+		/// sessions with packets for sending
+		std::deque<Session::Ptr> ready;
+
+		/// put session to ready list
+		void Schedule( const Session::Ptr& session ) {
+			std::unique_lock l( lock );
+			ready.push_back( session );
+			has_ready.notify_one();
+		}
+
+		/// send datagram to the socket or through the simulator
+		int SendTo( const char* data, int len, const ::sockaddr& to ) {
+			if( simulator != nullptr ) {
+				return simulator->Send( data, len, to );
+			}
+			return ::sendto( socket->GetSocket(), data, len, 0, &to, sizeof( to ) );
+		}
+
+		/// get session from ready list, wait for it up to timeout
+		Session::Ptr WaitReady( std::chrono::milliseconds timeout ) {
+			std::unique_lock l( lock );
+			if( !has_ready.wait_for( l, timeout, [this]() { return !ready.empty(); } ) ) {
+				return nullptr;
+			}
+			Session::Ptr result = ready.front();
+			ready.pop_front();
+			return result;
 		}
 	};
 
 	/**
 	*	Transport implementation for UDP protocol
+	*
+	*	URI/hints parameters:
+	*	- shards=N - number of I/O shards (default 1)
+	*	- multicast=1 - URI host is multicast group: connecting side sends to the group, listening side joins it
+	*	- ttl=N - TTL of outgoing multicast datagrams (default 1)
+	*	- iface=A.B.C.D - interface for multicast group membership and outgoing multicast datagrams
+	*	- loop=0/1 - deliver outgoing multicast datagrams to local receivers (default 1)
+	*	- repair=N - number of sent messages kept for retransmission by NACK (default 64 for multicast, 0 otherwise)
+	*	- nack=ms - receiving side requests missing packets after ms without packets, 0 - disabled
+	*	  (default 20 for multicast, 0 otherwise)
+	*	- reassembly_timeout=ms - incomplete message is dropped after ms without packets (default 1000)
+	*	- fec_n=N&fec_k=K - send K parity packets per group of N data packets (default 0 - disabled)
+	*	- crc=1 - append CRC32C to sent packets, received packets with checksum are always verified
+	*	- session_timeout=ms - listening side removes session after ms without packets from the peer, connecting
+	*	  side sends keepalive packet every quarter of it (default 10000, 0 - disabled, sides should use the same)
+	*
+	*	"sim+udp://" scheme sends datagrams through net::NetSimulator with loss, reorder, delay, jitter and rate
+	*	impairments from URI/hints parameters (see NetSimulator.h), every shard has own simulator seeded by seed + index
 	*/
 	class TransportUDP : public comm::ITransport, public std::enable_shared_from_this<TransportUDP> {
 	protected:
 		OnReceiveMsg m_OnNewMessage;
-		NetBuffersStore::Ptr m_BuffersStore;
 		std::atomic<MessageID> m_MessageID{ 0 };
-		net::SocketUDP::Ptr m_Socket;
-		std::unique_ptr<std::thread> m_NetworkThread;
-		bool m_IsRunning{ false };
+		std::vector<Shard::Ptr> m_Shards;
+		std::atomic<bool> m_IsRunning{ false };
 		uint32_t m_MTUSize{ 1500 };
-		net::SocketAddress::Ptr m_RemoteAddress;
-		SendingQueue::Ptr m_SendingQueue;
-		ReceivingQueue::Ptr m_ReceivingQueue;
+		EOpen m_Mode{ EOpen::Listen };
+		/// number of sent messages kept per session for repair
+		size_t m_RepairWindow{ 0 };
+		/// settings of receiving queues
+		ReceivingQueue::Settings m_ReceivingSettings;
+		/// FEC settings for composed messages
+		FECSettings m_FEC;
+		/// append checksum to packets of composed messages
+		bool m_Checksum{ false };
+		/// impairments of "sim+udp" transport
+		bool m_Simulated{ false };
+		net::NetSimSettings m_SimSettings;
+		/// idle session is removed after the timeout, 0 - never
+		std::chrono::milliseconds m_SessionTimeout{ 10000 };
+		/// handler of removed sessions
+		OnSessionClosed m_OnSessionClosed;
+		/// lock for sessions table
+		std::mutex m_SessionsLock;
+		/// all sessions, several sessions with the same id are flows of one peer (sharded connecting side)
+		std::multimap<SessionID, Session::Ptr> m_Sessions;
 
 	public:
 		/// open transport
-		Error Open( const std::string& uri, EOpen mode, OnReceiveMsg onmsg ) override;
+		Error Open( const std::string& uri, const std::string& hints, EOpen mode, OnReceiveMsg onmsg ) override;
+
+		/// create message for sending to all sessions
+		IMsgCompose::Ptr ComposeMsg( const std::string& flow = std::string() ) override;
+
+		/// create message for sending to specified sessions, the shard and flows of peers are selected by flow key
+		IMsgCompose::Ptr ComposeMsg( const std::vector<SessionID>& sessions,
+									 const std::string& flow = std::string() ) override;
 
-		/// create message for sending
-		IMsgCompose::Ptr ComposeMsg() override;
+		/// get ids of known sessions
+		std::vector<SessionID> GetSessions() override;
+
+		/// get counters of all shards (atomics only)
+		TransportStats GetStats() override;
+
+		/// set handler of removed sessions, it is called by receiving thread
+		void SetOnSessionClosed( OnSessionClosed onclosed ) override;
 
 		/// close transport
 		Error Close() override;
 
 	protected:
-		/// working function of the network thread
-		void NetworkWork();
+		/// create shard, bind its socket for listening transport
+		Shard::Ptr CreateShard( const net::SocketAddress::Ptr& local_addr, bool reuse_port );
+
+		/// create shard for multicast group, receiving shard joins the group
+		Shard::Ptr CreateMulticastShard( const net::SocketAddress::Ptr& group, const utils::Params& params );
+
+		/// working function of the shard sending thread
+		void SendingWork( Shard* shard );
+
+		/// working function of the shard receiving thread
+		void ReceivingWork( Shard* shard );
+
+		/// create session and its queues
+		Session::Ptr CreateSession( Shard* shard, SessionID id, const net::SocketAddress::Ptr& address );
+
+		/// find session of received packet, new session is created for listening transport
+		Session::Ptr FindSession( Shard* shard, SessionID id, const ::sockaddr& from );
+
+		/// remove session of listening transport from shard and transport, handler is notified when the last flow
+		/// of the peer is removed
+		void CloseSession( Shard* shard, std::map<Shard::SessionKey, Session::Ptr>::iterator it );
+
+		/// send control packet to session
+		void SendControl( Session* session, UDPControl control );
+
+		/// send response with missing packets of message to session
+		void SendResponse( Session* session, MessageID msg_id, const std::vector<UDPPacketRange>& ranges );
+
+		/// send responses and drop expired messages of shard sessions, remove idle sessions and send keepalive
+		void CheckTimeouts( Shard* shard );
 
-		/// new message handler from ReceivingQueue
-		void OnReceive( MessageID msg_id, std::list<NetBuffer>& buffers );
+		/// new message handler from ReceivingQueue, trace is nullptr if the message is not traced
+		void OnReceive( Session* session, MessageID msg_id, std::list<NetBuffer>& buffers, const MsgTrace* trace );
 	};
 
 }  // namespace transports
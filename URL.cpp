@@ -1,8 +1,9 @@
-#include "url.h"
+#include "URL.h"
 #include <string>
 #include <algorithm>
 #include <cctype>
 #include <functional>
+#include <cstdlib>
 using namespace std;
 
 namespace comm {
@@ -64,5 +65,54 @@ namespace utils {
 
 	}  // Parse
 
+	Params Params::Parse( const std::string &query ) {
+		Params result;
+
+		size_t pos = ( !query.empty() && query[ 0 ] == '?' ) ? 1 : 0;
+		while( pos < query.length() ) {
+			size_t end = query.find( '&', pos );
+			if( end == std::string::npos ) {
+				end = query.length();
+			}
+
+			std::string pair = query.substr( pos, end - pos );
+			if( !pair.empty() ) {
+				size_t eq = pair.find( '=' );
+				if( eq != std::string::npos ) {
+					result.Values[ pair.substr( 0, eq ) ] = pair.substr( eq + 1 );
+				} else {
+					result.Values[ pair ] = std::string();
+				}
+			}
+
+			pos = end + 1;
+		}
+
+		return result;
+	}
+
+	void Params::Merge( const Params &other ) {
+		for( const auto &el : other.Values ) {
+			Values[ el.first ] = el.second;
+		}
+	}
+
+	bool Params::Has( const std::string &name ) const {
+		return Values.find( name ) != Values.end();
+	}
+
+	std::string Params::Get( const std::string &name, const std::string &def ) const {
+		auto found = Values.find( name );
+		return found != Values.end() ? found->second : def;
+	}
+
+	int Params::GetInt( const std::string &name, int def ) const {
+		auto found = Values.find( name );
+		if( found == Values.end() || found->second.empty() ) {
+			return def;
+		}
+		return std::atoi( found->second.c_str() );
+	}
+
 }  // namespace utils
 }  // namespace comm
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <map>
 
 // based on https://stackoverflow.com/questions/2616011/easy-way-to-parse-a-url-in-c-cross-platform
 
@@ -13,5 +14,25 @@ namespace utils {
 
 		static Uri Parse( const std::string &uri );
 	};  // uri
+
+	/**
+	*	Parameters in form "key1=value1&key2=value2" (URI query string or pipe hints)
+	*/
+	struct Params {
+	public:
+		std::map<std::string, std::string> Values;
+
+		/// parse query string, leading '?' is skipped
+		static Params Parse( const std::string &query );
+
+		/// add/replace values by values from other parameters
+		void Merge( const Params &other );
+
+		bool Has( const std::string &name ) const;
+
+		std::string Get( const std::string &name, const std::string &def = std::string() ) const;
+
+		int GetInt( const std::string &name, int def ) const;
+	};
 }  // namespace utils
 }  // namespace comm
@@ -0,0 +1,266 @@
+#include "VideoLayout.h"
+#include "CpuFeatures.h"
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+
+#if MFPIPE_X86_DISPATCH || defined( __SSE2__ )
+#include <immintrin.h>
+#endif
+
+namespace comm {
+namespace utils {
+	namespace video {
+
+		namespace {
+			/// chroma planes of 4:2:0 formats: half width and height, stride is half of luma stride
+			Layout Planar420( int width, int height, int row_bytes ) {
+				Layout layout;
+				size_t chroma_row = ( width + 1 ) / 2;
+				size_t chroma_rows = ( height + 1 ) / 2;
+				size_t chroma_stride = row_bytes / 2;
+				if( chroma_stride < chroma_row ) {
+					return layout;
+				}
+				layout.planes = 3;
+				layout.plane[ 0 ] = { 0, static_cast<size_t>( width ), static_cast<size_t>( height ),
+									  static_cast<size_t>( row_bytes ) };
+				size_t offset = static_cast<size_t>( row_bytes ) * height;
+				layout.plane[ 1 ] = { offset, chroma_row, chroma_rows, chroma_stride };
+				offset += chroma_stride * chroma_rows;
+				layout.plane[ 2 ] = { offset, chroma_row, chroma_rows, chroma_stride };
+				layout.size = offset + chroma_stride * chroma_rows;
+				return layout;
+			}
+
+			Layout Packed( size_t row_size, int height, int row_bytes ) {
+				Layout layout;
+				layout.planes = 1;
+				layout.plane[ 0 ] = { 0, row_size, static_cast<size_t>( height ), static_cast<size_t>( row_bytes ) };
+				layout.size = static_cast<size_t>( row_bytes ) * height;
+				return layout;
+			}
+
+			void CopyRowsSSE2( const byte* src, size_t src_stride, byte* dst, size_t dst_stride, size_t row_size,
+							   size_t rows ) {
+				for( size_t row = 0; row < rows; row++ ) {
+					const byte* s = src + row * src_stride;
+					byte* d = dst + row * dst_stride;
+					size_t i = 0;
+#if defined( __SSE2__ )
+					for( ; i + 16 <= row_size; i += 16 ) {
+						__m128i x = _mm_loadu_si128( reinterpret_cast<const __m128i*>( s + i ) );
+						_mm_storeu_si128( reinterpret_cast<__m128i*>( d + i ), x );
+					}
+#endif
+					if( i < row_size ) {
+						std::memcpy( d + i, s + i, row_size - i );
+					}
+				}
+			}
+
+			bool RowsEqualSSE2( const byte* a, size_t a_stride, const byte* b, size_t b_stride, size_t row_size,
+								size_t rows ) {
+				for( size_t row = 0; row < rows; row++ ) {
+					const byte* x = a + row * a_stride;
+					const byte* y = b + row * b_stride;
+					size_t i = 0;
+#if defined( __SSE2__ )
+					for( ; i + 16 <= row_size; i += 16 ) {
+						__m128i vx = _mm_loadu_si128( reinterpret_cast<const __m128i*>( x + i ) );
+						__m128i vy = _mm_loadu_si128( reinterpret_cast<const __m128i*>( y + i ) );
+						if( _mm_movemask_epi8( _mm_cmpeq_epi8( vx, vy ) ) != 0xFFFF ) {
+							return false;
+						}
+					}
+#endif
+					if( i < row_size && std::memcmp( x + i, y + i, row_size - i ) != 0 ) {
+						return false;
+					}
+				}
+				return true;
+			}
+
+#if MFPIPE_X86_DISPATCH
+			MFPIPE_TARGET( "avx2" )
+			void CopyRowsAVX2( const byte* src, size_t src_stride, byte* dst, size_t dst_stride, size_t row_size,
+							   size_t rows ) {
+				for( size_t row = 0; row < rows; row++ ) {
+					const byte* s = src + row * src_stride;
+					byte* d = dst + row * dst_stride;
+					size_t i = 0;
+					for( ; i + 32 <= row_size; i += 32 ) {
+						__m256i x = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( s + i ) );
+						_mm256_storeu_si256( reinterpret_cast<__m256i*>( d + i ), x );
+					}
+					if( i < row_size ) {
+						std::memcpy( d + i, s + i, row_size - i );
+					}
+				}
+			}
+
+			MFPIPE_TARGET( "avx2" )
+			bool RowsEqualAVX2( const byte* a, size_t a_stride, const byte* b, size_t b_stride, size_t row_size,
+								size_t rows ) {
+				for( size_t row = 0; row < rows; row++ ) {
+					const byte* x = a + row * a_stride;
+					const byte* y = b + row * b_stride;
+					size_t i = 0;
+					for( ; i + 32 <= row_size; i += 32 ) {
+						__m256i vx = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( x + i ) );
+						__m256i vy = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( y + i ) );
+						if( _mm256_movemask_epi8( _mm256_cmpeq_epi8( vx, vy ) ) != -1 ) {
+							return false;
+						}
+					}
+					if( i < row_size && std::memcmp( x + i, y + i, row_size - i ) != 0 ) {
+						return false;
+					}
+				}
+				return true;
+			}
+#endif
+
+			using CopyRowsFunc = void ( * )( const byte*, size_t, byte*, size_t, size_t, size_t );
+			using RowsEqualFunc = bool ( * )( const byte*, size_t, const byte*, size_t, size_t, size_t );
+
+			CopyRowsFunc SelectCopyRows() {
+#if MFPIPE_X86_DISPATCH
+				if( cpu::HasAVX2() ) {
+					return CopyRowsAVX2;
+				}
+#endif
+				return CopyRowsSSE2;
+			}
+
+			RowsEqualFunc SelectRowsEqual() {
+#if MFPIPE_X86_DISPATCH
+				if( cpu::HasAVX2() ) {
+					return RowsEqualAVX2;
+				}
+#endif
+				return RowsEqualSSE2;
+			}
+		}  // namespace
+
+		int PackedRowBytes( eMFCC fcc, int width ) {
+			if( width <= 0 || width > MaxDimension ) {
+				return 0;
+			}
+			switch( fcc ) {
+			case eMFCC_I420:
+			case eMFCC_YV12:
+			case eMFCC_NV12:
+				// even, so chroma rows of half stride fit
+				return ( width + 1 ) & ~1;
+			case eMFCC_YUY2:
+			case eMFCC_YVYU:
+			case eMFCC_UYVY:
+				return ( ( width + 1 ) / 2 ) * 4;
+			case eMFCC_RGB24:
+				return width * 3;
+			case eMFCC_RGB32:
+				return width * 4;
+			default:
+				return 0;
+			}
+		}
+
+		Layout GetLayout( eMFCC fcc, int width, int height, int row_bytes ) {
+			int packed = PackedRowBytes( fcc, width );
+			if( height <= 0 || height > MaxDimension || packed == 0 || row_bytes < packed || row_bytes > MaxRowBytes ) {
+				return Layout();
+			}
+			// planes of every format take less than two luma planes
+			if( static_cast<uint64_t>( row_bytes ) * static_cast<uint64_t>( height ) * 2 >
+				std::numeric_limits<size_t>::max() ) {
+				return Layout();
+			}
+
+			switch( fcc ) {
+			case eMFCC_I420:
+			case eMFCC_YV12:
+				return Planar420( width, height, row_bytes );
+			case eMFCC_NV12: {
+				Layout layout;
+				size_t chroma_rows = ( height + 1 ) / 2;
+				layout.planes = 2;
+				layout.plane[ 0 ] = { 0, static_cast<size_t>( width ), static_cast<size_t>( height ),
+									  static_cast<size_t>( row_bytes ) };
+				layout.plane[ 1 ] = { static_cast<size_t>( row_bytes ) * height, static_cast<size_t>( packed ),
+									  chroma_rows, static_cast<size_t>( row_bytes ) };
+				layout.size = static_cast<size_t>( row_bytes ) * ( height + chroma_rows );
+				return layout;
+			}
+			default:
+				return Packed( static_cast<size_t>( packed ), height, row_bytes );
+			}
+		}
+
+		void CopyRows( const byte* src, size_t src_stride, byte* dst, size_t dst_stride, size_t row_size,
+					   size_t rows ) {
+			if( src_stride == row_size && dst_stride == row_size ) {
+				std::memcpy( dst, src, row_size * rows );
+				return;
+			}
+
+			static const CopyRowsFunc copy = SelectCopyRows();
+			copy( src, src_stride, dst, dst_stride, row_size, rows );
+		}
+
+		bool RowsEqual( const byte* a, size_t a_stride, const byte* b, size_t b_stride, size_t row_size,
+						size_t rows ) {
+			static const RowsEqualFunc equal = SelectRowsEqual();
+			return equal( a, a_stride, b, b_stride, row_size, rows );
+		}
+
+		void CopyPlanes( const Layout& src_layout, const byte* src, const Layout& dst_layout, byte* dst ) {
+			for( size_t p = 0; p < std::min( src_layout.planes, dst_layout.planes ); p++ ) {
+				const Plane& from = src_layout.plane[ p ];
+				const Plane& to = dst_layout.plane[ p ];
+				size_t row_size = std::min( from.row_size, to.row_size );
+				size_t rows = std::min( from.rows, to.rows );
+				CopyRows( src + from.offset, from.stride, dst + to.offset, to.stride, row_size, rows );
+			}
+		}
+
+		void RowScatter::operator()( const byte* data, size_t size ) {
+			while( size > 0 && m_Plane < m_Layout.planes ) {
+				const Plane& plane = m_Layout.plane[ m_Plane ];
+				size_t row_size = m_Packed.plane[ m_Plane ].stride;
+				byte* row = m_Data + plane.offset + m_Row * plane.stride;
+
+				if( m_PosInRow == 0 && size >= row_size ) {
+					// whole rows of the piece
+					size_t rows = std::min( size / row_size, plane.rows - m_Row );
+					CopyRows( data, row_size, row, plane.stride, row_size, rows );
+					data += rows * row_size;
+					size -= rows * row_size;
+					NextRows( rows );
+					continue;
+				}
+
+				size_t copy_size = std::min( row_size - m_PosInRow, size );
+				std::memcpy( row + m_PosInRow, data, copy_size );
+				data += copy_size;
+				size -= copy_size;
+				m_PosInRow += copy_size;
+				if( m_PosInRow == row_size ) {
+					m_PosInRow = 0;
+					NextRows( 1 );
+				}
+			}
+		}
+
+		void RowScatter::NextRows( size_t rows ) {
+			m_Row += rows;
+			if( m_Row == m_Layout.plane[ m_Plane ].rows ) {
+				m_Row = 0;
+				m_Plane++;
+			}
+		}
+
+	}  // namespace video
+}  // namespace utils
+}  // namespace comm
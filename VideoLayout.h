@@ -0,0 +1,91 @@
+/**
+*	Memory layout of video frames by eMFCC format: planes, visible row size and stride of every plane.
+*	Used to send frames without stride padding and to restore padding (or apply other stride) on receive.
+*/
+#pragma once
+
+#include "MFTypes.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace comm {
+namespace utils {
+	namespace video {
+
+		constexpr size_t MaxPlanes = 3;
+		/// frames of larger width or height are rejected (e.g. forged properties of received frame)
+		constexpr int MaxDimension = 32768;
+		/// the largest stride, 4 bytes per pixel of the widest frame
+		constexpr int MaxRowBytes = MaxDimension * 4;
+
+		struct Plane {
+			/// offset of the plane in frame buffer
+			size_t offset;
+			/// bytes of visible pixels in row
+			size_t row_size;
+			size_t rows;
+			size_t stride;
+		};
+
+		struct Layout {
+			/// 0 - format is unknown or frame properties are invalid
+			size_t planes{ 0 };
+			Plane plane[ MaxPlanes ];
+			/// size of frame buffer
+			size_t size{ 0 };
+
+			bool IsKnown() const {
+				return planes != 0;
+			}
+		};
+
+		/**
+		*	Layout of frame
+		*	@param row_bytes - stride of the first plane, strides of other planes are derived from it
+		*	@return unknown layout for dimensions above MaxDimension or stride above MaxRowBytes
+		*/
+		Layout GetLayout( eMFCC fcc, int width, int height, int row_bytes );
+
+		/// the smallest row_bytes of format (no padding), 0 - format is unknown or width is out of range
+		int PackedRowBytes( eMFCC fcc, int width );
+
+		/// copy rows of row_size bytes between buffers with different strides, uses SSE2 and AVX2 if CPU has it
+		void CopyRows( const byte* src, size_t src_stride, byte* dst, size_t dst_stride, size_t row_size,
+					   size_t rows );
+
+		/// compare rows of row_size bytes, uses SSE2 and AVX2 if CPU has it
+		bool RowsEqual( const byte* a, size_t a_stride, const byte* b, size_t b_stride, size_t row_size,
+						size_t rows );
+
+		/// copy visible rows of all planes between layouts of the same frame (padding of dst is not touched)
+		void CopyPlanes( const Layout& src_layout, const byte* src, const Layout& dst_layout, byte* dst );
+
+		/**
+		*	Consumer of packed frame data arriving piece by piece (rows of packed layout, i.e. with the smallest
+		*	stride), rows are put to frame buffer with strides of layout
+		*/
+		class RowScatter {
+		protected:
+			const Layout& m_Packed;
+			const Layout& m_Layout;
+			byte* m_Data;
+			size_t m_Plane{ 0 };
+			size_t m_Row{ 0 };
+			size_t m_PosInRow{ 0 };
+
+		public:
+			/// @param layout - layout of frame buffer, its strides are not smaller than strides of packed layout
+			RowScatter( const Layout& packed, const Layout& layout, byte* data )
+				: m_Packed( packed )
+				, m_Layout( layout )
+				, m_Data( data ) {}
+
+			void operator()( const byte* data, size_t size );
+
+		protected:
+			void NextRows( size_t rows );
+		};
+
+	}  // namespace video
+}  // namespace utils
+}  // namespace comm
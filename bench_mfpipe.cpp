@@ -0,0 +1,389 @@
+/**
+*	Throughput/latency benchmark of MFPipeImpl: sweeps payload size, channel count, writer thread count and transport,
+*	every case sends objects (PipePut -> PipeGet) or messages (PipeMessagePut -> PipeMessageGet) through local pipe
+*	and reports msgs/sec, MB/sec, CPU seconds per GB and one-way latency percentiles as JSON.
+*
+*	Usage: mfpipe_bench [--key=value ...], see PrintUsage()
+*/
+#include "MFPipeImpl.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined( WIN32 )
+#include <WinSock2.h>
+#endif
+
+using namespace comm;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+	std::vector<size_t> sizes{ 64, 1024, 16 * 1024, 256 * 1024, 4 * 1024 * 1024, 16 * 1024 * 1024 };
+	std::vector<size_t> channels{ 1, 4 };
+	std::vector<size_t> threads{ 1, 4 };
+	std::vector<std::string> transports{ "udp?repair=256&nack=5" };
+	std::vector<std::string> kinds{ "object", "message" };
+	/// bytes sent by case, number of messages is budget / size within [MinMessages, max_messages]
+	size_t budget{ 64 * 1024 * 1024 };
+	size_t max_messages{ 2000 };
+	int port{ 14000 };
+	/// receiver gives up after timeout ms without messages
+	int timeout{ 2000 };
+	/// objects per PipePutBatch/PipeGetBatch of "batch" kind
+	size_t batch{ 64 };
+	std::string output{ "mfpipe_bench.json" };
+};
+
+constexpr size_t MinMessages = 4;
+
+struct Case {
+	std::string kind;
+	std::string transport;
+	size_t size;
+	size_t channels;
+	size_t threads;
+	size_t messages;
+};
+
+struct Result {
+	size_t received{ 0 };
+	size_t lost{ 0 };
+	double seconds{ 0 };
+	double cpu_seconds{ 0 };
+	/// one-way latencies in microseconds
+	std::vector<double> latencies;
+};
+
+int64_t NowNs() {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>( Clock::now().time_since_epoch() ).count();
+}
+
+/// CPU time of the process (std::clock() is process time on POSIX)
+double CpuSeconds() {
+	return static_cast<double>( std::clock() ) / CLOCKS_PER_SEC;
+}
+
+std::vector<std::string> Split( const std::string &value, char separator ) {
+	std::vector<std::string> result;
+	size_t pos = 0;
+	while( pos <= value.length() ) {
+		size_t end = value.find( separator, pos );
+		if( end == std::string::npos ) {
+			end = value.length();
+		}
+		if( end != pos ) {
+			result.push_back( value.substr( pos, end - pos ) );
+		}
+		pos = end + 1;
+	}
+	return result;
+}
+
+std::vector<size_t> SplitSizes( const std::string &value ) {
+	std::vector<size_t> result;
+	for( const auto &el : Split( value, ',' ) ) {
+		result.push_back( static_cast<size_t>( std::stoull( el ) ) );
+	}
+	return result;
+}
+
+void PrintUsage() {
+	std::cerr << "mfpipe_bench [options]\n"
+				 "  --sizes=64,1024,...      payload sizes in bytes\n"
+				 "  --channels=1,4           numbers of channels\n"
+				 "  --threads=1,4            numbers of writer threads\n"
+				 "  --transports=udp;...     transports, optional URI query: udp?shards=2 (';' separated)\n"
+				 "                           impaired link: sim+udp?loss=1%&delay=10ms&nack=5&repair=256\n"
+				 "  --kinds=object,message   PipePut/PipeGet and/or PipeMessagePut/PipeMessageGet,\n"
+				 "                           batch - PipePutBatch/PipeGetBatch\n"
+				 "  --batch=N                objects per batch of batch kind (default 64)\n"
+				 "  --budget=N               bytes per case (default 64 MB)\n"
+				 "  --max-messages=N         max messages per case (default 2000)\n"
+				 "  --port=N                 first local port, every case takes the next one (default 14000)\n"
+				 "  --timeout=ms             receiver gives up after ms without messages (default 2000)\n"
+				 "  --output=path            JSON report, '-' - stdout (default mfpipe_bench.json)\n";
+}
+
+bool ParseOptions( int argc, char **argv, Options &options ) {
+	for( int i = 1; i < argc; i++ ) {
+		std::string arg = argv[ i ];
+		size_t eq = arg.find( '=' );
+		if( arg.compare( 0, 2, "--" ) != 0 || eq == std::string::npos ) {
+			return false;
+		}
+		std::string key = arg.substr( 2, eq - 2 );
+		std::string value = arg.substr( eq + 1 );
+		if( key == "sizes" ) {
+			options.sizes = SplitSizes( value );
+		} else if( key == "channels" ) {
+			options.channels = SplitSizes( value );
+		} else if( key == "threads" ) {
+			options.threads = SplitSizes( value );
+		} else if( key == "transports" ) {
+			options.transports = Split( value, ';' );
+		} else if( key == "kinds" ) {
+			options.kinds = Split( value, ',' );
+		} else if( key == "budget" ) {
+			options.budget = static_cast<size_t>( std::stoull( value ) );
+		} else if( key == "max-messages" ) {
+			options.max_messages = static_cast<size_t>( std::stoull( value ) );
+		} else if( key == "port" ) {
+			options.port = std::stoi( value );
+		} else if( key == "timeout" ) {
+			options.timeout = std::stoi( value );
+		} else if( key == "batch" ) {
+			options.batch = std::max<size_t>( 1, static_cast<size_t>( std::stoull( value ) ) );
+		} else if( key == "output" ) {
+			options.output = value;
+		} else {
+			return false;
+		}
+	}
+	return true;
+}
+
+/// "udp?shards=2" -> "udp://127.0.0.1:port?shards=2"
+std::string MakeUri( const std::string &transport, int port ) {
+	size_t query = transport.find( '?' );
+	std::string uri = transport.substr( 0, query ) + "://127.0.0.1:" + std::to_string( port );
+	if( query != std::string::npos ) {
+		uri += transport.substr( query );
+	}
+	return uri;
+}
+
+/// payload starts with send time, so the receiver gets one-way latency
+void Stamp( byte *data ) {
+	int64_t now = NowNs();
+	std::memcpy( data, &now, sizeof( now ) );
+}
+
+double LatencyUs( const byte *data ) {
+	int64_t sent;
+	std::memcpy( &sent, data, sizeof( sent ) );
+	return static_cast<double>( NowNs() - sent ) / 1000.0;
+}
+
+Result RunCase( const Case &c, const Options &options, int port ) {
+	Result result;
+	std::string uri = MakeUri( c.transport, port );
+
+	MFPipeImpl reader;
+	MFPipeImpl writer;
+	if( reader.PipeCreate( uri, "" ) != Error::Ok || writer.PipeOpen( uri, 32, "" ) != Error::Ok ) {
+		result.lost = c.messages;
+		return result;
+	}
+
+	bool objects = c.kind == "object";
+	bool batch = c.kind == "batch";
+	// message i goes to channel i % channels from thread i % threads
+	std::vector<size_t> expected( c.channels, 0 );
+	for( size_t i = 0; i < c.messages; i++ ) {
+		expected[ i % c.channels ]++;
+	}
+
+	std::vector<std::vector<double>> latencies( c.channels );
+	std::vector<size_t> received( c.channels, 0 );
+	std::vector<std::thread> workers;
+
+	double cpu_start = CpuSeconds();
+	auto start = Clock::now();
+
+	for( size_t ch = 0; ch < c.channels; ch++ ) {
+		workers.emplace_back( [&, ch]() {
+			std::string channel = "ch" + std::to_string( ch );
+			latencies[ ch ].reserve( expected[ ch ] );
+			std::vector<std::shared_ptr<MF_BASE_TYPE>> batch_objects;
+			while( received[ ch ] < expected[ ch ] ) {
+				if( batch ) {
+					if( reader.PipeGetBatch( channel, batch_objects, expected[ ch ] - received[ ch ], options.timeout,
+											 "" ) != Error::Ok ) {
+						break;
+					}
+					for( const auto &object : batch_objects ) {
+						auto buffer = std::dynamic_pointer_cast<MF_BUFFER>( object );
+						if( buffer != nullptr && buffer->data.size() >= sizeof( int64_t ) ) {
+							latencies[ ch ].push_back( LatencyUs( buffer->data.data() ) );
+						}
+					}
+					received[ ch ] += batch_objects.size();
+					continue;
+				}
+				if( objects ) {
+					std::shared_ptr<MF_BASE_TYPE> object;
+					if( reader.PipeGet( channel, object, options.timeout, "" ) != Error::Ok ) {
+						break;
+					}
+					auto buffer = std::dynamic_pointer_cast<MF_BUFFER>( object );
+					if( buffer != nullptr && buffer->data.size() >= sizeof( int64_t ) ) {
+						latencies[ ch ].push_back( LatencyUs( buffer->data.data() ) );
+					}
+				} else {
+					std::string name, param;
+					if( reader.PipeMessageGet( channel, &name, &param, options.timeout ) != Error::Ok ) {
+						break;
+					}
+					if( param.size() >= sizeof( int64_t ) ) {
+						latencies[ ch ].push_back( LatencyUs( reinterpret_cast<const byte *>( param.data() ) ) );
+					}
+				}
+				received[ ch ]++;
+			}
+		} );
+	}
+
+	for( size_t t = 0; t < c.threads; t++ ) {
+		workers.emplace_back( [&, t]() {
+			auto buffer = std::make_shared<MF_BUFFER>();
+			buffer->data.assign( std::max( c.size, sizeof( int64_t ) ), 0x5a );
+			std::string param( std::max( c.size, sizeof( int64_t ) ), 'x' );
+			// objects of channel are collected to batch, every object is own buffer
+			std::vector<std::vector<std::shared_ptr<MF_BASE_TYPE>>> batches( c.channels );
+			for( size_t i = t; i < c.messages; i += c.threads ) {
+				std::string channel = "ch" + std::to_string( i % c.channels );
+				if( batch ) {
+					auto &pending = batches[ i % c.channels ];
+					auto object = std::make_shared<MF_BUFFER>( *buffer );
+					Stamp( object->data.data() );
+					pending.push_back( object );
+					if( pending.size() >= options.batch ) {
+						writer.PipePutBatch( channel, pending, options.timeout, "" );
+						pending.clear();
+					}
+				} else if( objects ) {
+					Stamp( buffer->data.data() );
+					writer.PipePut( channel, buffer, options.timeout, "" );
+				} else {
+					Stamp( reinterpret_cast<byte *>( &param[ 0 ] ) );
+					writer.PipeMessagePut( channel, "bench", param, options.timeout );
+				}
+			}
+			for( size_t ch = 0; ch < c.channels; ch++ ) {
+				if( !batches[ ch ].empty() ) {
+					writer.PipePutBatch( "ch" + std::to_string( ch ), batches[ ch ], options.timeout, "" );
+				}
+			}
+		} );
+	}
+
+	for( auto &worker : workers ) {
+		worker.join();
+	}
+
+	result.seconds = std::chrono::duration<double>( Clock::now() - start ).count();
+	result.cpu_seconds = CpuSeconds() - cpu_start;
+	for( size_t ch = 0; ch < c.channels; ch++ ) {
+		result.received += received[ ch ];
+		result.latencies.insert( result.latencies.end(), latencies[ ch ].begin(), latencies[ ch ].end() );
+	}
+	result.lost = c.messages - result.received;
+
+	writer.PipeClose();
+	reader.PipeClose();
+	return result;
+}
+
+/// nearest-rank percentile of sorted values
+double Percentile( const std::vector<double> &sorted, double p ) {
+	if( sorted.empty() ) {
+		return 0;
+	}
+	size_t rank = static_cast<size_t>( p / 100.0 * sorted.size() + 0.5 );
+	return sorted[ std::min( sorted.size() - 1, rank == 0 ? 0 : rank - 1 ) ];
+}
+
+std::string JsonString( const std::string &value ) {
+	std::string result = "\"";
+	for( char ch : value ) {
+		if( ch == '"' || ch == '\\' ) {
+			result += '\\';
+		}
+		result += ch;
+	}
+	return result + "\"";
+}
+
+void WriteCase( std::ostream &out, const Case &c, Result &r ) {
+	std::sort( r.latencies.begin(), r.latencies.end() );
+	double bytes = static_cast<double>( r.received ) * c.size;
+	double seconds = std::max( r.seconds, 1e-9 );
+
+	out << "    {\"kind\": " << JsonString( c.kind ) << ", \"transport\": " << JsonString( c.transport )
+		<< ", \"payload_bytes\": " << c.size << ", \"channels\": " << c.channels << ", \"threads\": " << c.threads
+		<< ", \"messages\": " << c.messages << ", \"received\": " << r.received << ", \"lost\": " << r.lost
+		<< ", \"seconds\": " << r.seconds << ", \"msgs_per_sec\": " << r.received / seconds
+		<< ", \"mb_per_sec\": " << bytes / seconds / ( 1024.0 * 1024.0 )
+		<< ", \"cpu_sec_per_gb\": " << ( bytes > 0 ? r.cpu_seconds / ( bytes / ( 1024.0 * 1024.0 * 1024.0 ) ) : 0 )
+		<< ", \"latency_us\": {\"p50\": " << Percentile( r.latencies, 50 )
+		<< ", \"p99\": " << Percentile( r.latencies, 99 ) << ", \"p99_9\": " << Percentile( r.latencies, 99.9 )
+		<< ", \"max\": " << ( r.latencies.empty() ? 0 : r.latencies.back() ) << "}}";
+}
+
+}  // namespace
+
+int main( int argc, char **argv ) {
+	Options options;
+	if( !ParseOptions( argc, argv, options ) ) {
+		PrintUsage();
+		return 1;
+	}
+
+#if defined( WIN32 )
+	WSADATA wsa_data;
+	if( ::WSAStartup( MAKEWORD( 2, 2 ), &wsa_data ) != 0 ) {
+		return 1;
+	}
+#endif
+
+	std::ostringstream report;
+	report << "{\n  \"benchmark\": \"mfpipe_bench\",\n  \"version\": 1,\n  \"cases\": [\n";
+
+	int port = options.port;
+	bool first = true;
+	for( const auto &transport : options.transports ) {
+		for( const auto &kind : options.kinds ) {
+			for( size_t channels : options.channels ) {
+				for( size_t threads : options.threads ) {
+					for( size_t size : options.sizes ) {
+						size_t messages = options.budget / std::max<size_t>( 1, size );
+						messages = std::min( options.max_messages, std::max( MinMessages, messages ) );
+						Case c{ kind, transport, size, std::max<size_t>( 1, channels ),
+								std::max<size_t>( 1, threads ), messages };
+						Result r = RunCase( c, options, port++ );
+						std::cerr << kind << " " << transport << " size=" << size << " channels=" << c.channels
+								  << " threads=" << c.threads << ": " << r.received << "/" << messages << " in "
+								  << r.seconds << " s" << std::endl;
+
+						report << ( first ? "" : ",\n" );
+						WriteCase( report, c, r );
+						first = false;
+					}
+				}
+			}
+		}
+	}
+	report << "\n  ]\n}\n";
+
+	if( options.output == "-" ) {
+		std::cout << report.str();
+	} else {
+		std::ofstream out( options.output );
+		out << report.str();
+	}
+
+#if defined( WIN32 )
+	::WSACleanup();
+#endif
+	return 0;
+}
@@ -0,0 +1,399 @@
+/**
+*	Micro-benchmarks of hot paths: ChunkWriter::Write/ChunkReader::Read of every traits type across buffer sizes
+*	and encodings, NetBuffersStore::Alloc/Release under contention, MF_BUFFER/MF_FRAME serialization round-trip.
+*	Reports ns/op, MB/sec and bytes/cycle (TSC cycles, x86 only) as JSON.
+*
+*	Usage: mfpipe_microbench [--key=value ...], see PrintUsage()
+*/
+#include "ChunkReaderWriter.h"
+#include "TransportUDP.h"
+#include "MFObjects.h"
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined( _MSC_VER )
+#include <intrin.h>
+#elif defined( __x86_64__ ) || defined( __i386__ )
+#include <x86intrin.h>
+#endif
+
+using namespace comm;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+	/// buffer (packet) sizes of chunk streams
+	std::vector<size_t> buffer_sizes{ 64, 1500, 64 * 1024 };
+	std::vector<size_t> threads{ 1, 2, 4, 8, 16, 32, 64 };
+	/// every measurement runs at least min_time ms
+	int min_time{ 200 };
+	/// only benchmarks with name containing filter
+	std::string filter;
+	std::string output{ "-" };
+};
+
+struct Measurement {
+	std::string name;
+	std::string params;
+	double ns_per_op{ 0 };
+	double mb_per_sec{ 0 };
+	/// 0 - cycle counter is not available
+	double bytes_per_cycle{ 0 };
+	uint64_t ops{ 0 };
+};
+
+uint64_t Cycles() {
+#if defined( _MSC_VER ) || defined( __x86_64__ ) || defined( __i386__ )
+	return __rdtsc();
+#else
+	return 0;
+#endif
+}
+
+/// keeps results of benchmarked code alive
+volatile size_t g_Sink = 0;
+
+/**
+*	Run fn( iterations ) with growing number of iterations until it takes min_time
+*	@param bytes_per_op - payload bytes of one operation
+*/
+template<typename FN>
+Measurement Measure( const std::string& name, const std::string& params, size_t bytes_per_op, int min_time, FN fn ) {
+	Measurement m;
+	m.name = name;
+	m.params = params;
+	for( uint64_t iterations = 1;; iterations *= 2 ) {
+		auto start = Clock::now();
+		uint64_t start_cycles = Cycles();
+		fn( iterations );
+		uint64_t cycles = Cycles() - start_cycles;
+		double seconds = std::chrono::duration<double>( Clock::now() - start ).count();
+		if( seconds * 1000 >= min_time || iterations >= ( uint64_t( 1 ) << 40 ) ) {
+			double bytes = static_cast<double>( bytes_per_op ) * iterations;
+			m.ops = iterations;
+			m.ns_per_op = seconds * 1e9 / iterations;
+			m.mb_per_sec = bytes / seconds / ( 1024.0 * 1024.0 );
+			m.bytes_per_cycle = cycles != 0 ? bytes / cycles : 0;
+			return m;
+		}
+	}
+}
+
+/**
+*	Sink policy handing out buffers of fixed size from pool, every writer starts from the beginning of the pool and
+*	pool grows when writer needs more buffers. Refs are in deque: writer keeps pointers to them until Flush().
+*/
+class PoolSink {
+protected:
+	std::vector<std::vector<byte>>& m_Pool;
+	std::deque<NetBufferRef>& m_Refs;
+	size_t m_BufferSize;
+	size_t m_Next{ 0 };
+
+public:
+	PoolSink( std::vector<std::vector<byte>>& pool, std::deque<NetBufferRef>& refs, size_t buffer_size )
+		: m_Pool( pool )
+		, m_Refs( refs )
+		, m_BufferSize( buffer_size ) {}
+
+	NetBufferRef* Alloc( size_t size ) {
+		if( m_Next == m_Pool.size() ) {
+			m_Pool.emplace_back( m_BufferSize );
+			m_Refs.emplace_back();
+		}
+		m_Refs[ m_Next ] = NetBufferRef{ m_Pool[ m_Next ].data(), m_BufferSize };
+		return &m_Refs[ m_Next++ ];
+	}
+
+	void Write( NetBufferRef* buffer, size_t len ) {
+		buffer->size = len;
+	}
+
+	/// buffers written by this sink
+	size_t Count() const {
+		return m_Next;
+	}
+};
+
+const char* EncodingName( utils::EEncoding encoding ) {
+	return encoding == utils::EEncoding::Compact ? "compact" : "fixed";
+}
+
+/// values of every traits type
+struct Values {
+	uint32_t u32{ 123456789 };
+	byte b{ 0x5a };
+	char c{ 'x' };
+	std::string str = std::string( 32, 's' );
+	std::vector<byte> small_bytes = std::vector<byte>( 256, 0x11 );
+	std::vector<byte> large_bytes = std::vector<byte>( 64 * 1024, 0x22 );
+	MFFrameHeader block = MFFrameHeader::From( M_TIME{ 1, 2 }, M_AV_PROPS{} );
+};
+
+/// fn( name, value ) for every traits type
+template<typename FN>
+void ForEachType( Values& values, FN fn ) {
+	fn( "uint32", values.u32 );
+	fn( "byte", values.b );
+	fn( "char", values.c );
+	fn( "string32", values.str );
+	fn( "bytes256", values.small_bytes );
+	fn( "bytes64k", values.large_bytes );
+	fn( "block", values.block );
+}
+
+template<typename TYPE>
+bool WriteValue( utils::ChunkWriter& writer, const TYPE& val ) {
+	return writer.Write( val );
+}
+
+bool WriteValue( utils::ChunkWriter& writer, const MFFrameHeader& val ) {
+	return writer.WriteBlock( val );
+}
+
+template<typename TYPE>
+bool ReadValue( utils::ChunkReader& reader, TYPE& val ) {
+	return reader.Read( val );
+}
+
+bool ReadValue( utils::ChunkReader& reader, MFFrameHeader& val ) {
+	uint32_t size = 0;
+	return reader.ReadBlock( val, size );
+}
+
+template<typename TYPE>
+size_t PayloadSize( const TYPE& val ) {
+	return sizeof( val );
+}
+
+size_t PayloadSize( const std::string& val ) {
+	return val.size();
+}
+
+size_t PayloadSize( const std::vector<byte>& val ) {
+	return val.size();
+}
+
+void BenchChunks( const Options& options, std::vector<Measurement>& results ) {
+	Values values;
+	for( auto encoding : { utils::EEncoding::Fixed, utils::EEncoding::Compact } ) {
+		for( size_t buffer_size : options.buffer_sizes ) {
+			ForEachType( values, [&]( const char* type, auto& value ) {
+				std::string params = std::string( "type=" ) + type + "&encoding=" + EncodingName( encoding ) +
+									 "&buffer=" + std::to_string( buffer_size );
+				size_t payload = PayloadSize( value );
+
+				// writer keeps all buffers of stream, so stream is restarted every count values (about 1MB)
+				size_t count = std::max<size_t>( 16, ( 1024 * 1024 ) / payload );
+				std::vector<std::vector<byte>> pool;
+				std::deque<NetBufferRef> refs;
+				results.push_back(
+					Measure( "ChunkWriter::Write", params, payload, options.min_time, [&]( uint64_t iterations ) {
+						for( uint64_t done = 0; done < iterations; ) {
+							utils::SinkChunkWriter<PoolSink> writer( PoolSink( pool, refs, buffer_size ), encoding );
+							for( size_t i = 0; i < count && done < iterations; i++, done++ ) {
+								WriteValue( writer, value );
+							}
+							writer.Flush();
+						}
+					} ) );
+
+				// stream for reading, values are split between buffers
+				size_t buffers = 0;
+				{
+					utils::SinkChunkWriter<PoolSink> writer( PoolSink( pool, refs, buffer_size ), encoding );
+					for( size_t i = 0; i < count; i++ ) {
+						WriteValue( writer, value );
+					}
+					writer.Flush();
+					buffers = writer.GetSink().Count();
+				}
+				ConstNetBufferSeq seq;
+				for( size_t i = 0; i < buffers; i++ ) {
+					seq.push_back( &refs[ i ] );
+				}
+
+				auto read_value = value;
+				results.push_back(
+					Measure( "ChunkReader::Read", params, payload, options.min_time, [&]( uint64_t iterations ) {
+						for( uint64_t done = 0; done < iterations; ) {
+							utils::ChunkReader reader( seq, encoding );
+							for( size_t i = 0; i < count && done < iterations; i++, done++ ) {
+								g_Sink = g_Sink + ( ReadValue( reader, read_value ) ? 1 : 0 );
+							}
+						}
+					} ) );
+			} );
+		}
+	}
+}
+
+void BenchBuffersStore( const Options& options, std::vector<Measurement>& results ) {
+	using transports::NetBuffer;
+	using transports::NetBuffersStore;
+
+	for( size_t threads : options.threads ) {
+		for( size_t batch : { 1, 16 } ) {
+			auto store = std::make_shared<NetBuffersStore>();
+			std::string params = "threads=" + std::to_string( threads ) + "&batch=" + std::to_string( batch );
+			// op is Alloc + Release of batch packets by every thread, ns/op is wall time per op of one thread
+			results.push_back( Measure( "NetBuffersStore::Alloc/Release", params, batch * 1500, options.min_time,
+										[&]( uint64_t iterations ) {
+											std::vector<std::thread> workers;
+											for( size_t t = 0; t < threads; t++ ) {
+												workers.emplace_back( [&]() {
+													std::list<NetBuffer> list;
+													for( uint64_t i = 0; i < iterations; i++ ) {
+														store->Alloc( list, 1500, batch );
+														store->Release( list );
+													}
+												} );
+											}
+											for( auto& worker : workers ) {
+												worker.join();
+											}
+										} ) );
+		}
+	}
+}
+
+/// write object to contiguous buffer and load it back
+template<typename OBJ>
+Measurement RoundTrip( const std::string& params, const OBJ& object, size_t payload, int min_time ) {
+	std::vector<byte> data;
+	return Measure( "RoundTrip", params, payload, min_time, [&]( uint64_t iterations ) {
+		for( uint64_t i = 0; i < iterations; i++ ) {
+			data.clear();
+			utils::SinkChunkWriter<utils::VectorSink> writer( utils::VectorSink( data ), utils::EEncoding::Compact );
+			object.Write( writer );
+			writer.Flush();
+
+			OBJ loaded;
+			utils::ChunkReader reader( data.data(), data.size(), utils::EEncoding::Compact );
+			g_Sink = g_Sink + ( loaded.Load( reader ) ? 1 : 0 );
+		}
+	} );
+}
+
+void BenchObjects( const Options& options, std::vector<Measurement>& results ) {
+	for( size_t size : { 1024, 1024 * 1024 } ) {
+		MF_BUFFER buffer;
+		buffer.data.assign( size, 0x33 );
+		results.push_back(
+			RoundTrip( "object=MF_BUFFER&size=" + std::to_string( size ), buffer, size, options.min_time ) );
+	}
+
+	MF_FRAME frame;
+	frame.av_props.vidProps = { eMFCC_I420, 1920, 1080, 1920, 1, 1, 25.0 };
+	frame.vec_video_data.assign( 1920 * 1080 * 3 / 2, 0x44 );
+	frame.vec_audio_data.assign( 7680, 0x55 );
+	size_t size = frame.vec_video_data.size() + frame.vec_audio_data.size();
+	results.push_back( RoundTrip( "object=MF_FRAME&format=I420&width=1920&height=1080", frame, size,
+								  options.min_time ) );
+}
+
+std::vector<size_t> SplitSizes( const std::string& value ) {
+	std::vector<size_t> result;
+	std::istringstream in( value );
+	std::string item;
+	while( std::getline( in, item, ',' ) ) {
+		if( !item.empty() ) {
+			result.push_back( static_cast<size_t>( std::stoull( item ) ) );
+		}
+	}
+	return result;
+}
+
+void PrintUsage() {
+	std::cerr << "mfpipe_microbench [options]\n"
+				 "  --buffers=64,1500,...    buffer sizes of chunk streams\n"
+				 "  --threads=1,2,...        thread counts of NetBuffersStore benchmark\n"
+				 "  --min-time=ms            min time of every measurement (default 200)\n"
+				 "  --filter=text            run benchmarks with name containing text (chunk, store, roundtrip)\n"
+				 "  --output=path            JSON report, '-' - stdout (default)\n";
+}
+
+bool ParseOptions( int argc, char** argv, Options& options ) {
+	for( int i = 1; i < argc; i++ ) {
+		std::string arg = argv[ i ];
+		size_t eq = arg.find( '=' );
+		if( arg.compare( 0, 2, "--" ) != 0 || eq == std::string::npos ) {
+			return false;
+		}
+		std::string key = arg.substr( 2, eq - 2 );
+		std::string value = arg.substr( eq + 1 );
+		if( key == "buffers" ) {
+			options.buffer_sizes = SplitSizes( value );
+		} else if( key == "threads" ) {
+			options.threads = SplitSizes( value );
+		} else if( key == "min-time" ) {
+			options.min_time = std::stoi( value );
+		} else if( key == "filter" ) {
+			options.filter = value;
+		} else if( key == "output" ) {
+			options.output = value;
+		} else {
+			return false;
+		}
+	}
+	return true;
+}
+
+void WriteReport( std::ostream& out, const std::vector<Measurement>& results ) {
+	out << "{\n  \"benchmark\": \"mfpipe_microbench\",\n  \"version\": 1,\n  \"results\": [\n";
+	for( size_t i = 0; i < results.size(); i++ ) {
+		const auto& m = results[ i ];
+		out << "    {\"name\": \"" << m.name << "\", \"params\": \"" << m.params << "\", \"ops\": " << m.ops
+			<< ", \"ns_per_op\": " << m.ns_per_op << ", \"mb_per_sec\": " << m.mb_per_sec
+			<< ", \"bytes_per_cycle\": ";
+		if( m.bytes_per_cycle != 0 ) {
+			out << m.bytes_per_cycle;
+		} else {
+			out << "null";
+		}
+		out << "}" << ( i + 1 < results.size() ? "," : "" ) << "\n";
+	}
+	out << "  ]\n}\n";
+}
+
+}  // namespace
+
+int main( int argc, char** argv ) {
+	Options options;
+	if( !ParseOptions( argc, argv, options ) ) {
+		PrintUsage();
+		return 1;
+	}
+
+	auto enabled = [&]( const std::string& group ) {
+		return options.filter.empty() || group.find( options.filter ) != std::string::npos;
+	};
+
+	std::vector<Measurement> results;
+	if( enabled( "chunk" ) ) {
+		BenchChunks( options, results );
+	}
+	if( enabled( "store" ) ) {
+		BenchBuffersStore( options, results );
+	}
+	if( enabled( "roundtrip" ) ) {
+		BenchObjects( options, results );
+	}
+
+	if( options.output == "-" ) {
+		WriteReport( std::cout, results );
+	} else {
+		std::ofstream out( options.output );
+		WriteReport( out, results );
+	}
+	return 0;
+}
@@ -0,0 +1,149 @@
+/**
+*	Replay of capture file ("capture=path" hint of PipeCreate/PipeOpen, see Capture.h): captured objects and
+*	messages are put to a pipe at original pacing (optionally scaled) or as fast as possible, so real streams become
+*	repeatable load tests.
+*
+*	Usage: mfpipe_replay --capture=path [--key=value ...], see PrintUsage()
+*/
+#include "MFPipeImpl.h"
+#include "Capture.h"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#if defined( WIN32 )
+#include <WinSock2.h>
+#endif
+
+using namespace comm;
+
+namespace {
+
+struct Options {
+	std::string capture;
+	std::string pipe{ "udp://127.0.0.1:14500" };
+	/// "open" - PipeOpen (connect to listening consumer), "create" - PipeCreate (serve connecting consumers)
+	std::string mode{ "open" };
+	std::string hints;
+	/// 0 - as fast as possible
+	double speed{ 1.0 };
+	/// "sent", "received" or "all"
+	std::string direction{ "all" };
+	std::string channel;
+	int max_wait{ 1000 };
+	/// pause before replay in ms, e.g. for consumers to connect to created pipe
+	int delay{ 0 };
+	/// number of replays of the capture
+	int loops{ 1 };
+};
+
+void PrintUsage() {
+	std::cerr << "mfpipe_replay --capture=path [options]\n"
+				 "  --capture=path           capture file\n"
+				 "  --pipe=uri               pipe (default udp://127.0.0.1:14500)\n"
+				 "  --mode=open|create       PipeOpen or PipeCreate of the pipe (default open)\n"
+				 "  --hints=a=1&b=2          hints of PipeOpen/PipeCreate\n"
+				 "  --speed=N                pacing factor, 2 - twice faster, 0 - as fast as possible (default 1)\n"
+				 "  --direction=all          replay sent, received or all entries (default all)\n"
+				 "  --channel=name           replay only the channel\n"
+				 "  --max-wait=ms            _nMaxWaitMs of puts (default 1000)\n"
+				 "  --delay=ms               pause before replay (default 0)\n"
+				 "  --loops=N                replay the capture N times (default 1)\n";
+}
+
+bool ParseOptions( int argc, char **argv, Options &options ) {
+	for( int i = 1; i < argc; i++ ) {
+		std::string arg = argv[ i ];
+		size_t eq = arg.find( '=' );
+		if( arg.compare( 0, 2, "--" ) != 0 || eq == std::string::npos ) {
+			return false;
+		}
+		std::string key = arg.substr( 2, eq - 2 );
+		std::string value = arg.substr( eq + 1 );
+		if( key == "capture" ) {
+			options.capture = value;
+		} else if( key == "pipe" ) {
+			options.pipe = value;
+		} else if( key == "mode" ) {
+			options.mode = value;
+		} else if( key == "hints" ) {
+			options.hints = value;
+		} else if( key == "speed" ) {
+			options.speed = std::stod( value );
+		} else if( key == "direction" ) {
+			options.direction = value;
+		} else if( key == "channel" ) {
+			options.channel = value;
+		} else if( key == "max-wait" ) {
+			options.max_wait = std::stoi( value );
+		} else if( key == "delay" ) {
+			options.delay = std::stoi( value );
+		} else if( key == "loops" ) {
+			options.loops = std::stoi( value );
+		} else {
+			return false;
+		}
+	}
+	return !options.capture.empty() && ( options.mode == "open" || options.mode == "create" ) &&
+		   ( options.direction == "all" || options.direction == "sent" || options.direction == "received" );
+}
+
+}  // namespace
+
+int main( int argc, char **argv ) {
+	Options options;
+	if( !ParseOptions( argc, argv, options ) ) {
+		PrintUsage();
+		return 1;
+	}
+
+	auto reader = utils::capture::Reader::Open( options.capture );
+	if( reader == nullptr ) {
+		std::cerr << "unable read capture " << options.capture << std::endl;
+		return 1;
+	}
+	std::cerr << "capture " << options.capture << ": " << reader->GetCount() << " entries"
+			  << ( reader->IsIndexed() ? "" : " (not closed, entries are scanned)" ) << std::endl;
+
+#if defined( WIN32 )
+	WSADATA wsa_data;
+	if( ::WSAStartup( MAKEWORD( 2, 2 ), &wsa_data ) != 0 ) {
+		return 1;
+	}
+#endif
+
+	MFPipeImpl pipe;
+	Error err = options.mode == "open" ? pipe.PipeOpen( options.pipe, 32, options.hints )
+									   : pipe.PipeCreate( options.pipe, options.hints );
+	if( err != Error::Ok ) {
+		std::cerr << "unable " << options.mode << " pipe " << options.pipe << std::endl;
+		return 1;
+	}
+	std::this_thread::sleep_for( std::chrono::milliseconds( options.delay ) );
+
+	utils::capture::ReplaySettings settings;
+	settings.paced = options.speed > 0;
+	settings.speed = options.speed;
+	settings.sent = options.direction != "received";
+	settings.received = options.direction != "sent";
+	settings.channel = options.channel;
+	settings.max_wait_ms = options.max_wait;
+
+	int res = 0;
+	for( int loop = 0; loop < options.loops; loop++ ) {
+		utils::capture::ReplayStats stats;
+		err = utils::capture::Replay( pipe, *reader, settings, &stats );
+		std::cerr << "replay " << loop + 1 << ": objects=" << stats.objects << " messages=" << stats.messages
+				  << " failed=" << stats.failed << " seconds=" << stats.seconds
+				  << " max_lag_ms=" << stats.max_lag / 1e6 << std::endl;
+		res = err != Error::Ok ? 1 : res;
+	}
+
+	pipe.PipeClose();
+
+#if defined( WIN32 )
+	::WSACleanup();
+#endif
+	return res;
+}
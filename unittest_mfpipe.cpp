@@ -1,10 +1,27 @@
 #include "MFPipeImpl.h"
 #include "ChunkReaderWriter.h"
+#include "TransportUDP.h"
+#include "Log.h"
+#include "Trace.h"
+#include "Metrics.h"
+#include "SocketUDP.h"
+#include "NetSimulator.h"
+#include "Capture.h"
+#include "SpillQueue.h"
+#include "Executor.h"
+#include "ReadyEvent.h"
 #include <iostream>
 #include <atomic>
+#include <thread>
+#include <algorithm>
+#include <cassert>
+#include <filesystem>
+#include <limits>
 
 #if defined( WIN32 )
 #include <WinSock2.h>
+#else
+#include <poll.h>
 #endif
 
 #define PACKETS_COUNT ( 8 )
@@ -15,6 +32,46 @@
 
 using namespace comm;
 
+void TestExecutor() {
+	using namespace comm::utils;
+
+	// queued tasks are run before destruction of pool
+	std::atomic<int> counter{ 0 };
+	{
+		ThreadPoolExecutor pool( 3 );
+		assert( pool.GetThreads() == 3 );
+		for( int i = 0; i < 1000; i++ ) {
+			pool.Post( [&]() { counter++; } );
+		}
+	}
+	assert( counter == 1000 );
+
+	InlineExecutor executor;
+	executor.Post( [&]() { counter++; } );
+	assert( counter == 1001 );
+
+	// readiness event
+	auto event = ReadyEvent::Create();
+	assert( event != nullptr && event->GetHandle() != -1 && !event->IsSignaled() );
+	auto readable = [&]() {
+#if defined( WIN32 )
+		return ::WaitForSingleObject( reinterpret_cast<HANDLE>( event->GetHandle() ), 0 ) == WAIT_OBJECT_0;
+#else
+		pollfd fd{ static_cast<int>( event->GetHandle() ), POLLIN, 0 };
+		return ::poll( &fd, 1, 0 ) == 1 && ( fd.revents & POLLIN ) != 0;
+#endif
+	};
+	assert( !readable() );
+	event->Signal();
+	event->Signal();
+	assert( readable() && event->IsSignaled() );
+	event->Clear();
+	assert( !readable() && !event->IsSignaled() );
+	event->Clear();
+	event->Signal();
+	assert( readable() );
+}
+
 int TestMethod1() {
 	Error err;
 
@@ -152,105 +209,2840 @@ int TestMethod2() {
 	return 0;
 }
 
-void TestChunkReaderAndWriter() {
-	using namespace comm::utils;
+int TestMethod3() {
+	// Sharded transport test
+	// several threads send buffers through sockets of both sides bound with SO_REUSEPORT
 
-	struct Buf {
-		std::vector<comm::byte> buffer;
-		comm::NetBufferRef ref;
-	};
+	MFPipeImpl MFPipe_Read;
+	Error err = MFPipe_Read.PipeCreate( "udp://127.0.0.1:12346?shards=4", "" );
+	assert( err == Error::Ok );
 
-	std::string str{ "string6789ABCDEF0123" };
-	std::string emptystr;
-	std::string zerostr{ "" };
-	std::vector<comm::byte> bb{ 0x00, 0x55, 0xAA };
+	MFPipeImpl MFPipe_Write;
+	err = MFPipe_Write.PipeOpen( "udp://127.0.0.1:12346", 32, "shards=4" );
+	assert( err == Error::Ok );
 
-	for( size_t sz = 1; sz <= 50; sz++ ) {
-		std::vector<std::unique_ptr<Buf>> buffers;
-		auto allocator = [&]( size_t size ) -> comm::NetBufferRef* {
-			buffers.emplace_back( new Buf() );
-			auto& buf = buffers.back();
-			buf->buffer.resize( sz );
-			buf->ref.data = buf->buffer.data();
-			buf->ref.size = buf->buffer.size();
-			return &buf->ref;
-		};
+	const int threads_count = 4;
+	const int iterations = 16;
 
-		auto writer = []( comm::NetBufferRef* buf, size_t len ) { buf->size = len; };
+	std::vector<std::unique_ptr<std::thread>> threads;
+	threads.resize( threads_count );
+	std::atomic<int> channel{ 0 };
+	for( auto& t : threads ) {
+		t.reset( new std::thread( [&]() {
+			Error err;
+			int ch_num = channel++;
+			std::string ch = "shard#" + std::to_string( ch_num );
 
-		ChunkWriter chunk_writer( allocator, writer );
-		bool res = chunk_writer.Write( (uint32_t)1000 );
-		res &= chunk_writer.Write( (char)'a' );
-		res &= chunk_writer.Write( (char)'b' );
-		res &= chunk_writer.Write( str );
-		res &= chunk_writer.Write( emptystr );
-		res &= chunk_writer.Write( zerostr );
-		res &= chunk_writer.Write( bb );
-		chunk_writer.Flush();
+			for( int i = 0; i < iterations; i++ ) {
+				auto buffer_in = std::make_shared<MF_BUFFER>();
+				buffer_in->flags = eMFBF_Buffer;
+				buffer_in->data.resize( 4096 + i * 1000 );
+				for( size_t n = 0; n < buffer_in->data.size(); n++ ) {
+					buffer_in->data[ n ] = static_cast<uint8_t>( n + i + ch_num );
+				}
 
-		size_t total_size = 0;
-		std::vector<comm::byte> output;
-		std::for_each( buffers.begin(), buffers.end(), [&]( const auto& el ) {
-			total_size += el->ref.size;
-			output.insert( output.end(), el->buffer.begin(), el->buffer.begin() + el->ref.size );
-		} );
+				err = MFPipe_Write.PipePut( ch, buffer_in, 100, "" );
+				assert( err == Error::Ok );
 
-		assert( total_size == 64 );
+				std::shared_ptr<MF_BASE_TYPE> buffer_out;
+				err = MFPipe_Read.PipeGet( ch, buffer_out, 100, "" );
+				assert( err == Error::Ok );
 
-		size_t num_buffers = ( total_size + sz - 1 ) / sz;
-		assert( num_buffers == buffers.size() );
+				auto buffer = std::dynamic_pointer_cast<MF_BUFFER>( buffer_out );
+				assert( buffer != nullptr );
+				assert( buffer->data == buffer_in->data );
+			}
+		} ) );
+	}
 
-		ConstNetBufferSeq seq;
-		for( const auto& el : buffers ) {
-			seq.push_back( &el->ref );
+	for( auto& t : threads ) {
+		if( t->joinable() ) {
+			t->join();
 		}
-		ChunkReader chunk_reader( seq );
+	}
 
-		uint32_t read_uint32;
-		res = chunk_reader.Read( read_uint32 );
-		assert( read_uint32 == 1000 );
+	// messages of one channel go through one shard and arrive in order
+	const int count = 200;
+	for( int i = 0; i < count; i++ ) {
+		auto buffer_in = std::make_shared<MF_BUFFER>();
+		buffer_in->flags = eMFBF_Buffer;
+		buffer_in->data.assign( 1000, static_cast<uint8_t>( i ) );
+		err = MFPipe_Write.PipePut( "ordered", buffer_in, 100, "" );
+		assert( err == Error::Ok );
+	}
+	for( int i = 0; i < count; i++ ) {
+		std::shared_ptr<MF_BASE_TYPE> buffer_out;
+		err = MFPipe_Read.PipeGet( "ordered", buffer_out, 1000, "" );
+		assert( err == Error::Ok );
 
-		char read_c0;
-		res &= chunk_reader.Read( read_c0 );
-		assert( read_c0 == 'a' );
+		auto buffer = std::dynamic_pointer_cast<MF_BUFFER>( buffer_out );
+		assert( buffer != nullptr && buffer->data.size() == 1000 );
+		assert( buffer->data[ 0 ] == static_cast<uint8_t>( i ) );
+	}
 
-		char read_c1;
-		res &= chunk_reader.Read( read_c1 );
-		assert( read_c1 == 'b' );
+	MFPipe_Write.PipeClose();
+	MFPipe_Read.PipeClose();
 
-		std::string read_str;
-		res &= chunk_reader.Read( read_str );
-		assert( read_str == str );
+	return 0;
+}
 
-		std::string read_strempty;
-		res &= chunk_reader.Read( read_strempty );
-		assert( read_strempty == emptystr );
+int TestMethod4() {
+	// Multi-client test
+	// one listening pipe serves several connecting pipes, channels are sent to subscribers only
 
-		std::string read_strzero;
-		res &= chunk_reader.Read( read_strzero );
-		assert( read_strzero == zerostr );
+	Error err;
 
-		std::vector<byte> read_vec;
-		res &= chunk_reader.Read( read_vec );
-		assert( read_vec == bb );
+	MFPipeImpl MFPipe_Server;
+	err = MFPipe_Server.PipeCreate( "udp://127.0.0.1:12347", "" );
+	assert( err == Error::Ok );
+
+	const int clients_count = 6;
+	std::vector<std::unique_ptr<MFPipeImpl>> clients;
+	for( int i = 0; i < clients_count; i++ ) {
+		clients.emplace_back( new MFPipeImpl() );
+		std::string hints = ( i % 2 ) == 0 ? "channels=even" : "channels=odd";
+		err = clients.back()->PipeOpen( "udp://127.0.0.1:12347", 32, hints );
+		assert( err == Error::Ok );
+	}
+
+	// every client is known by the server
+	for( int i = 0; i < clients_count; i++ ) {
+		err = clients[ i ]->PipeMessagePut( "up", "hello", std::to_string( i ), 100 );
+		assert( err == Error::Ok );
+	}
+	for( int i = 0; i < clients_count; i++ ) {
+		std::string name;
+		err = MFPipe_Server.PipeMessageGet( "up", &name, NULL, 100 );
+		assert( err == Error::Ok );
+		assert( name == "hello" );
+	}
+
+	// single put is delivered to subscribers of the channel
+	err = MFPipe_Server.PipeMessagePut( "even", "event", "even-param", 100 );
+	assert( err == Error::Ok );
+
+	// channel without subscribers is delivered to everybody
+	auto buffer_in = std::make_shared<MF_BUFFER>();
+	buffer_in->flags = eMFBF_Buffer;
+	buffer_in->data.assign( 3000, 0x5A );
+	err = MFPipe_Server.PipePut( "all", buffer_in, 100, "" );
+	assert( err == Error::Ok );
+
+	for( int i = 0; i < clients_count; i++ ) {
+		std::string param;
+		err = clients[ i ]->PipeMessageGet( "even", NULL, &param, 100 );
+		assert( err == ( ( i % 2 ) == 0 ? Error::Ok : Error::Timeout ) );
+
+		std::shared_ptr<MF_BASE_TYPE> buffer_out;
+		err = clients[ i ]->PipeGet( "all", buffer_out, 100, "" );
+		assert( err == Error::Ok );
+		assert( std::dynamic_pointer_cast<MF_BUFFER>( buffer_out )->data == buffer_in->data );
 	}
+
+	for( auto& client : clients ) {
+		client->PipeClose();
+	}
+	MFPipe_Server.PipeClose();
+
+	return 0;
 }
 
-int main( void ) {
-#if defined( WIN32 )
-	// TODO: Move this stuff to Transport implementation
-	WSADATA wsa_data;
-	int res = ::WSAStartup( MAKEWORD( 2, 2 ), &wsa_data );
-	if( res == 0 )
-#endif
-	{
-		TestChunkReaderAndWriter();
-		if( TestMethod1() ) {
-			std::cerr << "TestMethod1: Failed" << std::endl;
-			return 1;
+int TestMethod5() {
+	// Multicast test
+	// one connecting pipe sends to multicast group, every listening pipe joined to the group receives the data
+
+	Error err;
+	const std::string group = "udp://239.255.0.1:12348?multicast=1&iface=127.0.0.1";
+
+	MFPipeImpl MFPipe_Read[ 3 ];
+	for( auto& pipe : MFPipe_Read ) {
+		err = pipe.PipeCreate( group, "" );
+		assert( err == Error::Ok );
+	}
+
+	MFPipeImpl MFPipe_Write;
+	err = MFPipe_Write.PipeOpen( group, 32, "ttl=1" );
+	assert( err == Error::Ok );
+
+	for( int i = 0; i < 4; i++ ) {
+		auto buffer_in = std::make_shared<MF_BUFFER>();
+		buffer_in->flags = eMFBF_VideoData;
+		buffer_in->data.resize( 10000 + i );
+		for( size_t n = 0; n < buffer_in->data.size(); n++ ) {
+			buffer_in->data[ n ] = static_cast<uint8_t>( n * 7 + i );
 		}
-		if( TestMethod2() ) {
-			std::cerr << "TestMethod2: Failed" << std::endl;
+
+		err = MFPipe_Write.PipePut( "video", buffer_in, 100, "" );
+		assert( err == Error::Ok );
+
+		for( auto& pipe : MFPipe_Read ) {
+			std::shared_ptr<MF_BASE_TYPE> buffer_out;
+			err = pipe.PipeGet( "video", buffer_out, 100, "" );
+			assert( err == Error::Ok );
+			assert( std::dynamic_pointer_cast<MF_BUFFER>( buffer_out )->data == buffer_in->data );
+		}
+	}
+
+	MFPipe_Write.PipeClose();
+	for( auto& pipe : MFPipe_Read ) {
+		pipe.PipeClose();
+	}
+
+	return 0;
+}
+
+int TestMethod6() {
+	// FEC test
+	// connecting side sends parity packets, listening side drops them when data packets are complete
+
+	MFPipeImpl MFPipe_Read;
+	Error err = MFPipe_Read.PipeCreate( "udp://127.0.0.1:12349", "" );
+	assert( err == Error::Ok );
+
+	MFPipeImpl MFPipe_Write;
+	err = MFPipe_Write.PipeOpen( "udp://127.0.0.1:12349?fec_n=4&fec_k=2", 32, "" );
+	assert( err == Error::Ok );
+
+	for( int i = 0; i < 8; i++ ) {
+		auto buffer_in = std::make_shared<MF_BUFFER>();
+		buffer_in->flags = eMFBF_Buffer;
+		buffer_in->data.resize( 1000 + i * 3000 );
+		for( size_t n = 0; n < buffer_in->data.size(); n++ ) {
+			buffer_in->data[ n ] = static_cast<uint8_t>( n * 3 + i );
+		}
+
+		err = MFPipe_Write.PipePut( "fec", buffer_in, 100, "" );
+		assert( err == Error::Ok );
+
+		std::shared_ptr<MF_BASE_TYPE> buffer_out;
+		err = MFPipe_Read.PipeGet( "fec", buffer_out, 100, "" );
+		assert( err == Error::Ok );
+
+		auto buffer = std::dynamic_pointer_cast<MF_BUFFER>( buffer_out );
+		assert( buffer != nullptr );
+		assert( buffer->data == buffer_in->data );
+	}
+
+	MFPipe_Write.PipeClose();
+	MFPipe_Read.PipeClose();
+
+	return 0;
+}
+
+int TestMethod7() {
+	// Encodings test
+	// connecting pipe offers compact encoding, listening pipe supports fixed one only
+
+	MFPipeImpl MFPipe_Read;
+	Error err = MFPipe_Read.PipeCreate( "udp://127.0.0.1:12350", "encoding=fixed" );
+	assert( err == Error::Ok );
+
+	MFPipeImpl MFPipe_Write;
+	err = MFPipe_Write.PipeOpen( "udp://127.0.0.1:12350", 32, "" );
+	assert( err == Error::Ok );
+
+	for( int i = 0; i < 4; i++ ) {
+		std::string event_name = "name#" + std::to_string( i );
+		err = MFPipe_Write.PipeMessagePut( "ch", event_name, "param", 100 );
+		assert( err == Error::Ok );
+		err = MFPipe_Read.PipeMessagePut( "ch", event_name, "reply", 100 );
+		assert( err == Error::Ok );
+
+		std::string name;
+		std::string param;
+		err = MFPipe_Read.PipeMessageGet( "ch", &name, &param, 100 );
+		assert( err == Error::Ok && name == event_name && param == "param" );
+		err = MFPipe_Write.PipeMessageGet( "ch", &name, &param, 100 );
+		assert( err == Error::Ok && name == event_name && param == "reply" );
+	}
+
+	MFPipe_Write.PipeClose();
+	MFPipe_Read.PipeClose();
+
+	return 0;
+}
+
+int TestMethod8() {
+	// Checksums test
+	// packets carry CRC32C, records end with checksum chunk
+
+	MFPipeImpl MFPipe_Read;
+	Error err = MFPipe_Read.PipeCreate( "udp://127.0.0.1:12351?crc=1", "checksum=1" );
+	assert( err == Error::Ok );
+
+	MFPipeImpl MFPipe_Write;
+	err = MFPipe_Write.PipeOpen( "udp://127.0.0.1:12351?crc=1&fec_n=4&fec_k=1", 32, "checksum=1" );
+	assert( err == Error::Ok );
+
+	for( int i = 0; i < 4; i++ ) {
+		auto frame_in = std::make_shared<MF_FRAME>();
+		frame_in->time = { i, i + 1 };
+		frame_in->vec_video_data.resize( 5000 + i * 1000 );
+		for( size_t n = 0; n < frame_in->vec_video_data.size(); n++ ) {
+			frame_in->vec_video_data[ n ] = static_cast<uint8_t>( n + i );
+		}
+
+		err = MFPipe_Write.PipePut( "crc", frame_in, 100, "" );
+		assert( err == Error::Ok );
+		err = MFPipe_Write.PipeMessagePut( "crc", "event", std::to_string( i ), 100 );
+		assert( err == Error::Ok );
+
+		std::shared_ptr<MF_BASE_TYPE> frame_out;
+		err = MFPipe_Read.PipeGet( "crc", frame_out, 100, "" );
+		assert( err == Error::Ok );
+		auto frame = std::dynamic_pointer_cast<MF_FRAME>( frame_out );
+		assert( frame != nullptr && frame->time.rtStartTime == i );
+		assert( frame->vec_video_data == frame_in->vec_video_data );
+
+		std::string name;
+		std::string param;
+		err = MFPipe_Read.PipeMessageGet( "crc", &name, &param, 100 );
+		assert( err == Error::Ok && param == std::to_string( i ) );
+	}
+
+	MFPipe_Write.PipeClose();
+	MFPipe_Read.PipeClose();
+
+	return 0;
+}
+
+int TestMethod9() {
+	// Compression test
+	// listening side compresses "bulk" channel, connecting side compresses all channels
+
+	MFPipeImpl MFPipe_Read;
+	Error err = MFPipe_Read.PipeCreate( "udp://127.0.0.1:12352", "compress.bulk=zstd&compress_level=5" );
+	assert( err == Error::Ok );
+
+	MFPipeImpl MFPipe_Write;
+	err = MFPipe_Write.PipeOpen( "udp://127.0.0.1:12352", 32, "compress=lz4" );
+	assert( err == Error::Ok );
+
+	for( int i = 0; i < 3; i++ ) {
+		auto frame_in = std::make_shared<MF_FRAME>();
+		frame_in->time = { i, i + 1 };
+		frame_in->vec_video_data.resize( 100000 );
+		for( size_t n = 0; n < frame_in->vec_video_data.size(); n++ ) {
+			frame_in->vec_video_data[ n ] = static_cast<uint8_t>( ( n / 64 ) * i );
+		}
+		frame_in->vec_audio_data.assign( 4000, static_cast<uint8_t>( i ) );
+
+		// the last frame is sent uncompressed
+		std::string hints = i == 2 ? "compress=none" : "";
+		err = MFPipe_Write.PipePut( "video", frame_in, 100, hints );
+		assert( err == Error::Ok );
+		err = MFPipe_Read.PipePut( "bulk", frame_in, 100, hints );
+		assert( err == Error::Ok );
+
+		for( auto pipe : { &MFPipe_Read, &MFPipe_Write } ) {
+			std::shared_ptr<MF_BASE_TYPE> frame_out;
+			err = pipe->PipeGet( pipe == &MFPipe_Read ? "video" : "bulk", frame_out, 100, "" );
+			assert( err == Error::Ok );
+			auto frame = std::dynamic_pointer_cast<MF_FRAME>( frame_out );
+			assert( frame != nullptr && frame->time.rtStartTime == i );
+			assert( frame->vec_video_data == frame_in->vec_video_data );
+			assert( frame->vec_audio_data == frame_in->vec_audio_data );
+		}
+	}
+
+	MFPipe_Write.PipeClose();
+	MFPipe_Read.PipeClose();
+
+	return 0;
+}
+
+int TestMethod10() {
+	// Video stride test
+	// padding is not sent, receiver restores stride of sender or applies requested stride
+
+	MFPipeImpl MFPipe_Read;
+	Error err = MFPipe_Read.PipeCreate( "udp://127.0.0.1:12353", "" );
+	assert( err == Error::Ok );
+
+	MFPipeImpl MFPipe_Write;
+	err = MFPipe_Write.PipeOpen( "udp://127.0.0.1:12353", 32, "" );
+	assert( err == Error::Ok );
+
+	auto frame_in = std::make_shared<MF_FRAME>();
+	frame_in->av_props.vidProps = { eMFCC_RGB32, 301, 20, 1280, 1, 1, 25.0 };
+	frame_in->vec_video_data.resize( 1280 * 20 );
+	for( size_t n = 0; n < frame_in->vec_video_data.size(); n++ ) {
+		frame_in->vec_video_data[ n ] = ( n % 1280 ) < 301 * 4 ? static_cast<uint8_t>( n ) : 0;
+	}
+
+	for( int row_bytes : { -1, 0, 2048 } ) {
+		err = MFPipe_Write.PipePut( "video", frame_in, 100, "" );
+		assert( err == Error::Ok );
+
+		std::shared_ptr<MF_BASE_TYPE> frame_out;
+		err = MFPipe_Read.PipeGet( "video", frame_out, 100, "row_bytes=" + std::to_string( row_bytes ) );
+		assert( err == Error::Ok );
+		auto frame = std::dynamic_pointer_cast<MF_FRAME>( frame_out );
+		assert( frame != nullptr );
+
+		int expected = row_bytes < 0 ? 1280 : row_bytes == 0 ? 301 * 4 : row_bytes;
+		assert( frame->av_props.vidProps.nRowBytes == expected );
+		bool changed = frame->ChangeRowBytes( 1280 );
+		assert( changed );
+		assert( frame->vec_video_data == frame_in->vec_video_data );
+	}
+
+	MFPipe_Write.PipeClose();
+	MFPipe_Read.PipeClose();
+
+	return 0;
+}
+
+int TestMethod11() {
+	// Delta frames test
+	// mostly static channel is sent as changed tiles, other channels as full frames
+
+	MFPipeImpl MFPipe_Read;
+	Error err = MFPipe_Read.PipeCreate( "udp://127.0.0.1:12354", "" );
+	assert( err == Error::Ok );
+
+	MFPipeImpl MFPipe_Write;
+	err = MFPipe_Write.PipeOpen( "udp://127.0.0.1:12354", 32, "delta.overlay=1&keyframe_interval=4" );
+	assert( err == Error::Ok );
+
+	auto frame_in = std::make_shared<MF_FRAME>();
+	frame_in->av_props.vidProps = { eMFCC_I420, 321, 50, 384, 1, 1, 25.0 };
+	frame_in->vec_video_data.assign( 384 * 50 + 192 * 25 * 2, 0x80 );
+
+	for( int i = 0; i < 10; i++ ) {
+		frame_in->time = { i, i + 1 };
+		frame_in->vec_video_data[ i * 1000 ] = static_cast<uint8_t>( i );
+		frame_in->vec_audio_data.assign( 100, static_cast<uint8_t>( i ) );
+
+		for( const std::string channel : { "overlay", "video" } ) {
+			err = MFPipe_Write.PipePut( channel, frame_in, 100, "" );
+			assert( err == Error::Ok );
+
+			std::shared_ptr<MF_BASE_TYPE> frame_out;
+			err = MFPipe_Read.PipeGet( channel, frame_out, 100, "" );
+			assert( err == Error::Ok );
+			auto frame = std::dynamic_pointer_cast<MF_FRAME>( frame_out );
+			assert( frame != nullptr && frame->time.rtStartTime == i );
+			assert( frame->av_props.vidProps.nRowBytes == 384 );
+			assert( frame->vec_audio_data == frame_in->vec_audio_data );
+			// padding is not sent
+			auto layout = comm::utils::video::GetLayout( eMFCC_I420, 321, 50, 384 );
+			for( size_t p = 0; p < layout.planes; p++ ) {
+				const auto& plane = layout.plane[ p ];
+				assert( comm::utils::video::RowsEqual( frame->vec_video_data.data() + plane.offset, plane.stride,
+													   frame_in->vec_video_data.data() + plane.offset, plane.stride,
+													   plane.row_size, plane.rows ) );
+			}
+		}
+	}
+
+	MFPipe_Write.PipeClose();
+	MFPipe_Read.PipeClose();
+
+	return 0;
+}
+
+int TestMethod12() {
+	// Priority test
+	// small records of high priority channel are sent while large frame of video channel is in sending queue
+
+	MFPipeImpl MFPipe_Read;
+	Error err = MFPipe_Read.PipeCreate( "udp://127.0.0.1:12355", "nack=5" );
+	assert( err == Error::Ok );
+
+	MFPipeImpl MFPipe_Write;
+	err = MFPipe_Write.PipeOpen( "udp://127.0.0.1:12355", 32, "priority.audio=1&weight.video=2&repair=8" );
+	assert( err == Error::Ok );
+	err = MFPipe_Write.PipeChannelSet( "control", "priority=2" );
+	assert( err == Error::Ok );
+
+	auto frame_in = std::make_shared<MF_FRAME>();
+	frame_in->vec_video_data.assign( 100000, 0x55 );
+	std::thread video( [&]() {
+		Error res = MFPipe_Write.PipePut( "video", frame_in, 1000, "" );
+		assert( res == Error::Ok );
+	} );
+
+	auto audio_in = std::make_shared<MF_FRAME>();
+	audio_in->vec_audio_data.assign( 1000, 0x11 );
+	err = MFPipe_Write.PipePut( "audio", audio_in, 100, "" );
+	assert( err == Error::Ok );
+	err = MFPipe_Write.PipeMessagePut( "control", "stop", "now", 100 );
+	assert( err == Error::Ok );
+	// hint of put overrides priority of the channel
+	err = MFPipe_Write.PipePut( "audio", audio_in, 100, "priority=0&weight=4" );
+	assert( err == Error::Ok );
+	video.join();
+
+	std::string name, param;
+	err = MFPipe_Read.PipeMessageGet( "control", &name, &param, 100 );
+	assert( err == Error::Ok && name == "stop" && param == "now" );
+	for( const std::string channel : { "audio", "audio", "video" } ) {
+		std::shared_ptr<MF_BASE_TYPE> frame_out;
+		err = MFPipe_Read.PipeGet( channel, frame_out, 1000, "" );
+		assert( err == Error::Ok );
+		auto frame = std::dynamic_pointer_cast<MF_FRAME>( frame_out );
+		assert( frame != nullptr );
+		assert( frame->vec_video_data == ( channel == "video" ? frame_in : audio_in )->vec_video_data );
+		assert( frame->vec_audio_data == ( channel == "video" ? frame_in : audio_in )->vec_audio_data );
+	}
+
+	MFPipe_Write.PipeClose();
+	MFPipe_Read.PipeClose();
+
+	return 0;
+}
+
+int TestMethod13() {
+	// Deadline test
+	// frame which is not sent within its duration is dropped by sending side
+
+	MFPipeImpl MFPipe_Read;
+	Error err = MFPipe_Read.PipeCreate( "udp://127.0.0.1:12356", "" );
+	assert( err == Error::Ok );
+
+	MFPipeImpl MFPipe_Write;
+	err = MFPipe_Write.PipeOpen( "udp://127.0.0.1:12356", 32, "deadline.live=frame&fec_n=8&fec_k=1&crc=1" );
+	assert( err == Error::Ok );
+
+	// 1 ms frame, serialization of its packets takes longer
+	auto frame_in = std::make_shared<MF_FRAME>();
+	frame_in->time = { 0, 10000 };
+	frame_in->vec_video_data.assign( 16000000, 0x44 );
+	err = MFPipe_Write.PipePut( "live", frame_in, 1000, "" );
+	assert( err == Error::Expired );
+
+	MFPipe::MF_PIPE_INFO info = {};
+	std::string name;
+	err = MFPipe_Write.PipeInfoGet( &name, "live", &info );
+	assert( err == Error::Ok && name == "udp://127.0.0.1:12356" );
+	assert( info.nObjectsDropped == 1 && info.nPipesConnected == 1 );
+
+	// hint of put overrides deadline of the channel
+	frame_in->vec_video_data.assign( 100000, 0x44 );
+	err = MFPipe_Write.PipePut( "live", frame_in, 1000, "deadline=1000" );
+	assert( err == Error::Ok );
+	std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+	err = MFPipe_Read.PipeInfoGet( nullptr, "live", &info );
+	assert( err == Error::Ok && info.nObjectsHave == 1 && info.nObjectsDropped == 0 );
+
+	std::shared_ptr<MF_BASE_TYPE> frame_out;
+	err = MFPipe_Read.PipeGet( "live", frame_out, 1000, "" );
+	assert( err == Error::Ok );
+	auto frame = std::dynamic_pointer_cast<MF_FRAME>( frame_out );
+	assert( frame != nullptr && frame->vec_video_data == frame_in->vec_video_data );
+
+	MFPipe_Write.PipeClose();
+	MFPipe_Read.PipeClose();
+
+	return 0;
+}
+
+int TestMethod14() {
+	// Trace test
+	// stages of traced objects and messages are recorded by both sides
+
+	namespace trace = comm::utils::trace;
+	trace::Reset();
+
+	MFPipeImpl MFPipe_Read;
+	Error err = MFPipe_Read.PipeCreate( "udp://127.0.0.1:12357", "" );
+	assert( err == Error::Ok );
+
+	MFPipeImpl MFPipe_Write;
+	err = MFPipe_Write.PipeOpen( "udp://127.0.0.1:12357", 32, "trace=2&crc=1&fec_n=4&fec_k=1&deadline=1000" );
+	assert( err == Error::Ok );
+
+	// every second object is traced
+	auto frame_in = std::make_shared<MF_FRAME>();
+	frame_in->vec_video_data.assign( 20000, 0x33 );
+	for( int i = 0; i < 4; i++ ) {
+		err = MFPipe_Write.PipePut( "video", frame_in, 1000, "" );
+		assert( err == Error::Ok );
+	}
+	for( int i = 0; i < 4; i++ ) {
+		std::shared_ptr<MF_BASE_TYPE> frame_out;
+		err = MFPipe_Read.PipeGet( "video", frame_out, 1000, "" );
+		assert( err == Error::Ok );
+		auto frame = std::dynamic_pointer_cast<MF_FRAME>( frame_out );
+		assert( frame != nullptr && frame->vec_video_data == frame_in->vec_video_data );
+	}
+
+	for( auto stage : { trace::Stage::Compose, trace::Stage::Send, trace::Stage::Transfer, trace::Stage::Reassemble,
+						trace::Stage::Wait, trace::Stage::Total } ) {
+		assert( trace::GetHistogram( stage ).Count() == 2 );
+	}
+	const auto& total = trace::GetHistogram( trace::Stage::Total );
+	assert( total.Max() >= trace::GetHistogram( trace::Stage::Compose ).Max() );
+	assert( total.Percentile( 0.5 ) <= total.Max() );
+
+	std::string histograms = trace::ExportHistograms();
+	assert( histograms.find( "\"reassemble\": { \"count\": 2" ) != std::string::npos );
+	std::string chrome = trace::ExportChromeTrace();
+	assert( chrome.find( "\"name\": \"wait\", \"cat\": \"mfpipe\", \"ph\": \"X\"" ) != std::string::npos );
+	assert( chrome.find( "\"channel\": \"video\"" ) != std::string::npos );
+
+	MFPipe_Write.PipeClose();
+	MFPipe_Read.PipeClose();
+
+	return 0;
+}
+
+/// GET request to local HTTP endpoint, empty - failed
+std::string HttpGet( uint16_t port, const std::string& path ) {
+	comm::net::basesocket socket = ::socket( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+	::sockaddr_in addrin = {};
+	addrin.sin_family = AF_INET;
+	addrin.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+	addrin.sin_port = htons( port );
+	std::string response;
+	if( ::connect( socket, reinterpret_cast<const ::sockaddr*>( &addrin ), sizeof( addrin ) ) == 0 ) {
+		std::string request = "GET " + path + " HTTP/1.1\r\nHost: localhost\r\n\r\n";
+		::send( socket, request.data(), static_cast<int>( request.size() ), 0 );
+		char buf[ 4096 ];
+		int res;
+		while( ( res = ::recv( socket, buf, sizeof( buf ), 0 ) ) > 0 ) {
+			response.append( buf, res );
+		}
+	}
+	::closesocket( socket );
+	return response;
+}
+
+int TestMethod15() {
+	// Metrics test
+	// counters of pipe, channels and transport are served by HTTP endpoint and written to file
+
+	// output goes to temp directory, the file and its temporary copy are removed at the end
+	std::error_code ec;
+	std::string path = ( std::filesystem::temp_directory_path( ec ) / "mfpipe_metrics_test.prom" ).string();
+	std::remove( path.c_str() );
+
+	MFPipeImpl MFPipe_Read;
+	Error err = MFPipe_Read.PipeCreate( "udp://127.0.0.1:12358", "metrics_port=12359" );
+	assert( err == Error::Ok );
+
+	// access to transport counters
+	struct StatsPipe : public MFPipeImpl {
+		TransportStats GetTransportStats() {
+			return m_Transport->GetStats();
+		}
+	};
+	StatsPipe MFPipe_Write;
+	err = MFPipe_Write.PipeOpen( "udp://127.0.0.1:12358", 32, "metrics_file=" + path + "&metrics_interval=20" );
+	assert( err == Error::Ok );
+
+	auto buffer_in = std::make_shared<MF_BUFFER>();
+	buffer_in->data.assign( 5000, 0x21 );
+	for( int i = 0; i < 3; i++ ) {
+		err = MFPipe_Write.PipePut( "data", buffer_in, 1000, "" );
+		assert( err == Error::Ok );
+	}
+	err = MFPipe_Write.PipeMessagePut( "control", "start", "", 100 );
+	assert( err == Error::Ok );
+
+	std::shared_ptr<MF_BASE_TYPE> buffer_out;
+	err = MFPipe_Read.PipeGet( "data", buffer_out, 1000, "" );
+	assert( err == Error::Ok );
+	std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+
+	std::string response = HttpGet( 12359, "/metrics" );
+	assert( response.compare( 0, 15, "HTTP/1.1 200 OK" ) == 0 );
+	assert( response.find( "application/openmetrics-text" ) != std::string::npos );
+	assert( response.find( "# TYPE mfpipe_transport_packets_received counter\n" ) != std::string::npos );
+	// 3 objects of 4 packets, Hello and message
+	assert( response.find( "mfpipe_transport_messages_received_total{pipe=\"udp://127.0.0.1:12358\",role=\"listen\"" ) !=
+			std::string::npos );
+	assert( response.find( ",channel=\"data\"} 1\n" ) != std::string::npos );
+	assert( response.find( "mfpipe_pipe_received_waiting{pipe=\"udp://127.0.0.1:12358\",role=\"listen\"" ) !=
+			std::string::npos );
+	assert( response.size() > 7 && response.compare( response.size() - 6, 6, "# EOF\n" ) == 0 );
+	assert( HttpGet( 12359, "/other" ).compare( 0, 12, "HTTP/1.1 404" ) == 0 );
+
+	std::string text;
+	FILE* file = std::fopen( path.c_str(), "rb" );
+	assert( file != nullptr );
+	char buf[ 4096 ];
+	size_t read;
+	while( ( read = std::fread( buf, 1, sizeof( buf ), file ) ) > 0 ) {
+		text.append( buf, read );
+	}
+	std::fclose( file );
+	assert( text.find( "mfpipe_channel_objects_put_total{pipe=\"udp://127.0.0.1:12358\",role=\"connect\"" ) !=
+			std::string::npos );
+	assert( text.find( ",channel=\"data\"} 3\n" ) != std::string::npos );
+	assert( text.find( "mfpipe_pipe_put_seconds_count{pipe=\"udp://127.0.0.1:12358\",role=\"connect\"" ) !=
+			std::string::npos );
+
+	// packets of sent objects go back to the store, so buffers gauge does not grow with puts
+	uint64_t total = MFPipe_Write.GetTransportStats().buffers_total;
+	for( int i = 0; i < 200; i++ ) {
+		err = MFPipe_Write.PipePut( "data", buffer_in, 1000, "" );
+		assert( err == Error::Ok );
+	}
+	TransportStats stats = MFPipe_Write.GetTransportStats();
+	assert( stats.buffers_total <= total + 16 && stats.buffers_free != 0 );
+
+	MFPipe_Write.PipeClose();
+	MFPipe_Read.PipeClose();
+	std::remove( path.c_str() );
+	std::remove( ( path + ".tmp" ).c_str() );
+
+	// endpoint is closed with the pipe
+	assert( HttpGet( 12359, "/metrics" ).empty() );
+
+	return 0;
+}
+
+int TestMethod16() {
+	// Impaired network test
+	// objects are delivered over lossy, reordering and delaying link by NACK repair and FEC
+
+	std::string uri = "sim+udp://127.0.0.1:12360?loss=3%&reorder=2%&delay=5ms&jitter=2ms&rate=200mbit&seed=11";
+
+	MFPipeImpl MFPipe_Read;
+	Error err = MFPipe_Read.PipeCreate( uri, "nack=10" );
+	assert( err == Error::Ok );
+
+	MFPipeImpl MFPipe_Write;
+	err = MFPipe_Write.PipeOpen( uri, 32, "repair=64&fec_n=8&fec_k=1" );
+	assert( err == Error::Ok );
+
+	// invalid impairment
+	MFPipeImpl MFPipe_Invalid;
+	err = MFPipe_Invalid.PipeOpen( "sim+udp://127.0.0.1:12360?loss=200%", 32, "" );
+	assert( err == Error::InvalidSettings );
+
+	constexpr int count = 16;
+	std::thread writer( [&]() {
+		for( int i = 0; i < count; i++ ) {
+			auto buffer_in = std::make_shared<MF_BUFFER>();
+			buffer_in->data.assign( 30000, static_cast<byte>( i ) );
+			Error res = MFPipe_Write.PipePut( "data", buffer_in, 1000, "" );
+			assert( res == Error::Ok );
+		}
+	} );
+
+	std::set<int> received;
+	for( int i = 0; i < count; i++ ) {
+		std::shared_ptr<MF_BASE_TYPE> buffer_out;
+		err = MFPipe_Read.PipeGet( "data", buffer_out, 2000, "" );
+		assert( err == Error::Ok );
+		auto buffer = std::dynamic_pointer_cast<MF_BUFFER>( buffer_out );
+		assert( buffer != nullptr && buffer->data.size() == 30000 );
+		assert( std::count( buffer->data.begin(), buffer->data.end(), buffer->data[ 0 ] ) == 30000 );
+		received.insert( buffer->data[ 0 ] );
+	}
+	writer.join();
+	assert( received.size() == count );
+
+	MFPipe_Write.PipeClose();
+	MFPipe_Read.PipeClose();
+
+	return 0;
+}
+
+int TestMethod17() {
+	// Capture and replay test
+	// objects/messages captured by both sides are replayed through another pipe
+
+	std::string capture_put = "mfpipe_capture_put.cap";
+	std::string capture_get = "mfpipe_capture_get.cap";
+
+	{
+		MFPipeImpl MFPipe_Read;
+		Error err = MFPipe_Read.PipeCreate( "udp://127.0.0.1:12362", "capture=" + capture_get );
+		assert( err == Error::Ok );
+
+		MFPipeImpl MFPipe_Write;
+		err = MFPipe_Write.PipeOpen( "udp://127.0.0.1:12362", 32, "capture=" + capture_put + "&delta.video=1" );
+		assert( err == Error::Ok );
+
+		for( int i = 0; i < 4; i++ ) {
+			auto frame = std::make_shared<MF_FRAME>();
+			frame->av_props.vidProps = { eMFCC_I420, 64, 32, 64, 1, 1, 25.0 };
+			frame->vec_video_data.assign( 64 * 32 * 3 / 2, static_cast<comm::byte>( i ) );
+			err = MFPipe_Write.PipePut( "video", frame, 100, "" );
+			assert( err == Error::Ok );
+			err = MFPipe_Write.PipeMessagePut( "events", "frame", std::to_string( i ), 100 );
+			assert( err == Error::Ok );
+			std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) );
+		}
+
+		for( int i = 0; i < 4; i++ ) {
+			std::shared_ptr<MF_BASE_TYPE> object;
+			err = MFPipe_Read.PipeGet( "video", object, 1000, "" );
+			assert( err == Error::Ok );
+			std::string name;
+			std::string param;
+			err = MFPipe_Read.PipeMessageGet( "events", &name, &param, 1000 );
+			assert( err == Error::Ok && param == std::to_string( i ) );
+		}
+
+		MFPipe_Write.PipeClose();
+		MFPipe_Read.PipeClose();
+	}
+
+	auto put_reader = utils::capture::Reader::Open( capture_put );
+	auto get_reader = utils::capture::Reader::Open( capture_get );
+	assert( put_reader != nullptr && put_reader->IsIndexed() && put_reader->GetCount() == 8 );
+	assert( get_reader != nullptr && get_reader->IsIndexed() && get_reader->GetCount() == 8 );
+
+	// replay of sent entries at double speed, paced like the capture (60 ms)
+	MFPipeImpl MFPipe_Replayed;
+	Error err = MFPipe_Replayed.PipeCreate( "udp://127.0.0.1:12363", "" );
+	assert( err == Error::Ok );
+
+	MFPipeImpl MFPipe_Replay;
+	err = MFPipe_Replay.PipeOpen( "udp://127.0.0.1:12363", 32, "" );
+	assert( err == Error::Ok );
+
+	utils::capture::ReplaySettings settings;
+	settings.speed = 2.0;
+	settings.received = false;
+	utils::capture::ReplayStats stats;
+	auto started = std::chrono::steady_clock::now();
+	err = utils::capture::Replay( MFPipe_Replay, *put_reader, settings, &stats );
+	assert( err == Error::Ok && stats.objects == 4 && stats.messages == 4 && stats.failed == 0 );
+	assert( std::chrono::steady_clock::now() - started >= std::chrono::milliseconds( 25 ) );
+
+	utils::capture::Entry entry;
+	for( int i = 0; i < 4; i++ ) {
+		std::shared_ptr<MF_BASE_TYPE> object;
+		err = MFPipe_Replayed.PipeGet( "video", object, 1000, "" );
+		assert( err == Error::Ok );
+		auto frame = std::dynamic_pointer_cast<MF_FRAME>( object );
+		assert( frame != nullptr && frame->vec_video_data.size() == 64 * 32 * 3 / 2 &&
+				frame->vec_video_data[ 0 ] == static_cast<comm::byte>( i ) );
+
+		std::string name;
+		std::string param;
+		err = MFPipe_Replayed.PipeMessageGet( "events", &name, &param, 1000 );
+		assert( err == Error::Ok && name == "frame" && param == std::to_string( i ) );
+	}
+	// received entries are the same frames, delta frames are captured as full frames
+	for( size_t i = 0; i < get_reader->GetCount(); i++ ) {
+		bool found = get_reader->Get( i, entry );
+		assert( found && entry.direction == utils::capture::Direction::Received );
+		if( entry.kind == utils::capture::Kind::Object ) {
+			auto frame = std::dynamic_pointer_cast<MF_FRAME>( utils::capture::Reader::LoadObject( entry ) );
+			assert( frame != nullptr && frame->vec_video_data.size() == 64 * 32 * 3 / 2 );
+		}
+	}
+
+	MFPipe_Replay.PipeClose();
+	MFPipe_Replayed.PipeClose();
+
+	put_reader.reset();
+	get_reader.reset();
+	std::remove( capture_put.c_str() );
+	std::remove( capture_get.c_str() );
+
+	return 0;
+}
+
+int TestMethod18() {
+	// Spill test
+	// objects/messages over in-memory limit of stalled consumer go to spill queue and are got back in order
+
+	// access to records in memory
+	struct SpillPipe : public MFPipeImpl {
+		size_t GetInMemory() {
+			std::unique_lock lock( m_ReceivingLock );
+			return m_ReceivedRecords.size();
+		}
+	};
+	SpillPipe MFPipe_Read;
+	Error err = MFPipe_Read.PipeCreate( "udp://127.0.0.1:12364", "spill.data=3&spill_segment=1&spill_dir=.&nack=5" );
+	assert( err == Error::Ok );
+
+	MFPipeImpl MFPipe_Write;
+	err = MFPipe_Write.PipeOpen( "udp://127.0.0.1:12364", 32, "repair=128" );
+	assert( err == Error::Ok );
+
+	constexpr int count = 30;
+	for( int i = 0; i < count; i++ ) {
+		auto buffer_in = std::make_shared<MF_BUFFER>();
+		buffer_in->data.assign( 100000 + i, static_cast<comm::byte>( i ) );
+		err = MFPipe_Write.PipePut( "data", buffer_in, 1000, "" );
+		assert( err == Error::Ok );
+		err = MFPipe_Write.PipeMessagePut( "data", "index", std::to_string( i ), 1000 );
+		assert( err == Error::Ok );
+	}
+
+	// consumer stalled, everything is received
+	MFPipe::MF_PIPE_INFO info = {};
+	for( int i = 0; i < 100 && info.nObjectsHave + info.nMessagesHave < count * 2; i++ ) {
+		std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+		err = MFPipe_Read.PipeInfoGet( nullptr, "data", &info );
+		assert( err == Error::Ok );
+	}
+	assert( info.nObjectsHave == count && info.nMessagesHave == count );
+
+	// messages first, objects stay in memory and in spill queue (repaired records may be received out of order)
+	std::set<std::string> messages;
+	for( int i = 0; i < count; i++ ) {
+		std::string name;
+		std::string param;
+		err = MFPipe_Read.PipeMessageGet( "data", &name, &param, 1000 );
+		assert( err == Error::Ok && name == "index" );
+		messages.insert( param );
+	}
+	assert( messages.size() == count );
+	// spilled objects are not read back by message getter
+	assert( MFPipe_Read.GetInMemory() <= 3 );
+	std::set<int> objects;
+	for( int i = 0; i < count; i++ ) {
+		std::shared_ptr<MF_BASE_TYPE> buffer_out;
+		err = MFPipe_Read.PipeGet( "data", buffer_out, 1000, "" );
+		assert( err == Error::Ok );
+		auto buffer = std::dynamic_pointer_cast<MF_BUFFER>( buffer_out );
+		assert( buffer != nullptr && buffer->data.size() == 100000u + buffer->data[ 0 ] );
+		objects.insert( buffer->data[ 0 ] );
+	}
+	assert( objects.size() == count );
+	err = MFPipe_Read.PipeInfoGet( nullptr, "data", &info );
+	assert( err == Error::Ok && info.nObjectsHave == 0 && info.nMessagesHave == 0 );
+
+	MFPipe_Write.PipeClose();
+	MFPipe_Read.PipeClose();
+
+	return 0;
+}
+
+void TestSendingQueue() {
+	using namespace comm::transports;
+
+	auto store = std::make_shared<NetBuffersStore>();
+	auto make_message = [&]( std::list<NetBuffer>& out, MessageID msg_id, uint32_t packets ) {
+		store->Alloc( out, 1000, packets );
+		uint32_t packet = 0;
+		for( auto& buf : out ) {
+			UDPPacketHeader* ph = reinterpret_cast<UDPPacketHeader*>( buf.GetBuffer() );
+			ph->flags = 0;
+			ph->msg_id = msg_id;
+			ph->packet = packet++;
+			ph->session = 0;
+			buf.ref.data = buf.buffer.data() + sizeof( UDPPacketHeader );
+			buf.ref.size = buf.buffer.size() - sizeof( UDPPacketHeader );
+		}
+	};
+	auto next_message = [&]( SendingQueue& queue ) {
+		bool reschedule = false;
+		const NetBuffer* buf = queue.GetNextBufferPacket( reschedule );
+		assert( buf != nullptr );
+		MessageID msg_id = buf->GetPacketHeader().msg_id;
+		queue.SentReport( buf, Error::Ok );
+		return msg_id;
+	};
+
+	// strict priority: the message of higher priority goes ahead of queued packets
+	std::list<NetBuffer> video, audio, bulk;
+	make_message( video, 1, 100 );
+	make_message( audio, 2, 2 );
+	make_message( bulk, 3, 100 );
+	size_t reports = 0;
+	auto report = [&]( size_t, const Error& err ) { reports++; };
+
+	SendingQueue queue;
+	bool idle = queue.Send( 1, video, { "video", 0, 1 }, report );
+	assert( idle );
+	MessageID first = next_message( queue );
+	assert( first == 1 );
+	idle = queue.Send( 2, audio, { "audio", 1, 1 }, report );
+	assert( !idle );
+	MessageID second = next_message( queue );
+	MessageID third = next_message( queue );
+	assert( second == 2 && third == 2 );
+	assert( reports == 1 );
+
+	// weighted share among flows of the same priority, 1000 bytes packets and 1500 bytes quantum
+	queue.Send( 3, bulk, { "bulk", 0, 3 }, report );
+	size_t video_count = 0, bulk_count = 0;
+	for( int i = 0; i < 80; i++ ) {
+		( next_message( queue ) == 1 ? video_count : bulk_count )++;
+	}
+	assert( video_count >= 18 && video_count <= 22 && bulk_count >= 58 && bulk_count <= 62 );
+
+	// the rest goes anyway
+	bool reschedule = true;
+	while( reschedule ) {
+		const NetBuffer* buf = queue.GetNextBufferPacket( reschedule );
+		assert( buf != nullptr );
+		queue.SentReport( buf, Error::Ok );
+	}
+	assert( reports == 3 );
+
+	// not sent packets of expired message are dropped, the message is reported as expired
+	std::list<NetBuffer> late;
+	make_message( late, 4, 10 );
+	Error status = Error::Ok;
+	queue.Send( 4, late, { "live", 0, 1 }, [&]( size_t, const Error& err ) { status = err; },
+				SendingQueue::Clock::now() - std::chrono::milliseconds( 1 ) );
+	auto expired_packet = queue.GetNextBufferPacket( reschedule );
+	assert( expired_packet == nullptr && !reschedule );
+	assert( status == Error::Expired && queue.GetExpired() == 1 );
+
+	store->Release( video );
+	store->Release( audio );
+	store->Release( bulk );
+	store->Release( late );
+}
+
+void TestReceivingQueue() {
+	using namespace comm::transports;
+	using namespace std::chrono_literals;
+
+	auto store = std::make_shared<NetBuffersStore>();
+	auto make_packet = [&]( std::list<NetBuffer>& out, MessageID msg_id, uint32_t packet, bool last ) {
+		store->Alloc( out, sizeof( UDPPacketHeader ) + 1 );
+		auto& buf = out.back();
+		UDPPacketHeader* ph = reinterpret_cast<UDPPacketHeader*>( buf.GetBuffer() );
+		ph->flags = ( packet == 0 ? static_cast<byte>( UDPPacketFlag::First ) : 0 ) |
+					( last ? static_cast<byte>( UDPPacketFlag::Last ) : 0 );
+		ph->msg_id = msg_id;
+		ph->packet = packet;
+		ph->session = 0;
+		buf.ref.data = buf.buffer.data() + sizeof( UDPPacketHeader );
+		buf.ref.size = 1;
+		buf.ref.data[ 0 ] = static_cast<byte>( packet );
+	};
+
+	std::vector<byte> delivered;
+	std::vector<UDPPacketRange> requested;
+	ReceivingQueue::Settings settings;
+	settings.response_delay = 1ms;
+	ReceivingQueue queue(
+		store,
+		[&]( MessageID msg_id, std::list<NetBuffer>& buffers, const MsgTrace* trace ) {
+			for( const auto& buf : buffers ) {
+				delivered.push_back( buf.ref.data[ 0 ] );
+			}
+			store->Release( buffers );
+		},
+		[&]( MessageID msg_id, const std::vector<UDPPacketRange>& ranges ) { requested = ranges; }, settings );
+
+	// packets 0..5, 2 and 5 (last) are lost, others are reordered
+	for( uint32_t packet : { 1, 0, 4, 3 } ) {
+		std::list<NetBuffer> packet_list;
+		make_packet( packet_list, 7, packet, false );
+		queue.ProcessBuffer( 7, packet_list );
+		store->Release( packet_list );
+	}
+	assert( delivered.empty() );
+
+	std::list<NetBuffer> released;
+	queue.CheckTimeouts( ReceivingQueue::Clock::now() + 2ms, released );
+	assert( requested.size() == 2 );
+	assert( requested[ 0 ].start == 2 && requested[ 0 ].end == 2 );
+	assert( requested[ 1 ].start == 5 && requested[ 1 ].end == std::numeric_limits<uint32_t>::max() );
+
+	// repairs, the last one is duplicated
+	for( uint32_t packet : { 5, 2, 5 } ) {
+		std::list<NetBuffer> packet_list;
+		make_packet( packet_list, 7, packet, packet == 5 );
+		queue.ProcessBuffer( 7, packet_list );
+		store->Release( packet_list );
+	}
+	assert( ( delivered == std::vector<byte>{ 0, 1, 2, 3, 4, 5 } ) );
+
+	// incomplete message is dropped by timeout
+	std::list<NetBuffer> packet_list;
+	make_packet( packet_list, 8, 0, false );
+	queue.ProcessBuffer( 8, packet_list );
+	size_t dropped = queue.CheckTimeouts( ReceivingQueue::Clock::now() + settings.timeout + 1ms, released );
+	assert( dropped == 1 && released.size() == 1 );
+	assert( queue.GetTimedOut() == 1 && queue.GetExpired() == 0 );
+
+	// incomplete message is dropped by deadline of sending side, its late packets are ignored
+	auto make_live_packet = [&]( std::list<NetBuffer>& out, uint32_t packet, bool last ) {
+		make_packet( out, 9, packet, last );
+		auto& buf = out.back();
+		buf.buffer.resize( buf.buffer.size() + UDPDeadlineSize );
+		buf.ref.data = buf.buffer.data() + sizeof( UDPPacketHeader );
+		reinterpret_cast<UDPPacketHeader*>( buf.GetBuffer() )->flags |= static_cast<byte>( UDPPacketFlag::Deadline );
+		ReceivingQueue::AddDeadline( buf, 5 );
+	};
+	delivered.clear();
+	make_live_packet( packet_list, 0, false );
+	queue.ProcessBuffer( 9, packet_list );
+	dropped = queue.CheckTimeouts( ReceivingQueue::Clock::now() + 6ms, released );
+	assert( dropped == 1 && queue.GetExpired() == 1 );
+	make_live_packet( packet_list, 1, true );
+	queue.ProcessBuffer( 9, packet_list );
+	store->Release( packet_list );
+	queue.CheckTimeouts( ReceivingQueue::Clock::now(), released );
+	assert( delivered.empty() && released.size() == 2 );
+}
+
+void TestFECRecovery() {
+	using namespace comm::transports;
+	namespace fec = comm::utils::fec;
+
+	// coding selected at runtime matches table one for all tails of 32-byte and 16-byte blocks
+	{
+		std::vector<byte> src( 100 );
+		for( size_t n = 0; n < src.size(); n++ ) {
+			src[ n ] = static_cast<byte>( n * 13 + 5 );
+		}
+		for( size_t len : { 0, 1, 15, 16, 17, 31, 32, 33, 48, 63, 64, 100 } ) {
+			for( byte coef : { 0, 1, 2, 0x53, 0xFF } ) {
+				std::vector<byte> simd( len, 0x5A );
+				std::vector<byte> table( len, 0x5A );
+				fec::MulAdd( simd.data(), src.data(), coef, len );
+				fec::MulAddTable( table.data(), src.data(), coef, len );
+				assert( simd == table );
+			}
+		}
+	}
+
+	// 5 packets of different size in groups of 3 data + 2 parity packets
+	std::vector<std::vector<byte>> payloads;
+	for( size_t i = 0; i < 5; i++ ) {
+		payloads.emplace_back( 100 + i * 37 );
+		for( size_t n = 0; n < payloads.back().size(); n++ ) {
+			payloads.back()[ n ] = static_cast<byte>( n * 7 + i );
+		}
+	}
+	const uint32_t group = 3;
+	const uint32_t parity_count = 2;
+
+	auto store = std::make_shared<NetBuffersStore>();
+	auto make_packet = [&]( std::list<NetBuffer>& out, uint32_t packet ) {
+		const auto& payload = payloads[ packet ];
+		store->Alloc( out, sizeof( UDPPacketHeader ) + payload.size() );
+		auto& buf = out.back();
+		UDPPacketHeader* ph = reinterpret_cast<UDPPacketHeader*>( buf.GetBuffer() );
+		ph->flags = ( packet == 0 ? static_cast<byte>( UDPPacketFlag::First ) : 0 ) |
+					( packet + 1 == payloads.size() ? static_cast<byte>( UDPPacketFlag::Last ) : 0 );
+		ph->msg_id = 3;
+		ph->packet = packet;
+		ph->session = 0;
+		buf.ref.data = buf.buffer.data() + sizeof( UDPPacketHeader );
+		buf.ref.size = payload.size();
+		std::copy( payload.begin(), payload.end(), buf.ref.data );
+	};
+	auto make_parity = [&]( std::list<NetBuffer>& out, uint32_t first, uint8_t index ) {
+		uint32_t count = std::min<uint32_t>( group, static_cast<uint32_t>( payloads.size() ) - first );
+		size_t block = 0;
+		for( uint32_t i = 0; i < count; i++ ) {
+			block = std::max( block, sizeof( uint16_t ) + payloads[ first + i ].size() );
+		}
+		store->Alloc( out, sizeof( UDPPacketHeader ) + sizeof( UDPParityHeader ) + block );
+		auto& buf = out.back();
+		UDPPacketHeader* ph = reinterpret_cast<UDPPacketHeader*>( buf.GetBuffer() );
+		ph->flags = static_cast<byte>( UDPPacketFlag::Parity );
+		ph->msg_id = 3;
+		ph->packet = static_cast<uint32_t>( payloads.size() ) + first + index;
+		ph->session = 0;
+		buf.ref.data = buf.buffer.data() + sizeof( UDPPacketHeader );
+		buf.ref.size = sizeof( UDPParityHeader ) + block;
+		UDPParityHeader* fh = reinterpret_cast<UDPParityHeader*>( buf.ref.data );
+		*fh = UDPParityHeader{ first, static_cast<uint32_t>( payloads.size() ), static_cast<uint16_t>( count ), index,
+							   static_cast<uint8_t>( parity_count ) };
+		byte* coded = buf.ref.data + sizeof( UDPParityHeader );
+		std::fill( coded, coded + block, 0 );
+		for( uint32_t i = 0; i < count; i++ ) {
+			uint16_t len = static_cast<uint16_t>( payloads[ first + i ].size() );
+			fec::MulAdd( coded, reinterpret_cast<const byte*>( &len ), fec::Coefficient( index, i ), sizeof( len ) );
+			fec::MulAdd( coded + sizeof( len ), payloads[ first + i ].data(), fec::Coefficient( index, i ), len );
+		}
+	};
+
+	std::vector<std::vector<byte>> delivered;
+	ReceivingQueue queue(
+		store,
+		[&]( MessageID msg_id, std::list<NetBuffer>& buffers, const MsgTrace* trace ) {
+			for( const auto& buf : buffers ) {
+				delivered.emplace_back( buf.ref.data, buf.ref.data + buf.ref.size );
+			}
+			store->Release( buffers );
+		},
+		[&]( MessageID msg_id, const std::vector<UDPPacketRange>& ranges ) {}, ReceivingQueue::Settings() );
+
+	// packets 1, 2 of the first group and 4 (last) of the second group are lost
+	for( uint32_t packet : { 0, 3 } ) {
+		std::list<NetBuffer> packet_list;
+		make_packet( packet_list, packet );
+		queue.ProcessBuffer( 3, packet_list );
+		store->Release( packet_list );
+	}
+	// duplicated parity is ignored
+	for( auto parity : { std::make_pair( 0u, 0 ), std::make_pair( 0u, 0 ), std::make_pair( 3u, 1 ) } ) {
+		std::list<NetBuffer> packet_list;
+		make_parity( packet_list, parity.first, static_cast<uint8_t>( parity.second ) );
+		queue.ProcessBuffer( 3, packet_list );
+		store->Release( packet_list );
+	}
+	assert( delivered.empty() );
+
+	std::list<NetBuffer> packet_list;
+	make_parity( packet_list, 0, 1 );
+	queue.ProcessBuffer( 3, packet_list );
+	assert( delivered == payloads );
+}
+
+struct SchemaSample {
+	uint32_t id;
+	comm::byte kind;
+	char mark;
+	std::string name;
+	uint32_t count;
+	std::vector<comm::byte> payload;
+
+	static constexpr auto Schema() {
+		using namespace comm::utils::schema;
+		return Fields( Field( &SchemaSample::id ), Field( &SchemaSample::kind ), Field( &SchemaSample::mark ),
+					   Field( &SchemaSample::name ), Field( &SchemaSample::count ), Field( &SchemaSample::payload ) );
+	}
+};
+
+void TestSchemaSerialization() {
+	using namespace comm::utils;
+
+	struct Buf {
+		std::vector<comm::byte> buffer;
+		comm::NetBufferRef ref;
+	};
+
+	SchemaSample in{ 1000, 7, 'x', "name", 42, { 0x00, 0x55, 0xAA } };
+
+	for( size_t sz = 1; sz <= 50; sz++ ) {
+		std::vector<std::unique_ptr<Buf>> buffers;
+		auto allocator = [&]( size_t size ) -> comm::NetBufferRef* {
+			buffers.emplace_back( new Buf() );
+			auto& buf = buffers.back();
+			buf->buffer.resize( sz );
+			buf->ref.data = buf->buffer.data();
+			buf->ref.size = buf->buffer.size();
+			return &buf->ref;
+		};
+		auto writer = []( comm::NetBufferRef* buf, size_t len ) { buf->size = len; };
+		auto output = [&]() {
+			std::vector<comm::byte> result;
+			for( const auto& el : buffers ) {
+				result.insert( result.end(), el->buffer.begin(), el->buffer.begin() + el->ref.size );
+			}
+			return result;
+		};
+
+		// schema and per-field writes produce the same stream
+		ChunkWriter field_writer( allocator, writer );
+		field_writer.Write( in.id );
+		field_writer.Write( in.kind );
+		field_writer.Write( in.mark );
+		field_writer.Write( in.name );
+		field_writer.Write( in.count );
+		field_writer.Write( in.payload );
+		field_writer.Flush();
+		auto expected = output();
+
+		buffers.clear();
+		ChunkWriter schema_writer( allocator, writer );
+		bool res = schema_writer.WriteSchema( in );
+		schema_writer.Flush();
+		assert( res );
+		assert( output() == expected );
+
+		ConstNetBufferSeq seq;
+		for( const auto& el : buffers ) {
+			seq.push_back( &el->ref );
+		}
+		ChunkReader schema_reader( seq );
+		SchemaSample out{};
+		res = schema_reader.ReadSchema( out );
+		assert( res );
+		assert( out.id == in.id && out.kind == in.kind && out.mark == in.mark && out.name == in.name );
+		assert( out.count == in.count && out.payload == in.payload );
+
+		// stream of other layout is rejected
+		ChunkReader buffer_reader( seq );
+		MF_BUFFER buffer;
+		bool read = buffer_reader.ReadSchema( buffer );
+		assert( !read );
+	}
+}
+
+void TestChunkSinks() {
+	using namespace comm::utils;
+
+	SchemaSample in{ 1000, 7, 'x', "name", 42, std::vector<comm::byte>( 100, 0x55 ) };
+
+	// contiguous vector, already stored data is kept
+	std::vector<comm::byte> output{ 0xEE };
+	SinkChunkWriter<VectorSink> vector_writer{ VectorSink( output ) };
+	bool res = vector_writer.Write( std::string( "vector" ) );
+	res &= vector_writer.WriteSchema( in );
+	vector_writer.Flush();
+	assert( res );
+	assert( output[ 0 ] == 0xEE );
+
+	ChunkReader vector_reader( output.data() + 1, output.size() - 1 );
+	std::string str;
+	SchemaSample out{};
+	res = vector_reader.Read( str );
+	res &= vector_reader.ReadSchema( out );
+	assert( res && str == "vector" && out.name == in.name && out.payload == in.payload );
+
+	// iovec batch gets the same stream
+	std::vector<comm::byte> storage( 256 );
+	std::vector<comm::NetBufferRef> iov;
+	for( size_t pos = 0; pos < storage.size(); pos += 16 ) {
+		iov.push_back( comm::NetBufferRef{ storage.data() + pos, 16 } );
+	}
+	SinkChunkWriter<IoVecSink> iov_writer{ IoVecSink( iov.data(), iov.size() ) };
+	res = iov_writer.Write( std::string( "vector" ) );
+	res &= iov_writer.WriteSchema( in );
+	iov_writer.Flush();
+	assert( res );
+
+	size_t used = iov_writer.GetSink().GetUsed();
+	std::vector<comm::byte> joined;
+	for( size_t i = 0; i < used; i++ ) {
+		joined.insert( joined.end(), iov[ i ].data, iov[ i ].data + iov[ i ].size );
+	}
+	assert( joined.size() + 1 == output.size() && std::equal( joined.begin(), joined.end(), output.begin() + 1 ) );
+
+	// not enough buffers
+	SinkChunkWriter<IoVecSink> short_writer{ IoVecSink( iov.data(), 2 ) };
+	bool written = short_writer.WriteSchema( in );
+	assert( !written );
+}
+
+void TestEncodedSize() {
+	using namespace comm::utils;
+
+	MF_FRAME frame;
+	frame.time = { 1, 2 };
+	frame.str_user_props = std::string( 40, 'p' );
+	frame.vec_video_data.assign( 3000, 0x10 );
+
+	MF_BUFFER buffer;
+	buffer.flags = eMFBF_VideoData;
+	buffer.data.assign( 20, 0x20 );
+
+	for( auto encoding : { EEncoding::Fixed, EEncoding::Compact } ) {
+		for( const MF_BASE_TYPE* obj : std::initializer_list<const MF_BASE_TYPE*>{ &frame, &buffer } ) {
+			size_t size = obj->EncodedSize( encoding );
+			assert( size != 0 );
+
+			// exact size is enough, one byte less is not
+			std::vector<comm::byte> output( size );
+			SinkChunkWriter<BufferSink> writer{ BufferSink( output.data(), output.size() ), encoding };
+			bool res = obj->Write( writer );
+			writer.Flush();
+			assert( res && writer.GetSink().GetSize() == size );
+
+			SinkChunkWriter<BufferSink> short_writer{ BufferSink( output.data(), size - 1 ), encoding };
+			res = obj->Write( short_writer );
+			assert( !res );
+
+			ChunkReader reader( output.data(), output.size(), encoding );
+			auto loaded = MF_BASE_TYPE::CreateByObjectType( obj->GetObjectType() );
+			res = loaded->Load( reader );
+			assert( res && loaded->EncodedSize( encoding ) == size );
+		}
+	}
+}
+
+void TestFrameSerialization() {
+	using namespace comm::utils;
+
+	struct Buf {
+		std::vector<comm::byte> buffer;
+		comm::NetBufferRef ref;
+	};
+
+	std::vector<std::unique_ptr<Buf>> buffers;
+	auto allocator = [&]( size_t size ) -> comm::NetBufferRef* {
+		buffers.emplace_back( new Buf() );
+		auto& buf = buffers.back();
+		buf->buffer.resize( 100 );
+		buf->ref.data = buf->buffer.data();
+		buf->ref.size = buf->buffer.size();
+		return &buf->ref;
+	};
+	auto writer = []( comm::NetBufferRef* buf, size_t len ) { buf->size = len; };
+	auto to_seq = [&]() {
+		ConstNetBufferSeq seq;
+		for( const auto& el : buffers ) {
+			seq.push_back( &el->ref );
+		}
+		return seq;
+	};
+
+	MF_FRAME frame_in;
+	frame_in.time = { 400000, 800000 };
+	frame_in.av_props.vidProps = { eMFCC_NV12, 1920, 1080, 1920, 16, 9, 25.0 };
+	frame_in.av_props.audProps = { 2, 48000, 16, 0 };
+	frame_in.str_user_props = "props";
+	frame_in.vec_video_data.assign( 300, 0x55 );
+	frame_in.vec_audio_data.assign( 50, 0xAA );
+
+	ChunkWriter chunk_writer( allocator, writer );
+	bool res = frame_in.Write( chunk_writer );
+	chunk_writer.Flush();
+	assert( res );
+
+	auto seq = to_seq();
+	ChunkReader chunk_reader( seq );
+	MF_FRAME frame_out;
+	res = frame_out.Load( chunk_reader );
+	assert( res );
+	assert( frame_out.time.rtStartTime == 400000 && frame_out.time.rtEndTime == 800000 );
+	assert( std::memcmp( &frame_out.av_props.vidProps, &frame_in.av_props.vidProps, sizeof( M_VID_PROPS ) ) == 0 );
+	assert( std::memcmp( &frame_out.av_props.audProps, &frame_in.av_props.audProps, sizeof( M_AUD_PROPS ) ) == 0 );
+	assert( frame_out.str_user_props == frame_in.str_user_props );
+	assert( frame_out.vec_video_data == frame_in.vec_video_data );
+	assert( frame_out.vec_audio_data == frame_in.vec_audio_data );
+
+	// frame without header (older peer)
+	buffers.clear();
+	ChunkWriter old_writer( allocator, writer );
+	old_writer.Write( frame_in.str_user_props );
+	old_writer.Write( frame_in.vec_video_data );
+	old_writer.Write( frame_in.vec_audio_data );
+	old_writer.Flush();
+
+	seq = to_seq();
+	ChunkReader old_reader( seq );
+	MF_FRAME frame_old;
+	res = frame_old.Load( old_reader );
+	assert( res );
+	assert( frame_old.time.rtStartTime == 0 && frame_old.av_props.vidProps.nWidth == 0 );
+	assert( frame_old.vec_video_data == frame_in.vec_video_data );
+}
+
+void TestCompactEncoding() {
+	using namespace comm::utils;
+
+	struct Buf {
+		std::vector<comm::byte> buffer;
+		comm::NetBufferRef ref;
+	};
+
+	std::string str( 200, 's' );
+	std::vector<comm::byte> bb{ 0x00, 0x55, 0xAA };
+
+	for( size_t sz = 1; sz <= 50; sz++ ) {
+		std::vector<std::unique_ptr<Buf>> buffers;
+		auto allocator = [&]( size_t size ) -> comm::NetBufferRef* {
+			buffers.emplace_back( new Buf() );
+			auto& buf = buffers.back();
+			buf->buffer.resize( sz );
+			buf->ref.data = buf->buffer.data();
+			buf->ref.size = buf->buffer.size();
+			return &buf->ref;
+		};
+		auto writer = []( comm::NetBufferRef* buf, size_t len ) { buf->size = len; };
+
+		ChunkWriter chunk_writer( allocator, writer, EEncoding::Compact );
+		bool res = chunk_writer.Write( (comm::byte)1 );
+		res &= chunk_writer.Write( (uint32_t)5 );
+		res &= chunk_writer.Write( (uint32_t)0xFFFFFFFF );
+		res &= chunk_writer.Write( std::string( "ch1" ) );
+		res &= chunk_writer.Write( str );
+		res &= chunk_writer.Write( bb );
+		chunk_writer.Flush();
+		assert( res );
+
+		size_t total_size = 0;
+		ConstNetBufferSeq seq;
+		for( const auto& el : buffers ) {
+			total_size += el->ref.size;
+			seq.push_back( &el->ref );
+		}
+		// tags: 1 + 1 + 1 + 1 + 3 (tag and LEB128 size) + 1, values: uint32 as LEB128
+		assert( total_size == 8 + 1 + 1 + 5 + 3 + 200 + 3 );
+
+		ChunkReader chunk_reader( seq, EEncoding::Compact );
+		comm::byte read_byte;
+		uint32_t read_small;
+		uint32_t read_large;
+		std::string read_short;
+		std::string read_long;
+		std::vector<comm::byte> read_vec;
+
+		// type mismatch keeps position
+		res = chunk_reader.Read( read_short );
+		assert( !res );
+		res = chunk_reader.Read( read_byte );
+		res &= chunk_reader.Read( read_small );
+		res &= chunk_reader.Read( read_large );
+		res &= chunk_reader.Read( read_short );
+		res &= chunk_reader.Read( read_long );
+		res &= chunk_reader.Read( read_vec );
+		assert( res );
+		assert( read_byte == 1 && read_small == 5 && read_large == 0xFFFFFFFF );
+		assert( read_short == "ch1" && read_long == str && read_vec == bb );
+	}
+}
+
+void TestChecksum() {
+	using namespace comm::transports;
+	using namespace comm::utils;
+
+	const char* check = "123456789";
+	assert( Crc32c( 0, reinterpret_cast<const comm::byte*>( check ), 9 ) == 0xE3069283 );
+	assert( Crc32cTable( 0, reinterpret_cast<const comm::byte*>( check ), 9 ) == 0xE3069283 );
+
+	// implementation selected at runtime matches table one for all tails and chained calls
+	std::vector<comm::byte> random( 1000 );
+	for( size_t i = 0; i < random.size(); i++ ) {
+		random[ i ] = static_cast<comm::byte>( i * 131 + ( i >> 3 ) );
+	}
+	for( size_t len = 0; len < 40; len++ ) {
+		assert( Crc32c( 0, random.data() + 1, len ) == Crc32cTable( 0, random.data() + 1, len ) );
+	}
+	uint32_t chained = Crc32c( Crc32c( 0, random.data(), 333 ), random.data() + 333, random.size() - 333 );
+	assert( chained == Crc32cTable( 0, random.data(), random.size() ) );
+
+	// packet checksum is verified and removed by receiving queue
+	auto store = std::make_shared<NetBuffersStore>();
+	std::vector<std::vector<comm::byte>> delivered;
+	ReceivingQueue queue(
+		store,
+		[&]( MessageID msg_id, std::list<NetBuffer>& buffers, const MsgTrace* trace ) {
+			for( const auto& buf : buffers ) {
+				delivered.emplace_back( buf.ref.data, buf.ref.data + buf.ref.size );
+			}
+			store->Release( buffers );
+		},
+		[&]( MessageID msg_id, const std::vector<UDPPacketRange>& ranges ) {}, ReceivingQueue::Settings() );
+
+	for( bool corrupt : { true, false } ) {
+		std::list<NetBuffer> packet_list;
+		store->Alloc( packet_list, sizeof( UDPPacketHeader ) + 10 + UDPChecksumSize );
+		auto& buf = packet_list.back();
+		UDPPacketHeader* ph = reinterpret_cast<UDPPacketHeader*>( buf.GetBuffer() );
+		ph->flags = static_cast<comm::byte>( UDPPacketFlag::First ) | static_cast<comm::byte>( UDPPacketFlag::Last ) |
+					static_cast<comm::byte>( UDPPacketFlag::Checksum );
+		ph->msg_id = 1;
+		ph->packet = 0;
+		ph->session = 0;
+		buf.ref.data = buf.buffer.data() + sizeof( UDPPacketHeader );
+		buf.ref.size = 10;
+		std::fill( buf.ref.data, buf.ref.data + 10, 0x33 );
+		ReceivingQueue::AddChecksum( buf );
+		if( corrupt ) {
+			buf.ref.data[ 5 ] ^= 0x01;
+		}
+		queue.ProcessBuffer( 1, packet_list );
+		store->Release( packet_list );
+	}
+	assert( queue.GetCorrupted() == 1 );
+	assert( delivered.size() == 1 && delivered[ 0 ] == std::vector<comm::byte>( 10, 0x33 ) );
+
+	// record checksum
+	struct Buf {
+		std::vector<comm::byte> buffer;
+		comm::NetBufferRef ref;
+	};
+	for( auto encoding : { EEncoding::Fixed, EEncoding::Compact } ) {
+		for( size_t sz = 1; sz <= 20; sz++ ) {
+			std::vector<std::unique_ptr<Buf>> buffers;
+			auto allocator = [&]( size_t size ) -> comm::NetBufferRef* {
+				buffers.emplace_back( new Buf() );
+				auto& buf = buffers.back();
+				buf->buffer.resize( sz );
+				buf->ref.data = buf->buffer.data();
+				buf->ref.size = buf->buffer.size();
+				return &buf->ref;
+			};
+			auto writer = []( comm::NetBufferRef* buf, size_t len ) { buf->size = len; };
+
+			ChunkWriter chunk_writer( allocator, writer, encoding );
+			chunk_writer.EnableChecksum();
+			bool res = chunk_writer.Write( std::string( "checksum" ) );
+			res &= chunk_writer.Write( (uint32_t)12345 );
+			res &= chunk_writer.WriteChecksum();
+			chunk_writer.Flush();
+			assert( res );
+
+			ConstNetBufferSeq seq;
+			for( const auto& el : buffers ) {
+				seq.push_back( &el->ref );
+			}
+			assert( VerifyChecksum( seq, encoding ) );
+			buffers[ 0 ]->buffer[ 0 ] ^= 0x80;
+			assert( !VerifyChecksum( seq, encoding ) );
+		}
+	}
+}
+
+void TestCompression() {
+	using namespace comm::utils;
+
+	// flat regions shrink, noise is stored as is
+	std::vector<comm::byte> flat( compression::BlockSize );
+	for( size_t n = 0; n < flat.size(); n++ ) {
+		flat[ n ] = static_cast<comm::byte>( n / 100 );
+	}
+	std::vector<comm::byte> noise( 3000 );
+	uint32_t seed = 1;
+	for( auto& el : noise ) {
+		seed = seed * 1103515245 + 12345;
+		el = static_cast<comm::byte>( seed >> 16 );
+	}
+
+	std::vector<ECodec> codecs;
+	for( auto codec : { ECodec::LZ4, ECodec::Zstd } ) {
+		if( ( compression::SupportedCodecs() & ( 1u << static_cast<uint32_t>( codec ) ) ) != 0 ) {
+			codecs.push_back( codec );
+		}
+	}
+	assert( !codecs.empty() && codecs[ 0 ] == ECodec::LZ4 );
+
+	for( auto codec : codecs ) {
+		Compressor compressor( codec, 0 );
+		Decompressor decompressor;
+		size_t compressed_size;
+		const comm::byte* compressed = compressor.Compress( flat.data(), flat.size(), compressed_size );
+		assert( compressed != nullptr && compressed_size < flat.size() / 10 );
+		std::vector<comm::byte> output( flat.size() );
+		bool decompressed = decompressor.Decompress( codec, compressed, compressed_size, output.data(), output.size() );
+		assert( decompressed && output == flat );
+		decompressed = decompressor.Decompress( codec, compressed, compressed_size, output.data(), output.size() - 1 );
+		assert( !decompressed );
+
+		compressed = compressor.Compress( noise.data(), noise.size(), compressed_size );
+		assert( compressed == nullptr );
+	}
+
+	// blocks made by reference lz4 (lz4 -9 -BI), they cover extended literal and match lengths and overlapped copy
+	struct Lz4Sample {
+		std::vector<comm::byte> raw;
+		std::vector<comm::byte> block;
+	};
+	std::string repeated;
+	for( int i = 0; i < 8; i++ ) {
+		repeated += "The quick brown fox jumps over the lazy dog. ";
+	}
+	std::vector<comm::byte> steps( 1000 );
+	for( size_t n = 0; n < steps.size(); n++ ) {
+		steps[ n ] = static_cast<comm::byte>( n / 100 );
+	}
+	const std::string abc = "abcabcabcabcabcabcabcabcabchello";
+	std::vector<Lz4Sample> samples = {
+		{ { abc.begin(), abc.end() }, { 0x3F, 0x61, 0x62, 0x63, 0x03, 0x00, 0x05, 0x50, 0x68, 0x65, 0x6C, 0x6C, 0x6F } },
+		{ steps,
+		  { 0x1F, 0x00, 0x01, 0x00, 0x50, 0x1F, 0x01, 0x01, 0x00, 0x50, 0x1F, 0x02, 0x01, 0x00, 0x50, 0x1F, 0x03, 0x01, 0x00,
+			0x50, 0x1F, 0x04, 0x01, 0x00, 0x50, 0x1F, 0x05, 0x01, 0x00, 0x50, 0x1F, 0x06, 0x01, 0x00, 0x50, 0x1F, 0x07, 0x01,
+			0x00, 0x50, 0x1F, 0x08, 0x01, 0x00, 0x50, 0x1F, 0x09, 0x01, 0x00, 0x4B, 0x50, 0x09, 0x09, 0x09, 0x09, 0x09 } },
+		{ { repeated.begin(), repeated.end() },
+		  { 0xFF, 0x1E, 0x54, 0x68, 0x65, 0x20, 0x71, 0x75, 0x69, 0x63, 0x6B, 0x20, 0x62, 0x72, 0x6F, 0x77, 0x6E, 0x20, 0x66,
+			0x6F, 0x78, 0x20, 0x6A, 0x75, 0x6D, 0x70, 0x73, 0x20, 0x6F, 0x76, 0x65, 0x72, 0x20, 0x74, 0x68, 0x65, 0x20, 0x6C,
+			0x61, 0x7A, 0x79, 0x20, 0x64, 0x6F, 0x67, 0x2E, 0x20, 0x2D, 0x00, 0xFF, 0x24, 0x50, 0x64, 0x6F, 0x67, 0x2E, 0x20 } },
+	};
+	for( const auto& sample : samples ) {
+		std::vector<comm::byte> output( sample.raw.size() );
+		bool decompressed = compression::Lz4Decompress( sample.block.data(), sample.block.size(), output.data(),
+														output.size() );
+		assert( decompressed && output == sample.raw );
+
+		// compressed block of this build is read back and is not larger than the reference one by much
+		std::vector<comm::byte> compressed( compression::Bound( ECodec::LZ4, sample.raw.size() ) );
+		std::vector<uint32_t> table( compression::Lz4TableSize );
+		size_t size = compression::Lz4Compress( sample.raw.data(), sample.raw.size(), compressed.data(),
+												compressed.size(), table.data() );
+		assert( size != 0 && size <= sample.block.size() * 2 );
+		std::fill( output.begin(), output.end(), 0 );
+		decompressed = compression::Lz4Decompress( compressed.data(), size, output.data(), output.size() );
+		assert( decompressed && output == sample.raw );
+	}
+	// broken blocks: offset 0, offset before the start, literals past the end of block
+	for( const std::vector<comm::byte>& block : std::initializer_list<std::vector<comm::byte>>{
+			 { 0x3F, 0x61, 0x62, 0x63, 0x00, 0x00, 0x05, 0x50, 0x68, 0x65, 0x6C, 0x6C, 0x6F },
+			 { 0x3F, 0x61, 0x62, 0x63, 0x04, 0x00, 0x05, 0x50, 0x68, 0x65, 0x6C, 0x6C, 0x6F },
+			 { 0x3F, 0x61, 0x62, 0x63, 0x03, 0x00, 0x05, 0x60, 0x68, 0x65, 0x6C, 0x6C, 0x6F } } ) {
+		std::vector<comm::byte> output( abc.size() );
+		bool decompressed = compression::Lz4Decompress( block.data(), block.size(), output.data(), output.size() );
+		assert( !decompressed );
+	}
+
+	// compressed array claims 1 GB of raw data, it is not allocated before blocks are read
+	{
+		std::vector<comm::byte> output;
+		SinkChunkWriter<VectorSink> writer{ VectorSink( output ), EEncoding::Compact };
+		compression::Header header = {};
+		header.codec = static_cast<comm::byte>( ECodec::LZ4 );
+		header.raw_size = static_cast<uint32_t>( compression::MaxSize );
+		header.block_size = static_cast<uint32_t>( compression::BlockSize );
+		bool res = writer.WriteBlock( header );
+		res &= writer.Write( std::vector<comm::byte>( 1000, 0x42 ) );
+		writer.Flush();
+		assert( res );
+
+		ChunkReader reader( output.data(), output.size(), EEncoding::Compact );
+		std::vector<comm::byte> loaded;
+		bool loaded_ok = reader.Read( loaded );
+		assert( !loaded_ok && loaded.capacity() <= compression::BlockSize * 2 );
+	}
+
+	// objects are compressed by blocks and read back from contiguous memory and from packets
+	MF_FRAME frame;
+	frame.time = { 5, 6 };
+	frame.str_user_props = "props";
+	frame.vec_video_data.resize( compression::BlockSize * 2 + 1000 );
+	for( size_t n = 0; n < frame.vec_video_data.size(); n++ ) {
+		frame.vec_video_data[ n ] = static_cast<comm::byte>( ( n / 32 ) % 7 );
+	}
+	frame.vec_audio_data = noise;
+
+	MF_BUFFER buffer;
+	buffer.flags = eMFBF_SideData;
+	buffer.data.assign( 1000, 0x42 );
+
+	for( auto codec : codecs ) {
+		for( auto encoding : { EEncoding::Fixed, EEncoding::Compact } ) {
+			for( const MF_BASE_TYPE* obj : std::initializer_list<const MF_BASE_TYPE*>{ &frame, &buffer } ) {
+				std::vector<comm::byte> output;
+				SinkChunkWriter<VectorSink> writer{ VectorSink( output ), encoding };
+				writer.EnableCompression( codec );
+				bool res = obj->Write( writer );
+				writer.Flush();
+				assert( res && output.size() < obj->EncodedSize( encoding ) );
+
+				ChunkReader reader( output.data(), output.size(), encoding );
+				auto loaded = MF_BASE_TYPE::CreateByObjectType( obj->GetObjectType() );
+				bool loaded_ok = loaded->Load( reader );
+				assert( loaded_ok );
+				assert( loaded->EncodedSize( encoding ) == obj->EncodedSize( encoding ) );
+
+				std::vector<comm::NetBufferRef> packets;
+				for( size_t pos = 0; pos < output.size(); pos += 1400 ) {
+					packets.push_back( { output.data() + pos, std::min<size_t>( 1400, output.size() - pos ) } );
+				}
+				comm::ConstNetBufferSeq seq;
+				for( const auto& el : packets ) {
+					seq.push_back( &el );
+				}
+				ChunkReader packets_reader( seq, encoding );
+				auto loaded_packets = MF_BASE_TYPE::CreateByObjectType( obj->GetObjectType() );
+				loaded_ok = loaded_packets->Load( packets_reader );
+				assert( loaded_ok );
+
+				if( obj == &frame ) {
+					for( const auto& el : { loaded, loaded_packets } ) {
+						auto loaded_frame = std::dynamic_pointer_cast<MF_FRAME>( el );
+						assert( loaded_frame->time.rtEndTime == 6 && loaded_frame->str_user_props == "props" );
+						assert( loaded_frame->vec_video_data == frame.vec_video_data );
+						assert( loaded_frame->vec_audio_data == frame.vec_audio_data );
+					}
+				} else {
+					auto loaded_buffer = std::dynamic_pointer_cast<MF_BUFFER>( loaded_packets );
+					assert( loaded_buffer->flags == eMFBF_SideData && loaded_buffer->data == buffer.data );
+				}
+			}
+		}
+	}
+}
+
+void TestVideoLayout() {
+	using namespace comm::utils;
+
+	// odd width: chroma rows are rounded up, the smallest stride of planar formats is even
+	auto i420 = video::GetLayout( eMFCC_I420, 101, 7, 128 );
+	assert( i420.planes == 3 && i420.plane[ 1 ].row_size == 51 && i420.plane[ 1 ].rows == 4 );
+	assert( i420.plane[ 1 ].stride == 64 && i420.size == 128 * 7 + 64 * 4 * 2 );
+	assert( video::PackedRowBytes( eMFCC_I420, 101 ) == 102 );
+	assert( !video::GetLayout( eMFCC_I420, 101, 7, 101 ).IsKnown() );
+	auto nv12 = video::GetLayout( eMFCC_NV12, 101, 7, 128 );
+	assert( nv12.planes == 2 && nv12.plane[ 1 ].row_size == 102 && nv12.size == 128 * 11 );
+	assert( video::GetLayout( eMFCC_YUY2, 101, 7, 256 ).plane[ 0 ].row_size == 204 );
+	assert( video::GetLayout( eMFCC_RGB32, 101, 7, 404 ).size == 404 * 7 );
+	assert( !video::GetLayout( eMFCC_Default, 101, 7, 404 ).IsKnown() );
+
+	for( auto fcc : { eMFCC_I420, eMFCC_NV12, eMFCC_UYVY, eMFCC_RGB24 } ) {
+		MF_FRAME frame;
+		frame.av_props.vidProps = { fcc, 101, 7, 400, 1, 1, 25.0 };
+		frame.str_user_props = "props";
+		auto layout = video::GetLayout( fcc, 101, 7, 400 );
+		assert( layout.IsKnown() );
+		frame.vec_video_data.assign( layout.size, 0xEE );
+		for( size_t p = 0; p < layout.planes; p++ ) {
+			for( size_t row = 0; row < layout.plane[ p ].rows; row++ ) {
+				for( size_t n = 0; n < layout.plane[ p ].row_size; n++ ) {
+					frame.vec_video_data[ layout.plane[ p ].offset + row * layout.plane[ p ].stride + n ] =
+						static_cast<comm::byte>( p * 50 + row * 3 + n );
+				}
+			}
+		}
+		frame.vec_audio_data.assign( 10, 0x11 );
+
+		// visible pixels of all rows
+		auto visible = []( const MF_FRAME& f ) {
+			const auto& vid = f.av_props.vidProps;
+			auto l = video::GetLayout( vid.fccType, vid.nWidth, vid.nHeight, vid.nRowBytes );
+			assert( l.size == f.vec_video_data.size() );
+			std::vector<comm::byte> pixels;
+			for( size_t p = 0; p < l.planes; p++ ) {
+				for( size_t row = 0; row < l.plane[ p ].rows; row++ ) {
+					auto begin = f.vec_video_data.begin() + l.plane[ p ].offset + row * l.plane[ p ].stride;
+					pixels.insert( pixels.end(), begin, begin + l.plane[ p ].row_size );
+				}
+			}
+			return pixels;
+		};
+
+		for( auto codec : { ECodec::None, ECodec::LZ4 } ) {
+			for( auto encoding : { EEncoding::Fixed, EEncoding::Compact } ) {
+				std::vector<comm::byte> output;
+				SinkChunkWriter<VectorSink> writer{ VectorSink( output ), encoding };
+				writer.EnableCompression( codec );
+				bool res = frame.Write( writer );
+				writer.Flush();
+				assert( res );
+				if( codec == ECodec::None ) {
+					// padding is not sent
+					assert( output.size() == frame.EncodedSize( encoding ) );
+					assert( output.size() < layout.size );
+				}
+
+				for( int row_bytes : { -1, 0, 512 } ) {
+					std::vector<comm::NetBufferRef> packets;
+					for( size_t pos = 0; pos < output.size(); pos += 100 ) {
+						packets.push_back( { output.data() + pos, std::min<size_t>( 100, output.size() - pos ) } );
+					}
+					comm::ConstNetBufferSeq seq;
+					for( const auto& el : packets ) {
+						seq.push_back( &el );
+					}
+					ChunkReader reader( seq, encoding );
+					MF_FRAME loaded;
+					bool loaded_ok = loaded.Load( reader, row_bytes );
+					assert( loaded_ok );
+					int expected = row_bytes < 0 ? 400 : std::max( row_bytes, video::PackedRowBytes( fcc, 101 ) );
+					assert( loaded.av_props.vidProps.nRowBytes == expected );
+					assert( loaded.str_user_props == "props" && loaded.vec_audio_data == frame.vec_audio_data );
+					assert( visible( loaded ) == visible( frame ) );
+				}
+			}
+		}
+	}
+
+	// forged properties: dimensions above the limit and strides which overflow size
+	assert( video::PackedRowBytes( eMFCC_RGB32, std::numeric_limits<int>::max() ) == 0 );
+	assert( !video::GetLayout( eMFCC_RGB32, video::MaxDimension + 1, 7, ( video::MaxDimension + 1 ) * 4 ).IsKnown() );
+	assert( !video::GetLayout( eMFCC_I420, 101, video::MaxDimension + 1, 128 ).IsKnown() );
+	assert( !video::GetLayout( eMFCC_RGB32, 101, 7, std::numeric_limits<int>::max() ).IsKnown() );
+	assert( video::GetLayout( eMFCC_RGB32, video::MaxDimension, 2, video::MaxRowBytes ).size ==
+			static_cast<size_t>( video::MaxRowBytes ) * 2 );
+
+	// header and array prefix claim 1 GB of video, the stream has a few bytes: nothing is allocated
+	for( bool matching_size : { true, false } ) {
+		MF_FRAME forged;
+		forged.av_props.vidProps = { eMFCC_RGB32, 16384, 16384, 16384 * 4, 1, 1, 25.0 };
+		MFFrameHeader header = MFFrameHeader::From( forged.time, forged.av_props );
+		header.source_row_bytes = 16384 * 4;
+		std::vector<comm::byte> output;
+		{
+			SinkChunkWriter<VectorSink> writer{ VectorSink( output ), EEncoding::Compact };
+			bool res = writer.WriteBlock( header );
+			res &= writer.Write( std::string( "props" ) );
+			writer.Flush();
+			assert( res );
+		}
+		size_t claimed = matching_size ? size_t( 16384 ) * 16384 * 4 : 1000;
+		comm::byte prefix[ compact::MaxPrefixSize ];
+		size_t prefix_size = compact::PutPrefix( static_cast<comm::byte>( traits::ETypes::BytesArray ), claimed, prefix );
+		output.insert( output.end(), prefix, prefix + prefix_size );
+		output.insert( output.end(), 1000, 0x55 );
+
+		ChunkReader reader( output.data(), output.size(), EEncoding::Compact );
+		MF_FRAME loaded;
+		bool loaded_ok = loaded.Load( reader, -1 );
+		assert( !loaded_ok && loaded.vec_video_data.capacity() == 0 );
+	}
+}
+
+void TestFrameDelta() {
+	using namespace comm::utils;
+
+	MF_FRAME frame;
+	frame.av_props.vidProps = { eMFCC_RGB32, 200, 64, 1024, 1, 1, 25.0 };
+	frame.vec_video_data.assign( 1024 * 64, 0 );
+	for( size_t row = 0; row < 64; row++ ) {
+		for( size_t n = 0; n < 800; n++ ) {
+			frame.vec_video_data[ row * 1024 + n ] = static_cast<comm::byte>( row + n );
+		}
+	}
+
+	FrameDeltaEncoder encoder( 3 );
+	FrameDeltaDecoder decoder;
+	auto encode = [&]( size_t* size ) {
+		std::vector<comm::byte> output;
+		SinkChunkWriter<VectorSink> writer{ VectorSink( output ), EEncoding::Compact };
+		bool res = encoder.Write( writer, frame );
+		writer.Flush();
+		assert( res );
+		if( size != nullptr ) {
+			*size = output.size();
+		}
+		return output;
+	};
+	auto decode = [&]( const std::vector<comm::byte>& output, std::vector<std::shared_ptr<MF_FRAME>>& frames ) {
+		ChunkReader reader( output.data(), output.size(), EEncoding::Compact );
+		frames.clear();
+		bool res = decoder.Load( reader, -1, frames );
+		assert( res );
+	};
+	auto transfer = [&]( bool deliver, size_t* size ) -> std::shared_ptr<MF_FRAME> {
+		auto output = encode( size );
+		if( !deliver ) {
+			return nullptr;
+		}
+		std::vector<std::shared_ptr<MF_FRAME>> frames;
+		decode( output, frames );
+		return frames.empty() ? nullptr : frames.back();
+	};
+
+	// keyframe
+	size_t key_size;
+	auto first = transfer( true, &key_size );
+	assert( first != nullptr && first->vec_video_data == frame.vec_video_data );
+
+	// changed tile only, previous frame held by caller is not changed
+	frame.vec_video_data[ 10 * 1024 + 500 ] = 0xFF;
+	frame.time = { 1, 2 };
+	size_t delta_size;
+	auto second = transfer( true, &delta_size );
+	assert( second != nullptr && second != first && second->vec_video_data == frame.vec_video_data );
+	assert( second->time.rtStartTime == 1 && delta_size * 20 < key_size );
+	assert( first->vec_video_data[ 10 * 1024 + 500 ] != 0xFF );
+
+	// frame released by caller is updated in place
+	const MF_FRAME* second_ptr = second.get();
+	second.reset();
+	frame.vec_video_data[ 63 * 1024 + 799 ] = 0x01;
+	auto third = transfer( true, nullptr );
+	assert( third.get() == second_ptr && third->vec_video_data == frame.vec_video_data );
+
+	// keyframe after 3 deltas
+	size_t size;
+	transfer( true, &size );
+	assert( size * 20 < key_size );
+	transfer( true, &size );
+	assert( size > key_size / 2 );
+
+	// frames are dropped after missed frame until keyframe
+	frame.vec_video_data[ 0 ] = 0x02;
+	transfer( false, nullptr );
+	frame.vec_video_data[ 1 ] = 0x03;
+	auto dropped = transfer( true, nullptr );
+	assert( dropped == nullptr );
+	dropped = transfer( true, nullptr );
+	assert( dropped == nullptr );
+	auto key = transfer( true, nullptr );
+	assert( key != nullptr && key->vec_video_data == frame.vec_video_data );
+
+	// delta which comes ahead of a missed one waits for it, late delta does not break the reference
+	frame.vec_video_data[ 2 ] = 0x04;
+	auto late = encode( nullptr );
+	frame.vec_video_data[ 3 ] = 0x05;
+	auto ahead = encode( nullptr );
+	std::vector<std::shared_ptr<MF_FRAME>> frames;
+	decode( ahead, frames );
+	assert( frames.empty() );
+	decode( late, frames );
+	assert( frames.size() == 2 && frames[ 1 ]->vec_video_data == frame.vec_video_data );
+	assert( frames[ 0 ]->vec_video_data[ 2 ] == 0x04 && frames[ 0 ]->vec_video_data[ 3 ] != 0x05 );
+	decode( late, frames );
+	assert( frames.empty() );
+	frame.vec_video_data[ 4 ] = 0x06;
+	auto next = transfer( true, nullptr );
+	assert( next != nullptr && next->vec_video_data == frame.vec_video_data );
+
+	// the whole plane changes
+	std::fill( frame.vec_video_data.begin(), frame.vec_video_data.end(), 0x55 );
+	auto changed = transfer( true, nullptr );
+	assert( changed != nullptr );
+	auto layout = video::GetLayout( eMFCC_RGB32, 200, 64, 1024 );
+	assert( video::RowsEqual( changed->vec_video_data.data(), 1024, frame.vec_video_data.data(), 1024, 800, 64 ) );
+	assert( layout.size == changed->vec_video_data.size() );
+}
+
+void TestChunkReaderAndWriter() {
+	using namespace comm::utils;
+
+	struct Buf {
+		std::vector<comm::byte> buffer;
+		comm::NetBufferRef ref;
+	};
+
+	std::string str{ "string6789ABCDEF0123" };
+	std::string emptystr;
+	std::string zerostr{ "" };
+	std::vector<comm::byte> bb{ 0x00, 0x55, 0xAA };
+
+	for( size_t sz = 1; sz <= 50; sz++ ) {
+		std::vector<std::unique_ptr<Buf>> buffers;
+		auto allocator = [&]( size_t size ) -> comm::NetBufferRef* {
+			buffers.emplace_back( new Buf() );
+			auto& buf = buffers.back();
+			buf->buffer.resize( sz );
+			buf->ref.data = buf->buffer.data();
+			buf->ref.size = buf->buffer.size();
+			return &buf->ref;
+		};
+
+		auto writer = []( comm::NetBufferRef* buf, size_t len ) { buf->size = len; };
+
+		ChunkWriter chunk_writer( allocator, writer );
+		bool res = chunk_writer.Write( (uint32_t)1000 );
+		res &= chunk_writer.Write( (char)'a' );
+		res &= chunk_writer.Write( (char)'b' );
+		res &= chunk_writer.Write( str );
+		res &= chunk_writer.Write( emptystr );
+		res &= chunk_writer.Write( zerostr );
+		res &= chunk_writer.Write( bb );
+		chunk_writer.Flush();
+
+		size_t total_size = 0;
+		std::vector<comm::byte> output;
+		std::for_each( buffers.begin(), buffers.end(), [&]( const auto& el ) {
+			total_size += el->ref.size;
+			output.insert( output.end(), el->buffer.begin(), el->buffer.begin() + el->ref.size );
+		} );
+
+		assert( total_size == 64 );
+
+		size_t num_buffers = ( total_size + sz - 1 ) / sz;
+		assert( num_buffers == buffers.size() );
+
+		ConstNetBufferSeq seq;
+		for( const auto& el : buffers ) {
+			seq.push_back( &el->ref );
+		}
+		ChunkReader chunk_reader( seq );
+
+		uint32_t read_uint32;
+		res = chunk_reader.Read( read_uint32 );
+		assert( read_uint32 == 1000 );
+
+		char read_c0;
+		res &= chunk_reader.Read( read_c0 );
+		assert( read_c0 == 'a' );
+
+		char read_c1;
+		res &= chunk_reader.Read( read_c1 );
+		assert( read_c1 == 'b' );
+
+		std::string read_str;
+		res &= chunk_reader.Read( read_str );
+		assert( read_str == str );
+
+		std::string read_strempty;
+		res &= chunk_reader.Read( read_strempty );
+		assert( read_strempty == emptystr );
+
+		std::string read_strzero;
+		res &= chunk_reader.Read( read_strzero );
+		assert( read_strzero == zerostr );
+
+		std::vector<byte> read_vec;
+		res &= chunk_reader.Read( read_vec );
+		assert( read_vec == bb );
+	}
+}
+
+void TestLog() {
+	namespace log = comm::utils::log;
+
+	std::mutex lines_lock;
+	std::vector<std::string> lines;
+	log::SetSink( [&]( const std::string& line ) {
+		std::unique_lock lock( lines_lock );
+		lines.push_back( line );
+	} );
+	auto level = log::GetLevel();
+	log::SetLevel( log::Level::Info );
+
+	MFPIPE_LOG( Debug, "hidden", { "value", 1 } );
+	MFPIPE_LOG( Info, "event", { "int", -5 }, { "uint", 7u }, { "str", std::string( "abc" ) },
+				{ "err", Error::Expired } );
+	log::Flush();
+	assert( lines.size() == 1 );
+	assert( lines[ 0 ].find( " INFO " ) != std::string::npos );
+	assert( lines[ 0 ].find( "event int=-5 uint=7 str=abc err=" ) != std::string::npos );
+
+	// records of finished thread are delivered, overflow of its ring is counted
+	constexpr size_t count = 3000;
+	uint64_t dropped = log::Dropped();
+	std::thread( [&]() {
+		for( size_t i = 0; i < count; i++ ) {
+			MFPIPE_LOG( Warning, "burst", { "i", i } );
+		}
+	} ).join();
+	log::Flush();
+	assert( lines.size() - 1 + ( log::Dropped() - dropped ) == count );
+
+	log::SetLevel( level );
+	log::SetSink( nullptr );
+}
+
+void TestTraceHistogram() {
+	using comm::utils::trace::Histogram;
+
+	// buckets are contiguous and ordered, values below 2^SubBits are exact
+	for( int64_t v : { 0ll, 1ll, 63ll, 64ll, 65ll, 127ll, 128ll, 1000ll, 1000000ll, 123456789012ll } ) {
+		size_t index = Histogram::BucketIndex( v );
+		assert( Histogram::BucketUpper( index ) >= v );
+		assert( index == 0 || Histogram::BucketUpper( index - 1 ) < v );
+		assert( v >= static_cast<int64_t>( Histogram::SubCount ) || Histogram::BucketUpper( index ) == v );
+	}
+	assert( Histogram::BucketIndex( INT64_MAX ) == Histogram::BucketsCount - 1 );
+
+	Histogram h;
+	assert( h.Count() == 0 && h.Percentile( 0.5 ) == 0 && h.Min() == 0 );
+	for( int64_t v = 1; v <= 10000; v++ ) {
+		h.Record( v * 1000 );
+	}
+	h.Record( -5 );
+	assert( h.Count() == 10001 && h.Min() == 0 && h.Max() == 10000000 );
+	// within precision of bucket
+	constexpr int64_t sub_count = static_cast<int64_t>( Histogram::SubCount );
+	int64_t p50 = h.Percentile( 0.5 );
+	assert( p50 >= 5000000 && p50 <= 5000000 + 5000000 / sub_count );
+	int64_t p99 = h.Percentile( 0.99 );
+	assert( p99 >= 9900000 && p99 <= 9900000 + 9900000 / sub_count );
+	assert( h.Percentile( 1.0 ) == h.Max() );
+	h.Reset();
+	assert( h.Count() == 0 && h.Max() == 0 );
+}
+
+void TestMetricsWriter() {
+	namespace metrics = comm::utils::metrics;
+
+	comm::utils::trace::Histogram h;
+	h.Record( 500 );
+	h.Record( 2000000 );
+
+	// samples of family are grouped, label values are escaped
+	metrics::Writer writer;
+	writer.Counter( "b_packets", "Packets", { { "pipe", "a\"b" } }, 5 );
+	writer.Gauge( "a_depth", "Depth", {}, 2 );
+	writer.Counter( "b_packets", "Packets", { { "pipe", "c" } }, 7 );
+	writer.Histogram( "c_seconds", "Time", { { "stage", "x" } }, h );
+	std::string text = writer.Text();
+	std::string head = "# TYPE a_depth gauge\n# HELP a_depth Depth\na_depth 2\n# TYPE b_packets counter\n"
+					   "# HELP b_packets Packets\n";
+	assert( text.compare( 0, head.size(), head ) == 0 );
+	assert( text.find( "b_packets_total{pipe=\"a\\\"b\"} 5\nb_packets_total{pipe=\"c\"} 7\n" ) != std::string::npos );
+	assert( text.find( "c_seconds_bucket{stage=\"x\",le=\"1e-06\"} 1\n" ) != std::string::npos );
+	assert( text.find( "c_seconds_bucket{stage=\"x\",le=\"0.0025\"} 2\n" ) != std::string::npos );
+	assert( text.find( "c_seconds_bucket{stage=\"x\",le=\"+Inf\"} 2\nc_seconds_count{stage=\"x\"} 2\n" ) !=
+			std::string::npos );
+	assert( text.compare( text.size() - 6, 6, "# EOF\n" ) == 0 );
+}
+
+void TestNetSimulator() {
+	using namespace comm::net;
+	using Clock = std::chrono::steady_clock;
+
+	NetSimSettings settings;
+	utils::Params params = utils::Params::Parse( "loss=25%&delay=20ms&jitter=5ms&rate=10mbit&seed=3" );
+	bool parsed = NetSimSettings::Parse( params, settings );
+	assert( parsed );
+	assert( settings.loss == 0.25 && settings.delay.count() == 20000 && settings.jitter.count() == 5000 &&
+			settings.rate == 10000000 && settings.seed == 3 );
+	parsed = NetSimSettings::Parse( utils::Params::Parse( "delay=5min" ), settings );
+	assert( !parsed );
+	parsed = NetSimSettings::Parse( utils::Params::Parse( "rate=fast" ), settings );
+	assert( !parsed );
+	parsed = NetSimSettings::Parse( params, settings );
+	assert( parsed );
+
+	auto receiver = SocketUDP::Create();
+	assert( receiver != nullptr );
+	SocketAddress::Ptr address = SocketAddress::Parse( "127.0.0.1", 12361 )[ 0 ];
+	Error err = receiver->Bind( address );
+	assert( err == Error::Ok );
+	auto sender = SocketUDP::Create();
+	assert( sender != nullptr );
+	const sockaddr& to = address->GetSockAddress();
+
+	// the same seed gives the same losses
+	constexpr int count = 200;
+	uint64_t lost = 0;
+	for( int run = 0; run < 2; run++ ) {
+		NetSimulator simulator( settings, sender->GetSocket() );
+		auto started = Clock::now();
+		for( int i = 0; i < count; i++ ) {
+			char data[ 1000 ] = { static_cast<char>( i ) };
+			int sent = simulator.Send( data, sizeof( data ), to );
+			assert( sent == sizeof( data ) );
+		}
+		assert( run == 0 || simulator.GetLost() == lost );
+		lost = simulator.GetLost();
+		assert( lost > count / 8 && lost < count / 2 );
+
+		int received = 0;
+		bool early = false;
+		char buf[ 1500 ];
+		while( receiver->WaitReadable( 200 ) ) {
+			if( ::recv( receiver->GetSocket(), buf, sizeof( buf ), 0 ) == 1000 ) {
+				// not before delay - jitter
+				early |= Clock::now() - started < std::chrono::milliseconds( 15 );
+				received++;
+			}
+		}
+		assert( !early && received == count - static_cast<int>( lost ) );
+		// 1000 bytes at 10 mbit take 0.8 ms on the link
+		assert( Clock::now() - started >= std::chrono::milliseconds( ( count - lost ) * 8 / 10 ) );
+	}
+
+	sender->Close();
+	receiver->Close();
+}
+
+void TestCapture() {
+	using namespace utils::capture;
+
+	std::string path = "mfpipe_capture_unit.cap";
+	auto writer = Writer::Create( path, 1 );
+	assert( writer != nullptr );
+
+	// 64 KB segments, every buffer takes 20 KB, so entries go to several segments with padding
+	MF_BUFFER buffer;
+	buffer.flags = eMFBF_VideoData;
+	for( int i = 0; i < 10; i++ ) {
+		buffer.data.assign( 20000, static_cast<comm::byte>( i ) );
+		bool appended = writer->AppendObject( Direction::Sent, "data", buffer, 1000 + i );
+		assert( appended );
+		appended = writer->AppendMessage( Direction::Received, "events", "name", std::to_string( i ), 1000 + i );
+		assert( appended );
+	}
+	// the entry larger than segment takes own segment
+	buffer.data.assign( 200000, 0x55 );
+	bool appended = writer->AppendObject( Direction::Sent, "large", buffer, 2000 );
+	assert( appended );
+	assert( writer->GetCount() == 21 );
+
+	// not closed capture is scanned
+	auto reader = Reader::Open( path );
+	assert( reader != nullptr && !reader->IsIndexed() && reader->GetCount() == 21 );
+	reader.reset();
+
+	bool closed = writer->Close();
+	assert( closed );
+	appended = writer->AppendMessage( Direction::Sent, "events", "name", "", 0 );
+	assert( !appended );
+
+	reader = Reader::Open( path );
+	assert( reader != nullptr && reader->IsIndexed() && reader->GetCount() == 21 );
+	Entry entry;
+	for( int i = 0; i < 10; i++ ) {
+		bool found = reader->Get( i * 2, entry );
+		assert( found );
+		assert( entry.direction == Direction::Sent && entry.kind == Kind::Object && entry.channel == "data" &&
+				entry.time == 1000 + i );
+		auto loaded = std::dynamic_pointer_cast<MF_BUFFER>( Reader::LoadObject( entry ) );
+		assert( loaded != nullptr && loaded->flags == eMFBF_VideoData && loaded->data.size() == 20000 &&
+				loaded->data[ 19999 ] == static_cast<comm::byte>( i ) );
+
+		found = reader->Get( i * 2 + 1, entry );
+		assert( found );
+		std::string name;
+		std::string param;
+		assert( entry.direction == Direction::Received && entry.kind == Kind::Message );
+		bool loaded_message = Reader::LoadMessage( entry, name, param );
+		assert( loaded_message && name == "name" && param == std::to_string( i ) );
+		assert( Reader::LoadObject( entry ) == nullptr );
+	}
+	bool found = reader->Get( 20, entry );
+	assert( found && entry.channel == "large" && entry.size == buffer.EncodedSize( utils::EEncoding::Fixed ) );
+	found = reader->Get( 21, entry );
+	assert( !found );
+	reader.reset();
+	writer.reset();
+
+	assert( Reader::Open( "mfpipe_capture_missing.cap" ) == nullptr );
+	std::remove( path.c_str() );
+}
+
+void TestSpillQueue() {
+	using namespace comm::utils;
+
+	auto queue = SpillQueue::Create( "mfpipe_spill_unit", 1, false );
+	assert( queue != nullptr );
+
+	// records span staging blocks, segments and go to oversized segment
+	std::vector<size_t> sizes = { 10, 300000, 700000, 1, 1048576, 5000000, 123456, 0, 900000 };
+	std::vector<comm::byte> data;
+	std::vector<comm::byte> out;
+	SpillMeta meta;
+	for( int round = 0; round < 3; round++ ) {
+		for( size_t i = 0; i < sizes.size(); i++ ) {
+			data.assign( sizes[ i ], static_cast<comm::byte>( i + round ) );
+			if( !data.empty() ) {
+				data.back() = 0xEE;
+			}
+			// two buffers
+			size_t half = data.size() / 2;
+			NetBufferRef first{ data.data(), half };
+			NetBufferRef second{ data.data() + half, data.size() - half };
+			bool pushed = queue->Push( { &first, &second }, SpillMeta{ 1, static_cast<MessageID>( i ), 2, 3 } );
+			assert( pushed );
+
+			// read back half of records while writing
+			if( i % 2 == 1 ) {
+				bool popped = queue->Pop( out, meta );
+				assert( popped );
+				size_t index = meta.msg_id;
+				assert( out.size() == sizes[ index ] && meta.session == 1 && meta.tag == 2 && meta.time == 3 );
+				assert( out.empty() || out.back() == 0xEE );
+				assert( out.size() < 2 || out[ 0 ] == static_cast<comm::byte>( index + round ) );
+			}
+		}
+		size_t last = 0;
+		while( queue->Pop( out, meta ) ) {
+			assert( meta.msg_id >= last && out.size() == sizes[ meta.msg_id ] );
+			assert( out.size() < 2 || out[ 0 ] == static_cast<comm::byte>( meta.msg_id + round ) );
+			last = meta.msg_id;
+		}
+		// consumed segments are recycled, oversized ones are removed
+		assert( queue->Empty() && queue->GetBytes() == 0 && queue->GetSegments() <= SpillQueue::MaxFreeSegments );
+	}
+	queue.reset();
+	FILE *file = std::fopen( "mfpipe_spill_unit-0.spill", "rb" );
+	assert( file == nullptr );
+
+	// direct I/O (buffered writes where it is not supported)
+	queue = SpillQueue::Create( "mfpipe_spill_direct", 1, true );
+	assert( queue != nullptr );
+	for( size_t size : { 5000, 2000000, 700000 } ) {
+		data.assign( size, static_cast<comm::byte>( size ) );
+		NetBufferRef buffer{ data.data(), data.size() };
+		bool pushed = queue->Push( { &buffer }, SpillMeta{} );
+		assert( pushed );
+	}
+	for( size_t size : { 5000, 2000000, 700000 } ) {
+		bool popped = queue->Pop( out, meta );
+		assert( popped && out.size() == size );
+		assert( std::count( out.begin(), out.end(), static_cast<comm::byte>( size ) ) == static_cast<ptrdiff_t>( size ) );
+	}
+	queue.reset();
+}
+
+int TestMethod19() {
+	// Batch test
+	// objects put by PipePutBatch go in batch records, PipeGetBatch takes ready objects at once; records over spill
+	// limit are spilled as a whole
+
+	MFPipeImpl MFPipe_Read;
+	Error err = MFPipe_Read.PipeCreate( "udp://127.0.0.1:12365", "spill.audio=2&spill_dir=." );
+	assert( err == Error::Ok );
+
+	MFPipeImpl MFPipe_Write;
+	err = MFPipe_Write.PipeOpen( "udp://127.0.0.1:12365", 32, "batch_bytes=4096" );
+	assert( err == Error::Ok );
+
+	constexpr int batches = 10;
+	constexpr int batch_size = 100;
+	for( int n = 0; n < batches; n++ ) {
+		std::vector<std::shared_ptr<MF_BASE_TYPE>> objects;
+		for( int i = 0; i < batch_size; i++ ) {
+			auto buffer_in = std::make_shared<MF_BUFFER>();
+			// index of the object in the first bytes
+			int index = n * batch_size + i;
+			buffer_in->data.assign( 100, static_cast<comm::byte>( i ) );
+			buffer_in->data[ 0 ] = static_cast<comm::byte>( index & 0xFF );
+			buffer_in->data[ 1 ] = static_cast<comm::byte>( index >> 8 );
+			objects.push_back( buffer_in );
+		}
+		err = MFPipe_Write.PipePutBatch( "audio", objects, 1000, "" );
+		assert( err == Error::Ok );
+	}
+	err = MFPipe_Write.PipePutBatch( "audio", {}, 1000, "" );
+	assert( err == Error::Ok );
+
+	// objects of batch records are counted one by one
+	constexpr int count = batches * batch_size;
+	MFPipe::MF_PIPE_INFO info = {};
+	for( int i = 0; i < 100 && info.nObjectsHave < count; i++ ) {
+		std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+		err = MFPipe_Read.PipeInfoGet( nullptr, "audio", &info );
+		assert( err == Error::Ok );
+	}
+	assert( info.nObjectsHave == count );
+
+	auto index_of = []( const std::shared_ptr<MF_BASE_TYPE> &object ) {
+		auto buffer = std::dynamic_pointer_cast<MF_BUFFER>( object );
+		assert( buffer != nullptr && buffer->data.size() == 100 );
+		int index = buffer->data[ 0 ] | ( buffer->data[ 1 ] << 8 );
+		assert( buffer->data[ 99 ] == index % batch_size );
+		return index;
+	};
+
+	// objects of batch record are taken by PipeGet too
+	std::shared_ptr<MF_BASE_TYPE> object_out;
+	err = MFPipe_Read.PipeGet( "audio", object_out, 1000, "" );
+	assert( err == Error::Ok && index_of( object_out ) == 0 );
+	std::set<int> indexes{ 0 };
+	std::vector<std::shared_ptr<MF_BASE_TYPE>> objects_out;
+	while( indexes.size() < count ) {
+		err = MFPipe_Read.PipeGetBatch( "audio", objects_out, 300, 1000, "" );
+		assert( err == Error::Ok && !objects_out.empty() && objects_out.size() <= 300 );
+		for( const auto &object : objects_out ) {
+			indexes.insert( index_of( object ) );
+		}
+	}
+	assert( indexes.size() == count && *indexes.rbegin() == count - 1 );
+	err = MFPipe_Read.PipeInfoGet( nullptr, "audio", &info );
+	assert( err == Error::Ok && info.nObjectsHave == 0 );
+	err = MFPipe_Read.PipeGetBatch( "audio", objects_out, 300, 100, "" );
+	assert( err == Error::Timeout && objects_out.empty() );
+
+	// drained spill channel is not ready
+	intptr_t handle = -1;
+	err = MFPipe_Read.PipeReadyGet( &handle );
+	assert( err == Error::Ok && handle != -1 );
+#if defined( WIN32 )
+	assert( ::WaitForSingleObject( reinterpret_cast<HANDLE>( handle ), 0 ) == WAIT_TIMEOUT );
+#else
+	pollfd fd{ static_cast<int>( handle ), POLLIN, 0 };
+	assert( ::poll( &fd, 1, 0 ) == 0 );
+#endif
+
+	// listening side puts frames to connecting side
+	std::vector<std::shared_ptr<MF_BASE_TYPE>> frames;
+	for( int i = 0; i < 3; i++ ) {
+		auto frame = std::make_shared<MF_FRAME>();
+		frame->str_user_props = std::to_string( i );
+		frame->time.rtStartTime = i;
+		frames.push_back( frame );
+	}
+	err = MFPipe_Read.PipePutBatch( "video", frames, 1000, "" );
+	assert( err == Error::Ok );
+	for( int i = 0; i < 3; i++ ) {
+		err = MFPipe_Write.PipeGet( "video", object_out, 1000, "" );
+		assert( err == Error::Ok );
+		auto frame = std::dynamic_pointer_cast<MF_FRAME>( object_out );
+		assert( frame != nullptr && frame->str_user_props == std::to_string( i ) && frame->time.rtStartTime == i );
+	}
+
+	MFPipe_Write.PipeClose();
+	MFPipe_Read.PipeClose();
+
+	return 0;
+}
+int TestMethod20() {
+	// Event-driven consumer test
+	// objects/messages of channels with callbacks are delivered by executor, the rest is signaled by readiness
+	// descriptor and taken without waiting
+
+	MFPipeImpl MFPipe_Read;
+	Error err = MFPipe_Read.PipeCreate( "udp://127.0.0.1:12366", "executor_threads=2" );
+	assert( err == Error::Ok );
+
+	intptr_t handle = -1;
+	err = MFPipe_Read.PipeReadyGet( &handle );
+	assert( err == Error::Ok && handle != -1 );
+	auto wait_ready = [&]( int ms ) {
+#if defined( WIN32 )
+		return ::WaitForSingleObject( reinterpret_cast<HANDLE>( handle ), ms ) == WAIT_OBJECT_0;
+#else
+		pollfd fd{ static_cast<int>( handle ), POLLIN, 0 };
+		return ::poll( &fd, 1, ms ) == 1;
+#endif
+	};
+
+	constexpr int count = 50;
+	std::mutex lock;
+	std::condition_variable delivered;
+	std::vector<int> objects;
+	std::vector<std::string> messages;
+	std::atomic<int> running{ 0 };
+	std::atomic<bool> concurrent{ false };
+	err = MFPipe_Read.PipeCallbackSet(
+		"audio",
+		[&]( const std::string &channel, const std::shared_ptr<MF_BASE_TYPE> &object ) {
+			// callbacks of the channel are not called concurrently
+			concurrent = concurrent || running++ != 0;
+			auto buffer = std::dynamic_pointer_cast<MF_BUFFER>( object );
+			assert( channel == "audio" && buffer != nullptr && buffer->data.size() == 10 );
+			std::this_thread::sleep_for( std::chrono::microseconds( 100 ) );
+			running--;
+			std::unique_lock l( lock );
+			objects.push_back( buffer->data[ 0 ] );
+			delivered.notify_all();
+		},
+		[&]( const std::string &channel, const std::string &name, const std::string &param ) {
+			concurrent = concurrent || running++ != 0;
+			running--;
+			std::unique_lock l( lock );
+			messages.push_back( param );
+			delivered.notify_all();
+		} );
+	assert( err == Error::Ok );
+
+	MFPipeImpl MFPipe_Write;
+	err = MFPipe_Write.PipeOpen( "udp://127.0.0.1:12366", 32, "" );
+	assert( err == Error::Ok );
+
+	// nothing is waiting for PipeGet
+	assert( !wait_ready( 0 ) );
+
+	for( int i = 0; i < count; i++ ) {
+		auto buffer_in = std::make_shared<MF_BUFFER>();
+		buffer_in->data.assign( 10, static_cast<comm::byte>( i ) );
+		err = MFPipe_Write.PipePut( "audio", buffer_in, 1000, "" );
+		assert( err == Error::Ok );
+		err = MFPipe_Write.PipeMessagePut( "audio", "index", std::to_string( i ), 1000 );
+		assert( err == Error::Ok );
+	}
+	{
+		std::unique_lock l( lock );
+		bool res = delivered.wait_for( l, std::chrono::seconds( 5 ), [&]() {
+			return objects.size() == count && messages.size() == count;
+		} );
+		assert( res );
+		for( int i = 0; i < count; i++ ) {
+			assert( objects[ i ] == i && messages[ i ] == std::to_string( i ) );
+		}
+	}
+	assert( !concurrent );
+	assert( !wait_ready( 0 ) );
+	MFPipe::MF_PIPE_INFO info = {};
+	err = MFPipe_Read.PipeInfoGet( nullptr, "audio", &info );
+	assert( err == Error::Ok && info.nObjectsHave == 0 && info.nMessagesHave == 0 );
+
+	// other channels are signaled by the descriptor, reactor drains ready channels till Error::Timeout
+	constexpr int ready_count = 5;
+	auto buffer_in = std::make_shared<MF_BUFFER>();
+	for( int i = 0; i < ready_count; i++ ) {
+		buffer_in->data.assign( 10, static_cast<comm::byte>( i ) );
+		err = MFPipe_Write.PipePut( "video", buffer_in, 1000, "" );
+		assert( err == Error::Ok );
+		err = MFPipe_Write.PipeMessagePut( "control", "index", std::to_string( i ), 1000 );
+		assert( err == Error::Ok );
+	}
+	std::vector<int> video;
+	std::vector<std::string> control;
+	for( int i = 0; i < 20 && ( video.size() < ready_count || control.size() < ready_count ) && wait_ready( 1000 );
+		 i++ ) {
+		std::vector<std::string> channels;
+		err = MFPipe_Read.PipeReadyClear( &channels );
+		assert( err == Error::Ok );
+		for( const auto &channel : channels ) {
+			assert( channel == "video" || channel == "control" );
+			std::shared_ptr<MF_BASE_TYPE> object_out;
+			while( MFPipe_Read.PipeGet( channel, object_out, 0, "" ) == Error::Ok ) {
+				auto buffer = std::dynamic_pointer_cast<MF_BUFFER>( object_out );
+				assert( buffer != nullptr && channel == "video" );
+				video.push_back( buffer->data[ 0 ] );
+			}
+			assert( object_out == nullptr );
+			std::string name;
+			std::string param;
+			while( MFPipe_Read.PipeMessageGet( channel, &name, &param, 0 ) == Error::Ok ) {
+				assert( channel == "control" && name == "index" );
+				control.push_back( param );
+			}
+			assert( name.empty() && param.empty() );
+			std::vector<std::shared_ptr<MF_BASE_TYPE>> objects_out;
+			err = MFPipe_Read.PipeGetBatch( channel, objects_out, 10, 0, "" );
+			assert( err == Error::Timeout && objects_out.empty() );
+		}
+	}
+	assert( video.size() == ready_count && control.size() == ready_count );
+	for( int i = 0; i < ready_count; i++ ) {
+		assert( video[ i ] == i && control[ i ] == std::to_string( i ) );
+	}
+	err = MFPipe_Read.PipeReadyClear( nullptr );
+	assert( err == Error::Ok && !wait_ready( 0 ) );
+
+	// no wait for empty channel
+	auto started = std::chrono::steady_clock::now();
+	std::shared_ptr<MF_BASE_TYPE> object_out = buffer_in;
+	err = MFPipe_Read.PipeGet( "video", object_out, 0, "" );
+	assert( err == Error::Timeout && object_out == nullptr );
+	assert( std::chrono::steady_clock::now() - started < std::chrono::milliseconds( 50 ) );
+
+	// callbacks are removed, objects wait for PipeGet
+	err = MFPipe_Read.PipeCallbackSet( "audio", nullptr, nullptr );
+	assert( err == Error::Ok );
+	err = MFPipe_Write.PipePut( "audio", buffer_in, 1000, "" );
+	assert( err == Error::Ok );
+	err = MFPipe_Read.PipeGet( "audio", object_out, 1000, "" );
+	assert( err == Error::Ok && object_out != nullptr );
+	assert( objects.size() == count );
+
+	MFPipe_Write.PipeClose();
+	MFPipe_Read.PipeClose();
+
+	return 0;
+}
+int TestMethod21() {
+	// Session removal test
+	// listening side removes session of closed peer right away and of silent peer by session timeout, together with
+	// its subscriptions, capabilities and delta decoders
+
+	// access to per session state
+	struct SessionsPipe : public MFPipeImpl {
+		size_t GetSubscribers() {
+			std::unique_lock lock( m_SubscriptionsLock );
+			size_t count = 0;
+			for( const auto& el : m_Subscriptions ) {
+				count += el.second.size();
+			}
+			return count;
+		}
+		size_t GetPeers() {
+			std::unique_lock lock( m_PeersLock );
+			return m_Peers.size();
+		}
+		size_t GetDeltaDecoders() {
+			std::unique_lock lock( m_ReceivingLock );
+			return m_DeltaDecoders.size();
+		}
+	};
+	SessionsPipe MFPipe_Read;
+	Error err = MFPipe_Read.PipeCreate( "udp://127.0.0.1:12367", "session_timeout=300" );
+	assert( err == Error::Ok );
+
+	auto connected = []( MFPipeImpl& pipe ) {
+		MFPipe::MF_PIPE_INFO info = {};
+		pipe.PipeInfoGet( nullptr, "", &info );
+		return info.nPipesConnected;
+	};
+	auto wait_for = []( int ms, const std::function<bool()>& check ) {
+		for( int i = 0; i < ms / 10 && !check(); i++ ) {
+			std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+		}
+		return check();
+	};
+
+	// the first peer sends keepalive packets, the second one does not
+	MFPipeImpl MFPipe_Alive;
+	err = MFPipe_Alive.PipeOpen( "udp://127.0.0.1:12367", 32, "session_timeout=300&channels=audio" );
+	assert( err == Error::Ok );
+	MFPipeImpl MFPipe_Silent;
+	err = MFPipe_Silent.PipeOpen( "udp://127.0.0.1:12367", 32, "session_timeout=0&channels=video&delta.video=1" );
+	assert( err == Error::Ok );
+	bool done = wait_for( 1000, [&]() { return connected( MFPipe_Silent ) == 1; } );
+	assert( done );
+
+	auto frame_in = std::make_shared<MF_FRAME>();
+	frame_in->av_props.vidProps = { eMFCC_I420, 64, 16, 64, 1, 1, 25.0 };
+	frame_in->vec_video_data.assign( 64 * 16 + 32 * 8 * 2, 0x80 );
+	err = MFPipe_Silent.PipePut( "video", frame_in, 100, "" );
+	assert( err == Error::Ok );
+	std::shared_ptr<MF_BASE_TYPE> frame_out;
+	err = MFPipe_Read.PipeGet( "video", frame_out, 1000, "" );
+	assert( err == Error::Ok && frame_out != nullptr );
+
+	assert( connected( MFPipe_Read ) == 2 );
+	done = wait_for( 1000, [&]() { return MFPipe_Read.GetSubscribers() == 2; } );
+	assert( done );
+	assert( MFPipe_Read.GetPeers() == 2 && MFPipe_Read.GetDeltaDecoders() == 1 );
+
+	// silent peer is removed after session timeout, the other one is kept alive
+	done = wait_for( 1000, [&]() { return connected( MFPipe_Read ) == 1; } );
+	assert( done );
+	std::this_thread::sleep_for( std::chrono::milliseconds( 400 ) );
+	assert( connected( MFPipe_Read ) == 1 );
+	assert( MFPipe_Read.GetSubscribers() == 1 && MFPipe_Read.GetPeers() == 1 && MFPipe_Read.GetDeltaDecoders() == 0 );
+
+	// closed peer says goodbye, it is removed before session timeout
+	MFPipe_Alive.PipeClose();
+	done = wait_for( 150, [&]() { return connected( MFPipe_Read ) == 0; } );
+	assert( done );
+	assert( MFPipe_Read.GetSubscribers() == 0 && MFPipe_Read.GetPeers() == 0 );
+
+	// nobody to send to, the object is dropped
+	err = MFPipe_Read.PipePut( "video", frame_in, 100, "" );
+	assert( err == Error::Ok );
+
+	MFPipe_Silent.PipeClose();
+	MFPipe_Read.PipeClose();
+
+	return 0;
+}
+
+int TestMethod22() {
+	// Delta late joiner test
+	// peer which connects while delta channel is sent gets keyframe, not delta against a frame it never had
+
+	MFPipeImpl MFPipe_Write;
+	Error err = MFPipe_Write.PipeCreate( "udp://127.0.0.1:12368", "delta.video=1&keyframe_interval=100" );
+	assert( err == Error::Ok );
+
+	auto connected = []( MFPipeImpl& pipe ) {
+		MFPipe::MF_PIPE_INFO info = {};
+		pipe.PipeInfoGet( nullptr, "", &info );
+		return info.nPipesConnected;
+	};
+	auto wait_for = []( int ms, const std::function<bool()>& check ) {
+		for( int i = 0; i < ms / 10 && !check(); i++ ) {
+			std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+		}
+		return check();
+	};
+
+	MFPipeImpl MFPipe_First;
+	err = MFPipe_First.PipeOpen( "udp://127.0.0.1:12368", 32, "" );
+	assert( err == Error::Ok );
+	bool joined = wait_for( 1000, [&]() { return connected( MFPipe_Write ) == 1; } );
+	assert( joined );
+
+	auto frame_in = std::make_shared<MF_FRAME>();
+	frame_in->av_props.vidProps = { eMFCC_I420, 320, 32, 320, 1, 1, 25.0 };
+	frame_in->vec_video_data.assign( 320 * 32 + 160 * 16 * 2, 0x80 );
+	auto put = [&]( int i ) {
+		frame_in->time = { i, i + 1 };
+		frame_in->vec_video_data[ i * 100 ] = static_cast<uint8_t>( i );
+		Error res = MFPipe_Write.PipePut( "video", frame_in, 100, "" );
+		assert( res == Error::Ok );
+	};
+	auto get = [&]( MFPipeImpl& pipe, int i ) {
+		std::shared_ptr<MF_BASE_TYPE> frame_out;
+		Error res = pipe.PipeGet( "video", frame_out, 1000, "" );
+		assert( res == Error::Ok );
+		auto frame = std::dynamic_pointer_cast<MF_FRAME>( frame_out );
+		assert( frame != nullptr && frame->time.rtStartTime == i );
+		assert( frame->vec_video_data == frame_in->vec_video_data );
+	};
+
+	for( int i = 0; i < 4; i++ ) {
+		put( i );
+		get( MFPipe_First, i );
+	}
+
+	MFPipeImpl MFPipe_Second;
+	err = MFPipe_Second.PipeOpen( "udp://127.0.0.1:12368", 32, "" );
+	assert( err == Error::Ok );
+	joined = wait_for( 1000, [&]() { return connected( MFPipe_Write ) == 2; } );
+	assert( joined );
+
+	for( int i = 4; i < 8; i++ ) {
+		put( i );
+		get( MFPipe_First, i );
+		get( MFPipe_Second, i );
+	}
+
+	MFPipe_Second.PipeClose();
+	MFPipe_First.PipeClose();
+	MFPipe_Write.PipeClose();
+
+	return 0;
+}
+
+int main( void ) {
+#if defined( WIN32 )
+	// TODO: Move this stuff to Transport implementation
+	WSADATA wsa_data;
+	int res = ::WSAStartup( MAKEWORD( 2, 2 ), &wsa_data );
+	if( res == 0 )
+#endif
+	{
+		TestChunkReaderAndWriter();
+		TestFrameSerialization();
+		TestSchemaSerialization();
+		TestCompactEncoding();
+		TestChunkSinks();
+		TestEncodedSize();
+		TestChecksum();
+		TestCompression();
+		TestVideoLayout();
+		TestFrameDelta();
+		TestSendingQueue();
+		TestReceivingQueue();
+		TestFECRecovery();
+		TestLog();
+		TestTraceHistogram();
+		TestMetricsWriter();
+		TestNetSimulator();
+		TestCapture();
+		TestSpillQueue();
+		TestExecutor();
+		if( TestMethod1() ) {
+			std::cerr << "TestMethod1: Failed" << std::endl;
+			return 1;
+		}
+		if( TestMethod2() ) {
+			std::cerr << "TestMethod2: Failed" << std::endl;
+			return 1;
+		}
+		if( TestMethod3() ) {
+			std::cerr << "TestMethod3: Failed" << std::endl;
+			return 1;
+		}
+		if( TestMethod4() ) {
+			std::cerr << "TestMethod4: Failed" << std::endl;
+			return 1;
+		}
+		if( TestMethod5() ) {
+			std::cerr << "TestMethod5: Failed" << std::endl;
+			return 1;
+		}
+		if( TestMethod6() ) {
+			std::cerr << "TestMethod6: Failed" << std::endl;
+			return 1;
+		}
+		if( TestMethod7() ) {
+			std::cerr << "TestMethod7: Failed" << std::endl;
+			return 1;
+		}
+		if( TestMethod8() ) {
+			std::cerr << "TestMethod8: Failed" << std::endl;
+			return 1;
+		}
+		if( TestMethod9() ) {
+			std::cerr << "TestMethod9: Failed" << std::endl;
+			return 1;
+		}
+		if( TestMethod10() ) {
+			std::cerr << "TestMethod10: Failed" << std::endl;
+			return 1;
+		}
+		if( TestMethod11() ) {
+			std::cerr << "TestMethod11: Failed" << std::endl;
+			return 1;
+		}
+		if( TestMethod12() ) {
+			std::cerr << "TestMethod12: Failed" << std::endl;
+			return 1;
+		}
+		if( TestMethod13() ) {
+			std::cerr << "TestMethod13: Failed" << std::endl;
+			return 1;
+		}
+		if( TestMethod14() ) {
+			std::cerr << "TestMethod14: Failed" << std::endl;
+			return 1;
+		}
+		if( TestMethod15() ) {
+			std::cerr << "TestMethod15: Failed" << std::endl;
+			return 1;
+		}
+		if( TestMethod16() ) {
+			std::cerr << "TestMethod16: Failed" << std::endl;
+			return 1;
+		}
+		if( TestMethod17() ) {
+			std::cerr << "TestMethod17: Failed" << std::endl;
+			return 1;
+		}
+		if( TestMethod18() ) {
+			std::cerr << "TestMethod18: Failed" << std::endl;
+			return 1;
+		}
+		if( TestMethod19() ) {
+			std::cerr << "TestMethod19: Failed" << std::endl;
+			return 1;
+		}
+		if( TestMethod20() ) {
+			std::cerr << "TestMethod20: Failed" << std::endl;
+			return 1;
+		}
+		if( TestMethod21() ) {
+			std::cerr << "TestMethod21: Failed" << std::endl;
+			return 1;
+		}
+		if( TestMethod22() ) {
+			std::cerr << "TestMethod22: Failed" << std::endl;
 			return 1;
 		}
 